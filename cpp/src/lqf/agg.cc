@@ -4,6 +4,10 @@
 
 #include "agg.h"
 #include <cstring>
+#include <limits>
+#include <typeinfo>
+#include "hash.h"
+#include "heap.h"
 
 #ifdef LQF_STAT
 
@@ -34,7 +38,57 @@ namespace lqf {
             value_ = 0;
         }
 
-        Count::Count() : AggField(1, 0) {}
+        unique_ptr<ColumnIterator> AggField::input(Block &block) {
+            return block.col(read_idx_);
+        }
+
+        void AggField::reduceBatch(ColumnIterator *, uint64_t *, const uint32_t *, uint32_t) {
+            throw std::invalid_argument("field has no columnar kernel");
+        }
+
+        double AggField::rankValue(const uint64_t *) {
+            throw std::invalid_argument("field is not monotone");
+        }
+
+        struct Plus {
+            template<typename T>
+            static inline T apply(T a, T b) { return a + b; }
+        };
+
+        struct Larger {
+            template<typename T>
+            static inline T apply(T a, T b) { return std::max(a, b); }
+        };
+
+        struct Smaller {
+            template<typename T>
+            static inline T apply(T a, T b) { return std::min(a, b); }
+        };
+
+        /// Accumulate a batch of column values into the fields at write_idx of their group rows
+        template<typename ACC, typename OP>
+        inline void reduceColumn(ColumnIterator *input, uint64_t *table, uint32_t write_idx,
+                                 const uint32_t *groups, uint32_t size) {
+            using type = typename ACC::type;
+            type values[AGG_BATCH_SIZE];
+            for (uint32_t i = 0; i < size; ++i) {
+                values[i] = ACC::get(input->next());
+            }
+            for (uint32_t i = 0; i < size; ++i) {
+                auto &acc = *reinterpret_cast<type *>(table + groups[i] + write_idx);
+                acc = OP::apply(acc, values[i]);
+            }
+        }
+
+        inline void countColumn(uint64_t *table, uint32_t write_idx, const uint32_t *groups, uint32_t size) {
+            for (uint32_t i = 0; i < size; ++i) {
+                *reinterpret_cast<int32_t *>(table + groups[i] + write_idx) += 1;
+            }
+        }
+
+        Count::Count() : AggField(1, 0) {
+            monotone_ = true;
+        }
 
         void Count::reduce(DataRow &input) {
             *value_.pointer_.ival_ += 1;
@@ -44,6 +98,22 @@ namespace lqf {
             *value_.pointer_.ival_ += static_cast<Count &>(another).value_.asInt();
         }
 
+        bool Count::columnar() {
+            return typeid(*this) == typeid(Count);
+        }
+
+        unique_ptr<ColumnIterator> Count::input(Block &) {
+            return nullptr;
+        }
+
+        void Count::reduceBatch(ColumnIterator *, uint64_t *table, const uint32_t *groups, uint32_t size) {
+            countColumn(table, write_idx_, groups, size);
+        }
+
+        double Count::rankValue(const uint64_t *row) {
+            return *reinterpret_cast<const int32_t *>(row + write_idx_);
+        }
+
         IntDistinctCount::IntDistinctCount(uint32_t read_idx)
                 : AggField(1, read_idx, true) {}
 
@@ -73,7 +143,91 @@ namespace lqf {
             value_ = static_cast<int32_t>(size);
         }
 
-        IntSum::IntSum(uint32_t read_idx) : AggField(1, read_idx) {}
+        inline uint64_t hashValue(int32_t value) {
+            return hash::fmix64(static_cast<uint32_t>(value));
+        }
+
+        inline uint64_t hashValue(double value) {
+            // Normalize -0.0 so it counts as 0.0
+            value += 0.0;
+            uint64_t bits;
+            memcpy(&bits, &value, sizeof(uint64_t));
+            return hash::fmix64(bits);
+        }
+
+        template<typename ACC>
+        ApproxDistinctCount<ACC>::ApproxDistinctCount(uint32_t read_idx, uint32_t precision)
+                : AggField(1, read_idx, true), precision_(precision) {}
+
+        template<typename ACC>
+        void ApproxDistinctCount<ACC>::attach(DataRow &target) {
+            AggField::attach(target);
+            hll_ = reinterpret_cast<sketch::HyperLogLog *>(*value_.pointer_.raw_);
+        }
+
+        template<typename ACC>
+        void ApproxDistinctCount<ACC>::init() {
+            hll_ = new sketch::HyperLogLog(precision_);
+            *value_.pointer_.raw_ = reinterpret_cast<uint64_t>(hll_);
+        }
+
+        template<typename ACC>
+        void ApproxDistinctCount<ACC>::reduce(DataRow &input) {
+            hll_->add(hashValue(ACC::get(input[read_idx_])));
+        }
+
+        template<typename ACC>
+        void ApproxDistinctCount<ACC>::merge(AggField &another) {
+            auto &a = static_cast<ApproxDistinctCount<ACC> &>(another);
+            hll_->merge(*a.hll_);
+            delete a.hll_;
+        }
+
+        template<typename ACC>
+        void ApproxDistinctCount<ACC>::dump() {
+            auto estimate = hll_->estimate();
+            delete hll_;
+            value_ = static_cast<int32_t>(estimate);
+        }
+
+        template<typename ACC>
+        Quantile<ACC>::Quantile(uint32_t read_idx, double rank, uint32_t k)
+                : AggField(1, read_idx, true), rank_(rank), k_(k) {}
+
+        template<typename ACC>
+        void Quantile<ACC>::attach(DataRow &target) {
+            AggField::attach(target);
+            sketch_ = reinterpret_cast<sketch::KllSketch *>(*value_.pointer_.raw_);
+        }
+
+        template<typename ACC>
+        void Quantile<ACC>::init() {
+            sketch_ = new sketch::KllSketch(k_);
+            *value_.pointer_.raw_ = reinterpret_cast<uint64_t>(sketch_);
+        }
+
+        template<typename ACC>
+        void Quantile<ACC>::reduce(DataRow &input) {
+            sketch_->add(ACC::get(input[read_idx_]));
+        }
+
+        template<typename ACC>
+        void Quantile<ACC>::merge(AggField &another) {
+            auto &a = static_cast<Quantile<ACC> &>(another);
+            sketch_->merge(*a.sketch_);
+            delete a.sketch_;
+        }
+
+        template<typename ACC>
+        void Quantile<ACC>::dump() {
+            auto result = sketch_->quantile(rank_);
+            delete sketch_;
+            value_ = result;
+        }
+
+        IntSum::IntSum(uint32_t read_idx, bool nonneg) : AggField(1, read_idx) {
+            monotone_ = nonneg;
+        }
 
         void IntSum::reduce(DataRow &input) {
             *value_.pointer_.ival_ += input[read_idx_].asInt();
@@ -83,7 +237,21 @@ namespace lqf {
             *value_.pointer_.ival_ += static_cast<IntSum &>(another).value_.asInt();
         }
 
-        DoubleSum::DoubleSum(uint32_t read_idx) : AggField(1, read_idx) {}
+        bool IntSum::columnar() {
+            return typeid(*this) == typeid(IntSum);
+        }
+
+        void IntSum::reduceBatch(ColumnIterator *input, uint64_t *table, const uint32_t *groups, uint32_t size) {
+            reduceColumn<AsInt, Plus>(input, table, write_idx_, groups, size);
+        }
+
+        double IntSum::rankValue(const uint64_t *row) {
+            return *reinterpret_cast<const int32_t *>(row + write_idx_);
+        }
+
+        DoubleSum::DoubleSum(uint32_t read_idx, bool nonneg) : AggField(1, read_idx) {
+            monotone_ = nonneg;
+        }
 
         void DoubleSum::reduce(DataRow &input) {
             *value_.pointer_.dval_ += input[read_idx_].asDouble();
@@ -93,6 +261,18 @@ namespace lqf {
             *value_.pointer_.dval_ += static_cast<DoubleSum &>(another).value_.asDouble();
         }
 
+        bool DoubleSum::columnar() {
+            return typeid(*this) == typeid(DoubleSum);
+        }
+
+        void DoubleSum::reduceBatch(ColumnIterator *input, uint64_t *table, const uint32_t *groups, uint32_t size) {
+            reduceColumn<AsDouble, Plus>(input, table, write_idx_, groups, size);
+        }
+
+        double DoubleSum::rankValue(const uint64_t *row) {
+            return *reinterpret_cast<const double *>(row + write_idx_);
+        }
+
         template<typename ACC>
         Avg<ACC>::Avg(uint32_t read_idx) : AggField(2, read_idx, true) {}
 
@@ -128,6 +308,17 @@ namespace lqf {
             count_ = 0;
         }
 
+        template<typename ACC>
+        bool Avg<ACC>::columnar() {
+            return typeid(*this) == typeid(Avg<ACC>);
+        }
+
+        template<typename ACC>
+        void Avg<ACC>::reduceBatch(ColumnIterator *input, uint64_t *table, const uint32_t *groups, uint32_t size) {
+            reduceColumn<ACC, Plus>(input, table, write_idx_, groups, size);
+            countColumn(table, write_idx_ + 1, groups, size);
+        }
+
         template<typename ACC>
         Max<ACC>::Max(uint32_t read_idx) : AggField(1, read_idx) {}
 
@@ -146,6 +337,16 @@ namespace lqf {
             value_ = std::max(ACC::get(value_), ACC::get(static_cast<Max<ACC> &>(another).value_));
         }
 
+        template<typename ACC>
+        bool Max<ACC>::columnar() {
+            return typeid(*this) == typeid(Max<ACC>);
+        }
+
+        template<typename ACC>
+        void Max<ACC>::reduceBatch(ColumnIterator *input, uint64_t *table, const uint32_t *groups, uint32_t size) {
+            reduceColumn<ACC, Larger>(input, table, write_idx_, groups, size);
+        }
+
         template<typename ACC>
         Min<ACC>::Min(uint32_t read_idx) : AggField(1, read_idx) {}
 
@@ -164,6 +365,16 @@ namespace lqf {
             value_ = std::min(ACC::get(value_), ACC::get(static_cast<Min<ACC> &>(another).value_));
         }
 
+        template<typename ACC>
+        bool Min<ACC>::columnar() {
+            return typeid(*this) == typeid(Min<ACC>);
+        }
+
+        template<typename ACC>
+        void Min<ACC>::reduceBatch(ColumnIterator *input, uint64_t *table, const uint32_t *groups, uint32_t size) {
+            reduceColumn<ACC, Smaller>(input, table, write_idx_, groups, size);
+        }
+
         AggReducer::AggReducer(const vector<uint32_t> &offset, Snapshoter *header_copier,
                                vector<AggField *> fields,
                                const vector<uint32_t> &fields_offset)
@@ -204,12 +415,16 @@ namespace lqf {
         }
 
         void AggReducer::init(DataRow &input) {
+            prepare(input);
+            reduce(input);
+        }
+
+        void AggReducer::prepare(DataRow &input) {
             (*header_copier_)(storage_, input);
             // Init the storage content as 0
             for (auto &field:fields_) {
                 field->init();
             }
-            reduce(input);
         }
 
 
@@ -501,6 +716,213 @@ namespace lqf {
             }
         }
 
+        BatchHashCore::BatchHashCore(const vector<uint32_t> &col_offset, unique_ptr<AggReducer> reducer,
+                                     function<uint64_t(DataRow &)> &hasher,
+                                     function<void(DataRow &, DataRow &)> *row_copier, bool need_dump)
+                : CoreBase(row_copier, need_dump), reducer_(move(reducer)), hasher_(hasher),
+                  row_size_(col_offset.back()) {
+            map_.set_empty_key(-1);
+        }
+
+        uint32_t BatchHashCore::locate(uint64_t key, DataRow &row) {
+            auto found = map_.find(key);
+            if (__builtin_expect(found != map_.end(), 1)) {
+                return found->second;
+            }
+            uint32_t offset = table_.size();
+            table_.resize(offset + row_size_);
+            reducer_->attach(table_.data() + offset);
+            reducer_->prepare(row);
+            map_[key] = offset;
+            return offset;
+        }
+
+        void BatchHashCore::reduce(DataRow &row) {
+            auto offset = locate(hasher_(row), row);
+            reducer_->attach(table_.data() + offset);
+            reducer_->reduce(row);
+        }
+
+        void BatchHashCore::reduce(Block &block) {
+            auto &fields = reducer_->fields();
+            auto num_fields = fields.size();
+            vector<unique_ptr<ColumnIterator>> inputs;
+            for (auto &field: fields) {
+                inputs.push_back(field->input(block));
+            }
+            auto rows = block.rows();
+            uint32_t groups[AGG_BATCH_SIZE];
+            uint64_t block_size = block.size();
+            for (uint64_t start = 0; start < block_size; start += AGG_BATCH_SIZE) {
+                uint32_t batch_size = std::min<uint64_t>(AGG_BATCH_SIZE, block_size - start);
+                for (uint32_t i = 0; i < batch_size; ++i) {
+                    DataRow &row = rows->next();
+                    groups[i] = locate(hasher_(row), row);
+                }
+                // The table does not grow while the kernels run
+                auto table = table_.data();
+                for (uint32_t f = 0; f < num_fields; ++f) {
+                    fields[f]->reduceBatch(inputs[f].get(), table, groups, batch_size);
+                }
+            }
+        }
+
+        void BatchHashCore::merge(BatchHashCore &another) {
+            for (auto &ite: another.map_) {
+                another.reducer_->attach(another.table_.data() + ite.second);
+                auto exist = map_.find(ite.first);
+                if (exist != map_.end()) {
+                    reducer_->attach(table_.data() + exist->second);
+                    reducer_->merge(*another.reducer_);
+                } else {
+                    uint32_t offset = table_.size();
+                    table_.insert(table_.end(), another.table_.data() + ite.second,
+                                  another.table_.data() + ite.second + row_size_);
+                    map_[ite.first] = offset;
+                }
+            }
+        }
+
+        void BatchHashCore::dump(MemTable &table, function<bool(DataRow &)> pred) {
+            auto block = table.allocate(map_.size());
+            auto writerows = block->rows();
+            auto storage = reducer_->storage();
+            uint32_t counter = 0;
+            for (uint32_t offset = 0; offset < table_.size(); offset += row_size_) {
+                reducer_->attach(table_.data() + offset);
+                if (need_dump_) {
+                    reducer_->dump();
+                }
+                if (!pred || pred(*storage)) {
+                    (*row_copier_)(writerows->next(), *storage);
+                    ++counter;
+                }
+            }
+            block->resize(counter);
+        }
+
+        KeyCore::KeyCore(function<void(DataRow &, DataRow &)> *row_copier, bool need_dump)
+                : CoreBase(row_copier, need_dump) {}
+
+        DictCore::DictCore(uint32_t num_groups, const vector<uint32_t> &col_offset, const vector<DictDim> &dims,
+                           unique_ptr<AggReducer> reducer, function<void(DataRow &, DataRow &)> *row_copier,
+                           bool need_dump)
+                : CoreBase(row_copier, need_dump), reducer_(move(reducer)), dims_(dims),
+                  row_size_(col_offset.back()), columnar_(true), table_(num_groups * row_size_),
+                  used_(num_groups, 0), size_(0), translations_(dims.size(), nullptr) {
+            for (auto &field: reducer_->fields()) {
+                columnar_ &= field->columnar();
+            }
+        }
+
+        uint32_t DictCore::locate(DataRow &row) {
+            uint32_t index = 0;
+            auto num_dims = dims_.size();
+            for (uint32_t d = 0; d < num_dims; ++d) {
+                auto &dim = dims_[d];
+                uint32_t code = (dim.raw_ ? row(dim.index_) : row[dim.index_]).asInt();
+                if (translations_[d]) {
+                    code = (*translations_[d])[code];
+                }
+                code -= dim.base_;
+                if (__builtin_expect(code >= dim.cardinality_, 0)) {
+                    throw invalid_argument("group key out of the dictionary range");
+                }
+                index = index * dim.cardinality_ + code;
+            }
+            uint32_t offset = index * row_size_;
+            if (!used_[index]) {
+                used_[index] = 1;
+                ++size_;
+                reducer_->attach(table_.data() + offset);
+                reducer_->prepare(row);
+            }
+            return offset;
+        }
+
+        void DictCore::reduce(DataRow &row) {
+            reducer_->attach(table_.data() + locate(row));
+            reducer_->reduce(row);
+        }
+
+        void DictCore::reduce(Block &block) {
+            auto masked = dynamic_cast<MaskedBlock *>(&block);
+            auto pblock = dynamic_cast<ParquetBlock *>(masked ? masked->inner().get() : &block);
+            for (uint32_t d = 0; d < dims_.size(); ++d) {
+                translations_[d] = nullptr;
+                if (pblock && dims_[d].raw_) {
+                    auto table = static_cast<ParquetTable *>(pblock->owner());
+                    translations_[d] = table->LoadGlobalDictionary(dims_[d].index_)->translation(pblock->index());
+                }
+            }
+            auto rows = block.rows();
+            uint64_t block_size = block.size();
+            if (!columnar_) {
+                for (uint64_t i = 0; i < block_size; ++i) {
+                    reduce(rows->next());
+                }
+                return;
+            }
+            auto &fields = reducer_->fields();
+            auto num_fields = fields.size();
+            vector<unique_ptr<ColumnIterator>> inputs;
+            for (auto &field: fields) {
+                inputs.push_back(field->input(block));
+            }
+            uint32_t groups[AGG_BATCH_SIZE];
+            auto table = table_.data();
+            for (uint64_t start = 0; start < block_size; start += AGG_BATCH_SIZE) {
+                uint32_t batch_size = std::min<uint64_t>(AGG_BATCH_SIZE, block_size - start);
+                for (uint32_t i = 0; i < batch_size; ++i) {
+                    groups[i] = locate(rows->next());
+                }
+                for (uint32_t f = 0; f < num_fields; ++f) {
+                    fields[f]->reduceBatch(inputs[f].get(), table, groups, batch_size);
+                }
+            }
+        }
+
+        void DictCore::merge(DictCore &another) {
+            auto num_groups = used_.size();
+            for (uint32_t i = 0; i < num_groups; ++i) {
+                if (!another.used_[i]) {
+                    continue;
+                }
+                auto offset = i * row_size_;
+                if (used_[i]) {
+                    reducer_->attach(table_.data() + offset);
+                    another.reducer_->attach(another.table_.data() + offset);
+                    reducer_->merge(*another.reducer_);
+                } else {
+                    memcpy(table_.data() + offset, another.table_.data() + offset, sizeof(uint64_t) * row_size_);
+                    used_[i] = 1;
+                    ++size_;
+                }
+            }
+        }
+
+        void DictCore::dump(MemTable &table, function<bool(DataRow &)> pred) {
+            auto block = table.allocate(size_);
+            auto writerows = block->rows();
+            auto storage = reducer_->storage();
+            auto num_groups = used_.size();
+            uint32_t counter = 0;
+            for (uint32_t i = 0; i < num_groups; ++i) {
+                if (!used_[i]) {
+                    continue;
+                }
+                reducer_->attach(table_.data() + i * row_size_);
+                if (need_dump_) {
+                    reducer_->dump();
+                }
+                if (!pred || pred(*storage)) {
+                    (*row_copier_)(writerows->next(), *storage);
+                    ++counter;
+                }
+            }
+            block->resize(counter);
+        }
+
         TableCore::TableCore(uint32_t table_size, const vector<uint32_t> &col_offset,
                              function<unique_ptr<AggReducer>()> reducer_gen, function<uint32_t(DataRow &)> &indexer,
                              function<void(DataRow &, DataRow &)> *row_copier, bool need_dump)
@@ -989,6 +1411,11 @@ namespace lqf {
 
     template<typename CORE>
     shared_ptr<Table> Agg<CORE>::agg(Table &input) {
+        return reduceBlocks(*input.blocks());
+    }
+
+    template<typename CORE>
+    shared_ptr<Table> Agg<CORE>::reduceBlocks(Stream<shared_ptr<Block>> &blocks, shared_ptr<CORE> seed) {
         function<shared_ptr<CORE>(
                 const shared_ptr<Block> &)> mapper = bind(&Agg::processBlock, this, _1);
 
@@ -996,10 +1423,20 @@ namespace lqf {
             a->merge(*b);
             return move(a);
         };
-        auto merged = input.blocks()->map(mapper)->reduce(reducer);
+        auto merged = move(seed);
+        if (!blocks.isEmpty()) {
+            auto reduced = blocks.map(mapper)->reduce(reducer);
+            if (merged) {
+                merged->merge(*reduced);
+            } else {
+                merged = move(reduced);
+            }
+        }
 
         auto result = MemTable::Make(col_size_, vertical_);
-        merged->dump(*result, predicate_);
+        if (merged) {
+            merged->dump(*result, predicate_);
+        }
 #ifdef LQF_STAT
         lqf::stat::MemEstimator::INST.Record("Agg", result->memrss());
 #endif
@@ -1042,6 +1479,278 @@ namespace lqf {
         return make_shared<HashCore>(col_offset_, rc, hasher_, row_copier_.get(), need_field_dump_);
     }
 
+    shared_ptr<Table> HashAgg::agg(Table &input) {
+        auto stream = input.blocks();
+        partitioned_ = false;
+        if (stream->isEmpty()) {
+            return reduceBlocks(*stream);
+        }
+        // Only the first block is read ahead, the others stay in the stream unless partitioning
+        auto first = stream->head();
+        partitioned_ = estimateGroups(*first) > AGG_PARTITION_THRESHOLD;
+        if (partitioned_) {
+            auto parallel = stream->isParallel();
+            auto blocks = stream->collect();
+            blocks->insert(blocks->begin(), first);
+            return partitionAgg(*blocks, parallel);
+        }
+        return reduceBlocks(*stream, processBlock(first));
+    }
+
+    uint64_t HashAgg::estimateGroups(Block &block) {
+        uint64_t block_size = block.size();
+        uint64_t sample_size = std::min<uint64_t>(block_size, AGG_SAMPLE_SIZE);
+        if (sample_size == 0) {
+            return 0;
+        }
+        unordered_set<uint64_t> sample;
+        auto rows = block.rows();
+        for (uint64_t i = 0; i < sample_size; ++i) {
+            sample.insert(hasher_(rows->next()));
+        }
+        // Repeated keys in the sample mean the groups are mostly seen already, and the distinct
+        // count of the sample grows much slower than the rows. Scaling it linearly overestimates.
+        if (sample.size() * 16 < sample_size * AGG_SAMPLE_DISTINCT) {
+            return sample.size();
+        }
+        return sample.size() * block_size / sample_size;
+    }
+
+    shared_ptr<vector<vector<uint64_t>>> HashAgg::preAgg(const shared_ptr<Block> &block) {
+        const uint32_t row_size = col_offset_.back();
+        // Each slot holds a group row followed by its key
+        const uint32_t stride = row_size + 1;
+        const uint32_t slot_mask = AGG_CACHE_SLOTS - 1;
+        const uint32_t partition_shift = 32 - AGG_PARTITION_BITS;
+
+        auto partitions = make_shared<vector<vector<uint64_t>>>(1 << AGG_PARTITION_BITS);
+        vector<uint64_t> cache(AGG_CACHE_SLOTS * stride);
+        vector<bool> used(AGG_CACHE_SLOTS, false);
+        auto reducer = createReducer();
+
+        auto spill = [&partitions, &cache, stride, partition_shift](uint32_t slot) {
+            auto entry = cache.data() + slot * stride;
+            auto key = entry[stride - 1];
+            auto &partition = (*partitions)[hash::crc32_hash(0, key) >> partition_shift];
+            partition.insert(partition.end(), entry, entry + stride);
+        };
+
+        auto rows = block->rows();
+        uint64_t block_size = block->size();
+        for (uint64_t i = 0; i < block_size; ++i) {
+            DataRow &row = rows->next();
+            uint64_t key = hasher_(row);
+            uint32_t slot = hash::crc32_hash(0, key) & slot_mask;
+            auto entry = cache.data() + slot * stride;
+            reducer->attach(entry);
+            if (used[slot] && entry[row_size] == key) {
+                reducer->reduce(row);
+            } else {
+                if (used[slot]) {
+                    spill(slot);
+                }
+                reducer->init(row);
+                entry[row_size] = key;
+                used[slot] = true;
+            }
+        }
+        for (uint32_t slot = 0; slot < AGG_CACHE_SLOTS; ++slot) {
+            if (used[slot]) {
+                spill(slot);
+            }
+        }
+        return partitions;
+    }
+
+    unique_ptr<HashAgg::Spilled> HashAgg::spill(vector<shared_ptr<Block>> &blocks, bool parallel) {
+        function<shared_ptr<vector<vector<uint64_t>>>(const shared_ptr<Block> &)> mapper =
+                bind(&HashAgg::preAgg, this, _1);
+        auto blockstream = unique_ptr<Stream<shared_ptr<Block>>>(new VectorStream<shared_ptr<Block>>(blocks));
+        return (parallel ? blockstream->parallel() : blockstream->sequential())->map(mapper)->collect();
+    }
+
+    void HashAgg::mergePartition(Spilled &spilled, int32_t partition_id, AggReducer &reducer,
+                                 vector<uint64_t> &table, const function<bool(uint64_t)> &keep) {
+        const uint32_t row_size = col_offset_.back();
+        const uint32_t stride = row_size + 1;
+        auto spilled_reducer = createReducer();
+        google::dense_hash_map<uint64_t, uint32_t> map;
+        map.set_empty_key(-1);
+        for (auto &partitions: spilled) {
+            auto &partition = (*partitions)[partition_id];
+            for (uint64_t offset = 0; offset < partition.size(); offset += stride) {
+                auto entry = partition.data() + offset;
+                auto key = entry[row_size];
+                if (keep && !keep(key)) {
+                    continue;
+                }
+                auto found = map.find(key);
+                if (found != map.end()) {
+                    reducer.attach(table.data() + found->second);
+                    spilled_reducer->attach(entry);
+                    reducer.merge(*spilled_reducer);
+                } else {
+                    map[key] = table.size();
+                    table.insert(table.end(), entry, entry + row_size);
+                }
+            }
+            // Free the spilled groups as soon as they are merged
+            vector<uint64_t>().swap(partition);
+        }
+    }
+
+    shared_ptr<Table> HashAgg::partitionAgg(vector<shared_ptr<Block>> &blocks, bool parallel) {
+        auto spilled = spill(blocks, parallel);
+
+        auto result = MemTable::Make(col_size_, vertical_);
+        const uint32_t row_size = col_offset_.back();
+        function<void(const int32_t &)> final_agg = [this, &spilled, &result, row_size](
+                const int32_t &partition_id) {
+            auto reducer = createReducer();
+            vector<uint64_t> table;
+            mergePartition(*spilled, partition_id, *reducer, table);
+            if (table.empty()) {
+                return;
+            }
+            auto block = result->allocate(table.size() / row_size);
+            auto writer = block->rows();
+            auto storage = reducer->storage();
+            uint32_t counter = 0;
+            for (uint64_t offset = 0; offset < table.size(); offset += row_size) {
+                reducer->attach(table.data() + offset);
+                if (need_field_dump_) {
+                    reducer->dump();
+                }
+                if (!predicate_ || predicate_(*storage)) {
+                    (*row_copier_)(writer->next(), *storage);
+                    ++counter;
+                }
+            }
+            block->resize(counter);
+        };
+        auto partition_stream = IntStream::Make(0, 1 << AGG_PARTITION_BITS);
+        (parallel ? partition_stream->parallel() : partition_stream->sequential())->foreach(final_agg);
+#ifdef LQF_STAT
+        lqf::stat::MemEstimator::INST.Record("HashAgg", result->memrss());
+#endif
+        return result;
+    }
+
+    HashTopKAgg::HashTopKAgg(uint32_t n, function<bool(DataRow *, DataRow *)> comp,
+                             function<uint64_t(DataRow &)> hasher, unique_ptr<Snapshoter> header_copier,
+                             function<vector<agg::AggField *>()> fields_gen,
+                             function<bool(DataRow &)> pred, bool vertical)
+            : HashAgg(hasher, move(header_copier), fields_gen, pred, vertical), n_(n), comparator_(comp) {}
+
+    shared_ptr<Table> HashTopKAgg::agg(Table &input) {
+        auto stream = input.blocks();
+        auto parallel = stream->isParallel();
+        auto blocks = stream->collect();
+        partitioned_ = true;
+        pruned_ = 0;
+        if (bound_field_ >= 0 && !createReducer()->fields()[bound_field_]->monotone()) {
+            throw std::invalid_argument("bound field is not monotone");
+        }
+        auto spilled = spill(*blocks, parallel);
+
+        const uint32_t row_size = col_offset_.back();
+        function<DataRow *()> creator = [this]() { return new MemDataRow(col_offset_); };
+        Heap<DataRow *> top(n_, creator, comparator_);
+        mutex top_lock;
+
+        function<void(const int32_t &)> final_agg = [this, &spilled, &top, &top_lock, &creator, row_size](
+                const int32_t &partition_id) {
+            auto reducer = createReducer();
+            agg::AggField *bound_field = bound_field_ >= 0 ? reducer->fields()[bound_field_].get() : nullptr;
+
+            // Sum the values of the bound field by group. They are final as the partition holds
+            // all partial results of its groups
+            google::dense_hash_map<uint64_t, double> values;
+            double bound = -std::numeric_limits<double>::infinity();
+            if (bound_field) {
+                values.set_empty_key(-1);
+                for (auto &partitions: *spilled) {
+                    auto &partition = (*partitions)[partition_id];
+                    for (uint64_t offset = 0; offset < partition.size(); offset += row_size + 1) {
+                        auto entry = partition.data() + offset;
+                        values[entry[row_size]] += bound_field->rankValue(entry);
+                    }
+                }
+                // Groups failing the predicate do not rank, so the partition bounds itself only without one
+                if (!predicate_ && n_ > 0 && values.size() >= n_) {
+                    vector<double> ranked;
+                    ranked.reserve(values.size());
+                    for (auto &value: values) {
+                        ranked.push_back(value.second);
+                    }
+                    std::nth_element(ranked.begin(), ranked.begin() + n_ - 1, ranked.end(), std::greater<double>());
+                    bound = ranked[n_ - 1];
+                }
+            }
+
+            MemDataRow bar(col_offset_);
+            bool has_bar = false;
+            top_lock.lock();
+            if (top.content().size() == n_) {
+                bar = *top.content()[0];
+                has_bar = true;
+            }
+            top_lock.unlock();
+            if (has_bar && bound_field) {
+                bound = std::max(bound, bound_field->rankValue(bar.raw()));
+            }
+
+            vector<uint64_t> table;
+            if (bound_field) {
+                uint64_t pruned = 0;
+                for (auto &value: values) {
+                    pruned += value.second < bound;
+                }
+                function<bool(uint64_t)> keep = [&values, bound](uint64_t key) {
+                    return values.find(key)->second >= bound;
+                };
+                mergePartition(*spilled, partition_id, *reducer, table, keep);
+                top_lock.lock();
+                pruned_ += pruned;
+                top_lock.unlock();
+            } else {
+                mergePartition(*spilled, partition_id, *reducer, table);
+            }
+            if (table.empty()) {
+                return;
+            }
+
+            Heap<DataRow *> heap(n_, creator, comparator_);
+            auto storage = reducer->storage();
+            for (uint64_t offset = 0; offset < table.size(); offset += row_size) {
+                reducer->attach(table.data() + offset);
+                if (need_field_dump_) {
+                    reducer->dump();
+                }
+                if ((!has_bar || comparator_(storage, &bar)) && (!predicate_ || predicate_(*storage))) {
+                    heap.add(storage);
+                }
+            }
+            top_lock.lock();
+            for (auto row: heap.content()) {
+                top.add(row);
+            }
+            top_lock.unlock();
+        };
+        auto partition_stream = IntStream::Make(0, 1 << AGG_PARTITION_BITS);
+        (parallel ? partition_stream->parallel() : partition_stream->sequential())->foreach(final_agg);
+
+        top.done();
+        auto result = MemTable::Make(col_size_, vertical_);
+        auto &content = top.content();
+        auto block = result->allocate(content.size());
+        auto writer = block->rows();
+        for (auto row: content) {
+            (*row_copier_)(writer->next(), *row);
+        }
+        return result;
+    }
+
     DenseHashAgg::DenseHashAgg(function<uint64_t(DataRow &)> hasher, unique_ptr<Snapshoter> header_copier,
                                function<vector<agg::AggField *>()> fields_gen,
                                function<bool(DataRow &)> pred, bool vertical)
@@ -1052,6 +1761,62 @@ namespace lqf {
         return make_shared<DenseHashCore>(col_offset_, rc, hasher_, row_copier_.get(), need_field_dump_);
     }
 
+    BatchHashAgg::BatchHashAgg(function<uint64_t(DataRow &)> hasher, unique_ptr<Snapshoter> header_copier,
+                               function<vector<agg::AggField *>()> fields_gen,
+                               function<bool(DataRow &)> pred, bool vertical)
+            : Agg(move(header_copier), fields_gen, pred, vertical), hasher_(hasher), columnar_(true) {
+        for (auto field: fields_gen_()) {
+            columnar_ &= field->columnar();
+            delete field;
+        }
+    }
+
+    shared_ptr<BatchHashCore> BatchHashAgg::processBlock(const shared_ptr<Block> &block) {
+        if (!columnar_) {
+            return Agg::processBlock(block);
+        }
+        auto core = makeCore();
+        core->reduce(*block);
+        return core;
+    }
+
+    shared_ptr<BatchHashCore> BatchHashAgg::makeCore() {
+        return make_shared<BatchHashCore>(col_offset_, createReducer(), hasher_, row_copier_.get(),
+                                          need_field_dump_);
+    }
+
+    KeyAgg::KeyAgg(unique_ptr<Snapshoter> header_copier, function<vector<agg::AggField *>()> fields_gen,
+                   function<bool(DataRow &)> pred, bool vertical)
+            : Agg(move(header_copier), fields_gen, pred, vertical) {}
+
+    shared_ptr<KeyCore> KeyAgg::processBlock(const shared_ptr<Block> &block) {
+        auto core = makeCore();
+        core->reduce(*block);
+        return core;
+    }
+
+    DictAgg::DictAgg(vector<agg::DictDim> dims, unique_ptr<Snapshoter> header_copier,
+                     function<vector<agg::AggField *>()> fields_gen, function<bool(DataRow &)> pred, bool vertical)
+            : Agg(move(header_copier), fields_gen, pred, vertical), dims_(dims), num_groups_(1) {
+        for (auto &dim: dims_) {
+            if (dim.cardinality_ == 0 || num_groups_ > DICT_AGG_MAX_GROUPS / dim.cardinality_) {
+                throw invalid_argument("too many groups for DictAgg");
+            }
+            num_groups_ *= dim.cardinality_;
+        }
+    }
+
+    shared_ptr<DictCore> DictAgg::processBlock(const shared_ptr<Block> &block) {
+        auto core = makeCore();
+        core->reduce(*block);
+        return core;
+    }
+
+    shared_ptr<DictCore> DictAgg::makeCore() {
+        return make_shared<DictCore>(num_groups_, col_offset_, dims_, createReducer(), row_copier_.get(),
+                                     need_field_dump_);
+    }
+
     TableAgg::TableAgg(uint32_t table_size, function<uint32_t(DataRow &)> indexer, unique_ptr<Snapshoter> header_copier,
                        function<vector<agg::AggField *>()> fields_gen, function<bool(DataRow &)> pred, bool vertical)
             : Agg(move(header_copier), fields_gen, pred, vertical), table_size_(table_size), indexer_(indexer) {}
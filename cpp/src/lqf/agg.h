@@ -11,6 +11,22 @@
 #include "data_container.h"
 #include "rowcopy.h"
 #include "parallel.h"
+#include "sketch.h"
+
+// Number of rows whose group offsets are resolved before running the columnar kernels
+#define AGG_BATCH_SIZE 1024
+// HashAgg switches to two-phase partitioned aggregation above this many groups per block
+#define AGG_PARTITION_THRESHOLD 65536
+// Number of rows sampled from the first block to estimate the groups per block
+#define AGG_SAMPLE_SIZE 4096
+// The sample is extrapolated to the block only when this fraction (in 1/16) of its rows are distinct
+#define AGG_SAMPLE_DISTINCT 15
+// Radix partitions of the two-phase aggregation
+#define AGG_PARTITION_BITS 6
+// Slots of the direct-mapped pre-aggregation table, small enough to stay in cache
+#define AGG_CACHE_SLOTS 4096
+// Largest group array of a DictAgg
+#define DICT_AGG_MAX_GROUPS (1 << 20)
 
 namespace lqf {
     using namespace datacontainer;
@@ -18,6 +34,8 @@ namespace lqf {
     namespace agg {
 
         struct AsDouble {
+            using type = double;
+
             static double get(DataField &df) { return df.asDouble(); }
 
             static double MAX;
@@ -26,6 +44,8 @@ namespace lqf {
         };
 
         struct AsInt {
+            using type = int32_t;
+
             static int32_t get(DataField &df) { return df.asInt(); }
 
             static int MAX;
@@ -40,6 +60,7 @@ namespace lqf {
             uint32_t write_idx_;
             DataField value_;
             bool need_dump_;
+            bool monotone_ = false;
         public:
             AggField(uint32_t size, uint32_t read_idx, bool need_dump = false);
 
@@ -53,6 +74,17 @@ namespace lqf {
 
             virtual void merge(AggField &) = 0;
 
+            /// Whether the field has a columnar kernel. Subclasses overriding the row reduce
+            /// are not columnar unless they also provide the kernel
+            virtual bool columnar() { return false; }
+
+            /// The column read by the columnar kernel, or nullptr if it reads nothing
+            virtual unique_ptr<ColumnIterator> input(Block &);
+
+            /// Columnar kernel. The i-th value read from input accumulates into the group
+            /// row starting at table + groups[i]
+            virtual void reduceBatch(ColumnIterator *input, uint64_t *table, const uint32_t *groups, uint32_t size);
+
             inline bool need_dump() { return need_dump_; }
 
             virtual void dump();
@@ -60,6 +92,13 @@ namespace lqf {
             inline void write_at(uint32_t at) { write_idx_ = at; }
 
             inline uint32_t size() { return size_; }
+
+            /// Whether merging partials only adds non-negative values, so a partial value
+            /// never exceeds the final one
+            inline bool monotone() { return monotone_; }
+
+            /// The value of a monotone field in a group row
+            virtual double rankValue(const uint64_t *row);
         };
 
         class Count : public AggField {
@@ -69,6 +108,14 @@ namespace lqf {
             void reduce(DataRow &) override;
 
             void merge(AggField &) override;
+
+            bool columnar() override;
+
+            unique_ptr<ColumnIterator> input(Block &) override;
+
+            void reduceBatch(ColumnIterator *, uint64_t *, const uint32_t *, uint32_t) override;
+
+            double rankValue(const uint64_t *) override;
         };
 
         class IntDistinctCount : public AggField {
@@ -88,22 +135,103 @@ namespace lqf {
             void dump() override;
         };
 
+        /**
+         * COUNT(DISTINCT) estimated by a HyperLogLog per group. A group keeps 2^precision bytes
+         * whatever its cardinality, and the standard error is 1.04/sqrt(2^precision).
+         */
+        template<typename ACC>
+        class ApproxDistinctCount : public AggField {
+        protected:
+            uint32_t precision_;
+            sketch::HyperLogLog *hll_;
+        public:
+            ApproxDistinctCount(uint32_t, uint32_t precision = HLL_PRECISION);
+
+            void attach(DataRow &) override;
+
+            void init() override;
+
+            void reduce(DataRow &) override;
+
+            void merge(AggField &) override;
+
+            void dump() override;
+        };
+
+        template
+        class ApproxDistinctCount<AsInt>;
+
+        using IntApproxDistinctCount = ApproxDistinctCount<AsInt>;
+
+        template
+        class ApproxDistinctCount<AsDouble>;
+
+        using DoubleApproxDistinctCount = ApproxDistinctCount<AsDouble>;
+
+        /**
+         * Value at a normalized rank, e.g. 0.5 for the median, estimated by a KLL sketch per group.
+         * The rank of the result is within about 1.7/k^0.9 of the requested one. Output is a double.
+         */
+        template<typename ACC>
+        class Quantile : public AggField {
+        protected:
+            double rank_;
+            uint32_t k_;
+            sketch::KllSketch *sketch_;
+        public:
+            Quantile(uint32_t, double rank, uint32_t k = KLL_K);
+
+            void attach(DataRow &) override;
+
+            void init() override;
+
+            void reduce(DataRow &) override;
+
+            void merge(AggField &) override;
+
+            void dump() override;
+        };
+
+        template
+        class Quantile<AsInt>;
+
+        using IntQuantile = Quantile<AsInt>;
+
+        template
+        class Quantile<AsDouble>;
+
+        using DoubleQuantile = Quantile<AsDouble>;
+
         class IntSum : public AggField {
         public:
-            IntSum(uint32_t);
+            /// Declaring the input non-negative makes the sum monotone
+            IntSum(uint32_t, bool nonneg = false);
 
             virtual void reduce(DataRow &) override;
 
             void merge(AggField &) override;
+
+            bool columnar() override;
+
+            void reduceBatch(ColumnIterator *, uint64_t *, const uint32_t *, uint32_t) override;
+
+            double rankValue(const uint64_t *) override;
         };
 
         class DoubleSum : public AggField {
         public:
-            DoubleSum(uint32_t);
+            /// Declaring the input non-negative makes the sum monotone
+            DoubleSum(uint32_t, bool nonneg = false);
 
             virtual void reduce(DataRow &) override;
 
             void merge(AggField &) override;
+
+            bool columnar() override;
+
+            void reduceBatch(ColumnIterator *, uint64_t *, const uint32_t *, uint32_t) override;
+
+            double rankValue(const uint64_t *) override;
         };
 
         template<typename ACC>
@@ -122,6 +250,10 @@ namespace lqf {
             void merge(AggField &) override;
 
             void dump() override;
+
+            bool columnar() override;
+
+            void reduceBatch(ColumnIterator *, uint64_t *, const uint32_t *, uint32_t) override;
         };
 
         template
@@ -144,6 +276,10 @@ namespace lqf {
             void reduce(DataRow &) override;
 
             void merge(AggField &) override;
+
+            bool columnar() override;
+
+            void reduceBatch(ColumnIterator *, uint64_t *, const uint32_t *, uint32_t) override;
         };
 
         template
@@ -166,6 +302,10 @@ namespace lqf {
             void reduce(DataRow &) override;
 
             void merge(AggField &) override;
+
+            bool columnar() override;
+
+            void reduceBatch(ColumnIterator *, uint64_t *, const uint32_t *, uint32_t) override;
         };
 
         template
@@ -196,6 +336,9 @@ namespace lqf {
 
             void init(DataRow &);
 
+            /// Copy the header and init the fields without reducing the row
+            void prepare(DataRow &);
+
             void reduce(DataRow &);
 
             void dump();
@@ -270,6 +413,84 @@ namespace lqf {
             void dump(MemTable &table, function<bool(DataRow &)>);
         };
 
+        /**
+         * BatchHashCore keeps the group rows in one contiguous table. A block is processed in
+         * batches: the rows of a batch are first mapped to the offsets of their group rows,
+         * then each field runs its type-specialized kernel over the batch of column values.
+         */
+        class BatchHashCore : public CoreBase {
+        protected:
+            unique_ptr<AggReducer> reducer_;
+            function<uint64_t(DataRow &)> &hasher_;
+            uint32_t row_size_;
+            // Map from key to the offset of the group row in table_
+            google::dense_hash_map<uint64_t, uint32_t> map_;
+            vector<uint64_t> table_;
+
+            uint32_t locate(uint64_t key, DataRow &row);
+
+        public:
+            BatchHashCore(const vector<uint32_t> &, unique_ptr<AggReducer>, function<uint64_t(DataRow &)> &,
+                          function<void(DataRow &, DataRow &)> *, bool);
+
+            void reduce(DataRow &row);
+
+            /// Reduce the block with the columnar kernels of the fields
+            void reduce(Block &block);
+
+            void merge(BatchHashCore &another);
+
+            void dump(MemTable &table, function<bool(DataRow &)>);
+
+            inline uint32_t size() { return map_.size(); }
+        };
+
+        /// A group-key column of DictAgg, whose values are in [base, base + cardinality)
+        struct DictDim {
+            uint32_t index_;
+            uint32_t cardinality_;
+            int32_t base_;
+            // Read the dictionary code instead of the decoded value
+            bool raw_;
+
+            DictDim(uint32_t index, uint32_t cardinality, int32_t base = 0, bool raw = true)
+                    : index_(index), cardinality_(cardinality), base_(base), raw_(raw) {}
+        };
+
+        /**
+         * DictCore keeps the group rows in a dense array indexed by the key columns, so a row
+         * finds its group with a few multiply-adds instead of a hash lookup. Groups are dumped
+         * in the order of their keys.
+         */
+        class DictCore : public CoreBase {
+        protected:
+            unique_ptr<AggReducer> reducer_;
+            const vector<DictDim> &dims_;
+            uint32_t row_size_;
+            bool columnar_;
+            vector<uint64_t> table_;
+            vector<uint8_t> used_;
+            uint32_t size_;
+            // Translate the codes of a parquet row group to the global dictionary codes
+            vector<const vector<uint32_t> *> translations_;
+
+            uint32_t locate(DataRow &row);
+
+        public:
+            DictCore(uint32_t num_groups, const vector<uint32_t> &, const vector<DictDim> &, unique_ptr<AggReducer>,
+                     function<void(DataRow &, DataRow &)> *, bool);
+
+            void reduce(DataRow &row);
+
+            void reduce(Block &block);
+
+            void merge(DictCore &another);
+
+            void dump(MemTable &table, function<bool(DataRow &)>);
+
+            inline uint32_t size() { return size_; }
+        };
+
         class TableCore : public CoreBase {
         protected:
             function<unique_ptr<AggReducer>()> reducer_gen_;
@@ -343,6 +564,25 @@ namespace lqf {
             void dump(MemTable &table, function<bool(DataRow &)>);
         };
 
+        /**
+         * Interface of the cores specialized on a typed group key, see agg_key.h.
+         * The key type is resolved once per block instead of once per row.
+         */
+        class KeyCore : public CoreBase {
+        public:
+            KeyCore(function<void(DataRow &, DataRow &)> *, bool);
+
+            virtual ~KeyCore() = default;
+
+            virtual void reduce(DataRow &row) = 0;
+
+            virtual void reduce(Block &block) = 0;
+
+            virtual void merge(KeyCore &another) = 0;
+
+            virtual void dump(MemTable &table, function<bool(DataRow &)>) = 0;
+        };
+
         namespace recording {
 
             class RecordingAggField : public AggField {
@@ -456,6 +696,9 @@ namespace lqf {
 
         virtual unique_ptr<agg::AggReducer> createRecordingReducer();
 
+        /// Merge the cores of the blocks, and seed if given, into a table
+        shared_ptr<Table> reduceBlocks(Stream<shared_ptr<Block>> &, shared_ptr<CORE> seed = nullptr);
+
     public:
         Agg(unique_ptr<Snapshoter>, function<vector<AggField *>()>, function<bool(DataRow &)> pred = nullptr,
             bool vertical = false);
@@ -467,7 +710,7 @@ namespace lqf {
 
         virtual unique_ptr<NodeOutput> execute(const vector<NodeOutput *> &) override;
 
-        shared_ptr<Table> agg(Table &input);
+        virtual shared_ptr<Table> agg(Table &input);
 
         inline void setPredicate(function<bool(DataRow &)> p) { predicate_ = p; }
     };
@@ -484,16 +727,82 @@ namespace lqf {
                      function<bool(DataRow &)> pred = nullptr, bool vertical = false);
     };
 
+    /**
+     * HashAgg merges one HashCore per block, which costs O(blocks x groups) memory and a serial
+     * merge for high-cardinality keys. When the groups per block estimated from a sample of the
+     * first block exceed AGG_PARTITION_THRESHOLD, it aggregates in two phases instead. Each block is pre-aggregated
+     * in a small direct-mapped table, whose evicted groups spill into radix partitions by key hash.
+     * The partitions are then aggregated in parallel, independent of each other.
+     */
     class HashAgg : public Agg<agg::HashCore> {
     protected:
         function<uint64_t(DataRow &)> hasher_;
+        bool partitioned_ = false;
 
         shared_ptr<agg::HashCore> makeCore() override;
 
+        uint64_t estimateGroups(Block &);
+
+        shared_ptr<vector<vector<uint64_t>>> preAgg(const shared_ptr<Block> &);
+
+        using Spilled = vector<shared_ptr<vector<vector<uint64_t>>>>;
+
+        /// Phase 1, pre-aggregate each block into radix partitions
+        unique_ptr<Spilled> spill(vector<shared_ptr<Block>> &, bool parallel);
+
+        /// Phase 2, merge the spilled groups of one partition into a flat table of group rows,
+        /// releasing the spilled groups of that partition. Groups whose key is rejected by keep are skipped
+        void mergePartition(Spilled &, int32_t partition_id, agg::AggReducer &, vector<uint64_t> &table,
+                            const function<bool(uint64_t)> &keep = nullptr);
+
+        shared_ptr<Table> partitionAgg(vector<shared_ptr<Block>> &, bool parallel);
+
     public:
         HashAgg(function<uint64_t(DataRow &)>, unique_ptr<Snapshoter>,
                 function<vector<agg::AggField *>()>,
                 function<bool(DataRow &)> pred = nullptr, bool vertical = false);
+
+        shared_ptr<Table> agg(Table &input) override;
+
+        /// Whether the last aggregation used two phases
+        inline bool partitioned() { return partitioned_; }
+    };
+
+    /**
+     * HashTopKAgg fuses HashAgg with TopN for ORDER BY agg LIMIT k. It always aggregates in two
+     * phases. As a partition holds all partial results of its groups, the merged groups are final
+     * and are ranked in the partition by a heap of k rows, instead of being dumped to an output table.
+     * Each partition also starts with the k-th row of the heap merged from the finished partitions.
+     * A group not ranking before that bar cannot make the top k, and is dropped without a heap access.
+     *
+     * When the ranking is bound to a monotone field, a partition first sums only the values of that
+     * field by group, which are final. The bar value is the larger of the k-th row of the finished
+     * partitions and, without a predicate, the k-th value of the partition itself. Groups below it
+     * are dropped before their spilled rows are merged, so a partition materializes about k groups.
+     * A partial value only bounds its group from below, so groups cannot be dropped before the spill.
+     *
+     * Without a bound, every group is merged in the table of its partition. Only the partitions
+     * being merged hold such a table, and each partition releases its spilled groups once merged.
+     */
+    class HashTopKAgg : public HashAgg {
+    protected:
+        uint32_t n_;
+        function<bool(DataRow *, DataRow *)> comparator_;
+        int32_t bound_field_ = -1;
+        uint64_t pruned_ = 0;
+    public:
+        HashTopKAgg(uint32_t n, function<bool(DataRow *, DataRow *)> comp, function<uint64_t(DataRow &)>,
+                    unique_ptr<Snapshoter>, function<vector<agg::AggField *>()>,
+                    function<bool(DataRow &)> pred = nullptr, bool vertical = false);
+
+        /// Declare that the comparator ranks first by the given aggregation field in descending
+        /// order. The field must be monotone
+        inline void setBound(uint32_t field) { bound_field_ = field; }
+
+        shared_ptr<Table> agg(Table &input) override;
+
+        /// Groups dropped before merging by the last aggregation
+        inline uint64_t pruned() { return pruned_; }
     };
 
     class DenseHashAgg : public Agg<agg::DenseHashCore> {
@@ -508,6 +817,46 @@ namespace lqf {
                 function<bool(DataRow &)> pred = nullptr, bool vertical = false);
     };
 
+    /**
+     * BatchHashAgg runs the columnar kernels of the aggregation fields over batches of rows.
+     * It falls back to reducing row by row if some field has no columnar kernel.
+     */
+    class BatchHashAgg : public Agg<agg::BatchHashCore> {
+    protected:
+        function<uint64_t(DataRow &)> hasher_;
+        bool columnar_;
+
+        shared_ptr<agg::BatchHashCore> processBlock(const shared_ptr<Block> &block) override;
+
+        shared_ptr<agg::BatchHashCore> makeCore() override;
+
+    public:
+        BatchHashAgg(function<uint64_t(DataRow &)>, unique_ptr<Snapshoter>,
+                     function<vector<agg::AggField *>()>,
+                     function<bool(DataRow &)> pred = nullptr, bool vertical = false);
+
+        inline bool columnar() { return columnar_; }
+    };
+
+    /**
+     * Aggregation on group keys with small domains, such as dictionary codes of Parquet
+     * columns or years. Group rows live in an array indexed by code1 * |dim2| + code2 ...
+     * Codes can be translated back to values with ParquetTable::LoadDictionary on output.
+     */
+    class DictAgg : public Agg<agg::DictCore> {
+    protected:
+        vector<agg::DictDim> dims_;
+        uint32_t num_groups_;
+
+        shared_ptr<agg::DictCore> processBlock(const shared_ptr<Block> &block) override;
+
+        shared_ptr<agg::DictCore> makeCore() override;
+
+    public:
+        DictAgg(vector<agg::DictDim>, unique_ptr<Snapshoter>, function<vector<agg::AggField *>()>,
+                function<bool(DataRow &)> pred = nullptr, bool vertical = false);
+    };
+
     class TableAgg : public Agg<agg::TableCore> {
     protected:
         uint32_t table_size_;
@@ -555,6 +904,19 @@ namespace lqf {
                    function<bool(DataRow &)> pred = nullptr, bool vertical = false);
     };
 
+    /**
+     * Base of the aggregations on a typed group key. Subclasses create the key-specialized core,
+     * which reduces a whole block at a time. See KeyHashAgg in agg_key.h.
+     */
+    class KeyAgg : public Agg<agg::KeyCore> {
+    protected:
+        shared_ptr<agg::KeyCore> processBlock(const shared_ptr<Block> &block) override;
+
+    public:
+        KeyAgg(unique_ptr<Snapshoter>, function<vector<agg::AggField *>()>,
+               function<bool(DataRow &)> pred = nullptr, bool vertical = false);
+    };
+
     using namespace agg;
     using namespace agg::recording;
 
@@ -0,0 +1,458 @@
+//
+// Created by agent on 10/19/26.
+//
+
+#ifndef LQF_AGG_KEY_H
+#define LQF_AGG_KEY_H
+
+#include <tuple>
+#include <array>
+#include <cstring>
+#include <stdexcept>
+#include "agg.h"
+#include "hash.h"
+
+// Size of the chunks holding the variable-length keys of a core
+#define KEY_ARENA_CHUNK 65536
+
+namespace lqf {
+    namespace agg {
+
+        /**
+         * Group-key columns. A fixed-width column reports its width in bits and its value
+         * as an unsigned integer no wider than that, so several of them can be packed into
+         * one 64-bit key. The value of a narrowed column must be non-negative and fit in BITS.
+         */
+        template<uint32_t BITS = 32>
+        struct IntKey {
+            static_assert(BITS > 0 && BITS <= 32, "IntKey holds at most 32 bits");
+            static constexpr uint32_t bits = BITS;
+            uint32_t index_;
+
+            IntKey(uint32_t index) : index_(index) {}
+
+            inline uint64_t get(DataRow &row) const {
+                return static_cast<uint32_t>(row[index_].asInt()) & (uint32_t) ((1ull << BITS) - 1);
+            }
+        };
+
+        struct LongKey {
+            static constexpr uint32_t bits = 64;
+            uint32_t index_;
+
+            LongKey(uint32_t index) : index_(index) {}
+
+            inline uint64_t get(DataRow &row) const { return *row[index_].data(); }
+        };
+
+        struct DoubleKey {
+            static constexpr uint32_t bits = 64;
+            uint32_t index_;
+
+            DoubleKey(uint32_t index) : index_(index) {}
+
+            inline uint64_t get(DataRow &row) const {
+                // Normalize -0.0 so it groups with 0.0
+                double value = row[index_].asDouble() + 0.0;
+                uint64_t key;
+                memcpy(&key, &value, sizeof(uint64_t));
+                return key;
+            }
+        };
+
+        /**
+         * Dictionary code of an encoded column, read without decoding the value. The codes of a
+         * parquet row group are translated to the codes of the global dictionary of the column,
+         * so row groups with different dictionaries group the same values together. A code wider
+         * than BITS is rejected.
+         */
+        template<uint32_t BITS = 32>
+        struct DictKey {
+            static_assert(BITS > 0 && BITS <= 32, "DictKey holds at most 32 bits");
+            static constexpr uint32_t bits = BITS;
+            uint32_t index_;
+
+            DictKey(uint32_t index) : index_(index) {}
+
+            inline uint64_t get(DataRow &row, const vector<uint32_t> *translation) const {
+                uint32_t code = row(index_).asInt();
+                if (translation) {
+                    code = (*translation)[code];
+                }
+                if constexpr (BITS < 32) {
+                    if (__builtin_expect(code >> BITS, 0)) {
+                        throw invalid_argument("dictionary code wider than the DictKey");
+                    }
+                }
+                return code;
+            }
+        };
+
+        template<typename COL>
+        struct is_dict_key : false_type {
+        };
+
+        template<uint32_t BITS>
+        struct is_dict_key<DictKey<BITS>> : true_type {
+        };
+
+        /// Translations of the dictionary codes of a block for each key column, nullptr if not needed
+        template<uint32_t N>
+        using KeyCodes = array<const vector<uint32_t> *, N>;
+
+        /// Find the translations of the DictKey columns for the row group of a parquet block
+        template<typename... COLS>
+        void bindCodes(const tuple<COLS...> &cols, Block &block, KeyCodes<sizeof...(COLS)> &codes) {
+            auto masked = dynamic_cast<MaskedBlock *>(&block);
+            auto pblock = dynamic_cast<ParquetBlock *>(masked ? masked->inner().get() : &block);
+            auto table = pblock ? static_cast<ParquetTable *>(pblock->owner()) : nullptr;
+            uint32_t i = 0;
+            apply([table, pblock, &codes, &i](const COLS &... col) {
+                ((codes[i++] = table && is_dict_key<COLS>::value ?
+                               table->LoadGlobalDictionary(col.index_)->translation(pblock->index()) : nullptr), ...);
+            }, cols);
+        }
+
+        template<typename COL>
+        inline uint64_t keyValue(const COL &col, DataRow &row, const vector<uint32_t> *translation) {
+            if constexpr (is_dict_key<COL>::value) {
+                return col.get(row, translation);
+            } else {
+                return col.get(row);
+            }
+        }
+
+        /// Variable-length column, only usable in a BytesKey
+        struct ByteArrayKey {
+            uint32_t index_;
+
+            ByteArrayKey(uint32_t index) : index_(index) {}
+
+            inline ByteArray &get(DataRow &row) const { return row[index_].asByteArray(); }
+        };
+
+        /**
+         * Key of fixed-width columns packed into 64 bits, the first column in the high bits.
+         * The total width is checked at compile time.
+         */
+        template<typename... COLS>
+        class PackedKey {
+        protected:
+            tuple<COLS...> cols_;
+
+            template<uint32_t I>
+            inline uint64_t pack(DataRow &row, const KeyCodes<sizeof...(COLS)> &codes, uint64_t key) const {
+                if constexpr (I == sizeof...(COLS)) {
+                    return key;
+                } else {
+                    using COL = typename tuple_element<I, tuple<COLS...>>::type;
+                    if constexpr (COL::bits < 64) {
+                        key <<= COL::bits;
+                    }
+                    return pack<I + 1>(row, codes, key | keyValue(get<I>(cols_), row, codes[I]));
+                }
+            }
+
+        public:
+            static constexpr uint32_t width = (COLS::bits + ...);
+            static_assert(width <= 64, "Packed key is wider than 64 bits, use a BytesKey");
+
+            using type = uint64_t;
+
+            using Codes = KeyCodes<sizeof...(COLS)>;
+
+            struct Hash {
+                inline size_t operator()(uint64_t key) const {
+                    if constexpr (width <= 32) {
+                        return hash::crc32_hash(0, static_cast<uint32_t>(key));
+                    } else {
+                        return hash::crc32_hash(0, key);
+                    }
+                }
+            };
+
+            using Equal = equal_to<uint64_t>;
+
+            /// No packed key narrower than 64 bits has all bits set
+            static constexpr bool full_width = width == 64;
+
+            PackedKey(COLS... cols) : cols_(cols...) {}
+
+            inline static uint64_t empty() { return ~0ull; }
+
+            inline void bind(Block &block, Codes &codes) const { bindCodes(cols_, block, codes); }
+
+            inline uint64_t make(DataRow &row, vector<uint8_t> &, const Codes &codes) const {
+                return pack<0>(row, codes, 0);
+            }
+
+            /// The key of a row whose dictionary codes need no translation
+            inline uint64_t operator()(DataRow &row) const { return pack<0>(row, Codes{}, 0); }
+        };
+
+        /// Bytes of a variable-length key, either in a row buffer or in the arena of a core
+        struct KeyBytes {
+            const uint8_t *ptr_;
+            uint32_t len_;
+        };
+
+        /// Append-only storage of the variable-length keys of a core
+        class KeyArena {
+        protected:
+            vector<unique_ptr<uint8_t[]>> chunks_;
+            uint8_t *pos_ = nullptr;
+            uint32_t remain_ = 0;
+        public:
+            const uint8_t *copy(const uint8_t *data, uint32_t len) {
+                if (len > remain_) {
+                    auto size = std::max<uint32_t>(len, KEY_ARENA_CHUNK);
+                    chunks_.emplace_back(new uint8_t[size]);
+                    pos_ = chunks_.back().get();
+                    remain_ = size;
+                }
+                auto result = pos_;
+                memcpy(result, data, len);
+                pos_ += len;
+                remain_ -= len;
+                return result;
+            }
+        };
+
+        /**
+         * Key of any columns including ByteArrays. The columns are serialized into a buffer
+         * reused across rows, so no string is allocated per row. A key is copied into the
+         * arena of the core only when it creates a new group.
+         */
+        template<typename... COLS>
+        class BytesKey {
+        protected:
+            tuple<COLS...> cols_;
+
+            template<typename COL>
+            inline static void write(const COL &col, DataRow &row, const vector<uint32_t> *translation,
+                                     vector<uint8_t> &buffer) {
+                if constexpr (is_same<COL, ByteArrayKey>::value) {
+                    ByteArray &value = col.get(row);
+                    auto len = value.len;
+                    auto pos = buffer.size();
+                    buffer.resize(pos + sizeof(uint32_t) + len);
+                    memcpy(buffer.data() + pos, &len, sizeof(uint32_t));
+                    memcpy(buffer.data() + pos + sizeof(uint32_t), value.ptr, len);
+                } else {
+                    uint64_t value = keyValue(col, row, translation);
+                    auto pos = buffer.size();
+                    buffer.resize(pos + (COL::bits + 7) / 8);
+                    memcpy(buffer.data() + pos, &value, (COL::bits + 7) / 8);
+                }
+            }
+
+        public:
+            using type = KeyBytes;
+
+            using Codes = KeyCodes<sizeof...(COLS)>;
+
+            struct Hash {
+                inline size_t operator()(const KeyBytes &key) const {
+                    return hash::crc32_hash(0, key.ptr_, key.len_);
+                }
+            };
+
+            struct Equal {
+                inline bool operator()(const KeyBytes &a, const KeyBytes &b) const {
+                    return a.len_ == b.len_ && (a.ptr_ == b.ptr_ || !memcmp(a.ptr_, b.ptr_, a.len_));
+                }
+            };
+
+            static constexpr bool full_width = false;
+
+            BytesKey(COLS... cols) : cols_(cols...) {}
+
+            /// No serialized key has this length
+            inline static KeyBytes empty() { return KeyBytes{nullptr, 0xFFFFFFFF}; }
+
+            inline void bind(Block &block, Codes &codes) const { bindCodes(cols_, block, codes); }
+
+            inline KeyBytes make(DataRow &row, vector<uint8_t> &buffer, const Codes &codes) const {
+                buffer.clear();
+                uint32_t i = 0;
+                apply([&row, &buffer, &codes, &i](const COLS &... cols) {
+                    (write(cols, row, codes[i++], buffer), ...);
+                }, cols_);
+                return KeyBytes{buffer.data(), static_cast<uint32_t>(buffer.size())};
+            }
+        };
+
+        /**
+         * KeyHashCore groups rows by a typed key. The key is computed, hashed and compared
+         * inline, and the group rows are kept in one contiguous table as in BatchHashCore.
+         * The dictionary code translations of the key are bound to each block reduced.
+         */
+        template<typename KEY>
+        class KeyHashCore : public KeyCore {
+        protected:
+            using key_type = typename KEY::type;
+
+            const KEY &key_;
+            typename KEY::Codes codes_{};
+            unique_ptr<AggReducer> reducer_;
+            uint32_t row_size_;
+            bool columnar_;
+            google::dense_hash_map<key_type, uint32_t, typename KEY::Hash, typename KEY::Equal> map_;
+            vector<uint64_t> table_;
+            // A full-width packed key may collide with the empty key of the map
+            int64_t empty_offset_ = -1;
+            vector<uint8_t> buffer_;
+            KeyArena arena_;
+
+            inline uint32_t insert(const key_type &key) {
+                uint32_t offset = table_.size();
+                table_.resize(offset + row_size_);
+                if constexpr (is_same<key_type, KeyBytes>::value) {
+                    map_[KeyBytes{arena_.copy(key.ptr_, key.len_), key.len_}] = offset;
+                } else {
+                    if (KEY::full_width && key == KEY::empty()) {
+                        empty_offset_ = offset;
+                    } else {
+                        map_[key] = offset;
+                    }
+                }
+                return offset;
+            }
+
+            inline int64_t find(const key_type &key) {
+                if constexpr (KEY::full_width) {
+                    if (key == KEY::empty()) {
+                        return empty_offset_;
+                    }
+                }
+                auto found = map_.find(key);
+                return found == map_.end() ? -1 : static_cast<int64_t>(found->second);
+            }
+
+            inline uint32_t locate(DataRow &row) {
+                auto key = key_.make(row, buffer_, codes_);
+                auto found = find(key);
+                if (__builtin_expect(found >= 0, 1)) {
+                    return found;
+                }
+                auto offset = insert(key);
+                reducer_->attach(table_.data() + offset);
+                reducer_->prepare(row);
+                return offset;
+            }
+
+            void mergeGroup(KeyHashCore &another, const key_type &key, uint32_t from) {
+                auto source = another.table_.data() + from;
+                auto exist = find(key);
+                if (exist >= 0) {
+                    another.reducer_->attach(source);
+                    reducer_->attach(table_.data() + exist);
+                    reducer_->merge(*another.reducer_);
+                } else {
+                    auto offset = insert(key);
+                    memcpy(table_.data() + offset, source, sizeof(uint64_t) * row_size_);
+                }
+            }
+
+        public:
+            KeyHashCore(const vector<uint32_t> &col_offset, unique_ptr<AggReducer> reducer, const KEY &key,
+                        function<void(DataRow &, DataRow &)> *row_copier, bool need_dump)
+                    : KeyCore(row_copier, need_dump), key_(key), reducer_(move(reducer)),
+                      row_size_(col_offset.back()), columnar_(true) {
+                map_.set_empty_key(KEY::empty());
+                for (auto &field: reducer_->fields()) {
+                    columnar_ &= field->columnar();
+                }
+            }
+
+            void reduce(DataRow &row) override {
+                // locate may grow the table
+                auto offset = locate(row);
+                reducer_->attach(table_.data() + offset);
+                reducer_->reduce(row);
+            }
+
+            void reduce(Block &block) override {
+                key_.bind(block, codes_);
+                auto rows = block.rows();
+                uint64_t block_size = block.size();
+                if (!columnar_) {
+                    for (uint64_t i = 0; i < block_size; ++i) {
+                        reduce(rows->next());
+                    }
+                    return;
+                }
+                auto &fields = reducer_->fields();
+                auto num_fields = fields.size();
+                vector<unique_ptr<ColumnIterator>> inputs;
+                for (auto &field: fields) {
+                    inputs.push_back(field->input(block));
+                }
+                uint32_t groups[AGG_BATCH_SIZE];
+                for (uint64_t start = 0; start < block_size; start += AGG_BATCH_SIZE) {
+                    uint32_t batch_size = std::min<uint64_t>(AGG_BATCH_SIZE, block_size - start);
+                    for (uint32_t i = 0; i < batch_size; ++i) {
+                        groups[i] = locate(rows->next());
+                    }
+                    auto table = table_.data();
+                    for (uint32_t f = 0; f < num_fields; ++f) {
+                        fields[f]->reduceBatch(inputs[f].get(), table, groups, batch_size);
+                    }
+                }
+            }
+
+            void merge(KeyCore &core) override {
+                auto &another = static_cast<KeyHashCore &>(core);
+                for (auto &ite: another.map_) {
+                    mergeGroup(another, ite.first, ite.second);
+                }
+                if (another.empty_offset_ >= 0) {
+                    mergeGroup(another, KEY::empty(), another.empty_offset_);
+                }
+            }
+
+            void dump(MemTable &table, function<bool(DataRow &)> pred) override {
+                auto block = table.allocate(table_.size() / row_size_);
+                auto writerows = block->rows();
+                auto storage = reducer_->storage();
+                uint32_t counter = 0;
+                for (uint32_t offset = 0; offset < table_.size(); offset += row_size_) {
+                    reducer_->attach(table_.data() + offset);
+                    if (need_dump_) {
+                        reducer_->dump();
+                    }
+                    if (!pred || pred(*storage)) {
+                        (*row_copier_)(writerows->next(), *storage);
+                        ++counter;
+                    }
+                }
+                block->resize(counter);
+            }
+
+            inline uint32_t size() { return table_.size() / row_size_; }
+        };
+    }
+
+    /**
+     * Hash aggregation on a typed group key, e.g.
+     * <code>KeyHashAgg(PackedKey(IntKey<>(0), DictKey<12>(3)), ...)</code>.
+     * The key layout and hash function are fixed when the plan is built.
+     */
+    template<typename KEY>
+    class KeyHashAgg : public KeyAgg {
+    protected:
+        KEY key_;
+
+        shared_ptr<agg::KeyCore> makeCore() override {
+            return make_shared<agg::KeyHashCore<KEY>>(col_offset_, createReducer(), key_, row_copier_.get(),
+                                                      need_field_dump_);
+        }
+
+    public:
+        KeyHashAgg(KEY key, unique_ptr<Snapshoter> header_copier, function<vector<agg::AggField *>()> fields_gen,
+                   function<bool(DataRow &)> pred = nullptr, bool vertical = false)
+                : KeyAgg(move(header_copier), fields_gen, pred, vertical), key_(key) {}
+    };
+}
+
+#endif //LQF_AGG_KEY_H
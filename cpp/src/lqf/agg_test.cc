@@ -4,6 +4,7 @@
 
 #include <gtest/gtest.h>
 #include "agg.h"
+#include "agg_key.h"
 #include "rowcopy.h"
 
 using namespace std;
@@ -137,6 +138,62 @@ TEST(AggFieldTest, IntDistinct) {
     EXPECT_EQ(100, storage[0].asInt());
 }
 
+TEST(AggFieldTest, ApproxDistinct) {
+    vector<uint32_t> offset({0, 1, 2});
+
+    MemDataRow storage(offset);
+    MemDataRow storage2(offset);
+    MemDataRow row(offset);
+
+    IntApproxDistinctCount dcount(0);
+    dcount.write_at(0);
+    dcount.attach(storage);
+    dcount.init();
+    for (int i = 0; i < 50000; ++i) {
+        row[0] = i % 20000;
+        dcount.reduce(row);
+    }
+
+    IntApproxDistinctCount dcount2(0);
+    dcount2.write_at(0);
+    dcount2.attach(storage2);
+    dcount2.init();
+    for (int i = 0; i < 50000; ++i) {
+        row[0] = 10000 + i % 20000;
+        dcount2.reduce(row);
+    }
+
+    dcount.merge(dcount2);
+    dcount.dump();
+    // 3 standard errors of the default precision
+    EXPECT_NEAR(30000, storage[0].asInt(), 30000 * 0.05);
+}
+
+TEST(AggFieldTest, Quantile) {
+    vector<uint32_t> offset({0, 1, 2});
+
+    MemDataRow storage(offset);
+    MemDataRow storage2(offset);
+    MemDataRow row(offset);
+
+    DoubleQuantile median(0, 0.5);
+    median.write_at(0);
+    median.attach(storage);
+    median.init();
+    DoubleQuantile median2(0, 0.5);
+    median2.write_at(0);
+    median2.attach(storage2);
+    median2.init();
+    for (int i = 0; i < 100000; ++i) {
+        row[0] = (double) i;
+        (i % 2 ? median : median2).reduce(row);
+    }
+
+    median.merge(median2);
+    median.dump();
+    EXPECT_NEAR(50000, storage[0].asDouble(), 100000 * 0.02);
+}
+
 TEST(AggReducerTest, Init) {
     auto header_copier = RowCopyFactory().from(RAW)->to(RAW)
             ->field(F_REGULAR, 0, 0)->field(F_REGULAR, 1, 1)
@@ -708,6 +765,508 @@ TEST(HashAggTest, Agg) {
         EXPECT_DOUBLE_EQ(i_sum, sum[i_idx]);
     }
     EXPECT_EQ(20, key_count.size());
+    EXPECT_FALSE(agg.partitioned());
+}
+
+TEST(HashAggTest, Partitioned) {
+    function<uint64_t(DataRow &)> hasher =
+            [](DataRow &row) {
+                return row[0].asInt();
+            };
+
+    function<vector<AggField *>()> aggFields = []() {
+        return vector<AggField *>{new IntSum(1), new Count()};
+    };
+
+    HashAgg agg(hasher, RowCopyFactory().field(F_REGULAR, 0, 0)->buildSnapshot(),
+                aggFields, [](DataRow &row) { return row[2].asInt() > 1; });
+
+    const int num_keys = 150000;
+    const int block_size = 100000;
+    auto memTable = MemTable::Make(2);
+
+    vector<int> count(num_keys, 0);
+    vector<int> sum(num_keys, 0);
+    for (int b = 0; b < 3; ++b) {
+        auto block = memTable->allocate(block_size);
+        auto rows = block->rows();
+        for (int i = 0; i < block_size; ++i) {
+            int key = (i * 7919 + b * 50000) % num_keys;
+            int value = i % 97;
+            (*rows)[i][0] = key;
+            (*rows)[i][1] = value;
+            count[key] += 1;
+            sum[key] += value;
+        }
+    }
+
+    auto aggtable = agg.agg(*memTable);
+    EXPECT_TRUE(agg.partitioned());
+
+    int expect_groups = 0;
+    for (auto c: count) {
+        expect_groups += c > 1;
+    }
+    set<int32_t> keys;
+    auto blocks = aggtable->blocks()->collect();
+    for (auto &block: *blocks) {
+        auto rows = block->rows();
+        for (uint32_t i = 0; i < block->size(); ++i) {
+            DataRow &row = rows->next();
+            auto key = row[0].asInt();
+            keys.insert(key);
+            EXPECT_EQ(sum[key], row[1].asInt());
+            EXPECT_EQ(count[key], row[2].asInt());
+        }
+    }
+    EXPECT_EQ(expect_groups, keys.size());
+}
+
+TEST(HashAggTest, RepeatedKeysNotPartitioned) {
+    function<uint64_t(DataRow &)> hasher =
+            [](DataRow &row) {
+                return row[0].asInt();
+            };
+
+    function<vector<AggField *>()> aggFields = []() {
+        return vector<AggField *>{new IntSum(1), new Count()};
+    };
+
+    HashAgg agg(hasher, RowCopyFactory().field(F_REGULAR, 0, 0)->buildSnapshot(), aggFields);
+
+    // A sample of the first block sees most of the groups, which are far fewer than the rows
+    const int num_keys = 8000;
+    const int block_size = 200000;
+    auto memTable = MemTable::Make(2);
+
+    vector<int> count(num_keys, 0);
+    vector<int> sum(num_keys, 0);
+    for (int b = 0; b < 3; ++b) {
+        auto block = memTable->allocate(block_size);
+        auto rows = block->rows();
+        for (int i = 0; i < block_size; ++i) {
+            int key = static_cast<int>((static_cast<uint32_t>(i) * 2654435761u + b) % num_keys);
+            int value = i % 97;
+            (*rows)[i][0] = key;
+            (*rows)[i][1] = value;
+            count[key] += 1;
+            sum[key] += value;
+        }
+    }
+
+    auto aggtable = agg.agg(*memTable);
+    EXPECT_FALSE(agg.partitioned());
+
+    set<int32_t> keys;
+    auto blocks = aggtable->blocks()->collect();
+    for (auto &block: *blocks) {
+        auto rows = block->rows();
+        for (uint32_t i = 0; i < block->size(); ++i) {
+            DataRow &row = rows->next();
+            auto key = row[0].asInt();
+            keys.insert(key);
+            EXPECT_EQ(sum[key], row[1].asInt());
+            EXPECT_EQ(count[key], row[2].asInt());
+        }
+    }
+    EXPECT_EQ(num_keys, keys.size());
+
+    auto empty = MemTable::Make(2);
+    EXPECT_TRUE(agg.agg(*empty)->blocks()->collect()->empty());
+}
+
+TEST(HashTopKAggTest, TopK) {
+    function<uint64_t(DataRow &)> hasher = [](DataRow &row) {
+        return row[0].asInt();
+    };
+    function<vector<AggField *>()> aggFields = []() {
+        return vector<AggField *>{new IntSum(1)};
+    };
+    // Sum descending, then key ascending
+    function<bool(DataRow *, DataRow *)> comparator = [](DataRow *a, DataRow *b) {
+        auto sa = (*a)[1].asInt();
+        auto sb = (*b)[1].asInt();
+        return sa > sb || (sa == sb && (*a)[0].asInt() < (*b)[0].asInt());
+    };
+
+    HashTopKAgg agg(10, comparator, hasher, RowCopyFactory().field(F_REGULAR, 0, 0)->buildSnapshot(),
+                    aggFields, [](DataRow &row) { return row[0].asInt() % 3 != 0; });
+
+    const int num_keys = 50000;
+    const int block_size = 40000;
+    auto memTable = MemTable::Make(2);
+
+    vector<int> sum(num_keys, 0);
+    set<int> keys;
+    for (int b = 0; b < 4; ++b) {
+        auto block = memTable->allocate(block_size);
+        auto rows = block->rows();
+        for (int i = 0; i < block_size; ++i) {
+            int key = (i * 7919 + b * 20000) % num_keys;
+            int value = (i * 31 + b) % 1000;
+            (*rows)[i][0] = key;
+            (*rows)[i][1] = value;
+            sum[key] += value;
+            keys.insert(key);
+        }
+    }
+    vector<pair<int, int>> expect;
+    for (int key = 0; key < num_keys; ++key) {
+        if (keys.count(key) && key % 3 != 0) {
+            expect.emplace_back(-sum[key], key);
+        }
+    }
+    sort(expect.begin(), expect.end());
+
+    auto aggtable = agg.agg(*memTable);
+    EXPECT_TRUE(agg.partitioned());
+
+    auto blocks = aggtable->blocks()->collect();
+    ASSERT_EQ(1, blocks->size());
+    auto block = (*blocks)[0];
+    ASSERT_EQ(10, block->size());
+    auto rows = block->rows();
+    for (uint32_t i = 0; i < 10; ++i) {
+        DataRow &row = rows->next();
+        EXPECT_EQ(expect[i].second, row[0].asInt());
+        EXPECT_EQ(-expect[i].first, row[1].asInt());
+    }
+
+    HashTopKAgg large(100000, comparator, hasher, RowCopyFactory().field(F_REGULAR, 0, 0)->buildSnapshot(),
+                      aggFields);
+    auto all = large.agg(*memTable);
+    EXPECT_EQ(keys.size(), all->size());
+
+    // Undeclared sums cannot bound the ranking
+    HashTopKAgg unbounded(10, comparator, hasher, RowCopyFactory().field(F_REGULAR, 0, 0)->buildSnapshot(),
+                          aggFields);
+    unbounded.setBound(0);
+    EXPECT_THROW(unbounded.agg(*memTable), std::invalid_argument);
+
+    function<vector<AggField *>()> monotoneFields = []() {
+        return vector<AggField *>{new IntSum(1, true)};
+    };
+    HashTopKAgg bounded(10, comparator, hasher, RowCopyFactory().field(F_REGULAR, 0, 0)->buildSnapshot(),
+                        monotoneFields, [](DataRow &row) { return row[0].asInt() % 3 != 0; });
+    bounded.setBound(0);
+    HashTopKAgg selfBounded(10, comparator, hasher, RowCopyFactory().field(F_REGULAR, 0, 0)->buildSnapshot(),
+                            monotoneFields);
+    selfBounded.setBound(0);
+
+    vector<pair<int, int>> expectAll;
+    for (auto key: keys) {
+        expectAll.emplace_back(-sum[key], key);
+    }
+    sort(expectAll.begin(), expectAll.end());
+
+    for (auto &check: vector<pair<HashTopKAgg *, vector<pair<int, int>> *>>{{&bounded,     &expect},
+                                                                            {&selfBounded, &expectAll}}) {
+        auto bounded_table = check.first->agg(*memTable);
+        // Most groups are dropped before being merged
+        EXPECT_GT(check.first->pruned(), keys.size() / 2);
+        auto bounded_block = (*bounded_table->blocks()->collect())[0];
+        ASSERT_EQ(10, bounded_block->size());
+        auto bounded_rows = bounded_block->rows();
+        for (uint32_t i = 0; i < 10; ++i) {
+            DataRow &row = bounded_rows->next();
+            EXPECT_EQ((*check.second)[i].second, row[0].asInt());
+            EXPECT_EQ(-(*check.second)[i].first, row[1].asInt());
+        }
+    }
+}
+
+TEST(BatchHashAggTest, Agg) {
+    function<uint64_t(DataRow &)> hasher = [](DataRow &row) {
+        return row[0].asInt();
+    };
+    function<vector<AggField *>()> aggFields = []() {
+        return vector<AggField *>{new IntSum(1), new DoubleSum(2), new IntAvg(1), new DoubleMax(2),
+                                  new IntMin(1), new Count()};
+    };
+    BatchHashAgg agg(hasher, RowCopyFactory().field(F_REGULAR, 0, 0)->buildSnapshot(), aggFields);
+    EXPECT_TRUE(agg.columnar());
+
+    // Blocks larger than a batch, on a vertical table
+    auto memTable = MemTable::Make(3, true);
+    srand(time(NULL));
+    vector<int> count(50, 0);
+    vector<int> isum(50, 0);
+    vector<double> dsum(50, 0);
+    vector<double> dmax(50, INT32_MIN);
+    vector<int> imin(50, INT32_MAX);
+    for (int b = 0; b < 3; ++b) {
+        auto block = memTable->allocate(3000);
+        auto rows = block->rows();
+        for (int i = 0; i < 3000; ++i) {
+            int key = (i * 7 + b) % 50;
+            int ival = rand() % 1000 - 500;
+            double dval = (double) rand() / RAND_MAX;
+            (*rows)[i][0] = key;
+            (*rows)[i][1] = ival;
+            (*rows)[i][2] = dval;
+            count[key]++;
+            isum[key] += ival;
+            dsum[key] += dval;
+            dmax[key] = std::max(dmax[key], dval);
+            imin[key] = std::min(imin[key], ival);
+        }
+    }
+
+    auto aggtable = agg.agg(*memTable);
+    auto agged = aggtable->blocks()->collect();
+    EXPECT_EQ(1, agged->size());
+    auto aggblock = (*agged)[0];
+    EXPECT_EQ(50, aggblock->size());
+    auto rows = aggblock->rows();
+    set<int32_t> keys;
+    for (int i = 0; i < 50; ++i) {
+        DataRow &row = rows->next();
+        auto key = row[0].asInt();
+        keys.insert(key);
+        EXPECT_EQ(isum[key], row[1].asInt());
+        EXPECT_NEAR(dsum[key], row[2].asDouble(), 1e-9);
+        EXPECT_DOUBLE_EQ(static_cast<double>(isum[key]) / count[key], row[3].asDouble());
+        EXPECT_DOUBLE_EQ(dmax[key], row[4].asDouble());
+        EXPECT_EQ(imin[key], row[5].asInt());
+        EXPECT_EQ(count[key], row[6].asInt());
+    }
+    EXPECT_EQ(50, keys.size());
+}
+
+class DoubleSquareSum : public DoubleSum {
+public:
+    DoubleSquareSum(uint32_t index) : DoubleSum(index) {}
+
+    void reduce(DataRow &row) override {
+        value_ = value_.asDouble() + row[read_idx_].asDouble() * row[read_idx_].asDouble();
+    }
+};
+
+TEST(BatchHashAggTest, RowFallback) {
+    function<uint64_t(DataRow &)> hasher = [](DataRow &row) {
+        return row[0].asInt();
+    };
+    function<vector<AggField *>()> aggFields = []() {
+        return vector<AggField *>{new DoubleSquareSum(1), new Count()};
+    };
+    BatchHashAgg agg(hasher, RowCopyFactory().field(F_REGULAR, 0, 0)->buildSnapshot(), aggFields);
+    EXPECT_FALSE(agg.columnar());
+
+    auto memTable = MemTable::Make(2);
+    auto block = memTable->allocate(100);
+    auto rows = block->rows();
+    vector<double> sum(10, 0);
+    for (int i = 0; i < 100; ++i) {
+        (*rows)[i][0] = i % 10;
+        (*rows)[i][1] = i * 0.5;
+        sum[i % 10] += i * 0.5 * i * 0.5;
+    }
+    auto aggtable = agg.agg(*memTable);
+    auto aggblock = (*aggtable->blocks()->collect())[0];
+    EXPECT_EQ(10, aggblock->size());
+    auto aggrows = aggblock->rows();
+    for (int i = 0; i < 10; ++i) {
+        DataRow &row = aggrows->next();
+        EXPECT_DOUBLE_EQ(sum[row[0].asInt()], row[1].asDouble());
+        EXPECT_EQ(10, row[2].asInt());
+    }
+}
+
+TEST(PackedKeyTest, Pack) {
+    auto memTable = MemTable::Make(3);
+    auto block = memTable->allocate(1);
+    auto rows = block->rows();
+    (*rows)[0][0] = 0x12345;
+    (*rows)[0][1] = 0x3F;
+    (*rows)[0][2] = -1;
+
+    PackedKey key(IntKey<>(0), IntKey<6>(1));
+    EXPECT_EQ(38, decltype(key)::width);
+    EXPECT_EQ((0x12345ull << 6) | 0x3F, key((*rows)[0]));
+    // Narrowed columns keep only their low bits
+    PackedKey narrow(IntKey<4>(2), IntKey<6>(1));
+    EXPECT_EQ((0xFull << 6) | 0x3F, narrow((*rows)[0]));
+}
+
+TEST(PackedKeyTest, DictKeyWidth) {
+    auto memTable = MemTable::Make(2);
+    auto block = memTable->allocate(1);
+    auto rows = block->rows();
+    (*rows)[0][0] = 0x3F;
+    (*rows)[0][1] = 5;
+
+    PackedKey key(DictKey<6>(0), DictKey<3>(1));
+    EXPECT_EQ((0x3Full << 3) | 5, key((*rows)[0]));
+    // A code wider than the column is rejected instead of truncated
+    PackedKey narrow(DictKey<5>(0), DictKey<3>(1));
+    EXPECT_THROW(narrow((*rows)[0]), invalid_argument);
+
+    // Codes of a row group are translated to the global codes
+    vector<uint32_t> translation(64, 0);
+    translation[0x3F] = 2;
+    PackedKey<DictKey<5>, DictKey<3>>::Codes codes{&translation, nullptr};
+    vector<uint8_t> buffer;
+    EXPECT_EQ((2ull << 3) | 5, narrow.make((*rows)[0], buffer, codes));
+}
+
+TEST(KeyHashAggTest, PackedKey) {
+    function<vector<AggField *>()> aggFields = []() {
+        return vector<AggField *>{new DoubleSum(2), new Count()};
+    };
+    KeyHashAgg agg(PackedKey(IntKey<>(0), IntKey<8>(1)),
+                   RowCopyFactory().field(F_REGULAR, 0, 0)->field(F_REGULAR, 1, 1)->buildSnapshot(), aggFields);
+
+    auto memTable = MemTable::Make(3);
+    vector<vector<int>> count(10, vector<int>(5, 0));
+    vector<vector<double>> sum(10, vector<double>(5, 0));
+    for (int b = 0; b < 3; ++b) {
+        auto block = memTable->allocate(2000);
+        auto rows = block->rows();
+        for (int i = 0; i < 2000; ++i) {
+            int k1 = (i + b) % 10;
+            int k2 = (i / 10) % 5;
+            double v = (double) rand() / RAND_MAX;
+            (*rows)[i][0] = k1;
+            (*rows)[i][1] = k2;
+            (*rows)[i][2] = v;
+            count[k1][k2]++;
+            sum[k1][k2] += v;
+        }
+    }
+
+    auto aggtable = agg.agg(*memTable);
+    auto agged = aggtable->blocks()->collect();
+    ASSERT_EQ(1, agged->size());
+    auto aggblock = (*agged)[0];
+    EXPECT_EQ(50, aggblock->size());
+    auto rows = aggblock->rows();
+    for (int i = 0; i < 50; ++i) {
+        DataRow &row = rows->next();
+        auto k1 = row[0].asInt();
+        auto k2 = row[1].asInt();
+        EXPECT_NEAR(sum[k1][k2], row[2].asDouble(), 1e-9);
+        EXPECT_EQ(count[k1][k2], row[3].asInt());
+    }
+}
+
+TEST(KeyHashAggTest, FullWidthKey) {
+    function<vector<AggField *>()> aggFields = []() {
+        return vector<AggField *>{new DoubleSquareSum(1), new Count()};
+    };
+    KeyHashAgg agg(PackedKey(LongKey(0)), RowCopyFactory().field(F_REGULAR, 0, 0)->buildSnapshot(), aggFields);
+
+    auto memTable = MemTable::Make(2);
+    for (int b = 0; b < 2; ++b) {
+        auto block = memTable->allocate(100);
+        auto rows = block->rows();
+        for (int i = 0; i < 100; ++i) {
+            // All bits set collides with the empty key of the hash map
+            *(*rows)[i][0].data() = i % 2 ? ~0ull : 7;
+            (*rows)[i][1] = 1.0;
+        }
+    }
+
+    auto aggtable = agg.agg(*memTable);
+    auto agged = aggtable->blocks()->collect();
+    auto aggblock = (*agged)[0];
+    ASSERT_EQ(2, aggblock->size());
+    auto rows = aggblock->rows();
+    for (int i = 0; i < 2; ++i) {
+        DataRow &row = rows->next();
+        auto key = *row[0].data();
+        EXPECT_TRUE(key == ~0ull || key == 7);
+        EXPECT_DOUBLE_EQ(100, row[1].asDouble());
+        EXPECT_EQ(100, row[2].asInt());
+    }
+}
+
+TEST(KeyHashAggTest, BytesKey) {
+    function<vector<AggField *>()> aggFields = []() {
+        return vector<AggField *>{new IntSum(2), new Count()};
+    };
+    KeyHashAgg agg(BytesKey(ByteArrayKey(0), IntKey<>(1)),
+                   RowCopyFactory().field(F_STRING, 0, 0)->field(F_REGULAR, 1, 1)->buildSnapshot(), aggFields);
+
+    vector<string> words{"apple", "banana", "cherry", "apple1", ""};
+    auto memTable = MemTable::Make(vector<uint32_t>{2, 1, 1});
+    map<pair<string, int>, pair<int, int>> expect;
+    for (int b = 0; b < 2; ++b) {
+        auto block = memTable->allocate(500);
+        auto rows = block->rows();
+        for (int i = 0; i < 500; ++i) {
+            auto &word = words[(i + b) % words.size()];
+            ByteArray value((uint32_t) word.size(), (const uint8_t *) word.data());
+            (*rows)[i][0] = value;
+            (*rows)[i][1] = i % 3;
+            (*rows)[i][2] = i;
+            auto &group = expect[make_pair(word, i % 3)];
+            group.first += i;
+            group.second++;
+        }
+    }
+
+    auto aggtable = agg.agg(*memTable);
+    auto agged = aggtable->blocks()->collect();
+    auto aggblock = (*agged)[0];
+    EXPECT_EQ(expect.size(), aggblock->size());
+    auto rows = aggblock->rows();
+    for (uint32_t i = 0; i < aggblock->size(); ++i) {
+        DataRow &row = rows->next();
+        ByteArray &word = row[0].asByteArray();
+        auto found = expect.find(make_pair(string((const char *) word.ptr, word.len), row[1].asInt()));
+        ASSERT_TRUE(found != expect.end());
+        EXPECT_EQ(found->second.first, row[2].asInt());
+        EXPECT_EQ(found->second.second, row[3].asInt());
+    }
+}
+
+TEST(DictAggTest, Agg) {
+    function<vector<AggField *>()> aggFields = []() {
+        return vector<AggField *>{new DoubleSum(2), new Count()};
+    };
+    DictAgg agg({DictDim(0, 5), DictDim(1, 7, 1992, false)},
+                RowCopyFactory().field(F_REGULAR, 0, 0)->field(F_REGULAR, 1, 1)->buildSnapshot(), aggFields);
+
+    auto memTable = MemTable::Make(3);
+    vector<vector<int>> count(5, vector<int>(7, 0));
+    vector<vector<double>> sum(5, vector<double>(7, 0));
+    for (int b = 0; b < 3; ++b) {
+        auto block = memTable->allocate(1000);
+        auto rows = block->rows();
+        for (int i = 0; i < 1000; ++i) {
+            // Code 4 never appears with year 1998
+            int code = (i + b) % 5;
+            int year = 1992 + (i / 5) % (code == 4 ? 6 : 7);
+            double v = (double) rand() / RAND_MAX;
+            (*rows)[i][0] = code;
+            (*rows)[i][1] = year;
+            (*rows)[i][2] = v;
+            count[code][year - 1992]++;
+            sum[code][year - 1992] += v;
+        }
+    }
+
+    auto aggtable = agg.agg(*memTable);
+    auto agged = aggtable->blocks()->collect();
+    ASSERT_EQ(1, agged->size());
+    auto aggblock = (*agged)[0];
+    ASSERT_EQ(34, aggblock->size());
+    auto rows = aggblock->rows();
+    int prev = -1;
+    for (int i = 0; i < 34; ++i) {
+        DataRow &row = rows->next();
+        auto code = row[0].asInt();
+        auto year = row[1].asInt();
+        // Groups come out in key order
+        EXPECT_LT(prev, code * 7 + year - 1992);
+        prev = code * 7 + year - 1992;
+        EXPECT_NEAR(sum[code][year - 1992], row[2].asDouble(), 1e-9);
+        EXPECT_EQ(count[code][year - 1992], row[3].asInt());
+    }
+
+    EXPECT_THROW(DictAgg({DictDim(0, 1 << 12), DictDim(1, 1 << 12)},
+                         RowCopyFactory().field(F_REGULAR, 0, 0)->buildSnapshot(), aggFields),
+                 std::invalid_argument);
 }
 
 TEST(TableAggTest, Agg) {
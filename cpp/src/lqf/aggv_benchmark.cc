@@ -71,8 +71,56 @@ static void AggBenchmark_Column(benchmark::State &state) {
     }
 }
 
+// Q1-like workload: a few groups and several sum / avg / count fields
+static shared_ptr<MemTable> q1Table_;
+
+void initQ1() {
+    if (q1Table_) {
+        return;
+    }
+    q1Table_ = MemTable::Make(4);
+    srand(time(NULL));
+    for (int b = 0; b < 10; ++b) {
+        auto block = q1Table_->allocate(table_size / 10);
+        auto writer = block->rows();
+        for (int i = 0; i < table_size / 10; ++i) {
+            (*writer)[i][0] = rand() % 4;
+            (*writer)[i][1] = rand() % 50;
+            (*writer)[i][2] = (double) rand() / RAND_MAX;
+            (*writer)[i][3] = (double) rand() / RAND_MAX;
+        }
+    }
+}
+
+static function<vector<AggField *>()> q1Fields = []() {
+    return vector<AggField *>{new IntSum(1), new DoubleSum(2), new IntAvg(1), new DoubleAvg(2),
+                              new DoubleAvg(3), new Count()};
+};
+
+static void AggBenchmark_Q1Row(benchmark::State &state) {
+    initQ1();
+    for (auto _:state) {
+        HashAgg agg(COL_HASHER(0), RowCopyFactory().field(F_REGULAR, 0, 0)->buildSnapshot(), q1Fields);
+        auto agged = agg.agg(*q1Table_);
+        size_ = agged->size();
+    }
+    state.SetItemsProcessed(state.iterations() * table_size);
+}
+
+static void AggBenchmark_Q1Batch(benchmark::State &state) {
+    initQ1();
+    for (auto _:state) {
+        BatchHashAgg agg(COL_HASHER(0), RowCopyFactory().field(F_REGULAR, 0, 0)->buildSnapshot(), q1Fields);
+        auto agged = agg.agg(*q1Table_);
+        size_ = agged->size();
+    }
+    state.SetItemsProcessed(state.iterations() * table_size);
+}
+
 BENCHMARK(AggBenchmark_Row)->MinTime(5);
 // Note
 BENCHMARK(AggBenchmark_Column)->MinTime(5);
+BENCHMARK(AggBenchmark_Q1Row)->MinTime(5);
+BENCHMARK(AggBenchmark_Q1Batch)->MinTime(5);
 
 BENCHMARK_MAIN();
\ No newline at end of file
@@ -203,10 +203,6 @@ namespace lqf {
         size_ = newsize;
     }
 
-    vector<uint64_t> &MemBlock::content() {
-        return content_;
-    }
-
     class MemDataRowIterator;
 
     class MemDataRowView : public DataRow {
@@ -864,8 +860,9 @@ namespace lqf {
         shared_ptr<Page> page = pageReader->NextPage();
 
         if (page->type() == PageType::DICTIONARY_PAGE) {
-            Dictionary<DTYPE> dict(static_pointer_cast<DictionaryPage>(page));
-            accessor->dict(dict);
+            // The table decodes each distinct dictionary once for all row groups
+            auto dict = owner_->LoadGlobalDictionary<DTYPE>(col_index)->local(index_);
+            accessor->dict(*dict);
         } else {
             accessor->data((DataPage *) page.get());
         }
@@ -879,6 +876,10 @@ namespace lqf {
         return rowGroup_->GetColumnPageReader(col_index);
     }
 
+    bool ParquetBlock::hasDictionary(uint32_t col_index) {
+        return rowGroup_->metadata()->ColumnChunk(col_index)->has_dictionary_page();
+    }
+
     class ParquetRowIterator : public DataRowIterator {
     private:
         vector<unique_ptr<ParquetColumnIterator>> columns_;
@@ -984,10 +985,43 @@ namespace lqf {
     }
 
     template<typename DTYPE>
-    unique_ptr<Dictionary<DTYPE>> ParquetTable::LoadDictionary(int column) {
-        auto dictpage = static_pointer_cast<DictionaryPage>(
-                fileReader_->RowGroup(0)->GetColumnPageReader(column)->NextPage());
-        return unique_ptr<Dictionary<DTYPE>>(new Dictionary<DTYPE>(dictpage));
+    shared_ptr<Dictionary<DTYPE>> ParquetTable::LoadDictionary(int column) {
+        return LoadGlobalDictionary<DTYPE>(column)->global();
+    }
+
+    template<typename DTYPE>
+    shared_ptr<GlobalDictionary<DTYPE>> ParquetTable::LoadGlobalDictionary(int column) {
+        lock_guard<mutex> lock(dict_lock_);
+        auto &cached = dicts_[column];
+        if (!cached) {
+            uint32_t num_row_groups = numBlocks();
+            vector<shared_ptr<DictionaryPage>> pages(num_row_groups);
+            for (uint32_t i = 0; i < num_row_groups; ++i) {
+                auto page = fileReader_->RowGroup(i)->GetColumnPageReader(column)->NextPage();
+                if (page && page->type() == PageType::DICTIONARY_PAGE) {
+                    pages[i] = static_pointer_cast<DictionaryPage>(page);
+                }
+            }
+            cached = make_shared<GlobalDictionary<DTYPE>>(move(pages));
+        }
+        auto dict = dynamic_pointer_cast<GlobalDictionary<DTYPE>>(cached);
+        if (!dict) {
+            throw invalid_argument("dictionary type mismatch");
+        }
+        return dict;
+    }
+
+    shared_ptr<GlobalDictionaryBase> ParquetTable::LoadGlobalDictionary(int column) {
+        switch (fileReader_->metadata()->schema()->Column(column)->physical_type()) {
+            case Type::INT32:
+                return LoadGlobalDictionary<Int32Type>(column);
+            case Type::DOUBLE:
+                return LoadGlobalDictionary<DoubleType>(column);
+            case Type::BYTE_ARRAY:
+                return LoadGlobalDictionary<ByteArrayType>(column);
+            default:
+                throw invalid_argument("unsupported dictionary type");
+        }
     }
 
     MaskedTable::MaskedTable(ParquetTable *inner, vector<shared_ptr<Bitmap>> &masks)
@@ -1113,10 +1147,16 @@ namespace lqf {
     template shared_ptr<Bitmap>
     ParquetBlock::raw<ByteArrayType>(uint32_t col_index, RawAccessor<ByteArrayType> *accessor);
 
-    template unique_ptr<Dictionary<Int32Type>> ParquetTable::LoadDictionary<Int32Type>(int index);
+    template shared_ptr<Dictionary<Int32Type>> ParquetTable::LoadDictionary<Int32Type>(int index);
+
+    template shared_ptr<Dictionary<DoubleType>> ParquetTable::LoadDictionary<DoubleType>(int index);
+
+    template shared_ptr<Dictionary<ByteArrayType>> ParquetTable::LoadDictionary<ByteArrayType>(int index);
+
+    template shared_ptr<GlobalDictionary<Int32Type>> ParquetTable::LoadGlobalDictionary<Int32Type>(int index);
 
-    template unique_ptr<Dictionary<DoubleType>> ParquetTable::LoadDictionary<DoubleType>(int index);
+    template shared_ptr<GlobalDictionary<DoubleType>> ParquetTable::LoadGlobalDictionary<DoubleType>(int index);
 
-    template unique_ptr<Dictionary<ByteArrayType>> ParquetTable::LoadDictionary<ByteArrayType>(int index);
+    template shared_ptr<GlobalDictionary<ByteArrayType>> ParquetTable::LoadGlobalDictionary<ByteArrayType>(int index);
 
 }
\ No newline at end of file
@@ -8,6 +8,8 @@
 #include <cstdint>
 #include <random>
 #include <iostream>
+#include <mutex>
+#include <unordered_map>
 #include <arrow/util/bit_stream_utils.h>
 #include <parquet/file_reader.h>
 #include <parquet/column_reader.h>
@@ -233,7 +235,7 @@ namespace lqf {
 
         void resize(uint32_t newsize) override;
 
-        inline vector<uint64_t> &content();
+        inline vector<uint64_t> &content() { return content_; }
 
         unique_ptr<ColumnIterator> col(uint32_t col_index) override;
 
@@ -271,6 +273,10 @@ namespace lqf {
 
         void merge(MemvBlock &, const vector<pair<uint8_t, uint8_t>> &);
 
+        inline vector<uint64_t> &column(uint32_t index) { return *content_[index]; }
+
+        inline const vector<uint32_t> &colSize() { return col_size_; }
+
         uint64_t memrss() override;
     };
 
@@ -400,6 +406,9 @@ namespace lqf {
 
         unique_ptr<parquet::PageReader> pages(uint32_t);
 
+        /// Whether the column chunk starts with a dictionary page
+        bool hasDictionary(uint32_t col_index);
+
         unique_ptr<ColumnIterator> col(uint32_t col_index) override;
 
         unique_ptr<DataRowIterator> rows() override;
@@ -461,6 +470,9 @@ namespace lqf {
         uint64_t columns_;
 
         unique_ptr<ParquetFileReader> fileReader_;
+
+        mutex dict_lock_;
+        unordered_map<int, shared_ptr<GlobalDictionaryBase>> dicts_;
     public:
         ParquetTable(const string &fileName, uint64_t columns = 0);
 
@@ -476,8 +488,16 @@ namespace lqf {
 
         inline uint32_t numBlocks() { return fileReader_->metadata()->num_row_groups(); }
 
+        /// The global dictionary of a column, whose codes match the translated row group codes
         template<typename DTYPE>
-        unique_ptr<Dictionary<DTYPE>> LoadDictionary(int column);
+        shared_ptr<Dictionary<DTYPE>> LoadDictionary(int column);
+
+        /// Dictionaries of all row groups, decoded once and cached in the table
+        template<typename DTYPE>
+        shared_ptr<GlobalDictionary<DTYPE>> LoadGlobalDictionary(int column);
+
+        /// Same as above, with the type of the column
+        shared_ptr<GlobalDictionaryBase> LoadGlobalDictionary(int column);
 
         static shared_ptr<ParquetTable> Open(const string &filename, uint64_t columns = 0);
 
@@ -4,6 +4,7 @@
 
 #include "data_model_enc.h"
 #include <type_traits>
+#include <stdexcept>
 
 namespace lqf {
 
@@ -44,6 +45,13 @@ namespace lqf {
         unique_ptr<encoding::Decoder<DT>> decoder_;
 
         void read_buffer() {
+            if (row_index_ < buffer_start_) {
+                // Seek backward by decoding from the beginning
+                decoder_ = encoding::GetDecoder<DT>(type_);
+                decoder_->SetData(block_.content_[col_index_]);
+                buffer_start_ = 0;
+                buffer_end_ = 0;
+            }
             while (buffer_end_ <= row_index_) {
                 auto decoded = decoder_->Decode(buffer_, 16);
                 buffer_start_ = buffer_end_;
@@ -54,15 +62,19 @@ namespace lqf {
 
         void write_buffer() {
             encoder_->Add(buffer_[0]);
+            // A narrower value written to the next row should not keep the higher bytes of this one
+            buffer_[0] = data_type();
         }
 
     public:
         EncMemvColumnIterator(EncMemvBlock &block, uint32_t col_index)
                 : block_(block), col_index_(col_index), row_index_(-1), type_(block.encoding_types_[col_index]) {
             buffer_ = (data_type *) aligned_alloc(64, sizeof(data_type) * 16);
-            view_.size_ = 1;
+            memset((void *) buffer_, 0, sizeof(data_type) * 16);
+            view_.size_ = (sizeof(data_type) + 7) / 8;
             view_ = (uint64_t *) buffer_;
-            read_ = block.size_ > 0;
+            // A column is read once it has been written
+            read_ = col_index < block.content_.size() && block.content_[col_index];
             if (read_) {
                 // read mode
                 decoder_ = encoding::GetDecoder<DT>(type_);
@@ -72,6 +84,10 @@ namespace lqf {
                 // write mode
                 encoder_ = encoding::GetEncoder<DT>(type_);
             }
+            if (!decoder_ && !encoder_) {
+                free(buffer_);
+                throw invalid_argument("Unsupported encoding for the column type");
+            }
         }
 
         virtual ~EncMemvColumnIterator() noexcept {
@@ -112,11 +128,18 @@ namespace lqf {
         void close() override {
             if (!read_) {
                 // Write buffer
-                write_buffer();
+                if (row_index_ != (uint64_t) -1) {
+                    write_buffer();
+                }
                 while (block_.content_.size() <= col_index_) {
                     block_.content_.push_back(nullptr);
                 }
                 block_.content_[col_index_] = encoder_->Dump();
+                // Record the choice of an AUTO encoder for the readers
+                auto selecting = dynamic_cast<encoding::AutoEncoder<DT> *>(encoder_.get());
+                if (selecting) {
+                    block_.encoding_types_[col_index_] = selecting->Selected();
+                }
             }
         }
     };
@@ -210,13 +233,40 @@ namespace lqf {
         switch (type) {
             case parquet::Type::type::INT32:
                 return unique_ptr<ColumnIterator>(new EncMemvColumnIterator<parquet::Int32Type>(*this, col_index));
+            case parquet::Type::type::INT64:
+                return unique_ptr<ColumnIterator>(new EncMemvColumnIterator<parquet::Int64Type>(*this, col_index));
             case parquet::Type::type::DOUBLE:
                 return unique_ptr<ColumnIterator>(new EncMemvColumnIterator<parquet::DoubleType>(*this, col_index));
+            case parquet::Type::type::BYTE_ARRAY:
+                return unique_ptr<ColumnIterator>(
+                        new EncMemvColumnIterator<parquet::ByteArrayType>(*this, col_index));
             default:
                 return nullptr;
         }
     }
 
+    void EncMemvBlock::share(EncMemvBlock &from, uint32_t from_index, uint32_t to_index) {
+        if (from.data_types_[from_index] != data_types_[to_index] ||
+            from.encoding_types_[from_index] != encoding_types_[to_index]) {
+            throw invalid_argument("Shared column should have the same type and encoding");
+        }
+        if (content_.size() <= to_index) {
+            content_.resize(to_index + 1);
+        }
+        content_[to_index] = from.content_[from_index];
+        size_ = std::max<uint32_t>(size_, from.size_);
+    }
+
+    void EncMemvBlock::encode(Block &from, uint32_t from_index, uint32_t to_index) {
+        auto reader = from.col(from_index);
+        auto writer = col(to_index);
+        auto from_size = from.size();
+        for (uint32_t i = 0; i < from_size; ++i) {
+            writer->next() = reader->next();
+        }
+        writer->close();
+    }
+
     shared_ptr<Block> EncMemvBlock::mask(shared_ptr<Bitmap> mask) {
         // Does not support
         return make_shared<MaskedBlock>(shared_from_this(), mask);
@@ -225,6 +275,9 @@ namespace lqf {
     uint64_t EncMemvBlock::memrss() {
         uint64_t size = 0;
         for (auto &b: content_) {
+            if (!b) {
+                continue;
+            }
             for(auto& buffer: *b) {
                 size += buffer->size();
             }
@@ -49,6 +49,16 @@ namespace lqf {
 
         inline shared_ptr<vector<shared_ptr<Buffer>>> rawcol(uint32_t index) { return content_[index]; }
 
+        inline const vector<parquet::Type::type> &dataTypes() { return data_types_; }
+
+        inline const vector<encoding::EncodingType> &encodingTypes() { return encoding_types_; }
+
+        /// Reference an encoded column of another block, without decoding it
+        void share(EncMemvBlock &from, uint32_t from_index, uint32_t to_index);
+
+        /// Encode a column of another block into an empty column
+        void encode(Block &from, uint32_t from_index, uint32_t to_index);
+
         uint64_t memrss() override;
     };
 }
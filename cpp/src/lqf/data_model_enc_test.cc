@@ -76,4 +76,83 @@ TEST(EncMemvBlockTest, WriteAndReadBitpackCol) {
         ASSERT_EQ(i, readcol->next().asInt()) << i;
     }
     readcol->close();
-}
\ No newline at end of file
+}
+TEST(EncMemvBlockTest, WriteAndReadTypes) {
+    auto block = make_shared<EncMemvBlock>(
+            vector<Type::type>{Type::type::INT64, Type::type::DOUBLE, Type::type::BYTE_ARRAY,
+                               Type::type::BYTE_ARRAY},
+            vector<encoding::EncodingType>{encoding::EncodingType::BITPACK, encoding::EncodingType::DICTIONARY,
+                                           encoding::EncodingType::DICTIONARY, encoding::EncodingType::PLAIN});
+    vector<string> texts;
+    for (int i = 0; i < 2000; ++i) {
+        texts.push_back("text" + to_string(i % 50));
+    }
+    auto writer = block->rows();
+    for (int i = 0; i < 2000; ++i) {
+        DataRow &row = writer->next();
+        ByteArray bytes(texts[i].size(), reinterpret_cast<const uint8_t *>(texts[i].data()));
+        // An int written to a 64-bit column reads back by asInt
+        row[0] = i % 7 ? i : -i;
+        row[1] = (i % 20) * 0.25;
+        row[2] = bytes;
+        row[3] = bytes;
+    }
+    writer->close();
+    EXPECT_EQ(2000, block->size());
+
+    auto reader = block->rows();
+    for (int i: {0, 1, 500, 1999, 3, 777}) {
+        DataRow &row = (*reader)[i];
+        ByteArray bytes(texts[i].size(), reinterpret_cast<const uint8_t *>(texts[i].data()));
+        EXPECT_EQ(i % 7 ? i : -i, row[0].asInt()) << i;
+        EXPECT_EQ((i % 20) * 0.25, row[1].asDouble()) << i;
+        EXPECT_EQ(bytes, row[2].asByteArray()) << i;
+        EXPECT_EQ(bytes, row[3].asByteArray()) << i;
+    }
+
+    auto shared = make_shared<EncMemvBlock>(
+            vector<Type::type>{Type::type::BYTE_ARRAY, Type::type::INT32},
+            vector<encoding::EncodingType>{encoding::EncodingType::DICTIONARY, encoding::EncodingType::BITPACK});
+    shared->share(*block, 2, 0);
+    MemvBlock plain(2000, lqf::colSize(1));
+    auto plaincol = plain.col(0);
+    for (int i = 0; i < 2000; ++i) {
+        plaincol->next() = i * 2;
+    }
+    shared->encode(plain, 0, 1);
+    EXPECT_EQ(2000, shared->size());
+    EXPECT_EQ(block->rawcol(2), shared->rawcol(0));
+    auto sharedrows = shared->rows();
+    for (int i = 0; i < 2000; ++i) {
+        DataRow &row = sharedrows->next();
+        ByteArray bytes(texts[i].size(), reinterpret_cast<const uint8_t *>(texts[i].data()));
+        ASSERT_EQ(bytes, row[0].asByteArray());
+        ASSERT_EQ(i * 2, row[1].asInt());
+    }
+    EXPECT_THROW(shared->share(*block, 3, 0), std::invalid_argument);
+}
+
+TEST(EncMemvBlockTest, AutoEncoding) {
+    auto block = make_shared<EncMemvBlock>(
+            vector<Type::type>{Type::type::INT32, Type::type::INT32, Type::type::DOUBLE},
+            vector<encoding::EncodingType>{encoding::EncodingType::AUTO, encoding::EncodingType::AUTO,
+                                           encoding::EncodingType::AUTO});
+    auto writer = block->rows();
+    for (int i = 0; i < 3000; ++i) {
+        DataRow &row = writer->next();
+        row[0] = i;
+        row[1] = (int32_t) ((i * 2654435761u) % 2000000000);
+        row[2] = (i % 5) * 1.5;
+    }
+    writer->close();
+    EXPECT_EQ(vector<encoding::EncodingType>({encoding::EncodingType::DELTA, encoding::EncodingType::PLAIN,
+                                              encoding::EncodingType::DICTIONARY}), block->encodingTypes());
+
+    auto reader = block->rows();
+    for (int i = 0; i < 3000; ++i) {
+        DataRow &row = reader->next();
+        ASSERT_EQ(i, row[0].asInt());
+        ASSERT_EQ((int32_t) ((i * 2654435761u) % 2000000000), row[1].asInt());
+        ASSERT_EQ((i % 5) * 1.5, row[2].asDouble());
+    }
+}
@@ -2,6 +2,9 @@
 // Created by harper on 4/11/20.
 //
 
+#include <algorithm>
+#include <cstring>
+#include <string_view>
 #include <parquet/encoding.h>
 #include "dict.h"
 #include "memorypool.h"
@@ -12,8 +15,8 @@ namespace lqf {
     using namespace lqf::memory;
 
     template<typename DTYPE>
-    Dictionary<DTYPE>::Dictionary() {
-
+    Dictionary<DTYPE>::Dictionary(): buffer_(nullptr), sorted_(true) {
+        size_ = 0;
     }
 
     template<typename DTYPE>
@@ -30,12 +33,14 @@ namespace lqf {
 //                ByteArrayBuffer::instance.allocate(*ba);
 //            }
 //        }
+        checkSorted();
     }
 
     template<typename DTYPE>
     Dictionary<DTYPE>::Dictionary(void *buffer, uint32_t size) {
         buffer_ = reinterpret_cast<T *>(buffer);
         size_ = size;
+        checkSorted();
     }
 
     template<typename DTYPE>
@@ -44,6 +49,14 @@ namespace lqf {
             free(buffer_);
     }
 
+    template<typename DTYPE>
+    void Dictionary<DTYPE>::checkSorted() {
+        sorted_ = true;
+        for (uint32_t i = 1; i < size_ && sorted_; ++i) {
+            sorted_ = buffer_[i - 1] < buffer_[i];
+        }
+    }
+
     template<typename DTYPE>
     const typename DTYPE::c_type &Dictionary<DTYPE>::operator[](int32_t key) {
         return buffer_[key];
@@ -51,21 +64,55 @@ namespace lqf {
 
     template<typename DTYPE>
     int32_t Dictionary<DTYPE>::lookup(const T &key) {
-        uint32_t low = 0;
-        uint32_t high = size_;
-
-        while (low <= high && low < size_) {
-            uint32_t mid = (low + high) >> 1;
-            T midVal = buffer_[mid];
-
-            if (midVal < key)
-                low = mid + 1;
-            else if (midVal > key)
-                high = mid - 1;
-            else
-                return mid; // key found
+        uint32_t rank = lowerBound(key);
+        if (rank == size_) {
+            return -(rank + 1);
+        }
+        uint32_t code = sorted_ ? rank : order()[rank];
+        if (key < buffer_[code]) {
+            return -(rank + 1);  // key not found.
         }
-        return -(low + 1);  // key not found.
+        return code;
+    }
+
+    template<typename DTYPE>
+    uint32_t Dictionary<DTYPE>::lowerBound(const T &key) {
+        if (sorted_) {
+            return std::lower_bound(buffer_, buffer_ + size_, key) - buffer_;
+        }
+        auto &codes = order();
+        return std::lower_bound(codes.begin(), codes.end(), key, [this](uint32_t code, const T &key) {
+            return buffer_[code] < key;
+        }) - codes.begin();
+    }
+
+    template<typename DTYPE>
+    uint32_t Dictionary<DTYPE>::upperBound(const T &key) {
+        if (sorted_) {
+            return std::upper_bound(buffer_, buffer_ + size_, key) - buffer_;
+        }
+        auto &codes = order();
+        return std::upper_bound(codes.begin(), codes.end(), key, [this](const T &key, uint32_t code) {
+            return key < buffer_[code];
+        }) - codes.begin();
+    }
+
+    template<typename DTYPE>
+    const vector<uint32_t> &Dictionary<DTYPE>::order() {
+        lock_guard<mutex> lock(order_lock_);
+        if (!order_) {
+            auto codes = make_shared<vector<uint32_t>>(size_);
+            for (uint32_t i = 0; i < size_; ++i) {
+                (*codes)[i] = i;
+            }
+            if (!sorted_) {
+                std::sort(codes->begin(), codes->end(), [this](uint32_t a, uint32_t b) {
+                    return buffer_[a] < buffer_[b];
+                });
+            }
+            order_ = codes;
+        }
+        return *order_;
     }
 
     template<typename DTYPE>
@@ -79,6 +126,88 @@ namespace lqf {
         return result;
     }
 
+    template<typename DTYPE>
+    GlobalDictionary<DTYPE>::GlobalDictionary(vector<shared_ptr<DictionaryPage>> pages)
+            : pages_(move(pages)), locals_(pages_.size()) {
+        // Identical pages are decoded once
+        unordered_multimap<size_t, uint32_t> decoded;
+        for (uint32_t i = 0; i < pages_.size(); ++i) {
+            auto &page = pages_[i];
+            if (!page) {
+                continue;
+            }
+            auto hash = std::hash<std::string_view>()(std::string_view((const char *) page->data(), page->size()));
+            auto candidates = decoded.equal_range(hash);
+            for (auto it = candidates.first; it != candidates.second; ++it) {
+                auto &other = pages_[it->second];
+                if (other->num_values() == page->num_values() && other->size() == page->size() &&
+                    !memcmp(other->data(), page->data(), page->size())) {
+                    locals_[i] = locals_[it->second];
+                    break;
+                }
+            }
+            if (locals_[i]) {
+                page = nullptr;
+            } else {
+                locals_[i] = make_shared<Dictionary<DTYPE>>(page);
+                decoded.emplace(hash, i);
+            }
+        }
+        merge();
+    }
+
+    template<typename DTYPE>
+    GlobalDictionary<DTYPE>::GlobalDictionary(vector<shared_ptr<Dictionary<DTYPE>>> locals)
+            : locals_(move(locals)) {
+        merge();
+    }
+
+    template<typename DTYPE>
+    void GlobalDictionary<DTYPE>::merge() {
+        translations_.resize(locals_.size());
+        unordered_map<Dictionary<DTYPE> *, shared_ptr<vector<uint32_t>>> distinct;
+        for (auto &local: locals_) {
+            if (local && distinct.find(local.get()) == distinct.end()) {
+                distinct[local.get()] = nullptr;
+                global_ = local;
+            }
+        }
+        num_distinct_ = distinct.size();
+        if (num_distinct_ == 0) {
+            throw invalid_argument("no row group has a dictionary");
+        }
+        if (num_distinct_ == 1) {
+            return;
+        }
+        vector<T> entries;
+        for (auto &entry: distinct) {
+            auto dict = entry.first;
+            for (uint32_t i = 0; i < dict->size(); ++i) {
+                entries.push_back((*dict)[i]);
+            }
+        }
+        sort(entries.begin(), entries.end());
+        entries.erase(unique(entries.begin(), entries.end()), entries.end());
+
+        T *buffer = (T *) malloc(sizeof(T) * entries.size());
+        memcpy((void *) buffer, entries.data(), sizeof(T) * entries.size());
+        global_ = make_shared<Dictionary<DTYPE>>(buffer, entries.size());
+
+        for (auto &entry: distinct) {
+            auto dict = entry.first;
+            auto translation = make_shared<vector<uint32_t>>(dict->size());
+            for (uint32_t i = 0; i < dict->size(); ++i) {
+                (*translation)[i] = lower_bound(entries.begin(), entries.end(), (*dict)[i]) - entries.begin();
+            }
+            entry.second = translation;
+        }
+        for (uint32_t i = 0; i < locals_.size(); ++i) {
+            if (locals_[i]) {
+                translations_[i] = distinct[locals_[i].get()];
+            }
+        }
+    }
+
     template
     class Dictionary<Int32Type>;
 
@@ -88,4 +217,13 @@ namespace lqf {
     template
     class Dictionary<ByteArrayType>;
 
+    template
+    class GlobalDictionary<Int32Type>;
+
+    template
+    class GlobalDictionary<DoubleType>;
+
+    template
+    class GlobalDictionary<ByteArrayType>;
+
 }
\ No newline at end of file
@@ -6,6 +6,8 @@
 #define ARROW_DICT_H
 
 #include <memory>
+#include <mutex>
+#include <vector>
 #include <unordered_map>
 #include <parquet/types.h>
 #include <parquet/column_page.h>
@@ -35,6 +37,13 @@ namespace lqf {
         using T = typename DTYPE::c_type;
 
         T *buffer_;
+        // Codes in ascending order of their values, only built for unsorted dictionaries
+        shared_ptr<vector<uint32_t>> order_;
+        mutex order_lock_;
+        bool sorted_;
+
+        void checkSorted();
+
     public:
         Dictionary();
 
@@ -50,16 +59,35 @@ namespace lqf {
 
         const T &operator[](int32_t key);
 
+        /// Code of the key, or a negative number if the key is not in the dictionary
         int32_t lookup(const T &key);
 
         unique_ptr<vector<uint32_t>> list(function<bool(const T &)>);
 
+        /// Whether the entries are in ascending order, so that codes compare like values
+        inline bool sorted() { return sorted_; }
+
+        /// Number of entries less than the key
+        uint32_t lowerBound(const T &key);
+
+        /// Number of entries not greater than the key
+        uint32_t upperBound(const T &key);
+
+        /**
+         * Codes sorted by their values, which maps the ranks from lowerBound and upperBound
+         * to codes. It is built on the first call and cached. A sorted dictionary does not
+         * need it.
+         */
+        const vector<uint32_t> &order();
+
         Dictionary &operator=(Dictionary &) = delete;
 
         Dictionary &operator=(Dictionary &&other) {
             this->buffer_ = other.buffer_;
             other.buffer_ = nullptr;
             this->size_ = other.size_;
+            this->sorted_ = other.sorted_;
+            this->order_ = move(other.order_);
             return *this;
         }
     };
@@ -68,6 +96,54 @@ namespace lqf {
     using DoubleDictionary = Dictionary<DoubleType>;
     using ByteArrayDictionary = Dictionary<ByteArrayType>;
 
+    class GlobalDictionaryBase {
+    protected:
+        vector<shared_ptr<vector<uint32_t>>> translations_;
+        uint32_t num_distinct_;
+    public:
+        virtual ~GlobalDictionaryBase() = default;
+
+        /// Map from the codes of a row group to the global codes, nullptr if they are the same
+        inline const vector<uint32_t> *translation(uint32_t row_group) {
+            return translations_[row_group].get();
+        }
+
+        /// Number of distinct dictionaries among the row groups
+        inline uint32_t numDistinct() { return num_distinct_; }
+    };
+
+    /**
+     * GlobalDictionary merges the dictionaries of a column over all row groups. Identical
+     * dictionaries are decoded once and shared. When all row groups share one dictionary, it is
+     * also the global one and no translation is needed. Otherwise the global dictionary is the
+     * sorted union of the local entries, and each row group has a translation of its codes.
+     */
+    template<typename DTYPE>
+    class GlobalDictionary : public GlobalDictionaryBase {
+    private:
+        using T = typename DTYPE::c_type;
+
+        // Byte arrays in the dictionaries point to the page data
+        vector<shared_ptr<DictionaryPage>> pages_;
+        vector<shared_ptr<Dictionary<DTYPE>>> locals_;
+        shared_ptr<Dictionary<DTYPE>> global_;
+
+        void merge();
+
+    public:
+        /// Build from the dictionary page of each row group, nullptr if a row group has none
+        GlobalDictionary(vector<shared_ptr<DictionaryPage>> pages);
+
+        /// Build from decoded dictionaries, where row groups sharing a dictionary share the pointer
+        GlobalDictionary(vector<shared_ptr<Dictionary<DTYPE>>> locals);
+
+        virtual ~GlobalDictionary() = default;
+
+        inline shared_ptr<Dictionary<DTYPE>> local(uint32_t row_group) { return locals_[row_group]; }
+
+        inline shared_ptr<Dictionary<DTYPE>> global() { return global_; }
+    };
+
 }
 
 
@@ -7,3 +7,103 @@
 #include "data_model.h"
 
 
+
+using namespace lqf;
+
+TEST(GlobalDictionaryTest, Uniform) {
+    auto buffer = (int32_t *) malloc(sizeof(int32_t) * 3);
+    buffer[0] = 30;
+    buffer[1] = 10;
+    buffer[2] = 20;
+    auto shared = make_shared<Int32Dictionary>(buffer, 3);
+    GlobalDictionary<Int32Type> global({shared, shared, nullptr, shared});
+
+    EXPECT_EQ(1, global.numDistinct());
+    EXPECT_EQ(shared, global.global());
+    EXPECT_EQ(shared, global.local(3));
+    for (uint32_t i = 0; i < 4; ++i) {
+        EXPECT_EQ(nullptr, global.translation(i));
+    }
+}
+
+TEST(GlobalDictionaryTest, Merge) {
+    auto buffer1 = (int32_t *) malloc(sizeof(int32_t) * 3);
+    buffer1[0] = 30;
+    buffer1[1] = 10;
+    buffer1[2] = 20;
+    auto buffer2 = (int32_t *) malloc(sizeof(int32_t) * 2);
+    buffer2[0] = 40;
+    buffer2[1] = 10;
+    auto dict1 = make_shared<Int32Dictionary>(buffer1, 3);
+    auto dict2 = make_shared<Int32Dictionary>(buffer2, 2);
+    GlobalDictionary<Int32Type> global({dict1, dict2, dict1});
+
+    EXPECT_EQ(2, global.numDistinct());
+    auto merged = global.global();
+    ASSERT_EQ(4, merged->size());
+    EXPECT_EQ(10, (*merged)[0]);
+    EXPECT_EQ(20, (*merged)[1]);
+    EXPECT_EQ(30, (*merged)[2]);
+    EXPECT_EQ(40, (*merged)[3]);
+
+    // Row groups sharing a dictionary share the translation
+    EXPECT_EQ(global.translation(0), global.translation(2));
+    auto t1 = global.translation(0);
+    ASSERT_EQ(3, t1->size());
+    EXPECT_EQ(2, (*t1)[0]);
+    EXPECT_EQ(0, (*t1)[1]);
+    EXPECT_EQ(1, (*t1)[2]);
+    auto t2 = global.translation(1);
+    ASSERT_EQ(2, t2->size());
+    EXPECT_EQ(3, (*t2)[0]);
+    EXPECT_EQ(0, (*t2)[1]);
+
+    vector<shared_ptr<Int32Dictionary>> none(2);
+    EXPECT_THROW(GlobalDictionary<Int32Type>{none}, std::invalid_argument);
+}
+
+TEST(DictionaryTest, SortedBounds) {
+    auto buffer = (int32_t *) malloc(sizeof(int32_t) * 4);
+    buffer[0] = 10;
+    buffer[1] = 20;
+    buffer[2] = 30;
+    buffer[3] = 40;
+    Int32Dictionary dict(buffer, 4);
+
+    EXPECT_TRUE(dict.sorted());
+    EXPECT_EQ(0, dict.lookup(10));
+    EXPECT_EQ(3, dict.lookup(40));
+    EXPECT_EQ(-1, dict.lookup(5));
+    EXPECT_EQ(-3, dict.lookup(25));
+    EXPECT_EQ(-5, dict.lookup(50));
+    EXPECT_EQ(1, dict.lowerBound(20));
+    EXPECT_EQ(2, dict.upperBound(20));
+    EXPECT_EQ(2, dict.lowerBound(25));
+    EXPECT_EQ(2, dict.upperBound(25));
+    EXPECT_EQ(0, dict.lowerBound(0));
+    EXPECT_EQ(4, dict.upperBound(100));
+}
+
+TEST(DictionaryTest, UnsortedOrder) {
+    auto buffer = (ByteArray *) malloc(sizeof(ByteArray) * 4);
+    buffer[0] = ByteArray("MAIL");
+    buffer[1] = ByteArray("AIR");
+    buffer[2] = ByteArray("TRUCK");
+    buffer[3] = ByteArray("FOB");
+    ByteArrayDictionary dict(buffer, 4);
+
+    EXPECT_FALSE(dict.sorted());
+    auto &order = dict.order();
+    ASSERT_EQ(4, order.size());
+    EXPECT_EQ(1, order[0]);
+    EXPECT_EQ(3, order[1]);
+    EXPECT_EQ(0, order[2]);
+    EXPECT_EQ(2, order[3]);
+
+    EXPECT_EQ(2, dict.lookup(ByteArray("TRUCK")));
+    EXPECT_EQ(1, dict.lookup(ByteArray("AIR")));
+    EXPECT_GT(0, dict.lookup(ByteArray("RAIL")));
+    // Ranks of the values in [FOB, RAIL]
+    EXPECT_EQ(1, dict.lowerBound(ByteArray("FOB")));
+    EXPECT_EQ(3, dict.upperBound(ByteArray("RAIL")));
+}
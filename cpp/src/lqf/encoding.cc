@@ -3,7 +3,14 @@
 //
 
 #include "encoding.h"
+#include <algorithm>
+#include <cmath>
+#include <string>
+#include <type_traits>
+#include <unordered_map>
+#include <unordered_set>
 #include <sboost/byteutils.h>
+#include <sboost/sboost.h>
 #include <sboost/unpacker.h>
 #include <parquet/encoding.h>
 #include <arrow/util/rle_encoding.h>
@@ -24,6 +31,18 @@ namespace lqf {
         template
         class Decoder<parquet::DoubleType>;
 
+        template
+        class Encoder<parquet::Int64Type>;
+
+        template
+        class Decoder<parquet::Int64Type>;
+
+        template
+        class Encoder<parquet::ByteArrayType>;
+
+        template
+        class Decoder<parquet::ByteArrayType>;
+
         template<typename DT>
         class PlainEncoder : public Encoder<DT> {
             using data_type = typename DT::c_type;
@@ -70,6 +89,57 @@ namespace lqf {
             };
         };
 
+        // Plain ByteArray copies the bytes into one buffer, and keeps the offsets in another
+        class ByteArrayPlainEncoder : public Encoder<parquet::ByteArrayType> {
+        protected:
+            vector<uint32_t> offsets_{0};
+            string bytes_;
+        public:
+            void Add(parquet::ByteArray value) override {
+                bytes_.append(reinterpret_cast<const char *>(value.ptr), value.len);
+                offsets_.push_back(bytes_.size());
+            }
+
+            shared_ptr<vector<shared_ptr<Buffer>>> Dump() override {
+                auto offsets = parquet::AllocateBuffer(default_memory_pool(), sizeof(uint32_t) * offsets_.size());
+                memcpy(offsets->mutable_data(), offsets_.data(), offsets->size());
+                auto bytes = parquet::AllocateBuffer(default_memory_pool(), bytes_.size());
+                memcpy(bytes->mutable_data(), bytes_.data(), bytes_.size());
+
+                auto resvec = make_shared<vector<shared_ptr<Buffer>>>();
+                resvec->push_back(offsets);
+                resvec->push_back(bytes);
+                return resvec;
+            }
+        };
+
+        class ByteArrayPlainDecoder : public Decoder<parquet::ByteArrayType> {
+        protected:
+            shared_ptr<vector<shared_ptr<Buffer>>> data_;
+            const uint32_t *offsets_;
+            const uint8_t *bytes_;
+            uint32_t position_ = 0;
+            uint32_t left_ = 0;
+        public:
+            void SetData(shared_ptr<vector<shared_ptr<Buffer>>> data) override {
+                data_ = move(data);
+                offsets_ = reinterpret_cast<const uint32_t *>((*data_)[0]->data());
+                bytes_ = (*data_)[1]->data();
+                left_ = (*data_)[0]->size() / sizeof(uint32_t) - 1;
+            }
+
+            uint32_t Decode(parquet::ByteArray *dest, uint32_t expect) override {
+                uint32_t max = expect <= left_ ? expect : left_;
+                for (uint32_t i = 0; i < max; ++i) {
+                    dest[i] = parquet::ByteArray(offsets_[position_ + 1] - offsets_[position_],
+                                                 bytes_ + offsets_[position_]);
+                    ++position_;
+                }
+                left_ -= max;
+                return max;
+            }
+        };
+
         // Due to package access problem of parquet's DictEncoding, we implement the DictEncoder here by ourselves
         // This DictEncoder encode indices in blocks of a fixed size,
         // The last block of the returned buffer is dictionary block
@@ -77,66 +147,137 @@ namespace lqf {
 
         using namespace parquet;
 
+        // ByteArray is hashed by its content
+        template<typename DT>
+        struct DictKey {
+            using type = typename DT::c_type;
+
+            static inline const type &of(const type &value) { return value; }
+
+            static inline const type &value(const type &key) { return key; }
+        };
+
+        template<>
+        struct DictKey<ByteArrayType> {
+            using type = string;
+
+            static inline string of(const ByteArray &value) {
+                return string(reinterpret_cast<const char *>(value.ptr), value.len);
+            }
+
+            static inline ByteArray value(const string &key) {
+                return ByteArray(key.size(), reinterpret_cast<const uint8_t *>(key.data()));
+            }
+        };
+
+        template<typename KEY>
+        shared_ptr<Buffer> WriteDictionary(const unordered_map<KEY, int32_t> &dictionary) {
+            auto dictblock = AllocateBuffer(default_memory_pool(), sizeof(KEY) * dictionary.size());
+            KEY *view = (KEY *) dictblock->mutable_data();
+            for (auto &entry:dictionary) {
+                view[entry.second] = entry.first;
+            }
+            return dictblock;
+        }
+
+        // A ByteArray dictionary is the entry count, the offsets of entries and the bytes
+        template<>
+        shared_ptr<Buffer> WriteDictionary(const unordered_map<string, int32_t> &dictionary) {
+            vector<const string *> entries(dictionary.size());
+            uint32_t num_bytes = 0;
+            for (auto &entry: dictionary) {
+                entries[entry.second] = &entry.first;
+                num_bytes += entry.first.size();
+            }
+            uint32_t header_size = sizeof(uint32_t) * (entries.size() + 2);
+            auto dictblock = AllocateBuffer(default_memory_pool(), header_size + num_bytes);
+            auto header = reinterpret_cast<uint32_t *>(dictblock->mutable_data());
+            auto bytes = dictblock->mutable_data() + header_size;
+            header[0] = entries.size();
+            uint32_t offset = 0;
+            for (uint32_t i = 0; i < entries.size(); ++i) {
+                header[i + 1] = offset;
+                memcpy(bytes + offset, entries[i]->data(), entries[i]->size());
+                offset += entries[i]->size();
+            }
+            header[entries.size() + 1] = offset;
+            return dictblock;
+        }
+
+        // The bit-packed runs are compared by the SBoost kernels, which need at least 2 bits
+        static uint32_t MIN_BIT_WIDTH = 2;
+
+        /**
+         * The dictionary is sorted when the column is dumped, so the codes keep the order of values
+         * and range predicates can run on the codes. The codes of the whole column are held until then.
+         */
         template<typename DT>
         class DictEncoder : public Encoder<DT> {
             using data_type = typename DT::c_type;
+            using key_type = typename DictKey<DT>::type;
         protected:
-            unordered_map<data_type, int32_t> dictionary_;
+            unordered_map<key_type, int32_t> dictionary_;
             vector<int32_t> indices_;
             vector<shared_ptr<Buffer>> blocks_;
 
-            void DumpBlock() {
-                auto bit_width = BitUtil::Log2(dictionary_.size());
+            void DumpBlock(const int32_t *indices, uint32_t num_entry, const vector<int32_t> &remap) {
+                auto bit_width = std::max<uint32_t>(MIN_BIT_WIDTH, BitUtil::Log2(dictionary_.size()));
                 auto block_size = 6 + arrow::util::RleEncoder::MaxBufferSize(
-                        bit_width, static_cast<int>(indices_.size())) +
+                        bit_width, static_cast<int>(num_entry)) +
                                   arrow::util::RleEncoder::MinBufferSize(bit_width);
                 std::shared_ptr<ResizableBuffer> buffer =
                         AllocateBuffer(default_memory_pool(), block_size);
                 auto header = buffer->mutable_data();
                 header[0] = bit_width;
-                ((uint32_t *) (header + 1))[0] = indices_.size();
-                arrow::util::RleEncoder rleEncoder(header + 5, buffer->size(), bit_width);
-                for (auto &index:indices_) {
-                    rleEncoder.Put(index);
+                ((uint32_t *) (header + 1))[0] = num_entry;
+                arrow::util::RleEncoder rleEncoder(header + 5, buffer->size() - 5, bit_width);
+                for (uint32_t i = 0; i < num_entry; ++i) {
+                    rleEncoder.Put(remap[indices[i]]);
                 }
                 rleEncoder.Flush();
                 blocks_.push_back(buffer);
-                indices_.clear();
-            }
-
-            void WriteIndex(uint32_t index) {
-                indices_.push_back(index);
-                if (indices_.size() >= DICT_BLOCK_SIZE) {
-                    DumpBlock();
-                }
             }
 
         public:
             DictEncoder() {}
 
             void Add(data_type value) override {
-                auto found = dictionary_.find(value);
+                auto key = DictKey<DT>::of(value);
+                auto found = dictionary_.find(key);
                 uint32_t index;
                 if (found == dictionary_.end()) {
                     index = dictionary_.size();
-                    dictionary_[value] = index;
+                    dictionary_[key] = index;
                 } else {
                     index = found->second;
                 }
-                WriteIndex(index);
+                indices_.push_back(index);
             }
 
             shared_ptr<vector<shared_ptr<Buffer>>>
 
             Dump() override {
-                DumpBlock();
-                // Write Dictionary Block
-                auto dictblock = AllocateBuffer(default_memory_pool(), sizeof(data_type) * dictionary_.size());
-                data_type *view = (data_type *) dictblock->mutable_data();
-                for (auto &entry:dictionary_) {
-                    view[entry.second] = entry.first;
+                vector<pair<const key_type *, int32_t *>> entries;
+                entries.reserve(dictionary_.size());
+                for (auto &entry: dictionary_) {
+                    entries.emplace_back(&entry.first, &entry.second);
+                }
+                std::sort(entries.begin(), entries.end(),
+                          [](const pair<const key_type *, int32_t *> &a, const pair<const key_type *, int32_t *> &b) {
+                              return *a.first < *b.first;
+                          });
+                vector<int32_t> remap(entries.size());
+                for (uint32_t i = 0; i < entries.size(); ++i) {
+                    remap[*entries[i].second] = i;
+                    *entries[i].second = i;
                 }
-                blocks_.push_back(dictblock);
+                for (uint32_t start = 0; start < indices_.size() || start == 0; start += DICT_BLOCK_SIZE) {
+                    auto num_entry = std::min<uint32_t>(DICT_BLOCK_SIZE, indices_.size() - start);
+                    DumpBlock(indices_.data() + start, num_entry, remap);
+                }
+                indices_.clear();
+                // Write Dictionary Block
+                blocks_.push_back(WriteDictionary(dictionary_));
 
                 auto ret = make_shared<vector<shared_ptr<Buffer>>>(move(blocks_));
                 return ret;
@@ -177,7 +318,11 @@ namespace lqf {
 
             > data) override {
                 blocks_ = move(data);
-                dictionary_ = reinterpret_cast<const data_type *>((*blocks_)[blocks_->size() - 1]->data());
+                LoadDictionary(*(*blocks_)[blocks_->size() - 1]);
+            }
+
+            virtual void LoadDictionary(Buffer &dictblock) {
+                dictionary_ = reinterpret_cast<const data_type *>(dictblock.data());
             }
 
             virtual uint32_t Decode(data_type *dest, uint32_t expect) override {
@@ -215,6 +360,34 @@ namespace lqf {
             }
         };
 
+        class ByteArrayDictDecoder : public DictDecoder<ByteArrayType> {
+        protected:
+            vector<ByteArray> entries_;
+        public:
+            void LoadDictionary(Buffer &dictblock) override {
+                auto header = reinterpret_cast<const uint32_t *>(dictblock.data());
+                auto num_entry = header[0];
+                auto bytes = dictblock.data() + sizeof(uint32_t) * (num_entry + 2);
+                entries_.resize(num_entry);
+                for (uint32_t i = 0; i < num_entry; ++i) {
+                    entries_[i] = ByteArray(header[i + 2] - header[i + 1], bytes + header[i + 1]);
+                }
+                dictionary_ = entries_.data();
+            }
+        };
+
+        uint32_t DecodeDictCodes(const vector<shared_ptr<Buffer>> &blocks, int32_t *dest) {
+            uint32_t offset = 0;
+            // The last one is dictionary
+            for (uint32_t i = 0; i + 1 < blocks.size(); ++i) {
+                auto header = blocks[i]->data();
+                auto num_entry = ((uint32_t *) (header + 1))[0];
+                arrow::util::RleDecoder decoder(header + 5, blocks[i]->size() - 5, header[0]);
+                offset += decoder.GetBatch(dest + offset, num_entry);
+            }
+            return offset;
+        }
+
         static uint32_t BP_BLOCK_SIZE = 512;
 
         class BitpackEncoder : public Encoder<parquet::Int32Type> {
@@ -223,14 +396,14 @@ namespace lqf {
             vector<int32_t> buffer_;
 
             void DumpBlock() {
-                auto min = INT32_MAX;
-                auto max = INT32_MIN;
+                auto min = buffer_.empty() ? 0 : INT32_MAX;
+                auto max = buffer_.empty() ? 0 : INT32_MIN;
                 for (auto &item: buffer_) {
                     min = item < min ? item : min;
                     max = item > max ? item : max;
                 }
-                auto diff = max - min;
-                auto bit_width = parquet::BitUtil::Log2(diff);
+                auto diff = static_cast<uint32_t>(max) - static_cast<uint32_t>(min);
+                uint32_t bit_width = std::max<uint32_t>(MIN_BIT_WIDTH, parquet::BitUtil::NumRequiredBits(diff));
 
                 for (uint32_t i = 0; i < buffer_.size(); ++i) {
                     buffer_[i] -= min;
@@ -275,7 +448,9 @@ namespace lqf {
             }
 
             shared_ptr<vector<shared_ptr<Buffer>>> Dump() override {
-                DumpBlock();
+                if (!buffer_.empty() || blocks_.empty()) {
+                    DumpBlock();
+                }
 
                 auto ret = make_shared<vector<shared_ptr<Buffer>>>(move(blocks_));
                 return ret;
@@ -343,6 +518,367 @@ namespace lqf {
             }
         };
 
+        class DeltaEncoder : public Encoder<parquet::Int32Type> {
+        protected:
+            vector<shared_ptr<Buffer>> blocks_;
+            vector<int32_t> buffer_;
+
+            void DumpBlock() {
+                DeltaHeader header{static_cast<uint32_t>(buffer_.size()), 0, 0, 0, 0, 0};
+                // Deltas wrap around in 32 bits, the prefix sum in decoding wraps them back
+                vector<uint32_t> offsets((buffer_.size() + 7) & ~7u, 0);
+                if (!buffer_.empty()) {
+                    auto minmax = minmax_element(buffer_.begin(), buffer_.end());
+                    header.min_ = *minmax.first;
+                    header.max_ = *minmax.second;
+                    auto min_delta = INT32_MAX;
+                    auto max_delta = INT32_MIN;
+                    for (uint32_t i = 1; i < buffer_.size(); ++i) {
+                        int32_t delta = static_cast<uint32_t>(buffer_[i]) - static_cast<uint32_t>(buffer_[i - 1]);
+                        min_delta = std::min(min_delta, delta);
+                        max_delta = std::max(max_delta, delta);
+                    }
+                    if (buffer_.size() == 1) {
+                        min_delta = max_delta = 0;
+                    }
+                    header.min_delta_ = min_delta;
+                    header.base_ = static_cast<uint32_t>(buffer_[0]) - static_cast<uint32_t>(min_delta);
+                    header.bit_width_ = parquet::BitUtil::NumRequiredBits(
+                            static_cast<uint32_t>(max_delta) - static_cast<uint32_t>(min_delta));
+                    for (uint32_t i = 1; i < buffer_.size(); ++i) {
+                        offsets[i] = static_cast<uint32_t>(buffer_[i]) - static_cast<uint32_t>(buffer_[i - 1])
+                                     - static_cast<uint32_t>(min_delta);
+                    }
+                }
+                auto size_in_byte = sizeof(DeltaHeader) + offsets.size() / 8 * header.bit_width_;
+                auto block = AllocateBuffer(default_memory_pool(), size_in_byte);
+                memset(block->mutable_data(), 0, size_in_byte);
+                memcpy(block->mutable_data(), &header, sizeof(DeltaHeader));
+                if (header.bit_width_) {
+                    ::sboost::byteutils::bitpack(offsets.data(), offsets.size(), header.bit_width_,
+                                                 block->mutable_data() + sizeof(DeltaHeader));
+                }
+                blocks_.push_back(block);
+                buffer_.clear();
+            }
+
+        public:
+            void Add(int32_t value) override {
+                buffer_.push_back(value);
+                if (buffer_.size() >= BP_BLOCK_SIZE) {
+                    DumpBlock();
+                }
+            }
+
+            shared_ptr<vector<shared_ptr<Buffer>>> Dump() override {
+                if (!buffer_.empty() || blocks_.empty()) {
+                    DumpBlock();
+                }
+                return make_shared<vector<shared_ptr<Buffer>>>(move(blocks_));
+            }
+        };
+
+        uint32_t DecodeDelta(const uint8_t *block, int32_t *dest) {
+            auto header = reinterpret_cast<const DeltaHeader *>(block);
+            auto data = block + sizeof(DeltaHeader);
+            auto bit_width = header->bit_width_;
+            auto min_delta = _mm256_set1_epi32(header->min_delta_);
+            auto running = _mm256_set1_epi32(header->base_);
+            auto last = _mm256_set1_epi32(7);
+            for (uint32_t i = 0; i < header->num_entry_; i += 8) {
+                __m256i offsets;
+                if (bit_width == 0) {
+                    offsets = _mm256_setzero_si256();
+                } else if (bit_width == 32) {
+                    offsets = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(data));
+                } else {
+                    offsets = ::sboost::unpackers[bit_width]->unpack(data);
+                }
+                data += bit_width;
+                auto values = _mm256_add_epi32(running, ::sboost::cumsum32(_mm256_add_epi32(offsets, min_delta)));
+                _mm256_storeu_si256(reinterpret_cast<__m256i *>(dest + i), values);
+                running = _mm256_permutevar8x32_epi32(values, last);
+            }
+            return header->num_entry_;
+        }
+
+        class DeltaDecoder : public Decoder<parquet::Int32Type> {
+        protected:
+            shared_ptr<vector<shared_ptr<Buffer>>> data_;
+            uint32_t block_index_ = 0;
+            uint32_t block_pos_ = 0;
+            uint32_t block_size_ = 0;
+            int32_t *buffer_;
+        public:
+            DeltaDecoder() {
+                buffer_ = (int32_t *) aligned_alloc(64, sizeof(int32_t) * BP_BLOCK_SIZE);
+            }
+
+            virtual ~DeltaDecoder() {
+                free(buffer_);
+            }
+
+            void SetData(shared_ptr<vector<shared_ptr<Buffer>>> data) override {
+                data_ = move(data);
+                block_index_ = 0;
+                block_pos_ = 0;
+                block_size_ = 0;
+            }
+
+            uint32_t Decode(int32_t *dest, uint32_t expect) override {
+                uint32_t write_pos = 0;
+                while (write_pos < expect) {
+                    if (block_pos_ >= block_size_) {
+                        if (block_index_ >= data_->size()) {
+                            break;
+                        }
+                        block_size_ = DecodeDelta((*data_)[block_index_++]->data(), buffer_);
+                        block_pos_ = 0;
+                        continue;
+                    }
+                    auto load = std::min(block_size_ - block_pos_, expect - write_pos);
+                    memcpy(dest + write_pos, buffer_ + block_pos_, sizeof(int32_t) * load);
+                    write_pos += load;
+                    block_pos_ += load;
+                }
+                return write_pos;
+            }
+        };
+
+        // Frame-of-reference for 64-bit words. Each block of BP_BLOCK_SIZE values keeps the count and
+        // bit width in the first 8 bytes and the minimum in the next 8, followed by the packed offsets.
+        class Bitpack64Encoder : public Encoder<parquet::Int64Type> {
+        protected:
+            vector<shared_ptr<Buffer>> blocks_;
+            vector<int64_t> buffer_;
+
+            void DumpBlock() {
+                auto min = INT64_MAX;
+                auto max = INT64_MIN;
+                for (auto &item: buffer_) {
+                    min = item < min ? item : min;
+                    max = item > max ? item : max;
+                }
+                uint64_t diff = buffer_.empty() ? 0 : static_cast<uint64_t>(max) - static_cast<uint64_t>(min);
+                uint32_t bit_width = diff ? 64 - __builtin_clzll(diff) : 0;
+
+                auto num_word = (buffer_.size() * bit_width + 63) / 64 + 1;
+                auto block = AllocateBuffer(default_memory_pool(), 16 + num_word * sizeof(uint64_t));
+                memset(block->mutable_data(), 0, block->size());
+                auto header = reinterpret_cast<uint32_t *>(block->mutable_data());
+                header[0] = buffer_.size();
+                header[1] = bit_width;
+                reinterpret_cast<int64_t *>(block->mutable_data())[1] = min;
+
+                auto words = reinterpret_cast<uint64_t *>(block->mutable_data() + 16);
+                for (uint32_t i = 0; bit_width && i < buffer_.size(); ++i) {
+                    uint64_t delta = static_cast<uint64_t>(buffer_[i]) - static_cast<uint64_t>(min);
+                    uint64_t bit_pos = static_cast<uint64_t>(i) * bit_width;
+                    auto word = bit_pos >> 6;
+                    auto shift = bit_pos & 63;
+                    words[word] |= delta << shift;
+                    if (shift + bit_width > 64) {
+                        words[word + 1] |= delta >> (64 - shift);
+                    }
+                }
+                blocks_.push_back(block);
+                buffer_.clear();
+            }
+
+        public:
+            void Add(int64_t value) override {
+                buffer_.push_back(value);
+                if (buffer_.size() >= BP_BLOCK_SIZE) {
+                    DumpBlock();
+                }
+            }
+
+            shared_ptr<vector<shared_ptr<Buffer>>> Dump() override {
+                if (!buffer_.empty() || blocks_.empty()) {
+                    DumpBlock();
+                }
+                return make_shared<vector<shared_ptr<Buffer>>>(move(blocks_));
+            }
+        };
+
+        class Bitpack64Decoder : public Decoder<parquet::Int64Type> {
+        protected:
+            shared_ptr<vector<shared_ptr<Buffer>>> data_;
+            uint32_t block_index_ = 0;
+            uint32_t block_pos_ = 0;
+        public:
+            void SetData(shared_ptr<vector<shared_ptr<Buffer>>> data) override {
+                data_ = move(data);
+                block_index_ = 0;
+                block_pos_ = 0;
+            }
+
+            uint32_t Decode(int64_t *dest, uint32_t expect) override {
+                uint32_t write_pos = 0;
+                while (write_pos < expect && block_index_ < data_->size()) {
+                    auto raw = (*data_)[block_index_]->data();
+                    auto header = reinterpret_cast<const uint32_t *>(raw);
+                    auto num_entry = header[0];
+                    uint64_t bit_width = header[1];
+                    auto min = static_cast<uint64_t>(reinterpret_cast<const int64_t *>(raw)[1]);
+                    auto words = reinterpret_cast<const uint64_t *>(raw + 16);
+                    uint64_t mask = bit_width == 64 ? ~0ull : (1ull << bit_width) - 1;
+
+                    auto load = std::min(num_entry - block_pos_, expect - write_pos);
+                    for (uint32_t i = 0; i < load; ++i) {
+                        uint64_t delta = 0;
+                        if (bit_width) {
+                            uint64_t bit_pos = static_cast<uint64_t>(block_pos_ + i) * bit_width;
+                            auto word = bit_pos >> 6;
+                            auto shift = bit_pos & 63;
+                            delta = words[word] >> shift;
+                            if (shift + bit_width > 64) {
+                                delta |= words[word + 1] << (64 - shift);
+                            }
+                        }
+                        dest[write_pos + i] = static_cast<int64_t>(min + (delta & mask));
+                    }
+                    write_pos += load;
+                    block_pos_ += load;
+                    if (block_pos_ >= num_entry) {
+                        ++block_index_;
+                        block_pos_ = 0;
+                    }
+                }
+                return write_pos;
+            }
+        };
+
+        template<typename KEY>
+        ColumnFeature Profile(const vector<KEY> &sample) {
+            ColumnFeature feature;
+            feature.count_ = sample.size();
+            feature.distinct_ = unordered_set<KEY>(sample.begin(), sample.end()).size();
+            if constexpr (is_integral<KEY>::value) {
+                double bits = 0;
+                uint32_t num_window = 0;
+                for (uint32_t start = 0; start < sample.size(); start += BP_BLOCK_SIZE) {
+                    auto end = std::min<uint32_t>(start + BP_BLOCK_SIZE, sample.size());
+                    auto minmax = minmax_element(sample.begin() + start, sample.begin() + end);
+                    uint64_t range = static_cast<uint64_t>(*minmax.second) - static_cast<uint64_t>(*minmax.first);
+                    bits += range ? 64 - __builtin_clzll(range) : 0;
+                    ++num_window;
+                }
+                feature.range_bits_ = num_window ? bits / num_window : 0;
+                double delta_bits = 0;
+                for (uint32_t start = 0; start < sample.size(); start += BP_BLOCK_SIZE) {
+                    auto end = std::min<uint32_t>(start + BP_BLOCK_SIZE, sample.size());
+                    uint64_t min_delta = UINT64_MAX;
+                    uint64_t max_delta = 0;
+                    for (auto i = start + 1; i < end; ++i) {
+                        // Offset by 2^63 to compare signed deltas as unsigned
+                        uint64_t delta = static_cast<uint64_t>(sample[i]) - static_cast<uint64_t>(sample[i - 1])
+                                         + (1ull << 63);
+                        min_delta = std::min(min_delta, delta);
+                        max_delta = std::max(max_delta, delta);
+                    }
+                    uint64_t range = end - start > 1 ? max_delta - min_delta : 0;
+                    delta_bits += range ? 64 - __builtin_clzll(range) : 0;
+                }
+                feature.delta_bits_ = num_window ? delta_bits / num_window : 0;
+            } else if constexpr (is_same<KEY, string>::value) {
+                double length = 0;
+                for (auto &item: sample) {
+                    length += item.size();
+                }
+                feature.length_ = sample.empty() ? 0 : length / sample.size();
+            }
+            return feature;
+        }
+
+        EncodingType SelectEncoding(parquet::Type::type type, const ColumnFeature &feature) {
+            if (feature.count_ == 0) {
+                return PLAIN;
+            }
+            double width;
+            switch (type) {
+                case parquet::Type::type::INT32:
+                    width = 32;
+                    break;
+                case parquet::Type::type::BYTE_ARRAY:
+                    // The bytes and an offset
+                    width = feature.length_ * 8 + 32;
+                    break;
+                default:
+                    width = 64;
+                    break;
+            }
+            // The dictionary is assumed to grow with the block as it does in the sample
+            double ratio = static_cast<double>(feature.distinct_) / feature.count_;
+            double dict = ceil(log2(std::max<uint32_t>(feature.distinct_, 2))) + ratio * width;
+            double best = width;
+            EncodingType selected = PLAIN;
+            // The 32-bit bit-packer computes the range in int32, so leave a bit for its sign
+            bool packable = (type == parquet::Type::type::INT32 && feature.range_bits_ < 31) ||
+                            type == parquet::Type::type::INT64;
+            if (packable && feature.range_bits_ <= best) {
+                best = feature.range_bits_;
+                selected = BITPACK;
+            }
+            // Delta decoding adds a prefix sum, so it is chosen only when strictly smaller
+            if (type == parquet::Type::type::INT32 && feature.delta_bits_ < best) {
+                best = feature.delta_bits_;
+                selected = DELTA;
+            }
+            if (dict < best * ENC_DICT_MARGIN) {
+                selected = DICTIONARY;
+            }
+            return selected;
+        }
+
+        template<typename DT>
+        class SamplingEncoder : public AutoEncoder<DT> {
+            using data_type = typename DT::c_type;
+            using key_type = typename DictKey<DT>::type;
+        protected:
+            // ByteArray samples are copied, as the values may not outlive the call
+            vector<key_type> sample_;
+            unique_ptr<Encoder<DT>> encoder_;
+            EncodingType selected_ = PLAIN;
+
+            void Select() {
+                selected_ = SelectEncoding(DT::type_num, Profile(sample_));
+                encoder_ = GetEncoder<DT>(selected_);
+                for (auto &item: sample_) {
+                    encoder_->Add(DictKey<DT>::value(item));
+                }
+                sample_.clear();
+                sample_.shrink_to_fit();
+            }
+
+        public:
+            SamplingEncoder() {
+                sample_.reserve(ENC_SAMPLE_SIZE);
+            }
+
+            void Add(data_type value) override {
+                if (encoder_) {
+                    encoder_->Add(value);
+                    return;
+                }
+                sample_.push_back(DictKey<DT>::of(value));
+                if (sample_.size() >= ENC_SAMPLE_SIZE) {
+                    Select();
+                }
+            }
+
+            shared_ptr<vector<shared_ptr<Buffer>>> Dump() override {
+                if (!encoder_) {
+                    Select();
+                }
+                return encoder_->Dump();
+            }
+
+            EncodingType Selected() override {
+                return selected_;
+            }
+        };
+
         template<typename DT>
         unique_ptr<Encoder<DT>> GetEncoder(EncodingType type) {
             switch (type) {
@@ -350,6 +886,8 @@ namespace lqf {
                     return unique_ptr<Encoder<DT>>(new DictEncoder<DT>());
                 case PLAIN:
                     return unique_ptr<Encoder<DT>>(new PlainEncoder<DT>());
+                case AUTO:
+                    return unique_ptr<Encoder<DT>>(new SamplingEncoder<DT>());
                 default:
                     return nullptr;
             }
@@ -358,12 +896,16 @@ namespace lqf {
         template<>
         unique_ptr<Encoder<parquet::Int32Type>> GetEncoder(EncodingType type) {
             switch (type) {
+                case AUTO:
+                    return unique_ptr<Encoder<parquet::Int32Type>>(new SamplingEncoder<parquet::Int32Type>());
                 case DICTIONARY:
                     return unique_ptr<Encoder<parquet::Int32Type>>(new DictEncoder<parquet::Int32Type>());
                 case PLAIN:
                     return unique_ptr<Encoder<parquet::Int32Type>>(new PlainEncoder<parquet::Int32Type>());
                 case BITPACK:
                     return unique_ptr<Encoder<parquet::Int32Type>>(new BitpackEncoder());
+                case DELTA:
+                    return unique_ptr<Encoder<parquet::Int32Type>>(new DeltaEncoder());
                 default:
                     return nullptr;
             }
@@ -371,6 +913,36 @@ namespace lqf {
 
         template unique_ptr<Encoder<parquet::DoubleType>> GetEncoder(EncodingType);
 
+        template<>
+        unique_ptr<Encoder<parquet::Int64Type>> GetEncoder(EncodingType type) {
+            switch (type) {
+                case AUTO:
+                    return unique_ptr<Encoder<parquet::Int64Type>>(new SamplingEncoder<parquet::Int64Type>());
+                case DICTIONARY:
+                    return unique_ptr<Encoder<parquet::Int64Type>>(new DictEncoder<parquet::Int64Type>());
+                case PLAIN:
+                    return unique_ptr<Encoder<parquet::Int64Type>>(new PlainEncoder<parquet::Int64Type>());
+                case BITPACK:
+                    return unique_ptr<Encoder<parquet::Int64Type>>(new Bitpack64Encoder());
+                default:
+                    return nullptr;
+            }
+        }
+
+        template<>
+        unique_ptr<Encoder<parquet::ByteArrayType>> GetEncoder(EncodingType type) {
+            switch (type) {
+                case AUTO:
+                    return unique_ptr<Encoder<parquet::ByteArrayType>>(new SamplingEncoder<parquet::ByteArrayType>());
+                case DICTIONARY:
+                    return unique_ptr<Encoder<parquet::ByteArrayType>>(new DictEncoder<parquet::ByteArrayType>());
+                case PLAIN:
+                    return unique_ptr<Encoder<parquet::ByteArrayType>>(new ByteArrayPlainEncoder());
+                default:
+                    return nullptr;
+            }
+        }
+
         template<typename DT>
         unique_ptr<Decoder<DT>> GetDecoder(EncodingType type) {
             switch (type) {
@@ -392,11 +964,39 @@ namespace lqf {
                     return unique_ptr<Decoder<parquet::Int32Type>>(new PlainDecoder<parquet::Int32Type>());
                 case BITPACK:
                     return unique_ptr<Decoder<parquet::Int32Type>>(new BitpackDecoder());
+                case DELTA:
+                    return unique_ptr<Decoder<parquet::Int32Type>>(new DeltaDecoder());
                 default:
                     return nullptr;
             }
         }
 
         template unique_ptr<Decoder<parquet::DoubleType>> GetDecoder(EncodingType);
+
+        template<>
+        unique_ptr<Decoder<parquet::Int64Type>> GetDecoder(EncodingType type) {
+            switch (type) {
+                case DICTIONARY:
+                    return unique_ptr<Decoder<parquet::Int64Type>>(new DictDecoder<parquet::Int64Type>());
+                case PLAIN:
+                    return unique_ptr<Decoder<parquet::Int64Type>>(new PlainDecoder<parquet::Int64Type>());
+                case BITPACK:
+                    return unique_ptr<Decoder<parquet::Int64Type>>(new Bitpack64Decoder());
+                default:
+                    return nullptr;
+            }
+        }
+
+        template<>
+        unique_ptr<Decoder<parquet::ByteArrayType>> GetDecoder(EncodingType type) {
+            switch (type) {
+                case DICTIONARY:
+                    return unique_ptr<Decoder<parquet::ByteArrayType>>(new ByteArrayDictDecoder());
+                case PLAIN:
+                    return unique_ptr<Decoder<parquet::ByteArrayType>>(new ByteArrayPlainDecoder());
+                default:
+                    return nullptr;
+            }
+        }
     }
 }
\ No newline at end of file
@@ -2,7 +2,8 @@
 // Created by harper on 2/2/21.
 //
 // Contains encoding wrapper for intermediate result
-// Due to time reason, only support integer type for now.
+// INT32 supports PLAIN, DICTIONARY, BITPACK (frame-of-reference) and DELTA, INT64 supports PLAIN,
+// DICTIONARY and BITPACK, DOUBLE and BYTE_ARRAY support PLAIN and DICTIONARY.
 //
 
 #include <cstdint>
@@ -15,16 +16,44 @@
 #ifndef LQF_ENCODING_H
 #define LQF_ENCODING_H
 
+// Number of leading values an AUTO encoder profiles before choosing the encoding
+#define ENC_SAMPLE_SIZE 1024
+// Dictionary decoding is slower to scan, so it should save this fraction of space to be chosen
+#define ENC_DICT_MARGIN 0.8
+
 namespace lqf {
     namespace encoding {
 
         using namespace std;
         using namespace arrow;
 
+        // AUTO lets the writer choose the encoding of each column in each block from its first values
         enum EncodingType {
-            PLAIN, DICTIONARY, BITPACK
+            PLAIN, DICTIONARY, BITPACK, AUTO, DELTA
+        };
+
+        /**
+         * Header of a DELTA block. The block bit-packs the offsets of consecutive deltas from the
+         * minimal delta, so a sorted column takes the bits of its largest gap. The value range lets
+         * predicates skip or accept a block without decoding it.
+         */
+        struct DeltaHeader {
+            uint32_t num_entry_;
+            uint32_t bit_width_;
+            int32_t min_;
+            int32_t max_;
+            // The first value minus the minimal delta
+            int32_t base_;
+            int32_t min_delta_;
         };
 
+        /// Decode a DELTA block into dest, which should hold the number of values rounded up to 8
+        uint32_t DecodeDelta(const uint8_t *block, int32_t *dest);
+
+        /// Decode the codes of a DICTIONARY column into dest, without looking up the dictionary.
+        /// The dictionary is sorted, so the codes keep the order of values
+        uint32_t DecodeDictCodes(const vector<shared_ptr<Buffer>> &blocks, int32_t *dest);
+
         // Instead of having a template for each Encoder/Decoder
         // we choose to just overload the method.
 
@@ -32,6 +61,8 @@ namespace lqf {
         class Encoder {
             using dtype = typename DT::c_type;
         public:
+            virtual ~Encoder() = default;
+
             virtual void Add(dtype) = 0;
 
             virtual shared_ptr<vector<shared_ptr<Buffer>>> Dump() = 0;
@@ -41,22 +72,62 @@ namespace lqf {
         class Decoder {
             using dtype = typename DT::c_type;
         public:
+            virtual ~Decoder() = default;
+
             virtual void SetData(shared_ptr<vector<shared_ptr<Buffer>>> data) = 0;
 
             virtual uint32_t Decode(dtype *dest, uint32_t expect) = 0;
         };
 
+        /// An encoder that chooses the encoding from the values it receives
+        template<typename DT>
+        class AutoEncoder : public Encoder<DT> {
+        public:
+            /// The chosen encoding, known after Dump
+            virtual EncodingType Selected() = 0;
+        };
+
+        /**
+         * Features of the sampled values of a column. They are typed counterparts of the
+         * Distinct, Length and Sortness features of encsel, cheap enough to compute for each block.
+         */
+        struct ColumnFeature {
+            uint32_t count_ = 0;
+            uint32_t distinct_ = 0;
+            // Mean bit width of the value range within a bit-packing block, small for sorted or narrow values
+            double range_bits_ = 64;
+            // Mean bit width of the range of deltas between neighbors within a block, small for sorted values
+            double delta_bits_ = 64;
+            // Mean byte length of ByteArray values
+            double length_ = 0;
+        };
+
+        /// Choose the encoding with the smallest estimated size per value
+        EncodingType SelectEncoding(parquet::Type::type, const ColumnFeature &);
+
         template<typename DT>
         unique_ptr<Encoder<DT>> GetEncoder(EncodingType type);
 
         template<>
         unique_ptr<Encoder<parquet::Int32Type>> GetEncoder<parquet::Int32Type>(EncodingType type);
 
+        template<>
+        unique_ptr<Encoder<parquet::Int64Type>> GetEncoder<parquet::Int64Type>(EncodingType type);
+
+        template<>
+        unique_ptr<Encoder<parquet::ByteArrayType>> GetEncoder<parquet::ByteArrayType>(EncodingType type);
+
         template<typename DT>
         unique_ptr<Decoder<DT>> GetDecoder(EncodingType type);
 
         template<>
         unique_ptr<Decoder<parquet::Int32Type>> GetDecoder<parquet::Int32Type>(EncodingType type);
+
+        template<>
+        unique_ptr<Decoder<parquet::Int64Type>> GetDecoder<parquet::Int64Type>(EncodingType type);
+
+        template<>
+        unique_ptr<Decoder<parquet::ByteArrayType>> GetDecoder<parquet::ByteArrayType>(EncodingType type);
     }
 }
 
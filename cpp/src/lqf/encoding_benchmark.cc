@@ -0,0 +1,112 @@
+//
+// Created by agent on 10/19/26.
+//
+// This benchmark compares the memory footprint of an encoded intermediate result with the
+// time a downstream operator spends scanning it. The intermediate is half of the first lineitem
+// block, with a sorted key, a narrow integer, a wide double and a low cardinality string.
+//
+// The argument chooses the encodings:
+// 0 - all PLAIN, 1 - all DICTIONARY, 2 - BITPACK on integers and PLAIN otherwise,
+// 3 - AUTO, where the writer chooses for each column from its first values,
+// 4 - DELTA on the sorted key, BITPACK on the other integer and PLAIN otherwise.
+// The bytes counter reports the encoded size of the block.
+//
+
+#include <benchmark/benchmark.h>
+#include "tpch/tpchquery.h"
+#include "data_model_enc.h"
+
+using namespace std;
+using namespace lqf;
+using namespace lqf::encoding;
+
+class EncodingBenchmark : public benchmark::Fixture {
+protected:
+    shared_ptr<Block> source_;
+    vector<parquet::Type::type> types_{parquet::Type::type::INT32, parquet::Type::type::INT32,
+                                       parquet::Type::type::DOUBLE, parquet::Type::type::BYTE_ARRAY};
+    vector<uint32_t> fields_{tpch::LineItem::ORDERKEY, tpch::LineItem::QUANTITY,
+                             tpch::LineItem::EXTENDEDPRICE, tpch::LineItem::SHIPMODE};
+public:
+    EncodingBenchmark() {
+        auto lineitem = ParquetTable::Open(tpch::LineItem::path,
+                                           {tpch::LineItem::ORDERKEY, tpch::LineItem::QUANTITY,
+                                            tpch::LineItem::EXTENDEDPRICE, tpch::LineItem::SHIPMODE});
+        auto first_block = (*lineitem->blocks()->collect())[0];
+        auto mask = make_shared<SimpleBitmap>(first_block->size());
+        srand(0);
+        for (uint32_t i = 0; i < first_block->size(); ++i) {
+            if (rand() % 2) {
+                mask->put(i);
+            }
+        }
+        source_ = first_block->mask(mask);
+    }
+
+    vector<EncodingType> encodings(int64_t option) {
+        switch (option) {
+            case 0:
+                return vector<EncodingType>(4, PLAIN);
+            case 1:
+                return vector<EncodingType>(4, DICTIONARY);
+            case 2:
+                return vector<EncodingType>{BITPACK, BITPACK, PLAIN, PLAIN};
+            case 4:
+                return vector<EncodingType>{DELTA, BITPACK, PLAIN, PLAIN};
+            default:
+                return vector<EncodingType>(4, AUTO);
+        }
+    }
+
+    shared_ptr<EncMemvBlock> encode(int64_t option) {
+        auto block = make_shared<EncMemvBlock>(types_, encodings(option));
+        auto reader = source_->rows();
+        auto writer = block->rows();
+        auto size = source_->size();
+        for (uint32_t i = 0; i < size; ++i) {
+            DataRow &from = reader->next();
+            DataRow &to = writer->next();
+            for (uint32_t j = 0; j < fields_.size(); ++j) {
+                to[j] = from[fields_[j]];
+            }
+        }
+        writer->close();
+        return block;
+    }
+};
+
+BENCHMARK_DEFINE_F(EncodingBenchmark, Write)(benchmark::State &state) {
+    uint64_t bytes = 0;
+    for (auto _: state) {
+        bytes = encode(state.range(0))->memrss();
+    }
+    state.counters["bytes"] = bytes;
+    state.SetItemsProcessed(state.iterations() * source_->size());
+}
+
+BENCHMARK_DEFINE_F(EncodingBenchmark, Scan)(benchmark::State &state) {
+    auto block = encode(state.range(0));
+    state.counters["bytes"] = block->memrss();
+    for (auto _: state) {
+        int64_t key_sum = 0;
+        double price_sum = 0;
+        uint64_t length_sum = 0;
+        auto rows = block->rows();
+        auto size = block->size();
+        for (uint32_t i = 0; i < size; ++i) {
+            DataRow &row = rows->next();
+            key_sum += row[0].asInt() + row[1].asInt();
+            price_sum += row[2].asDouble();
+            length_sum += row[3].asByteArray().len;
+        }
+        benchmark::DoNotOptimize(key_sum);
+        benchmark::DoNotOptimize(price_sum);
+        benchmark::DoNotOptimize(length_sum);
+    }
+    state.SetItemsProcessed(state.iterations() * block->size());
+}
+
+BENCHMARK_REGISTER_F(EncodingBenchmark, Write)->DenseRange(0, 4);
+BENCHMARK_REGISTER_F(EncodingBenchmark, Scan)->DenseRange(0, 4);
+
+BENCHMARK_MAIN();
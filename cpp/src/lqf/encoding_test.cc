@@ -5,6 +5,8 @@
 #include <gtest/gtest.h>
 #include "encoding.h"
 
+using namespace std;
+
 using namespace lqf::encoding;
 
 TEST(Bitpack, Encoding) {
@@ -41,4 +43,160 @@ TEST(Bitpack, EncDec) {
         }
     }
     free(buffer);
-}
\ No newline at end of file
+}
+TEST(Bitpack, EncDec64) {
+    auto encoder = GetEncoder<parquet::Int64Type>(EncodingType::BITPACK);
+    vector<int64_t> values;
+    for (int64_t i = 0; i < 3000; ++i) {
+        // Blocks of small offsets from a large base, and a block spanning the full range
+        values.push_back(i < 2048 ? (1ll << 40) + i * 3 : (i % 2 ? INT64_MAX - i : INT64_MIN + i));
+    }
+    for (auto v: values) {
+        encoder->Add(v);
+    }
+    auto data = encoder->Dump();
+
+    auto decoder = GetDecoder<parquet::Int64Type>(EncodingType::BITPACK);
+    decoder->SetData(data);
+    vector<int64_t> buffer(7);
+    for (uint32_t i = 0; i < values.size(); i += 7) {
+        auto loaded = decoder->Decode(buffer.data(), 7);
+        ASSERT_EQ(std::min<uint32_t>(7, values.size() - i), loaded);
+        for (uint32_t j = 0; j < loaded; ++j) {
+            ASSERT_EQ(values[i + j], buffer[j]) << i + j;
+        }
+    }
+}
+
+TEST(Delta, EncDec) {
+    vector<vector<int32_t>> columns(5);
+    for (int i = 0; i < 1300; ++i) {
+        // Sorted keys with repeats
+        columns[0].push_back(1000000 + i / 3);
+        // Unsorted, with negative deltas
+        columns[1].push_back((i * 7919) % 1009 - 500);
+        // Constant, the deltas take no bit
+        columns[2].push_back(42);
+        // The deltas wrap around 32 bits
+        columns[3].push_back(i % 2 ? INT32_MAX : INT32_MIN);
+    }
+    columns[4].push_back(-7);
+
+    for (auto &values: columns) {
+        auto encoder = GetEncoder<parquet::Int32Type>(EncodingType::DELTA);
+        for (auto value: values) {
+            encoder->Add(value);
+        }
+        auto decoder = GetDecoder<parquet::Int32Type>(EncodingType::DELTA);
+        decoder->SetData(encoder->Dump());
+        int32_t buffer[13];
+        uint32_t read = 0;
+        while (read < values.size()) {
+            auto loaded = decoder->Decode(buffer, 13);
+            ASSERT_LT(0, loaded);
+            for (uint32_t j = 0; j < loaded; ++j) {
+                ASSERT_EQ(values[read + j], buffer[j]);
+            }
+            read += loaded;
+        }
+        EXPECT_EQ(values.size(), read);
+        EXPECT_EQ(0, decoder->Decode(buffer, 13));
+    }
+}
+
+TEST(ByteArrayEncoding, EncDec) {
+    vector<string> values;
+    for (int i = 0; i < 10000; ++i) {
+        values.push_back("value" + to_string(i % 300));
+    }
+    for (auto type: {EncodingType::PLAIN, EncodingType::DICTIONARY}) {
+        auto encoder = GetEncoder<parquet::ByteArrayType>(type);
+        for (auto &v: values) {
+            encoder->Add(parquet::ByteArray(v.size(), reinterpret_cast<const uint8_t *>(v.data())));
+        }
+        auto data = encoder->Dump();
+
+        auto decoder = GetDecoder<parquet::ByteArrayType>(type);
+        decoder->SetData(data);
+        parquet::ByteArray buffer[16];
+        for (uint32_t i = 0; i < values.size(); i += 16) {
+            auto loaded = decoder->Decode(buffer, 16);
+            ASSERT_EQ(std::min<uint32_t>(16, values.size() - i), loaded);
+            for (uint32_t j = 0; j < loaded; ++j) {
+                ASSERT_EQ(values[i + j], string(reinterpret_cast<const char *>(buffer[j].ptr), buffer[j].len));
+            }
+        }
+    }
+}
+
+TEST(AutoEncoding, Select) {
+    vector<string> modes{"AIR", "FOB", "MAIL", "RAIL", "REG AIR", "SHIP", "TRUCK"};
+    auto keys = GetEncoder<parquet::Int32Type>(EncodingType::AUTO);
+    auto prices = GetEncoder<parquet::DoubleType>(EncodingType::AUTO);
+    auto discounts = GetEncoder<parquet::DoubleType>(EncodingType::AUTO);
+    auto shipmodes = GetEncoder<parquet::ByteArrayType>(EncodingType::AUTO);
+    vector<double> price_values;
+    for (int i = 0; i < 5000; ++i) {
+        auto &mode = modes[(i * 7919) % modes.size()];
+        price_values.push_back(900 + ((i * 104729) % 100000) * 0.01);
+        // Sorted keys with repeats
+        keys->Add(1000000 + i / 4);
+        prices->Add(price_values.back());
+        discounts->Add((i % 11) * 0.01);
+        shipmodes->Add(parquet::ByteArray(mode.size(), reinterpret_cast<const uint8_t *>(mode.data())));
+    }
+    auto key_data = keys->Dump();
+    prices->Dump();
+    discounts->Dump();
+    auto shipmode_data = shipmodes->Dump();
+    EXPECT_EQ(DELTA, dynamic_cast<AutoEncoder<parquet::Int32Type> *>(keys.get())->Selected());
+    EXPECT_EQ(PLAIN, dynamic_cast<AutoEncoder<parquet::DoubleType> *>(prices.get())->Selected());
+    EXPECT_EQ(DICTIONARY, dynamic_cast<AutoEncoder<parquet::DoubleType> *>(discounts.get())->Selected());
+    EXPECT_EQ(DICTIONARY, dynamic_cast<AutoEncoder<parquet::ByteArrayType> *>(shipmodes.get())->Selected());
+
+    // The data decodes with the selected encoding
+    auto key_decoder = GetDecoder<parquet::Int32Type>(DELTA);
+    key_decoder->SetData(key_data);
+    int32_t *buffer = (int32_t *) aligned_alloc(64, sizeof(int32_t) * 16);
+    for (int i = 0; i < 5000; i += 16) {
+        auto loaded = key_decoder->Decode(buffer, 16);
+        for (uint32_t j = 0; j < loaded; ++j) {
+            ASSERT_EQ(1000000 + (i + j) / 4, buffer[j]);
+        }
+    }
+    free(buffer);
+    auto mode_decoder = GetDecoder<parquet::ByteArrayType>(DICTIONARY);
+    mode_decoder->SetData(shipmode_data);
+    parquet::ByteArray modebuf[1];
+    for (int i = 0; i < 5000; ++i) {
+        ASSERT_EQ(1, mode_decoder->Decode(modebuf, 1));
+        ASSERT_EQ(modes[(i * 7919) % modes.size()],
+                  string(reinterpret_cast<const char *>(modebuf[0].ptr), modebuf[0].len));
+    }
+}
+
+TEST(AutoEncoding, SelectFromFeature) {
+    ColumnFeature narrow;
+    narrow.count_ = 1024;
+    narrow.distinct_ = 1000;
+    narrow.range_bits_ = 10;
+    EXPECT_EQ(BITPACK, SelectEncoding(parquet::Type::type::INT32, narrow));
+    EXPECT_EQ(PLAIN, SelectEncoding(parquet::Type::type::DOUBLE, narrow));
+
+    ColumnFeature wide = narrow;
+    wide.range_bits_ = 31;
+    EXPECT_EQ(PLAIN, SelectEncoding(parquet::Type::type::INT32, wide));
+    EXPECT_EQ(BITPACK, SelectEncoding(parquet::Type::type::INT64, wide));
+
+    ColumnFeature sorted = wide;
+    sorted.delta_bits_ = 4;
+    EXPECT_EQ(DELTA, SelectEncoding(parquet::Type::type::INT32, sorted));
+    EXPECT_EQ(BITPACK, SelectEncoding(parquet::Type::type::INT64, sorted));
+
+    ColumnFeature repeated = wide;
+    repeated.distinct_ = 20;
+    repeated.length_ = 10;
+    EXPECT_EQ(DICTIONARY, SelectEncoding(parquet::Type::type::INT32, repeated));
+    EXPECT_EQ(DICTIONARY, SelectEncoding(parquet::Type::type::BYTE_ARRAY, repeated));
+    EXPECT_EQ(PLAIN, SelectEncoding(parquet::Type::type::INT32, ColumnFeature()));
+}
@@ -10,6 +10,7 @@
 #include <sboost/simd.h>
 #include <sboost/bitmap_writer.h>
 #include <sboost/encoding/encoding_utils.h>
+#include <arrow/util/rle_encoding.h>
 #ifdef LQF_STAT
 #include "stat.h"
 #endif
@@ -75,6 +76,27 @@ namespace lqf {
         return result;
     }
 
+    LikePredicate::LikePredicate(uint32_t index, const string &pattern)
+            : SboostPredicate(index, [pattern]() { return sboost::RawLike::build(pattern); }),
+              like_(pattern), fallback_(index, [this](const DataField &field) {
+                return like_.match(field.asByteArray());
+            }) {}
+
+    shared_ptr<Bitmap> LikePredicate::filterBlock(Block &block, Bitmap &skip) {
+        auto masked = dynamic_cast<MaskedBlock *>(&block);
+        auto pblock = dynamic_cast<ParquetBlock *>(masked ? masked->inner().get() : &block);
+        if (!pblock) {
+            return fallback_.filterBlock(block, skip);
+        }
+        auto result = FilterExecutor::inst->executeSboost(block, *this);
+        if (!result) {
+            // Not registered by a ColFilter, scan the column alone
+            auto accessor = build();
+            result = pblock->raw(index_, accessor.get());
+        }
+        return skip & *result;
+    }
+
     ColFilter::ColFilter(ColPredicate *pred) {
         predicates_.push_back(unique_ptr<ColPredicate>(pred));
     }
@@ -123,217 +145,70 @@ namespace lqf {
 
     using namespace ::sboost::encoding::rlehybrid;
 
+    /// Read the segments of a dictionary-encoded column chunk, clipped to the values in each page
     class PagedSegmentReader {
     protected:
         PageReader *page_reader_;
+        shared_ptr<Page> page_;
         unique_ptr<SegmentReader> inpage_reader_;
-        shared_ptr<Page> current_page_;
-        shared_ptr<Page> next_page_;
         uint32_t bit_width_;
+        uint32_t page_remain_;
 
-        void initInPageReader() {
-            auto datapage = static_pointer_cast<DataPage>(current_page_);
+        bool loadPage() {
+            page_ = page_reader_->NextPage();
+            if (!page_) {
+                return false;
+            }
+            auto datapage = static_pointer_cast<DataPage>(page_);
             bit_width_ = datapage->data()[0];
+            page_remain_ = datapage->num_values();
             inpage_reader_ = unique_ptr<SegmentReader>(
-                    new SegmentReader(datapage->data() + 1, bit_width_, datapage->num_values()));
+                    new SegmentReader(datapage->data() + 1, bit_width_, page_remain_));
+            return true;
         }
 
     public:
-        PagedSegmentReader(PageReader *page_reader) : page_reader_(page_reader) {
+        PagedSegmentReader(PageReader *page_reader) : page_reader_(page_reader), bit_width_(0), page_remain_(0) {
             // Skip Dictionary Page
             page_reader_->NextPage();
-
-            current_page_ = page_reader_->NextPage();
-            next_page_ = page_reader_->NextPage();
-            initInPageReader();
-        }
-
-        bool hasNext() {
-            bool currentPageNext = inpage_reader_->hasNext();
-            if (currentPageNext) {
-                return true;
-            }
-            return next_page_ != nullptr;
         }
 
-        Segment next() {
-            if (inpage_reader_->hasNext()) {
-                return inpage_reader_->next();
+        bool next(Segment &segment) {
+            while (page_remain_ == 0) {
+                if (!loadPage()) {
+                    return false;
+                }
             }
-            current_page_ = move(next_page_);
-            next_page_ = page_reader_->NextPage();
-            initInPageReader();
-            return inpage_reader_->next();
+            segment = inpage_reader_->next();
+            // The last bit-packed group of a page is padded
+            segment.num_entry_ = std::min(segment.num_entry_, page_remain_);
+            page_remain_ -= segment.num_entry_;
+            return true;
         }
 
+        /// Bit width of the page holding the last segment
         uint32_t bitWidth() {
             return bit_width_;
         }
     };
 
-    SboostRowFilter::SboostRowFilter(uint32_t col1, uint32_t col2)
-            : column1_(col1), column2_(col2) {}
-
-    /**
-     * Make sure the returned value is aligned
-     *
-     */
-    const uint8_t *align_buffer(const uint8_t *source, uint8_t *dest, uint32_t bit_width,
-                                uint32_t length, uint32_t entryoff) {
-        uint32_t num_bits = bit_width * entryoff;
-        uint32_t num_bytes = num_bits >> 3;
-        if ((num_bits & 0x7) == 0) {
-            return source + num_bytes;
-        }
-        uint64_t *source_view = (uint64_t *) (source + num_bytes);
-        uint64_t *dest_view = (uint64_t *) dest;
-        uint32_t offset = num_bits & 0x7;
-        uint32_t noffset = 64 - offset;
-        uint32_t pointer = num_bytes;
-        uint32_t counter = 0;
-        while (pointer < length) {
-            dest_view[counter] = (source_view[counter] << offset) | ((source_view[counter + 1]) >> noffset);
-            pointer += 8;
-            counter++;
-        }
-        return dest;
-    }
-
-    shared_ptr<Bitmap> SboostRowFilter::filterBlock(Block &block) {
-        auto parquetBlock = static_cast<ParquetBlock &>(block);
-        auto pages1 = parquetBlock.pages(column1_);
-        auto pages2 = parquetBlock.pages(column2_);
-
-        auto num_entry = block.size();
-        shared_ptr<SimpleBitmap> result = make_shared<SimpleBitmap>(num_entry);
-        BitmapWriter bitmapWriter(result->raw(), 0);
-
-        PagedSegmentReader sreader1(pages1.get());
-        PagedSegmentReader sreader2(pages2.get());
-
-        Segment seg1 = sreader1.next();
-        Segment seg2 = sreader2.next();
-        uint32_t remain1 = seg1.num_entry_;
-        uint32_t remain2 = seg2.num_entry_;
-
-        // Load PACKED data in buffer
-        uint8_t *align_buffer1 = (uint8_t *) aligned_alloc(64, sizeof(uint8_t) * 8192);
-        uint8_t *align_buffer2 = (uint8_t *) aligned_alloc(64, sizeof(uint8_t) * 8192);
-
-        uint32_t processed = 0;
-
-        auto bitwidth = sreader1.bitWidth();
-        ::sboost::BitpackCompare bpcompare(bitwidth);
-
-        while (processed < num_entry) {
-            auto remain = std::min(remain1, remain2);
-            switch ((seg1.mode_ << 1) + seg2.mode_) {
-                case 0:   // left RLE, right RLE
-                    bitmapWriter.appendBits(seg1.value_ < seg2.value_, remain);
-                    break;
-                case 1: { // left RLE, right PACKED
-                    ::sboost::Bitpack bitpack(seg1.value_, bitwidth);
-                    // Align seg2 data
-                    auto buffer2_aligned = align_buffer(seg2.data_, align_buffer2, bitwidth,
-                                                        seg2.data_length_, seg2.num_entry_ - remain2);
-                    bitpack.greater(buffer2_aligned, remain, result->raw(), bitmapWriter.offset());
-                    bitmapWriter.moveForward(remain);
-                }
-                    break;
-                case 2: { // left PACKED, right RLE
-                    ::sboost::Bitpack bitpack(seg2.value_, bitwidth);
-                    // Align seg1 data
-                    auto buffer1_aligned = align_buffer(seg1.data_, align_buffer1, bitwidth,
-                                                        seg1.data_length_, seg1.num_entry_ - remain1);
-                    bitpack.less(buffer1_aligned, remain, result->raw(), bitmapWriter.offset());
-                    bitmapWriter.moveForward(remain);
-                }
-                    break;
-                case 3: // left PACKED, right PACKED
-                    auto buffer1_aligned = align_buffer(seg1.data_, align_buffer1, bitwidth,
-                                                        seg1.data_length_, seg1.num_entry_ - remain1);
-                    auto buffer2_aligned = align_buffer(seg2.data_, align_buffer2, bitwidth,
-                                                        seg2.data_length_, seg2.num_entry_ - remain2);
-                    bpcompare.less(buffer1_aligned, buffer2_aligned,
-                                   remain, result->raw(), bitmapWriter.offset());
-                    bitmapWriter.moveForward(remain);
-                    break;
-            }
-            processed += remain;
-            if (remain == remain1 && sreader1.hasNext()) {
-                seg1 = sreader1.next();
-                remain1 = seg1.num_entry_;
-            }
-            if (remain == remain2 && sreader2.hasNext()) {
-                seg2 = sreader2.next();
-                remain2 = seg2.num_entry_;
-            }
-        }
-        ::sboost::encoding::cleanup(processed, num_entry, result->raw(), 0);
-
-        free(align_buffer1);
-        free(align_buffer2);
-
-        return result;
-    }
-
-    SboostRow2Filter::SboostRow2Filter(uint32_t col1, uint32_t col2, uint32_t col3)
-            : column1_(col1), column2_(col2), column3_(col3) {}
-
-    shared_ptr<Bitmap> SboostRow2Filter::filterBlock(Block &block) {
-        auto parquetBlock = static_cast<ParquetBlock &>(block);
-        auto pages1 = parquetBlock.pages(column1_);
-        auto pages2 = parquetBlock.pages(column2_);
-        auto pages3 = parquetBlock.pages(column3_);
-
-        auto num_entry = block.size();
-        shared_ptr<SimpleBitmap> result = make_shared<SimpleBitmap>(num_entry);
-        BitmapWriter bitmapWriter(result->raw(), 0);
-
-        PagedSegmentReader sreader1(pages1.get());
-        PagedSegmentReader sreader2(pages2.get());
-        PagedSegmentReader sreader3(pages3.get());
-
-        Segment seg1 = sreader1.next();
-        Segment seg2 = sreader2.next();
-        Segment seg3 = sreader3.next();
-
-        uint32_t processed = 0;
-
-        ::sboost::BitpackCompare bpcompare(sreader1.bitWidth());
-
-        uint64_t *cmp12 = (uint64_t *) aligned_alloc(64, 20 * sizeof(uint64_t));
-        uint64_t *cmp23 = (uint64_t *) aligned_alloc(64, 20 * sizeof(uint64_t));
-
-        while (processed < num_entry) {
-            memset(cmp12, 0, 20 * sizeof(uint64_t));
-            memset(cmp23, 0, 20 * sizeof(uint64_t));
-            assert(seg1.num_entry_ == seg2.num_entry_);
-            assert(seg2.num_entry_ == seg3.num_entry_);
-            assert(seg1.mode_ == PACKED);
-            assert(seg2.mode_ == PACKED);
-            assert(seg3.mode_ == PACKED);
-
-            auto num_words = (seg1.num_entry_ + 63) >> 6;
-            bpcompare.less(seg1.data_, seg2.data_, seg1.num_entry_, cmp12, 0);
-            bpcompare.less(seg2.data_, seg3.data_, seg2.num_entry_, cmp23, 0);
-            ::sboost::simd::simd_and(cmp12, cmp23, num_words);
-
-            bitmapWriter.appendWord(cmp12, seg1.num_entry_);
-            processed += seg1.num_entry_;
-            if (sreader1.hasNext())
-                seg1 = sreader1.next();
-            if (sreader2.hasNext())
-                seg2 = sreader2.next();
-            if (sreader3.hasNext())
-                seg3 = sreader3.next();
-        }
-        auto full_size = ((num_entry >> 6) + 1) << 6;
-        ::sboost::encoding::cleanup(full_size, num_entry, result->raw(), 0);
-
-        free(cmp12);
-        free(cmp23);
-        return result;
+    /// Skip the first entries of packed data, shifting the rest to start at a byte
+    const uint8_t *skip_packed(const uint8_t *source, vector<uint8_t> &dest, uint32_t bit_width,
+                               uint32_t length, uint32_t skip) {
+        uint32_t num_bits = bit_width * skip;
+        auto start = source + (num_bits >> 3);
+        uint32_t shift = num_bits & 0x7;
+        if (shift == 0) {
+            return start;
+        }
+        uint32_t num_bytes = length - (num_bits >> 3);
+        // The SIMD kernels read past the end
+        dest.resize(num_bytes + 128);
+        for (uint32_t i = 0; i < num_bytes; ++i) {
+            uint8_t high = i + 1 < num_bytes ? start[i + 1] : 0;
+            dest[i] = (start[i] >> shift) | (high << (8 - shift));
+        }
+        return dest.data();
     }
 
     KeyFinder::KeyFinder(uint32_t key_index, function<bool(DataRow &)> pred)
@@ -454,19 +329,138 @@ namespace lqf {
         }
 
         template<typename DTYPE>
-        DictEq<DTYPE>::DictEq(const T &target) : target_(target) {}
+        DictCodeScan<DTYPE>::DictCodeScan()
+                : dict_size_(0), lower_code_(0), upper_code_(0), use_keys_(false) {}
 
         template<typename DTYPE>
-        void DictEq<DTYPE>::dict(Dictionary<DTYPE> &dict) {
-            rawTarget_ = dict.lookup(target_);
+        void DictCodeScan<DTYPE>::ranks(Dictionary<DTYPE> &dict, uint32_t lower, uint32_t upper) {
+            dict_size_ = dict.size();
+            upper = std::max(lower, upper);
+            // Ranks are codes in a sorted dictionary
+            if (!dict.sorted() && upper - lower > 1 && upper - lower < dict_size_) {
+                auto &order = dict.order();
+                vector<uint32_t> keys(order.begin() + lower, order.begin() + upper);
+                sort(keys.begin(), keys.end());
+                codes(dict, move(keys));
+            } else {
+                use_keys_ = false;
+                lower_code_ = lower;
+                upper_code_ = upper;
+                if (!dict.sorted() && upper == lower + 1) {
+                    lower_code_ = dict.order()[lower];
+                    upper_code_ = lower_code_ + 1;
+                }
+            }
+        }
+
+        template<typename DTYPE>
+        void DictCodeScan<DTYPE>::codes(Dictionary<DTYPE> &dict, vector<uint32_t> keys) {
+            dict_size_ = dict.size();
+            use_keys_ = true;
+            keys_ = move(keys);
+            selected_.clear();
+            if (keys_.size() > DICT_SCAN_MAX_KEYS) {
+                selected_.resize(dict_size_, 0);
+                for (auto key: keys_) {
+                    selected_[key] = 1;
+                }
+            }
+        }
+
+        template<typename DTYPE>
+        void DictCodeScan<DTYPE>::scanPage(uint64_t numEntry, const uint8_t *data,
+                                           uint64_t *bitmap, uint64_t bitmap_offset) {
+            if (use_keys_) {
+                scanKeys(numEntry, data, bitmap, bitmap_offset);
+            } else {
+                scanRange(numEntry, data, bitmap, bitmap_offset);
+            }
         }
 
         template<typename DTYPE>
-        void DictEq<DTYPE>::scanPage(uint64_t numEntry, const uint8_t *data,
-                                     uint64_t *bitmap, uint64_t bitmap_offset) {
+        void DictCodeScan<DTYPE>::scanRange(uint64_t numEntry, const uint8_t *data,
+                                            uint64_t *bitmap, uint64_t bitmap_offset) {
+            if (lower_code_ >= upper_code_) {
+                return;
+            }
             uint8_t bitWidth = data[0];
-            ::sboost::encoding::rlehybrid::equal(data + 1, bitmap, bitmap_offset, bitWidth,
-                                                 numEntry, rawTarget_);
+            if (lower_code_ == 0 && upper_code_ >= dict_size_) {
+                ::sboost::BitmapWriter writer(bitmap, bitmap_offset);
+                writer.appendBits(1, numEntry);
+            } else if (upper_code_ == lower_code_ + 1) {
+                ::sboost::encoding::rlehybrid::equal(data + 1, bitmap, bitmap_offset, bitWidth,
+                                                     numEntry, lower_code_);
+            } else if (lower_code_ == 0) {
+                ::sboost::encoding::rlehybrid::less(data + 1, bitmap, bitmap_offset, bitWidth,
+                                                    numEntry, upper_code_);
+            } else if (upper_code_ >= dict_size_) {
+                ::sboost::encoding::rlehybrid::greater(data + 1, bitmap, bitmap_offset, bitWidth,
+                                                       numEntry, lower_code_ - 1);
+            } else {
+                ::sboost::encoding::rlehybrid::between(data + 1, bitmap, bitmap_offset, bitWidth,
+                                                       numEntry, lower_code_, upper_code_ - 1);
+            }
+        }
+
+        template<typename DTYPE>
+        void DictCodeScan<DTYPE>::scanKeys(uint64_t numEntry, const uint8_t *data,
+                                           uint64_t *bitmap, uint64_t bitmap_offset) {
+            if (keys_.empty()) {
+                return;
+            }
+            uint8_t bitWidth = data[0];
+            if (!selected_.empty()) {
+                // One pass over the decoded codes instead of one scan per key. A group of 8
+                // codes takes at most bitWidth bytes and a 5-byte header.
+                uint32_t max_len = (numEntry / 8 + 1) * (bitWidth + 5) + 16;
+                arrow::util::RleDecoder decoder(data + 1, max_len, bitWidth);
+                uint32_t codes[1024];
+                for (uint64_t start = 0; start < numEntry; start += 1024) {
+                    int batch_size = std::min<uint64_t>(1024, numEntry - start);
+                    decoder.GetBatch(codes, batch_size);
+                    for (int i = 0; i < batch_size; ++i) {
+                        if (selected_[codes[i]]) {
+                            auto pos = bitmap_offset + start + i;
+                            bitmap[pos >> 6] |= 1ul << (pos & 0x3F);
+                        }
+                    }
+                }
+                return;
+            }
+            // See SimpleBitmap for the reason of +2 here
+            uint32_t buffer_size = (numEntry >> 6) + 2;
+            uint64_t *page_oneresult = (uint64_t *) aligned_alloc(64, sizeof(uint64_t) * buffer_size);
+            uint64_t *page_result = (uint64_t *) aligned_alloc(64, sizeof(uint64_t) * buffer_size);
+
+            memset((void *) page_result, 0, sizeof(uint64_t) * buffer_size);
+
+            auto ite = keys_.begin();
+            ::sboost::encoding::rlehybrid::equal(data + 1, page_result, 0, bitWidth,
+                                                 numEntry, *ite);
+            ite++;
+            while (ite != keys_.end()) {
+                memset((void *) page_oneresult, 0, sizeof(uint64_t) * buffer_size);
+                ::sboost::encoding::rlehybrid::equal(data + 1, page_oneresult, 0, bitWidth,
+                                                     numEntry, *ite);
+                ::sboost::simd::simd_or(page_result, page_oneresult, buffer_size);
+                ite++;
+            }
+            ::sboost::BitmapWriter writer(bitmap, bitmap_offset);
+            writer.appendWord(page_result, numEntry);
+            free(page_oneresult);
+            free(page_result);
+        }
+
+        template<typename DTYPE>
+        DictEq<DTYPE>::DictEq(const T &target) : target_(target) {}
+
+        template<typename DTYPE>
+        void DictEq<DTYPE>::dict(Dictionary<DTYPE> &dict) {
+            this->dict_size_ = dict.size();
+            this->use_keys_ = false;
+            auto code = dict.lookup(target_);
+            this->lower_code_ = code < 0 ? 0 : code;
+            this->upper_code_ = code < 0 ? 0 : code + 1;
         }
 
         template<typename DTYPE>
@@ -479,20 +473,9 @@ namespace lqf {
 
         template<typename DTYPE>
         void DictLess<DTYPE>::dict(Dictionary<DTYPE> &dict) {
-            rawTarget_ = dict.lookup(target_);
-            if(rawTarget_ < 0) {
-                rawTarget_ = -rawTarget_;
-            }
+            this->ranks(dict, 0, dict.lowerBound(target_));
         };
 
-        template<typename DTYPE>
-        void DictLess<DTYPE>::scanPage(uint64_t numEntry, const uint8_t *data,
-                                       uint64_t *bitmap, uint64_t bitmap_offset) {
-            uint8_t bitWidth = data[0];
-            ::sboost::encoding::rlehybrid::less(data + 1, bitmap, bitmap_offset, bitWidth,
-                                                numEntry, rawTarget_);
-        }
-
         template<typename DTYPE>
         unique_ptr<DictLess<DTYPE>> DictLess<DTYPE>::build(const T &target) {
             return unique_ptr<DictLess<DTYPE>>(new DictLess<DTYPE>(target));
@@ -503,46 +486,23 @@ namespace lqf {
 
         template<typename DTYPE>
         void DictGreater<DTYPE>::dict(Dictionary<DTYPE> &dict) {
-            rawTarget_ = dict.lookup(target_);
+            this->ranks(dict, dict.upperBound(target_), dict.size());
         };
 
-        template<typename DTYPE>
-        void DictGreater<DTYPE>::scanPage(uint64_t numEntry, const uint8_t *data,
-                                          uint64_t *bitmap, uint64_t bitmap_offset) {
-            uint8_t bitWidth = data[0];
-            ::sboost::encoding::rlehybrid::greater(data + 1, bitmap, bitmap_offset, bitWidth,
-                                                   numEntry, rawTarget_);
-        }
-
         template<typename DTYPE>
         unique_ptr<DictGreater<DTYPE>> DictGreater<DTYPE>::build(const T &target) {
             return unique_ptr<DictGreater<DTYPE>>(new DictGreater<DTYPE>(target));
         }
 
-
         template<typename DTYPE>
         DictBetween<DTYPE>::DictBetween(const T &lower, const T &upper)
                 : lower_(lower), upper_(upper) {}
 
         template<typename DTYPE>
         void DictBetween<DTYPE>::dict(Dictionary<DTYPE> &dict) {
-            rawLower_ = dict.lookup(lower_);
-            if(rawLower_<0)
-                rawLower_ = -rawLower_;
-            rawUpper_ = dict.lookup(upper_);
-            if(rawUpper_<0) {
-                rawUpper_ = -rawUpper_;
-            }
+            this->ranks(dict, dict.lowerBound(lower_), dict.upperBound(upper_));
         };
 
-        template<typename DTYPE>
-        void DictBetween<DTYPE>::scanPage(uint64_t numEntry, const uint8_t *data,
-                                          uint64_t *bitmap, uint64_t bitmap_offset) {
-            uint8_t bitWidth = data[0];
-            ::sboost::encoding::rlehybrid::between(data + 1, bitmap, bitmap_offset, bitWidth,
-                                                   numEntry, rawLower_, rawUpper_);
-        }
-
         template<typename DTYPE>
         unique_ptr<DictBetween<DTYPE>> DictBetween<DTYPE>::build(const T &lower, const T &upper) {
             return unique_ptr<DictBetween<DTYPE>>(new DictBetween<DTYPE>(lower, upper));
@@ -554,63 +514,353 @@ namespace lqf {
 
         template<typename DTYPE>
         void DictRangele<DTYPE>::dict(Dictionary<DTYPE> &dict) {
-            rawLower_ = dict.lookup(lower_);
-            rawUpper_ = dict.lookup(upper_);
+            this->ranks(dict, dict.lowerBound(lower_), dict.lowerBound(upper_));
         };
 
-        template<typename DTYPE>
-        void DictRangele<DTYPE>::scanPage(uint64_t numEntry, const uint8_t *data,
-                                          uint64_t *bitmap, uint64_t bitmap_offset) {
-            uint8_t bitWidth = data[0];
-            ::sboost::encoding::rlehybrid::rangele(data + 1, bitmap, bitmap_offset, bitWidth,
-                                                   numEntry, rawLower_, rawUpper_);
-        }
-
         template<typename DTYPE>
         unique_ptr<DictRangele<DTYPE>> DictRangele<DTYPE>::build(const T &lower, const T &upper) {
             return unique_ptr<DictRangele<DTYPE>>(new DictRangele<DTYPE>(lower, upper));
         }
 
-
         template<typename DTYPE>
         DictMultiEq<DTYPE>::DictMultiEq(function<bool(const T &)> pred) : predicate_(pred) {}
 
         template<typename DTYPE>
         void DictMultiEq<DTYPE>::dict(Dictionary<DTYPE> &dict) {
-            keys_ = move(dict.list(predicate_));
+            this->codes(dict, move(*dict.list(predicate_)));
         };
 
         template<typename DTYPE>
-        void DictMultiEq<DTYPE>::scanPage(uint64_t numEntry, const uint8_t *data,
-                                          uint64_t *bitmap, uint64_t bitmap_offset) {
-            uint8_t bitWidth = data[0];
-            // See SimpleBitmap for the reason of +2 here
-            uint32_t buffer_size = (numEntry >> 6) + 2;
-            uint64_t *page_oneresult = (uint64_t *) aligned_alloc(64, sizeof(uint64_t) * buffer_size);
-            uint64_t *page_result = (uint64_t *) aligned_alloc(64, sizeof(uint64_t) * buffer_size);
+        unique_ptr<DictMultiEq<DTYPE>> DictMultiEq<DTYPE>::build(function<bool(const T &)> pred) {
+            return unique_ptr<DictMultiEq<DTYPE>>(new DictMultiEq<DTYPE>(pred));
+        }
 
-            memset((void *) page_result, 0, sizeof(uint64_t) * buffer_size);
+        DictLike::DictLike(const string &pattern) : like_(pattern) {
+            if (like_.prefixOnly()) {
+                prefix_ = like_.segments()[0];
+            }
+        }
 
-            auto ite = keys_.get()->begin();
-            ::sboost::encoding::rlehybrid::equal(data + 1, page_result, 0, bitWidth,
-                                                 numEntry, *ite);
-            ite++;
-            while (ite != keys_.get()->end()) {
-                memset((void *) page_oneresult, 0, sizeof(uint64_t) * buffer_size);
-                ::sboost::encoding::rlehybrid::equal(data + 1, page_oneresult, 0, bitWidth,
-                                                     numEntry, *ite);
-                ::sboost::simd::simd_or(page_result, page_oneresult, buffer_size);
-                ite++;
+        void DictLike::dict(ByteArrayDictionary &dict) {
+            if (!prefix_.empty()) {
+                // Values with a prefix are consecutive in the value order
+                ByteArray prefix(prefix_.size(), reinterpret_cast<const uint8_t *>(prefix_.data()));
+                auto lower = dict.lowerBound(prefix);
+                auto upper = lower;
+                auto size = dict.size();
+                while (upper < size && like_.match(dict[dict.sorted() ? upper : dict.order()[upper]])) {
+                    ++upper;
+                }
+                ranks(dict, lower, upper);
+                return;
             }
-            ::sboost::BitmapWriter writer(bitmap, bitmap_offset);
-            writer.appendWord(page_result, numEntry);
-            free(page_oneresult);
-            free(page_result);
+            vector<uint32_t> keys;
+            auto size = dict.size();
+            for (uint32_t i = 0; i < size; ++i) {
+                if (like_.match(dict[i])) {
+                    keys.push_back(i);
+                }
+            }
+            codes(dict, move(keys));
+        }
+
+        unique_ptr<DictLike> DictLike::build(const string &pattern) {
+            return unique_ptr<DictLike>(new DictLike(pattern));
+        }
+
+        PlainLike::PlainLike(const string &pattern) : like_(pattern) {}
+
+        void PlainLike::scanPage(uint64_t numEntry, const uint8_t *data,
+                                 uint64_t *bitmap, uint64_t bitmap_offset) {
+            for (uint64_t i = 0; i < numEntry; ++i) {
+                uint32_t len = *reinterpret_cast<const uint32_t *>(data);
+                if (like_.match(data + 4, len)) {
+                    auto pos = bitmap_offset + i;
+                    bitmap[pos >> 6] |= 1ul << (pos & 0x3F);
+                }
+                data += 4 + len;
+            }
+        }
+
+        unique_ptr<PlainLike> PlainLike::build(const string &pattern) {
+            return unique_ptr<PlainLike>(new PlainLike(pattern));
+        }
+
+        RawLike::RawLike(const string &pattern)
+                : dict_(DictLike::build(pattern)), plain_(PlainLike::build(pattern)) {}
+
+        void RawLike::dict(ByteArrayDictionary &dict) {
+            dict_->dict(dict);
+        }
+
+        void RawLike::data(DataPage *dpage) {
+            auto encoding = dpage->encoding();
+            if (encoding == Encoding::RLE_DICTIONARY || encoding == Encoding::PLAIN_DICTIONARY) {
+                dict_->scanPage(dpage->num_values(), dpage->data(), bitmap_->raw(), offset_);
+            } else {
+                plain_->scanPage(dpage->num_values(), dpage->data(), bitmap_->raw(), offset_);
+            }
+            offset_ += dpage->num_values();
+        }
+
+        unique_ptr<RawLike> RawLike::build(const string &pattern) {
+            return unique_ptr<RawLike>(new RawLike(pattern));
         }
 
         template<typename DTYPE>
-        unique_ptr<DictMultiEq<DTYPE>> DictMultiEq<DTYPE>::build(function<bool(const T &)> pred) {
-            return unique_ptr<DictMultiEq<DTYPE>>(new DictMultiEq<DTYPE>(pred));
+        ColCompare<DTYPE>::ColCompare(uint32_t left, uint32_t right, CompareOp op)
+                : ColPredicate(left), right_(right), op_(op) {}
+
+        template<typename DTYPE>
+        shared_ptr<Bitmap> ColCompare<DTYPE>::filterBlock(Block &block, Bitmap &skip) {
+            auto masked = dynamic_cast<MaskedBlock *>(&block);
+            auto pblock = dynamic_cast<ParquetBlock *>(masked ? masked->inner().get() : &block);
+            if (!pblock || !pblock->hasDictionary(index_) || !pblock->hasDictionary(right_)) {
+                return compareRows(block, skip);
+            }
+            auto table = static_cast<ParquetTable *>(pblock->owner());
+            auto translation = translate(table->LoadGlobalDictionary<DTYPE>(index_)->local(pblock->index()),
+                                         table->LoadGlobalDictionary<DTYPE>(right_)->local(pblock->index()));
+            shared_ptr<SimpleBitmap> result;
+            if (translation->direct_) {
+                result = comparePacked(*pblock);
+            }
+            if (!result) {
+                result = compareCodes(*pblock, *translation);
+            }
+            return skip & *result;
+        }
+
+        template<typename DTYPE>
+        shared_ptr<typename ColCompare<DTYPE>::Translation>
+        ColCompare<DTYPE>::translate(shared_ptr<Dictionary<DTYPE>> left, shared_ptr<Dictionary<DTYPE>> right) {
+            lock_guard<mutex> lock(lock_);
+            auto &cached = translations_[make_pair(left, right)];
+            if (cached) {
+                return cached;
+            }
+            cached = make_shared<Translation>();
+            bool same = left == right;
+            if (!same && left->size() == right->size()) {
+                same = true;
+                for (uint32_t i = 0; i < left->size() && same; ++i) {
+                    same = (*left)[i] == (*right)[i];
+                }
+            }
+            cached->direct_ = same && (left->sorted() || op_ == EQ || op_ == NEQ);
+            if (cached->direct_) {
+                return cached;
+            }
+            // Ranks in the union keep the order and the equality of the values
+            vector<T> values;
+            for (auto dict: {left.get(), right.get()}) {
+                for (uint32_t i = 0; i < dict->size(); ++i) {
+                    values.push_back((*dict)[i]);
+                }
+            }
+            sort(values.begin(), values.end());
+            values.erase(unique(values.begin(), values.end()), values.end());
+            for (auto &entry: {make_pair(left.get(), &cached->left_), make_pair(right.get(), &cached->right_)}) {
+                auto dict = entry.first;
+                entry.second->resize(dict->size());
+                for (uint32_t i = 0; i < dict->size(); ++i) {
+                    (*entry.second)[i] = lower_bound(values.begin(), values.end(), (*dict)[i]) - values.begin();
+                }
+            }
+            return cached;
+        }
+
+        template<typename DTYPE>
+        shared_ptr<SimpleBitmap> ColCompare<DTYPE>::comparePacked(ParquetBlock &block) {
+            auto pages1 = block.pages(index_);
+            auto pages2 = block.pages(right_);
+            PagedSegmentReader sreader1(pages1.get());
+            PagedSegmentReader sreader2(pages2.get());
+
+            auto num_entry = block.size();
+            auto result = make_shared<SimpleBitmap>(num_entry);
+            BitmapWriter writer(result->raw(), 0);
+
+            Segment seg1;
+            Segment seg2;
+            uint32_t remain1 = 0;
+            uint32_t remain2 = 0;
+            vector<uint8_t> shifted1;
+            vector<uint8_t> shifted2;
+            vector<uint64_t> cmp1;
+            vector<uint64_t> cmp2;
+
+            uint64_t processed = 0;
+            while (processed < num_entry) {
+                if (remain1 == 0) {
+                    sreader1.next(seg1);
+                    remain1 = seg1.num_entry_;
+                }
+                if (remain2 == 0) {
+                    sreader2.next(seg2);
+                    remain2 = seg2.num_entry_;
+                }
+                auto bit_width = sreader1.bitWidth();
+                // The sboost kernels do not support 1-bit codes
+                if (bit_width != sreader2.bitWidth() || bit_width < 2) {
+                    return nullptr;
+                }
+                auto remain = std::min(remain1, remain2);
+                if (seg1.mode_ == RLE && seg2.mode_ == RLE) {
+                    writer.appendBits(compare(seg1.value_, seg2.value_), remain);
+                } else {
+                    auto num_words = (remain >> 6) + 10;
+                    cmp1.assign(num_words, 0);
+                    auto data1 = seg1.mode_ == PACKED ?
+                                 skip_packed(seg1.data_, shifted1, bit_width, seg1.data_length_,
+                                             seg1.num_entry_ - remain1) : nullptr;
+                    auto data2 = seg2.mode_ == PACKED ?
+                                 skip_packed(seg2.data_, shifted2, bit_width, seg2.data_length_,
+                                             seg2.num_entry_ - remain2) : nullptr;
+                    bool invert = op_ == NEQ;
+                    if (seg1.mode_ == RLE) {
+                        ::sboost::Bitpack bitpack(bit_width, seg1.value_);
+                        switch (op_) {
+                            case LESS:
+                                bitpack.greater(data2, remain, cmp1.data(), 0);
+                                break;
+                            case LEQ:
+                                bitpack.geq(data2, remain, cmp1.data(), 0);
+                                break;
+                            default:
+                                bitpack.equal(data2, remain, cmp1.data(), 0);
+                        }
+                    } else if (seg2.mode_ == RLE) {
+                        ::sboost::Bitpack bitpack(bit_width, seg2.value_);
+                        switch (op_) {
+                            case LESS:
+                                bitpack.less(data1, remain, cmp1.data(), 0);
+                                break;
+                            case LEQ:
+                                bitpack.leq(data1, remain, cmp1.data(), 0);
+                                break;
+                            default:
+                                bitpack.equal(data1, remain, cmp1.data(), 0);
+                        }
+                    } else {
+                        ::sboost::BitpackCompare bpcompare(bit_width);
+                        switch (op_) {
+                            case LESS:
+                                bpcompare.less(data1, data2, remain, cmp1.data(), 0);
+                                break;
+                            case LEQ:
+                                // a <= b is not b < a
+                                bpcompare.less(data2, data1, remain, cmp1.data(), 0);
+                                invert = true;
+                                break;
+                            default:
+                                // a == b is neither a < b nor b < a
+                                cmp2.assign(num_words, 0);
+                                bpcompare.less(data1, data2, remain, cmp1.data(), 0);
+                                bpcompare.less(data2, data1, remain, cmp2.data(), 0);
+                                ::sboost::simd::simd_or(cmp1.data(), cmp2.data(), num_words);
+                                invert = op_ == EQ;
+                        }
+                    }
+                    if (invert) {
+                        for (auto &word: cmp1) {
+                            word = ~word;
+                        }
+                    }
+                    writer.appendWord(cmp1.data(), remain);
+                }
+                processed += remain;
+                remain1 -= remain;
+                remain2 -= remain;
+            }
+            return result;
+        }
+
+        template<typename DTYPE>
+        shared_ptr<SimpleBitmap> ColCompare<DTYPE>::compareCodes(ParquetBlock &block, Translation &translation) {
+            auto num_entry = block.size();
+            // Padded to full lanes
+            auto num_lanes = (num_entry + 15) & ~15ul;
+            vector<uint32_t> left(num_lanes, 0);
+            vector<uint32_t> right(num_lanes, 0);
+            for (auto &entry: {make_tuple(index_, left.data(), &translation.left_),
+                               make_tuple(right_, right.data(), &translation.right_)}) {
+                auto pages = block.pages(get<0>(entry));
+                auto codes = get<1>(entry);
+                auto &ranks = *get<2>(entry);
+                // Skip the dictionary page
+                pages->NextPage();
+                uint64_t offset = 0;
+                shared_ptr<Page> page;
+                while ((page = pages->NextPage())) {
+                    auto dpage = static_pointer_cast<DataPage>(page);
+                    arrow::util::RleDecoder decoder(dpage->data() + 1, dpage->size() - 1, dpage->data()[0]);
+                    decoder.GetBatch(codes + offset, dpage->num_values());
+                    offset += dpage->num_values();
+                }
+                if (!ranks.empty()) {
+                    for (uint64_t i = 0; i < num_entry; ++i) {
+                        codes[i] = ranks[codes[i]];
+                    }
+                }
+            }
+            auto result = make_shared<SimpleBitmap>(num_entry);
+            auto masks = reinterpret_cast<uint16_t *>(result->raw());
+            for (uint64_t i = 0; i < num_lanes; i += 16) {
+                auto l = _mm512_loadu_si512(left.data() + i);
+                auto r = _mm512_loadu_si512(right.data() + i);
+                switch (op_) {
+                    case EQ:
+                        masks[i >> 4] = _mm512_cmpeq_epu32_mask(l, r);
+                        break;
+                    case NEQ:
+                        masks[i >> 4] = _mm512_cmpneq_epu32_mask(l, r);
+                        break;
+                    case LESS:
+                        masks[i >> 4] = _mm512_cmplt_epu32_mask(l, r);
+                        break;
+                    case LEQ:
+                        masks[i >> 4] = _mm512_cmple_epu32_mask(l, r);
+                        break;
+                }
+            }
+            // Clear the padding
+            for (uint64_t i = num_entry; i < num_lanes; ++i) {
+                result->raw()[i >> 6] &= ~(1ul << (i & 0x3F));
+            }
+            return result;
+        }
+
+        template<typename DTYPE>
+        shared_ptr<Bitmap> ColCompare<DTYPE>::compareRows(Block &block, Bitmap &skip) {
+            auto result = make_shared<SimpleBitmap>(block.limit());
+            auto rows = block.rows();
+            auto test = [this](DataRow &row) {
+                if constexpr(is_same<DTYPE, ByteArrayType>::value) {
+                    return compare(row[index_].asByteArray(), row[right_].asByteArray());
+                } else if constexpr(is_same<DTYPE, DoubleType>::value) {
+                    return compare(row[index_].asDouble(), row[right_].asDouble());
+                } else {
+                    return compare(row[index_].asInt(), row[right_].asInt());
+                }
+            };
+            if (skip.isFull()) {
+                auto block_size = block.size();
+                for (uint64_t i = 0; i < block_size; ++i) {
+                    if (test(rows->next())) {
+                        result->put(rows->pos());
+                    }
+                }
+            } else {
+                auto posite = skip.iterator();
+                while (posite->hasNext()) {
+                    auto pos = posite->next();
+                    if (test((*rows)[pos])) {
+                        result->put(pos);
+                    }
+                }
+            }
+            return result;
         }
 
         DeltaEq::DeltaEq(const int target) : target_(target) {}
@@ -653,6 +903,15 @@ namespace lqf {
             return unique_ptr<DeltaBetween>(new DeltaBetween(lower, upper));
         }
 
+        template
+        class DictCodeScan<Int32Type>;
+
+        template
+        class DictCodeScan<DoubleType>;
+
+        template
+        class DictCodeScan<ByteArrayType>;
+
         template
         class DictEq<Int32Type>;
 
@@ -707,6 +966,15 @@ namespace lqf {
         template
         class DictMultiEq<ByteArrayType>;
 
+        template
+        class ColCompare<Int32Type>;
+
+        template
+        class ColCompare<DoubleType>;
+
+        template
+        class ColCompare<ByteArrayType>;
+
         template
         class SboostPredicate<Int32Type>;
 
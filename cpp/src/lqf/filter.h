@@ -5,15 +5,21 @@
 #ifndef LQF_OPERATOR_FILTER_H
 #define LQF_OPERATOR_FILTER_H
 
+#include <map>
 #include <memory>
+#include <mutex>
 #include "lang.h"
 #include "parallel.h"
 #include "data_model.h"
 #include "bitmap.h"
 #include "hash_container.h"
+#include "like.h"
 #include <sboost/encoding/rlehybrid.h>
 #include <sboost/encoding/deltabp.h>
 
+// Code sets larger than this are matched on decoded codes instead of a scan per code
+#define DICT_SCAN_MAX_KEYS 8
+
 #define ACCESS(type, param)
 #define ACCESS2(type, param1, param2)
 
@@ -114,12 +120,47 @@ namespace lqf {
         using SBoostDoublePredicate = SboostPredicate<DoubleType>;
         using SBoostByteArrayPredicate = SboostPredicate<ByteArrayType>;
 
+        /**
+         * Scan the dictionary codes of a page for a code range, or for a code set when the
+         * matching values do not map to consecutive codes. Subclasses choose the codes
+         * when the dictionary is loaded.
+         */
         template<typename DTYPE>
-        class DictEq : public RawAccessor<DTYPE> {
+        class DictCodeScan : public RawAccessor<DTYPE> {
+            using T = typename DTYPE::c_type;
+        protected:
+            uint32_t dict_size_;
+            uint32_t lower_code_;
+            uint32_t upper_code_;
+            bool use_keys_;
+            vector<uint32_t> keys_;
+            // Flags of the keys by code, for large key sets
+            vector<uint8_t> selected_;
+
+            /// Match the values ranked [lower, upper) in the dictionary
+            void ranks(Dictionary<DTYPE> &dict, uint32_t lower, uint32_t upper);
+
+            /// Match a set of codes
+            void codes(Dictionary<DTYPE> &dict, vector<uint32_t> keys);
+
+            void scanRange(uint64_t numEntry, const uint8_t *data, uint64_t *bitmap, uint64_t bitmap_offset);
+
+            void scanKeys(uint64_t numEntry, const uint8_t *data, uint64_t *bitmap, uint64_t bitmap_offset);
+
+        public:
+            DictCodeScan();
+
+            virtual ~DictCodeScan() = default;
+
+            void scanPage(uint64_t numEntry, const uint8_t *data,
+                          uint64_t *bitmap, uint64_t bitmap_offset) override;
+        };
+
+        template<typename DTYPE>
+        class DictEq : public DictCodeScan<DTYPE> {
             using T = typename DTYPE::c_type;
         private:
             const T &target_;
-            int rawTarget_;
         public:
             DictEq(const T &target);
 
@@ -127,9 +168,6 @@ namespace lqf {
 
             void dict(Dictionary<DTYPE> &dict) override;
 
-            void scanPage(uint64_t numEntry, const uint8_t *data,
-                          uint64_t *bitmap, uint64_t bitmap_offset) override;
-
             static unique_ptr<DictEq<DTYPE>> build(const T &target);
         };
 
@@ -138,10 +176,9 @@ namespace lqf {
         using ByteArrayDictEq = DictEq<ByteArrayType>;
 
         template<typename DTYPE>
-        class DictLess : public RawAccessor<DTYPE> {
+        class DictLess : public DictCodeScan<DTYPE> {
             using T = typename DTYPE::c_type;
             const T &target_;
-            int rawTarget_;
         public:
             DictLess(const T &target);
 
@@ -149,9 +186,6 @@ namespace lqf {
 
             void dict(Dictionary<DTYPE> &dict) override;
 
-            void scanPage(uint64_t numEntry, const uint8_t *data,
-                          uint64_t *bitmap, uint64_t bitmap_offset) override;
-
             static unique_ptr<DictLess<DTYPE>> build(const T &target);
         };
 
@@ -160,10 +194,9 @@ namespace lqf {
         using ByteArrayDictLess = DictLess<ByteArrayType>;
 
         template<typename DTYPE>
-        class DictGreater : public RawAccessor<DTYPE> {
+        class DictGreater : public DictCodeScan<DTYPE> {
             using T = typename DTYPE::c_type;
             const T &target_;
-            int rawTarget_;
         public:
             DictGreater(const T &target);
 
@@ -171,9 +204,6 @@ namespace lqf {
 
             void dict(Dictionary<DTYPE> &dict) override;
 
-            void scanPage(uint64_t numEntry, const uint8_t *data,
-                          uint64_t *bitmap, uint64_t bitmap_offset) override;
-
             static unique_ptr<DictGreater<DTYPE>> build(const T &target);
         };
 
@@ -181,13 +211,12 @@ namespace lqf {
         using DoubleDictGreater = DictGreater<DoubleType>;
         using ByteArrayDictGreater = DictGreater<ByteArrayType>;
 
+        /// Values in [lower, upper]
         template<typename DTYPE>
-        class DictBetween : public RawAccessor<DTYPE> {
+        class DictBetween : public DictCodeScan<DTYPE> {
             using T = typename DTYPE::c_type;
             const T &lower_;
             const T &upper_;
-            int rawLower_;
-            int rawUpper_;
         public:
             DictBetween(const T &lower, const T &upper);
 
@@ -195,9 +224,6 @@ namespace lqf {
 
             void dict(Dictionary<DTYPE> &dict) override;
 
-            void scanPage(uint64_t numEntry, const uint8_t *data,
-                          uint64_t *bitmap, uint64_t bitmap_offset) override;
-
             static unique_ptr<DictBetween<DTYPE>> build(const T &lower, const T &upper);
         };
 
@@ -205,13 +231,12 @@ namespace lqf {
         using DoubleDictBetween = DictBetween<DoubleType>;
         using ByteArrayDictBetween = DictBetween<ByteArrayType>;
 
+        /// Values in [lower, upper)
         template<typename DTYPE>
-        class DictRangele : public RawAccessor<DTYPE> {
+        class DictRangele : public DictCodeScan<DTYPE> {
             using T = typename DTYPE::c_type;
             const T &lower_;
             const T &upper_;
-            int rawLower_;
-            int rawUpper_;
         public:
             DictRangele(const T &lower, const T &upper);
 
@@ -219,9 +244,6 @@ namespace lqf {
 
             void dict(Dictionary<DTYPE> &dict) override;
 
-            void scanPage(uint64_t numEntry, const uint8_t *data,
-                          uint64_t *bitmap, uint64_t bitmap_offset) override;
-
             static unique_ptr<DictRangele<DTYPE>> build(const T &lower, const T &upper);
         };
 
@@ -230,10 +252,9 @@ namespace lqf {
         using ByteArrayDictRangele = DictRangele<ByteArrayType>;
 
         template<typename DTYPE>
-        class DictMultiEq : public RawAccessor<DTYPE> {
+        class DictMultiEq : public DictCodeScan<DTYPE> {
             using T = typename DTYPE::c_type;
             function<bool(const T &)> predicate_;
-            unique_ptr<vector<uint32_t>> keys_;
         public:
             DictMultiEq(function<bool(const T &)> pred);
 
@@ -241,9 +262,6 @@ namespace lqf {
 
             void dict(Dictionary<DTYPE> &dict) override;
 
-            void scanPage(uint64_t numEntry, const uint8_t *data,
-                          uint64_t *bitmap, uint64_t bitmap_offset) override;
-
             static unique_ptr<DictMultiEq<DTYPE>> build(function<bool(const T &)>);
         };
 
@@ -251,6 +269,114 @@ namespace lqf {
         using DoubleDictMultiEq = DictMultiEq<DoubleType>;
         using ByteArrayDictMultiEq = DictMultiEq<ByteArrayType>;
 
+        class DictLike : public DictCodeScan<ByteArrayType> {
+            Like like_;
+            string prefix_;
+        public:
+            DictLike(const string &pattern);
+
+            virtual ~DictLike() = default;
+
+            void dict(ByteArrayDictionary &dict) override;
+
+            static unique_ptr<DictLike> build(const string &pattern);
+        };
+
+        /// LIKE on plain pages, which hold each value as a 4-byte length followed by the bytes
+        class PlainLike : public RawAccessor<ByteArrayType> {
+            Like like_;
+        public:
+            PlainLike(const string &pattern);
+
+            virtual ~PlainLike() = default;
+
+            void scanPage(uint64_t numEntry, const uint8_t *data,
+                          uint64_t *bitmap, uint64_t bitmap_offset) override;
+
+            static unique_ptr<PlainLike> build(const string &pattern);
+        };
+
+        /// LIKE on a column chunk mixing dictionary pages and plain pages, such as a dictionary falling back to plain
+        class RawLike : public RawAccessor<ByteArrayType> {
+            unique_ptr<DictLike> dict_;
+            unique_ptr<PlainLike> plain_;
+        public:
+            RawLike(const string &pattern);
+
+            virtual ~RawLike() = default;
+
+            void dict(ByteArrayDictionary &dict) override;
+
+            void data(DataPage *dpage) override;
+
+            static unique_ptr<RawLike> build(const string &pattern);
+        };
+
+        enum CompareOp {
+            EQ, NEQ, LESS, LEQ
+        };
+
+        /**
+         * Compare two dictionary-encoded columns of a row, left op right. When both columns of a
+         * row group use the same dictionary and its codes keep the value order, the packed codes
+         * are compared directly and RLE runs are compared as a single value. Otherwise the codes
+         * are translated to their ranks in the union of the two dictionaries and compared with
+         * AVX-512 lanes. The translation is built once per pair of dictionaries.
+         */
+        template<typename DTYPE>
+        class ColCompare : public ColPredicate {
+            using T = typename DTYPE::c_type;
+        protected:
+            struct Translation {
+                // The codes are compared as they are
+                bool direct_;
+                // Code to rank, empty if the codes are the ranks
+                vector<uint32_t> left_;
+                vector<uint32_t> right_;
+            };
+
+            uint32_t right_;
+            CompareOp op_;
+            mutex lock_;
+            map<pair<shared_ptr<Dictionary<DTYPE>>, shared_ptr<Dictionary<DTYPE>>>, shared_ptr<Translation>>
+                    translations_;
+
+            template<typename V>
+            inline bool compare(const V &left, const V &right) {
+                switch (op_) {
+                    case EQ:
+                        return left == right;
+                    case NEQ:
+                        return !(left == right);
+                    case LESS:
+                        return left < right;
+                    default:
+                        return !(right < left);
+                }
+            }
+
+            shared_ptr<Translation> translate(shared_ptr<Dictionary<DTYPE>>, shared_ptr<Dictionary<DTYPE>>);
+
+            shared_ptr<SimpleBitmap> comparePacked(ParquetBlock &);
+
+            shared_ptr<SimpleBitmap> compareCodes(ParquetBlock &, Translation &);
+
+            shared_ptr<Bitmap> compareRows(Block &, Bitmap &);
+
+        public:
+            ColCompare(uint32_t left, uint32_t right, CompareOp op);
+
+            virtual ~ColCompare() = default;
+
+            inline uint32_t right() { return right_; }
+
+            shared_ptr<Bitmap> filterBlock(Block &, Bitmap &) override;
+        };
+
+        using Int32ColCompare = ColCompare<Int32Type>;
+        using DoubleColCompare = ColCompare<DoubleType>;
+        using ByteArrayColCompare = ColCompare<ByteArrayType>;
+
         class DeltaEq : public RawAccessor<Int32Type> {
         private:
             const int target_;
@@ -301,6 +427,24 @@ namespace lqf {
         };
     }
 
+    /**
+     * SQL LIKE on a ByteArray column. On parquet blocks it runs in the FilterExecutor scan of
+     * the column with the other sboost predicates. Dictionary pages are scanned for the codes
+     * of the matching entries, and plain pages are matched in place without decoding the values.
+     * Other blocks match the pattern row by row.
+     */
+    class LikePredicate : public sboost::SBoostByteArrayPredicate {
+    protected:
+        Like like_;
+        SimplePredicate fallback_;
+    public:
+        LikePredicate(uint32_t, const string &pattern);
+
+        virtual ~LikePredicate() = default;
+
+        shared_ptr<Bitmap> filterBlock(Block &, Bitmap &) override;
+    };
+
     class ColFilter : public Filter {
     protected:
         vector<unique_ptr<ColPredicate>> predicates_;
@@ -331,41 +475,6 @@ namespace lqf {
         virtual ~RowFilter() = default;
     };
 
-    /**
-     * Filter the data on column1 < column2
-     * The columns must use the same dictionary
-     */
-    class SboostRowFilter : public Filter {
-    protected:
-        uint32_t column1_;
-
-        uint32_t column2_;
-
-        virtual shared_ptr<Bitmap> filterBlock(Block &) override;
-
-    public:
-        SboostRowFilter(uint32_t, uint32_t);
-
-        virtual ~SboostRowFilter() = default;
-    };
-
-    /**
-     * Filter the data satisfying column1 < column2 < column3
-     */
-    class SboostRow2Filter : public Filter {
-    protected:
-        uint32_t column1_;
-        uint32_t column2_;
-        uint32_t column3_;
-
-        virtual shared_ptr<Bitmap> filterBlock(Block &) override;
-
-    public:
-        SboostRow2Filter(uint32_t, uint32_t, uint32_t);
-
-        virtual ~SboostRow2Filter() = default;
-    };
-
     using namespace hashcontainer;
 
     class MapFilter : public Filter {
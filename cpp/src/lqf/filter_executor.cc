@@ -58,12 +58,16 @@ namespace lqf {
         }
         auto ite = regTable_.find(mappingKey);
         if (ite != regTable_.end()) {
-            auto preds = *(ite->second).get();
+            // Other predicates on the column, such as a column comparison, run on their own
+            vector<ColPredicate *> preds;
             vector<unique_ptr<RawAccessor<DTYPE>>> content;
 
-            for (auto pred: preds) {
+            for (auto pred: *(ite->second)) {
                 auto spred = dynamic_cast<SboostPredicate<DTYPE> *>(pred);
-                content.push_back(spred->build());
+                if (spred) {
+                    preds.push_back(pred);
+                    content.push_back(spred->build());
+                }
             }
 
             PackedRawAccessor<DTYPE> packedAccessor(content);
@@ -172,10 +172,194 @@ TEST_F(ColFilterTest, FilterMultiSboost) {
     }
 }
 
-TEST(SboostRowFilterTest, Filter) {
+TEST(DictCodeScanTest, Ranges) {
+    auto buffer = (int32_t *) malloc(sizeof(int32_t) * 16);
+    for (int32_t i = 0; i < 16; ++i) {
+        buffer[i] = (i * 7) % 16 * 10;
+    }
+    Int32Dictionary unsorted(buffer, 16);
+    auto sorted_buffer = (int32_t *) malloc(sizeof(int32_t) * 16);
+    for (int32_t i = 0; i < 16; ++i) {
+        sorted_buffer[i] = i * 10;
+    }
+    Int32Dictionary sorted(sorted_buffer, 16);
+
+    // A bit-packed run of 64 4-bit codes, two codes per byte
+    uint8_t page[40];
+    memset(page, 0, 40);
+    page[0] = 4;
+    page[1] = ((64 / 8) << 1) | 1;
+    for (uint32_t i = 0; i < 64; ++i) {
+        page[2 + i / 2] |= (i % 16) << (4 * (i % 2));
+    }
+
+    int32_t lower = 35;
+    int32_t upper = 90;
+    int32_t equal = 70;
+    int32_t below = -10;
+    vector<pair<function<unique_ptr<DictCodeScan<Int32Type>>()>, function<bool(int32_t)>>> cases{
+            {[&]() { return Int32DictEq::build(equal); }, [&](int32_t v) { return v == equal; }},
+            {[&]() { return Int32DictLess::build(lower); }, [&](int32_t v) { return v < lower; }},
+            {[&]() { return Int32DictGreater::build(upper); }, [&](int32_t v) { return v > upper; }},
+            {[&]() { return Int32DictBetween::build(lower, upper); }, [&](int32_t v) { return v >= lower && v <= upper; }},
+            {[&]() { return Int32DictRangele::build(lower, equal); }, [&](int32_t v) { return v >= lower && v < equal; }},
+            {[&]() { return Int32DictGreater::build(below); }, [&](int32_t v) { return true; }},
+            {[&]() { return Int32DictBetween::build(upper, lower); }, [&](int32_t v) { return false; }}
+    };
+    for (auto &c: cases) {
+        for (auto dict: {&unsorted, &sorted}) {
+            auto scan = c.first();
+            scan->init(64);
+            scan->dict(*dict);
+            scan->scanPage(64, page, dynamic_pointer_cast<SimpleBitmap>(scan->result())->raw(), 0);
+            auto result = scan->result();
+            for (uint32_t i = 0; i < 64; ++i) {
+                EXPECT_EQ(c.second((*dict)[i % 16]), result->check(i)) << i;
+            }
+        }
+    }
+}
+
+TEST(DictLikeTest, Filter) {
+    // Unsorted dictionary of 32 strings, more matches than DICT_SCAN_MAX_KEYS
+    vector<string> values;
+    for (uint32_t i = 0; i < 32; ++i) {
+        values.push_back((i % 3 ? "PROMO " : "SMALL ") + to_string((i * 7) % 32) + " green");
+    }
+    auto buffer = (ByteArray *) malloc(sizeof(ByteArray) * 32);
+    for (uint32_t i = 0; i < 32; ++i) {
+        buffer[i] = ByteArray(values[i].size(), reinterpret_cast<const uint8_t *>(values[i].data()));
+    }
+    ByteArrayDictionary dict(buffer, 32);
+
+    // A bit-packed run of 64 5-bit codes
+    uint8_t page[64];
+    memset(page, 0, 64);
+    page[0] = 5;
+    page[1] = ((64 / 8) << 1) | 1;
+    for (uint32_t i = 0; i < 64; ++i) {
+        for (uint32_t b = 0; b < 5; ++b) {
+            auto bit = i * 5 + b;
+            page[2 + bit / 8] |= ((i % 32 >> b) & 1) << (bit % 8);
+        }
+    }
+
+    for (const string pattern: {"PROMO%", "%1_ green", "SMALL%green", "%blue%"}) {
+        Like like(pattern);
+        auto scan = DictLike::build(pattern);
+        scan->init(64);
+        scan->dict(dict);
+        scan->scanPage(64, page, dynamic_pointer_cast<SimpleBitmap>(scan->result())->raw(), 0);
+        auto result = scan->result();
+        for (uint32_t i = 0; i < 64; ++i) {
+            EXPECT_EQ(like.match(dict[i % 32]), result->check(i)) << pattern << " " << i;
+        }
+    }
+}
+
+TEST(PlainLikeTest, Filter) {
+    vector<string> values{"MAIL", "AIR", "AIR REG", "TRUCK", "", "RAIL", "REG AIR"};
+    string page;
+    for (auto &value: values) {
+        uint32_t len = value.size();
+        page.append(reinterpret_cast<const char *>(&len), 4);
+        page += value;
+    }
+    for (const string pattern: {"%AIR%", "AIR", "%AIL"}) {
+        Like like(pattern);
+        auto scan = PlainLike::build(pattern);
+        scan->init(100);
+        // Start in the middle of the bitmap as a second page would
+        scan->scanPage(values.size(), reinterpret_cast<const uint8_t *>(page.data()),
+                       dynamic_pointer_cast<SimpleBitmap>(scan->result())->raw(), 60);
+        auto result = scan->result();
+        EXPECT_EQ(0, result->check(59));
+        for (uint32_t i = 0; i < values.size(); ++i) {
+            EXPECT_EQ(like.match(ByteArray(values[i].size(), reinterpret_cast<const uint8_t *>(values[i].data()))),
+                      result->check(60 + i)) << pattern << " " << i;
+        }
+    }
+}
+
+TEST(RawLikeTest, MixedPages) {
+    vector<string> values{"MAIL", "AIR", "AIR REG", "TRUCK"};
+    auto buffer = (ByteArray *) malloc(sizeof(ByteArray) * 4);
+    for (uint32_t i = 0; i < 4; ++i) {
+        buffer[i] = ByteArray(values[i].size(), reinterpret_cast<const uint8_t *>(values[i].data()));
+    }
+    ByteArrayDictionary dict(buffer, 4);
+
+    // A bit-packed run of 8 2-bit codes
+    uint8_t codes[4]{2, (1 << 1) | 1, 0, 0};
+    for (uint32_t i = 0; i < 8; ++i) {
+        codes[2 + i / 4] |= (i % 4) << (i % 4 * 2);
+    }
+    // The dictionary grows too large and the column chunk falls back to plain pages
+    string plain;
+    for (auto &value: values) {
+        uint32_t len = value.size();
+        plain.append(reinterpret_cast<const char *>(&len), 4);
+        plain += value;
+    }
+    DataPageV1 dictPage(make_shared<arrow::Buffer>(codes, 4), 8, Encoding::RLE_DICTIONARY,
+                        Encoding::RLE, Encoding::RLE);
+    DataPageV1 plainPage(make_shared<arrow::Buffer>(reinterpret_cast<const uint8_t *>(plain.data()),
+                                                    plain.size()), 4, Encoding::PLAIN, Encoding::RLE, Encoding::RLE);
+
+    for (const string pattern: {"%AIR%", "%AIL", "%SHIP%"}) {
+        Like like(pattern);
+        auto scan = RawLike::build(pattern);
+        scan->init(12);
+        scan->dict(dict);
+        scan->data(&dictPage);
+        scan->data(&plainPage);
+        auto result = scan->result();
+        for (uint32_t i = 0; i < 12; ++i) {
+            EXPECT_EQ(like.match(dict[i % 4]), result->check(i)) << pattern << " " << i;
+        }
+    }
+}
+
+TEST(ColCompareTest, Rows) {
+    auto memTable = MemTable::Make(2);
+    auto block = memTable->allocate(100);
+    auto rows = block->rows();
+    for (int i = 0; i < 100; ++i) {
+        (*rows)[i][0] = i % 10;
+        (*rows)[i][1] = i / 10;
+    }
+    vector<pair<CompareOp, uint32_t>> expects{{EQ, 10}, {NEQ, 90}, {LESS, 45}, {LEQ, 55}};
+    for (auto &expect: expects) {
+        ColFilter filter(new Int32ColCompare(0, 1, expect.first));
+        auto result = (*filter.filter(*memTable)->blocks()->collect())[0];
+        EXPECT_EQ(expect.second, result->size()) << expect.first;
+        auto fRows = result->rows();
+        for (uint32_t i = 0; i < result->size(); ++i) {
+            auto &row = fRows->next();
+            auto left = row[0].asInt();
+            auto right = row[1].asInt();
+            switch (expect.first) {
+                case EQ:
+                    EXPECT_EQ(left, right);
+                    break;
+                case NEQ:
+                    EXPECT_NE(left, right);
+                    break;
+                case LESS:
+                    EXPECT_LT(left, right);
+                    break;
+                case LEQ:
+                    EXPECT_LE(left, right);
+                    break;
+            }
+        }
+    }
+}
+
+TEST(ColCompareTest, Filter) {
     auto ptable = ParquetTable::Open("testres/lineitem2", (1 << 14) - 1);
 
-    SboostRowFilter filter(10, 11);
+    ColFilter filter(new ByteArrayColCompare(10, 11, LESS));
     auto result = filter.filter(*ptable);
 
     RowFilter compareFilter([](DataRow &drow) {
@@ -189,10 +373,10 @@ TEST(SboostRowFilterTest, Filter) {
     EXPECT_EQ(b1->size(), b2->size());
 }
 
-TEST(SboostRow2FilterTest, Filter) {
+TEST(ColCompareTest, FilterTwo) {
     auto ptable = ParquetTable::Open("testres/lineitem2", (1 << 14) - 1);
 
-    SboostRow2Filter filter(10, 11, 12);
+    ColFilter filter({new ByteArrayColCompare(10, 11, LESS), new ByteArrayColCompare(11, 12, LESS)});
     auto result = filter.filter(*ptable);
 
     RowFilter compareFilter([](DataRow &drow) {
@@ -28,5 +28,17 @@ namespace lqf {
             h ^= h >> 33;
             return h;
         }
+
+        uint32_t crc32_hash(uint32_t seed, const uint8_t *data, uint32_t len) {
+            uint64_t h = seed;
+            uint32_t i = 0;
+            for (; i + 8 <= len; i += 8) {
+                h = _mm_crc32_u64(h, *reinterpret_cast<const uint64_t *>(data + i));
+            }
+            for (; i < len; ++i) {
+                h = _mm_crc32_u8(static_cast<uint32_t>(h), data[i]);
+            }
+            return static_cast<uint32_t>(h);
+        }
     }
 }
\ No newline at end of file
@@ -6,6 +6,7 @@
 #define ARROW_HASH_H
 
 #include <cstdint>
+#include <nmmintrin.h>
 #include "lang.h"
 
 namespace lqf {
@@ -15,6 +16,36 @@ namespace lqf {
         uint32_t knuth_hash(int64_t v);
 
         uint32_t murmur3_hash(int64_t v);
+
+        inline uint32_t crc32_hash(uint32_t seed, uint32_t v) {
+            return _mm_crc32_u32(seed, v);
+        }
+
+        inline uint32_t crc32_hash(uint32_t seed, uint64_t v) {
+            return static_cast<uint32_t>(_mm_crc32_u64(seed, v));
+        }
+
+        uint32_t crc32_hash(uint32_t seed, const uint8_t *data, uint32_t len);
+
+        // Finalizer of murmur3, spreading the bits of a combined hash to the lower bits
+        inline uint32_t fmix32(uint32_t h) {
+            h ^= h >> 16;
+            h *= 0x85ebca6b;
+            h ^= h >> 13;
+            h *= 0xc2b2ae35;
+            h ^= h >> 16;
+            return h;
+        }
+
+        // 64-bit finalizer of murmur3, all output bits depend on all input bits
+        inline uint64_t fmix64(uint64_t h) {
+            h ^= h >> 33;
+            h *= 0xff51afd7ed558ccdULL;
+            h ^= h >> 33;
+            h *= 0xc4ceb9fe1a85ec53ULL;
+            h ^= h >> 33;
+            return h;
+        }
     }
 }
 
@@ -2,6 +2,8 @@
 // Created by Harper on 4/29/20.
 //
 
+#include <cmath>
+#include <immintrin.h>
 #include "hash_container.h"
 
 namespace lqf {
@@ -60,14 +62,19 @@ namespace lqf {
         class HashSetPredicate<Int64>;
 
 
-        BitmapPredicate::BitmapPredicate(uint32_t size) : bitmap_(size) {}
+        BitmapPredicate::BitmapPredicate(uint32_t size) : base_(0), limit_(size), bitmap_(size) {}
+
+        BitmapPredicate::BitmapPredicate(int32_t min, int32_t max)
+                : base_(min), limit_(static_cast<uint32_t>(static_cast<int64_t>(max) - min) + 1), bitmap_(limit_) {}
 
         void BitmapPredicate::add(int32_t val) {
-            bitmap_.put(val);
+            bitmap_.put(static_cast<uint32_t>(val) - static_cast<uint32_t>(base_));
         }
 
         bool BitmapPredicate::test(int32_t val) {
-            return bitmap_.check(val);
+            // Keys below the base wrap around and fail the bound check
+            auto offset = static_cast<uint32_t>(val) - static_cast<uint32_t>(base_);
+            return offset < limit_ && bitmap_.check(offset);
         }
 
         template<typename DTYPE, typename MAP>
@@ -195,6 +202,664 @@ namespace lqf {
         template
         class HashSparseContainer<Int64>;
 
+        static atomic<uint64_t> container_id(0);
+
+        RowAccessors::RowAccessors(const vector<uint32_t> &col_offset)
+                : col_offset_(col_offset), id_(++container_id),
+                  accessors_([this]() { return MemDataRowPointer(col_offset_); }) {}
+
+        MemDataRowPointer &RowAccessors::local() {
+            static thread_local uint64_t cached_id = 0;
+            static thread_local MemDataRowPointer *cached = nullptr;
+            if (cached_id != id_) {
+                cached = accessors_.get().get();
+                cached_id = id_;
+            }
+            return *cached;
+        }
+
+        unique_ptr<DataRow> RowAccessors::detach(uint64_t *data) {
+            auto row = new MemDataRowPointer(col_offset_);
+            row->raw(data);
+            return unique_ptr<DataRow>(row);
+        }
+
+        template<typename DTYPE>
+        HashArrayContainer<DTYPE>::HashArrayContainer(const vector<uint32_t> &offset, ktype min, ktype max)
+                : col_offset_(offset), row_size_(offset.back()), min_(min), max_(max),
+                  range_(max >= min ? static_cast<uint64_t>(static_cast<int64_t>(max) - min) + 1 : 0),
+                  content_(range_ * row_size_), presence_(range_), size_(0), accessors_(col_offset_) {}
+
+        template<typename DTYPE>
+        DataRow &HashArrayContainer<DTYPE>::add(ktype key) {
+            auto idx = index(key);
+            assert(idx < range_);
+            if (presence_.set(idx)) {
+                size_++;
+            }
+            return accessors_.at(content_.data() + idx * row_size_);
+        }
+
+        template<typename DTYPE>
+        bool HashArrayContainer<DTYPE>::test(ktype key) {
+            auto idx = index(key);
+            return idx < range_ && presence_.test(idx);
+        }
+
+        template<typename DTYPE>
+        DataRow *HashArrayContainer<DTYPE>::get(ktype key) {
+            auto idx = index(key);
+            if (idx >= range_ || !presence_.test(idx)) {
+                return nullptr;
+            }
+            return &accessors_.at(content_.data() + idx * row_size_);
+        }
+
+        template<typename DTYPE>
+        unique_ptr<DataRow> HashArrayContainer<DTYPE>::remove(ktype key) {
+            auto idx = index(key);
+            if (idx >= range_ || !presence_.clear(idx)) {
+                return nullptr;
+            }
+            size_--;
+            // The slot is not reused, so the row can be referenced in place
+            return accessors_.detach(content_.data() + idx * row_size_);
+        }
+
+        template<typename DTYPE>
+        class HACIterator : public Iterator<pair<typename DTYPE::type, DataRow &> &> {
+            using ktype = typename DTYPE::type;
+        protected:
+            SimpleBitmapIterator bit_iterator_;
+            uint64_t *content_;
+            uint32_t row_size_;
+            ktype min_;
+            MemDataRowPointer accessor_;
+            pair<ktype, DataRow &> pair_;
+        public:
+            HACIterator(vector<uint64_t> &presence, uint64_t range, vector<uint64_t> &content,
+                        const vector<uint32_t> &col_offset, ktype min)
+                    : bit_iterator_(presence.data(), presence.size(), range), content_(content.data()),
+                      row_size_(col_offset.back()), min_(min), accessor_(col_offset), pair_{0, accessor_} {}
+
+            bool hasNext() override { return bit_iterator_.hasNext(); }
+
+            pair<ktype, DataRow &> &next() override {
+                auto idx = bit_iterator_.next();
+                pair_.first = static_cast<ktype>(min_ + static_cast<int64_t>(idx));
+                accessor_.raw(content_ + idx * row_size_);
+                return pair_;
+            }
+        };
+
+        template<typename DTYPE>
+        unique_ptr<lqf::Iterator<std::pair<typename DTYPE::type, DataRow &> &>> HashArrayContainer<DTYPE>::iterator() {
+            return unique_ptr<Iterator<std::pair<typename DTYPE::type, DataRow &> &>>(
+                    new HACIterator<DTYPE>(presence_.bits(), range_, content_, col_offset_, min_));
+        }
+
+        template
+        class HashArrayContainer<Int32>;
+
+        template
+        class HashArrayContainer<Int64>;
+
+#define FLAT_NONE 0xFFFFFFFF
+
+        inline bool casEntry(uint64_t *target, uint64_t cmp, uint64_t exchange) {
+            return __sync_bool_compare_and_swap(target, cmp, exchange);
+        }
+
+        inline bool casEntry(__uint128_t *target, __uint128_t cmp, __uint128_t exchange) {
+            return cas128(target, cmp, exchange);
+        }
+
+        FlatSlabs::FlatSlabs(uint32_t slot_size, uint32_t capacity)
+                : slot_size_(slot_size), slabs_(((capacity - 1) >> FLAT_SLAB_BITS) + 1, nullptr) {}
+
+        FlatSlabs::~FlatSlabs() {
+            for (auto slab: slabs_) {
+                delete[] slab;
+            }
+        }
+
+        uint64_t *FlatSlabs::allocate(uint32_t row) {
+            auto slab_index = row >> FLAT_SLAB_BITS;
+            if (__atomic_load_n(slabs_.data() + slab_index, __ATOMIC_ACQUIRE) == nullptr) {
+                auto slab = new uint64_t[slot_size_ << FLAT_SLAB_BITS]();
+                if (!__sync_bool_compare_and_swap(slabs_.data() + slab_index, nullptr, slab)) {
+                    delete[] slab;
+                }
+            }
+            return (*this)[row];
+        }
+
+        void FlatSlabs::reserve(uint32_t capacity) {
+            auto num_slabs = ((capacity - 1) >> FLAT_SLAB_BITS) + 1;
+            if (num_slabs > slabs_.size()) {
+                slabs_.resize(num_slabs, nullptr);
+            }
+        }
+
+        template<typename DTYPE>
+        HashFlatContainer<DTYPE>::HashFlatContainer(const vector<uint32_t> &offset)
+                : HashFlatContainer(offset, CONTAINER_SIZE) {}
+
+        template<typename DTYPE>
+        HashFlatContainer<DTYPE>::HashFlatContainer(const vector<uint32_t> &offset, uint32_t expect_size)
+                : col_offset_(offset), entries_len_(ceil2(std::max(expect_size, 16u) * SCALE)),
+                  row_limit_(entries_len_ / SCALE), empty_row_(FLAT_NONE), slabs_(offset.back() + 1, entries_len_),
+                  row_counter_(0), live_(entries_len_), size_(0), min_(DTYPE::max), max_(DTYPE::min),
+                  accessors_(col_offset_) {
+            entries_ = (Entry *) aligned_alloc(sizeof(Entry), sizeof(Entry) * entries_len_);
+            memset(entries_, -1, sizeof(Entry) * entries_len_);
+        }
+
+        template<typename DTYPE>
+        HashFlatContainer<DTYPE>::~HashFlatContainer() {
+            free(entries_);
+        }
+
+        template<typename DTYPE>
+        uint32_t HashFlatContainer<DTYPE>::find(ktype key) {
+            if (key == DTYPE::empty) {
+                return empty_row_.load();
+            }
+            auto mask = entries_len_ - 1;
+            auto index = knuth_hash(key) & mask;
+            while (entries_[index].pair.key_ != DTYPE::empty && entries_[index].pair.key_ != key) {
+                index = (index + 1) & mask;
+            }
+            return entries_[index].pair.key_ == key ? entries_[index].pair.row_ : FLAT_NONE;
+        }
+
+        template<typename DTYPE>
+        uint64_t *HashFlatContainer<DTYPE>::allocate(uint32_t row, ktype key) {
+            auto data = slabs_.allocate(row);
+            data[0] = static_cast<uint64_t>(static_cast<int64_t>(key));
+            return data;
+        }
+
+        template<typename DTYPE>
+        uint32_t HashFlatContainer<DTYPE>::insertEmpty() {
+            auto row = empty_row_.load();
+            if (row == FLAT_NONE) {
+                auto new_row = row_counter_++;
+                if (new_row >= row_limit_) {
+                    return FLAT_NONE;
+                }
+                allocate(new_row, DTYPE::empty);
+                row = empty_row_.compare_exchange_strong(row, new_row) ? new_row : row;
+            }
+            return row;
+        }
+
+        template<typename DTYPE>
+        uint32_t HashFlatContainer<DTYPE>::insert(ktype key) {
+            if (key == DTYPE::empty) {
+                return insertEmpty();
+            }
+            auto mask = entries_len_ - 1;
+            auto index = knuth_hash(key) & mask;
+            uint32_t row = FLAT_NONE;
+            while (true) {
+                Entry exist = entries_[index];
+                if (exist.pair.key_ == key) {
+                    if (exist.pair.row_ == FLAT_NONE) {
+                        // Partially observed concurrent insertion, read again
+                        __sync_synchronize();
+                        continue;
+                    }
+                    // Existing key, the row allocated by this call (if any) is left unused
+                    return exist.pair.row_;
+                }
+                if (exist.pair.key_ == DTYPE::empty) {
+                    if (row == FLAT_NONE) {
+                        row = row_counter_++;
+                        // Below the limit there is always an empty entry to terminate probing
+                        if (row >= row_limit_) {
+                            return FLAT_NONE;
+                        }
+                        allocate(row, key);
+                    }
+                    Entry entry = exist;
+                    entry.pair.key_ = key;
+                    entry.pair.row_ = row;
+                    if (casEntry(&(entries_ + index)->whole, exist.whole, entry.whole)) {
+                        return row;
+                    }
+                    continue;
+                }
+                index = (index + 1) & mask;
+            }
+        }
+
+        template<typename DTYPE>
+        void HashFlatContainer<DTYPE>::grow(uint32_t len) {
+            unique_lock<shared_mutex> lock(resize_lock_);
+            if (entries_len_ != len) {
+                // Another thread has grown the entries
+                return;
+            }
+            auto new_len = entries_len_ << 1;
+            auto new_entries = (Entry *) aligned_alloc(sizeof(Entry), sizeof(Entry) * new_len);
+            memset(new_entries, -1, sizeof(Entry) * new_len);
+            auto new_mask = new_len - 1;
+            for (uint32_t i = 0; i < entries_len_; ++i) {
+                auto &entry = entries_[i];
+                if (entry.pair.key_ != DTYPE::empty) {
+                    auto index = knuth_hash(entry.pair.key_) & new_mask;
+                    while (new_entries[index].pair.key_ != DTYPE::empty) {
+                        index = (index + 1) & new_mask;
+                    }
+                    new_entries[index] = entry;
+                }
+            }
+            free(entries_);
+            entries_ = new_entries;
+            entries_len_ = new_len;
+            // Row indices wasted by the calls that hit the limit are skipped
+            row_limit_ = std::max(static_cast<uint32_t>(new_len / SCALE), row_counter_.load() + 1);
+            slabs_.reserve(row_limit_);
+            live_.resize(row_limit_);
+        }
+
+        template<typename DTYPE>
+        DataRow &HashFlatContainer<DTYPE>::add(ktype key) {
+            ktype current;
+            current = min_.load();
+            while (key < current && !min_.compare_exchange_strong(current, key));
+            current = max_.load();
+            while (key > current && !max_.compare_exchange_strong(current, key));
+
+            uint64_t *data = nullptr;
+            while (data == nullptr) {
+                uint32_t len;
+                {
+                    shared_lock<shared_mutex> lock(resize_lock_);
+                    auto row = insert(key);
+                    if (row != FLAT_NONE) {
+                        if (live_.set(row)) {
+                            size_++;
+                        }
+                        // Slabs are never moved, so the row outlives the lock
+                        data = slabs_[row];
+                    }
+                    len = entries_len_;
+                }
+                if (data == nullptr) {
+                    grow(len);
+                }
+            }
+            return accessors_.at(data + 1);
+        }
+
+        template<typename DTYPE>
+        bool HashFlatContainer<DTYPE>::test(ktype key) {
+            auto row = find(key);
+            return row != FLAT_NONE && live_.test(row);
+        }
+
+        template<typename DTYPE>
+        DataRow *HashFlatContainer<DTYPE>::get(ktype key) {
+            if (key > max_ || key < min_)
+                return nullptr;
+            auto row = find(key);
+            if (row == FLAT_NONE || !live_.test(row)) {
+                return nullptr;
+            }
+            return &accessors_.at(slabs_[row] + 1);
+        }
+
+        template<typename DTYPE>
+        unique_ptr<DataRow> HashFlatContainer<DTYPE>::remove(ktype key) {
+            if (key > max_ || key < min_)
+                return nullptr;
+            auto row = find(key);
+            if (row == FLAT_NONE || !live_.clear(row)) {
+                return nullptr;
+            }
+            size_--;
+            // The slot is not reused, so the row can be referenced in place
+            return accessors_.detach(slabs_[row] + 1);
+        }
+        template<typename DTYPE>
+        class HFCIterator : public Iterator<pair<typename DTYPE::type, DataRow &> &> {
+            using ktype = typename DTYPE::type;
+        protected:
+            SimpleBitmapIterator bit_iterator_;
+            FlatSlabs &slabs_;
+            MemDataRowPointer accessor_;
+            pair<ktype, DataRow &> pair_;
+        public:
+            HFCIterator(vector<uint64_t> &live, uint64_t num_rows, FlatSlabs &slabs,
+                        const vector<uint32_t> &col_offset)
+                    : bit_iterator_(live.data(), live.size(), num_rows), slabs_(slabs),
+                      accessor_(col_offset), pair_{0, accessor_} {}
+
+            bool hasNext() override { return bit_iterator_.hasNext(); }
+
+            pair<ktype, DataRow &> &next() override {
+                auto row = bit_iterator_.next();
+                auto data = slabs_[row];
+                pair_.first = static_cast<ktype>(static_cast<int64_t>(data[0]));
+                accessor_.raw(data + 1);
+                return pair_;
+            }
+        };
+
+        template<typename DTYPE>
+        unique_ptr<lqf::Iterator<std::pair<typename DTYPE::type, DataRow &> &>> HashFlatContainer<DTYPE>::iterator() {
+            return unique_ptr<Iterator<std::pair<typename DTYPE::type, DataRow &> &>>(
+                    new HFCIterator<DTYPE>(live_.bits(), std::min(row_counter_.load(), row_limit_), slabs_, col_offset_));
+        }
+
+        template
+        class HashFlatContainer<Int32>;
+
+        template
+        class HashFlatContainer<Int64>;
+
+        CompositeKey::CompositeKey(const vector<KeyField> &fields) : fields_(fields) {
+            offset_.push_back(0);
+            for (auto &field: fields_) {
+                offset_.push_back(offset_.back() + (field.type_ == K_STRING ? 2 : 1));
+            }
+        }
+
+        bool CompositeKey::compatible(const CompositeKey &other) const {
+            if (fields_.size() != other.fields_.size()) {
+                return false;
+            }
+            for (auto i = 0u; i < fields_.size(); ++i) {
+                if (fields_[i].type_ != other.fields_[i].type_) {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        inline uint64_t doubleBits(double value) {
+            uint64_t bits;
+            memcpy(&bits, &value, sizeof(uint64_t));
+            return bits;
+        }
+
+        // The body of murmur3_32 on one word
+        inline uint32_t mixWord(uint32_t h, uint32_t k) {
+            k *= 0xcc9e2d51;
+            k = (k << 15) | (k >> 17);
+            k *= 0x1b873593;
+            h ^= k;
+            h = (h << 13) | (h >> 19);
+            return h * 5 + 0xe6546b64;
+        }
+
+        inline void mixWords(uint32_t *hashes, const uint32_t *words, uint32_t num) {
+            uint32_t i = 0;
+            const auto c1 = _mm512_set1_epi32(0xcc9e2d51);
+            const auto c2 = _mm512_set1_epi32(0x1b873593);
+            const auto five = _mm512_set1_epi32(5);
+            const auto add = _mm512_set1_epi32(0xe6546b64);
+            for (; i + 16 <= num; i += 16) {
+                auto k = _mm512_loadu_si512(words + i);
+                auto h = _mm512_loadu_si512(hashes + i);
+                k = _mm512_mullo_epi32(_mm512_rol_epi32(_mm512_mullo_epi32(k, c1), 15), c2);
+                h = _mm512_rol_epi32(_mm512_xor_si512(h, k), 13);
+                h = _mm512_add_epi32(_mm512_mullo_epi32(h, five), add);
+                _mm512_storeu_si512(hashes + i, h);
+            }
+            for (; i < num; ++i) {
+                hashes[i] = mixWord(hashes[i], words[i]);
+            }
+        }
+
+        inline void fmixWords(uint32_t *hashes, uint32_t num) {
+            uint32_t i = 0;
+            const auto m1 = _mm512_set1_epi32(0x85ebca6b);
+            const auto m2 = _mm512_set1_epi32(0xc2b2ae35);
+            for (; i + 16 <= num; i += 16) {
+                auto h = _mm512_loadu_si512(hashes + i);
+                h = _mm512_mullo_epi32(_mm512_xor_si512(h, _mm512_srli_epi32(h, 16)), m1);
+                h = _mm512_mullo_epi32(_mm512_xor_si512(h, _mm512_srli_epi32(h, 13)), m2);
+                h = _mm512_xor_si512(h, _mm512_srli_epi32(h, 16));
+                _mm512_storeu_si512(hashes + i, h);
+            }
+            for (; i < num; ++i) {
+                hashes[i] = fmix32(hashes[i]);
+            }
+        }
+
+        void CompositeKey::hash(Block &block, vector<uint32_t> &hashes) const {
+            auto block_size = block.size();
+            hashes.assign(block_size, 0);
+            vector<uint32_t> low(block_size);
+            vector<uint32_t> high(block_size);
+            for (auto &field: fields_) {
+                auto col = block.col(field.index_);
+                switch (field.type_) {
+                    case K_INT:
+                        for (uint32_t i = 0; i < block_size; ++i) {
+                            low[i] = static_cast<uint32_t>(col->next().asInt());
+                        }
+                        break;
+                    case K_LONG:
+                        for (uint32_t i = 0; i < block_size; ++i) {
+                            auto bits = *col->next().data();
+                            low[i] = static_cast<uint32_t>(bits);
+                            high[i] = static_cast<uint32_t>(bits >> 32);
+                        }
+                        break;
+                    case K_DOUBLE:
+                        for (uint32_t i = 0; i < block_size; ++i) {
+                            auto bits = doubleBits(col->next().asDouble());
+                            low[i] = static_cast<uint32_t>(bits);
+                            high[i] = static_cast<uint32_t>(bits >> 32);
+                        }
+                        break;
+                    case K_STRING:
+                        for (uint32_t i = 0; i < block_size; ++i) {
+                            auto &value = col->next().asByteArray();
+                            low[i] = crc32_hash(0, value.ptr, value.len);
+                        }
+                        break;
+                }
+                mixWords(hashes.data(), low.data(), block_size);
+                if (field.type_ == K_LONG || field.type_ == K_DOUBLE) {
+                    mixWords(hashes.data(), high.data(), block_size);
+                }
+            }
+            fmixWords(hashes.data(), block_size);
+        }
+
+        uint32_t CompositeKey::hash(DataRow &row) const {
+            uint32_t h = 0;
+            for (auto &field: fields_) {
+                switch (field.type_) {
+                    case K_INT:
+                        h = mixWord(h, static_cast<uint32_t>(row[field.index_].asInt()));
+                        break;
+                    case K_LONG:
+                    case K_DOUBLE: {
+                        auto bits = field.type_ == K_LONG ? *row[field.index_].data()
+                                                          : doubleBits(row[field.index_].asDouble());
+                        h = mixWord(mixWord(h, static_cast<uint32_t>(bits)), static_cast<uint32_t>(bits >> 32));
+                        break;
+                    }
+                    case K_STRING: {
+                        auto &value = row[field.index_].asByteArray();
+                        h = mixWord(h, crc32_hash(0, value.ptr, value.len));
+                        break;
+                    }
+                }
+            }
+            return fmix32(h);
+        }
+
+        void CompositeKey::write(uint64_t *dest, DataRow &row) const {
+            for (auto i = 0u; i < fields_.size(); ++i) {
+                auto &field = fields_[i];
+                switch (field.type_) {
+                    case K_INT:
+                        dest[offset_[i]] = static_cast<uint32_t>(row[field.index_].asInt());
+                        break;
+                    case K_LONG:
+                        dest[offset_[i]] = *row[field.index_].data();
+                        break;
+                    case K_DOUBLE:
+                        dest[offset_[i]] = doubleBits(row[field.index_].asDouble());
+                        break;
+                    case K_STRING:
+                        // Strings are referenced, not copied, same as in the row snapshots
+                        *reinterpret_cast<ByteArray *>(dest + offset_[i]) = row[field.index_].asByteArray();
+                        break;
+                }
+            }
+        }
+
+        bool CompositeKey::equals(const uint64_t *stored, DataRow &row) const {
+            for (auto i = 0u; i < fields_.size(); ++i) {
+                auto &field = fields_[i];
+                switch (field.type_) {
+                    case K_INT:
+                        if (static_cast<int32_t>(stored[offset_[i]]) != row[field.index_].asInt()) {
+                            return false;
+                        }
+                        break;
+                    case K_LONG:
+                        if (stored[offset_[i]] != *row[field.index_].data()) {
+                            return false;
+                        }
+                        break;
+                    case K_DOUBLE:
+                        if (stored[offset_[i]] != doubleBits(row[field.index_].asDouble())) {
+                            return false;
+                        }
+                        break;
+                    case K_STRING: {
+                        auto &value = row[field.index_].asByteArray();
+                        auto &exist = *reinterpret_cast<const ByteArray *>(stored + offset_[i]);
+                        if (value.len != exist.len || memcmp(value.ptr, exist.ptr, value.len)) {
+                            return false;
+                        }
+                        break;
+                    }
+                }
+            }
+            return true;
+        }
+
+        HashCompositeContainer::HashCompositeContainer(const CompositeKey &key, const vector<uint32_t> &offset,
+                                                       uint32_t expect_size)
+                : key_(key), col_offset_(offset), key_size_(key.size()),
+                  entries_len_(ceil2(std::max(expect_size, 16u) * SCALE)), entries_(entries_len_, UINT64_MAX),
+                  row_limit_(entries_len_ / SCALE), slabs_(key_size_ + offset.back(), entries_len_),
+                  row_counter_(0), size_(0), accessors_(col_offset_) {}
+
+        uint64_t *HashCompositeContainer::find(const CompositeKey &key, DataRow &row, uint32_t hash) {
+            auto mask = entries_len_ - 1;
+            auto index = hash & mask;
+            while (true) {
+                auto entry = entries_[index];
+                if ((entry & 0xFFFFFFFF) == FLAT_NONE) {
+                    return nullptr;
+                }
+                if ((entry >> 32) == hash) {
+                    auto stored = slabs_[entry & 0xFFFFFFFF];
+                    if (key.equals(stored, row)) {
+                        return stored;
+                    }
+                }
+                index = (index + 1) & mask;
+            }
+        }
+
+        uint64_t *HashCompositeContainer::insert(DataRow &row, uint32_t hash) {
+            auto mask = entries_len_ - 1;
+            auto index = hash & mask;
+            uint32_t row_index = FLAT_NONE;
+            while (true) {
+                auto exist = __atomic_load_n(entries_.data() + index, __ATOMIC_ACQUIRE);
+                if ((exist & 0xFFFFFFFF) == FLAT_NONE) {
+                    if (row_index == FLAT_NONE) {
+                        row_index = row_counter_++;
+                        // Below the limit there is always an empty entry to terminate probing
+                        if (row_index >= row_limit_) {
+                            return nullptr;
+                        }
+                        key_.write(slabs_.allocate(row_index), row);
+                    }
+                    uint64_t entry = (static_cast<uint64_t>(hash) << 32) | row_index;
+                    if (__sync_bool_compare_and_swap(entries_.data() + index, exist, entry)) {
+                        size_++;
+                        return slabs_[row_index];
+                    }
+                    continue;
+                }
+                if ((exist >> 32) == hash) {
+                    auto stored = slabs_[exist & 0xFFFFFFFF];
+                    if (key_.equals(stored, row)) {
+                        // Existing key, the slot allocated by this call (if any) is left unused
+                        return stored;
+                    }
+                }
+                index = (index + 1) & mask;
+            }
+        }
+
+        void HashCompositeContainer::grow(uint32_t len) {
+            unique_lock<shared_mutex> lock(resize_lock_);
+            if (entries_len_ != len) {
+                // Another thread has grown the entries
+                return;
+            }
+            auto new_len = entries_len_ << 1;
+            vector<uint64_t> new_entries(new_len, UINT64_MAX);
+            auto new_mask = new_len - 1;
+            for (auto entry: entries_) {
+                if ((entry & 0xFFFFFFFF) != FLAT_NONE) {
+                    auto index = (entry >> 32) & new_mask;
+                    while (new_entries[index] != UINT64_MAX) {
+                        index = (index + 1) & new_mask;
+                    }
+                    new_entries[index] = entry;
+                }
+            }
+            entries_ = move(new_entries);
+            entries_len_ = new_len;
+            // Row indices wasted by the calls that hit the limit are skipped
+            row_limit_ = std::max(static_cast<uint32_t>(new_len / SCALE), row_counter_.load() + 1);
+            slabs_.reserve(row_limit_);
+        }
+
+        DataRow &HashCompositeContainer::add(DataRow &row, uint32_t hash) {
+            uint64_t *data = nullptr;
+            while (data == nullptr) {
+                uint32_t len;
+                {
+                    shared_lock<shared_mutex> lock(resize_lock_);
+                    data = insert(row, hash);
+                    len = entries_len_;
+                }
+                if (data == nullptr) {
+                    grow(len);
+                }
+            }
+            return accessors_.at(data + key_size_);
+        }
+
+        DataRow *HashCompositeContainer::get(const CompositeKey &key, DataRow &row, uint32_t hash) {
+            auto stored = find(key, row, hash);
+            if (stored == nullptr) {
+                return nullptr;
+            }
+            return &accessors_.at(stored + key_size_);
+        }
+
+        bool HashCompositeContainer::test(const CompositeKey &key, DataRow &row, uint32_t hash) {
+            return find(key, row, hash) != nullptr;
+        }
+
         Hash32MapHeapContainer::Hash32MapHeapContainer(const vector<uint32_t> &offset)
                 : Hash32MapHeapContainer(offset, CONTAINER_SIZE) {}
 
@@ -322,6 +987,12 @@ namespace lqf {
         template
         class HashMemBlock<Int64Predicate>;
 
+        template
+        class HashMemBlock<Int32Container>;
+
+        template
+        class HashMemBlock<Int64Container>;
+
         template
         class HashMemBlock<Hash32Predicate>;
 
@@ -340,6 +1011,15 @@ namespace lqf {
         template
         class HashMemBlock<Hash64DenseContainer>;
 
+        template
+        class HashMemBlock<Hash32ArrayContainer>;
+
+        template
+        class HashMemBlock<Hash32FlatContainer>;
+
+        template
+        class HashMemBlock<Hash64FlatContainer>;
+
         shared_ptr<Int32Predicate>
         HashBuilder::buildHashPredicate(Table &input, uint32_t keyIndex, uint32_t expect_size) {
             Hash32Predicate *pred = new Hash32Predicate(expect_size);
@@ -352,7 +1032,7 @@ namespace lqf {
                             retval = hashpredblock->content();
                             return;
                         } else {
-                            auto hashcontblock = dynamic_pointer_cast<HashMemBlock<Hash32Container>>(block);
+                            auto hashcontblock = dynamic_pointer_cast<HashMemBlock<Int32Container>>(block);
                             if (hashcontblock) {
                                 retval = hashcontblock->content();
                                 return;
@@ -412,29 +1092,198 @@ namespace lqf {
             return shared_ptr<Int32Predicate>(predicate);
         }
 
-        shared_ptr<Hash32Container> HashBuilder::buildContainer(Table &input, uint32_t keyIndex,
-                                                                Snapshoter *builder, uint32_t expect_size) {
-            Hash32Container *container = new Hash32Container(builder->colOffset(), expect_size);
-            shared_ptr<Hash32Container> retval = shared_ptr<Hash32Container>(container);
+        const char *strategyName(JOIN_STRATEGY strategy) {
+            switch (strategy) {
+                case JS_PREBUILT:
+                    return "prebuilt";
+                case JS_BITMAP:
+                    return "bitmap";
+                case JS_ARRAY:
+                    return "array";
+                case JS_HASH:
+                    return "hash";
+            }
+            return "unknown";
+        }
 
-            function<void(const shared_ptr<Block> &)> processor = [builder, keyIndex, &container, &retval](
-                    const shared_ptr<Block> &block) {
-                auto hashblock = dynamic_pointer_cast<HashMemBlock<Hash32Container>>(block);
-                if (hashblock) {
-                    retval = hashblock->content();
-                    return;
-                }
-                auto rows = block->rows();
+        JOIN_STRATEGY KeyStat::choose(bool payload) const {
+            if (count_ == 0) {
+                return JS_HASH;
+            }
+            auto range = static_cast<uint64_t>(static_cast<int64_t>(max_) - min_);
+            // The bitmap starts at min_, so it takes at most BITMAP_DENSITY bits per key
+            if (!payload && range < distinct_ * BITMAP_DENSITY) {
+                return JS_BITMAP;
+            }
+            if (payload && range < count_ * DIRECT_DENSITY) {
+                return JS_ARRAY;
+            }
+            return JS_HASH;
+        }
+
+        uint32_t KeyStat::expectSize() const {
+            // Leave a margin for the estimation error
+            return static_cast<uint32_t>(distinct_ + (distinct_ >> 3) + 64);
+        }
+
+        uint32_t KeyStat::expectSize(uint32_t caller) const {
+            return std::min(caller, expectSize());
+        }
+
+        KeyStat HashBuilder::keyStat(vector<shared_ptr<Block>> &blocks, bool parallel, uint32_t keyIndex,
+                                     vector<vector<int32_t>> *keys) {
+            atomic<int32_t> gmin(Int32::max);
+            atomic<int32_t> gmax(Int32::min);
+            atomic<uint64_t> gcount(0);
+            const uint64_t sketch_size = 1ul << DISTINCT_SKETCH_BITS;
+            const uint32_t sketch_mask = sketch_size - 1;
+            ConcurrentBitmap sketch(sketch_size);
+            if (keys) {
+                keys->resize(blocks.size());
+            }
+            function<void(const int32_t &)> scanner = [&blocks, keys, keyIndex, sketch_mask, &gmin, &gmax, &gcount,
+                    &sketch](const int32_t &index) {
+                auto &block = blocks[index];
+                auto col = block->col(keyIndex);
                 auto block_size = block->size();
+                int32_t *keep = nullptr;
+                if (keys) {
+                    (*keys)[index].resize(block_size);
+                    keep = (*keys)[index].data();
+                }
+                int32_t lmin = Int32::max;
+                int32_t lmax = Int32::min;
                 for (uint32_t i = 0; i < block_size; ++i) {
-                    DataRow &row = rows->next();
-                    auto key = row[keyIndex].asInt();
-                    DataRow &writeto = container->add(key);
-                    (*builder)(writeto, row);
+                    auto key = col->next().asInt();
+                    if (keep) {
+                        keep[i] = key;
+                    }
+                    lmin = std::min(lmin, key);
+                    lmax = std::max(lmax, key);
+                    auto bit = hash::fmix32(static_cast<uint32_t>(key)) & sketch_mask;
+                    // Skip the atomic write for bits already set
+                    if (!sketch.check(bit)) {
+                        sketch.put(bit);
+                    }
                 }
+                int32_t current;
+                current = gmin.load();
+                while (lmin < current && !gmin.compare_exchange_strong(current, lmin));
+                current = gmax.load();
+                while (lmax > current && !gmax.compare_exchange_strong(current, lmax));
+                gcount += block_size;
             };
-            input.blocks()->foreach(processor);
-            return retval;
+            auto stream = IntStream::Make(0, blocks.size());
+            (parallel ? stream->parallel() : stream->sequential())->foreach(scanner);
+
+            KeyStat stat;
+            stat.min_ = gmin.load();
+            stat.max_ = gmax.load();
+            stat.count_ = gcount.load();
+            auto zeros = sketch_size - sketch.cardinality();
+            // The estimation is unreliable when the sketch is close to saturation
+            if (zeros * 1024 < sketch_size) {
+                stat.distinct_ = stat.count_;
+            } else {
+                auto estimate = static_cast<uint64_t>(ceil(sketch_size * log(static_cast<double>(sketch_size) / zeros)));
+                stat.distinct_ = std::min(stat.count_, estimate);
+            }
+            return stat;
+        }
+
+        /// Fill the container with the keys kept by keyStat, reading only the payload from the blocks
+        template<typename C32>
+        void fillContainer32(C32 *container, vector<shared_ptr<Block>> &blocks, vector<vector<int32_t>> &keys,
+                             bool parallel, Snapshoter *builder) {
+            function<void(const int32_t &)> processor = [&blocks, &keys, builder, container](const int32_t &index) {
+                auto rows = blocks[index]->rows();
+                auto &block_keys = keys[index];
+                auto block_size = block_keys.size();
+                for (uint32_t i = 0; i < block_size; ++i) {
+                    DataRow &writeto = container->add(block_keys[i]);
+                    (*builder)(writeto, rows->next());
+                }
+            };
+            auto stream = IntStream::Make(0, blocks.size());
+            (parallel ? stream->parallel() : stream->sequential())->foreach(processor);
+        }
+
+        template<typename P32>
+        void fillPredicate32(P32 *predicate, vector<vector<int32_t>> &keys, bool parallel) {
+            function<void(const int32_t &)> processor = [&keys, predicate](const int32_t &index) {
+                for (auto key: keys[index]) {
+                    predicate->add(key);
+                }
+            };
+            auto stream = IntStream::Make(0, keys.size());
+            (parallel ? stream->parallel() : stream->sequential())->foreach(processor);
+        }
+
+        shared_ptr<Int32Predicate> HashBuilder::buildPredicate(Table &input, uint32_t keyIndex, KeyStat *output,
+                                                               uint32_t expect_size) {
+            if (output) {
+                *output = KeyStat();
+            }
+            auto stream = input.blocks();
+            auto parallel = stream->isParallel();
+            auto blocks = stream->collect();
+            if (!blocks->empty()) {
+                auto hashpredblock = dynamic_pointer_cast<HashMemBlock<Int32Predicate>>((*blocks)[0]);
+                if (hashpredblock) {
+                    return hashpredblock->content();
+                }
+                auto hashcontblock = dynamic_pointer_cast<HashMemBlock<Int32Container>>((*blocks)[0]);
+                if (hashcontblock) {
+                    return hashcontblock->content();
+                }
+            }
+            vector<vector<int32_t>> keys;
+            auto stat = keyStat(*blocks, parallel, keyIndex, &keys);
+            stat.strategy_ = stat.choose(false);
+            if (output) {
+                *output = stat;
+            }
+
+            if (stat.strategy_ == JS_BITMAP) {
+                auto predicate = make_shared<BitmapPredicate>(stat.min_, stat.max_);
+                fillPredicate32(predicate.get(), keys, parallel);
+                return predicate;
+            }
+            auto predicate = make_shared<Hash32Predicate>(stat.expectSize(expect_size));
+            fillPredicate32(predicate.get(), keys, parallel);
+            return predicate;
+        }
+
+        shared_ptr<Int32Container> HashBuilder::buildContainer(Table &input, uint32_t keyIndex,
+                                                               Snapshoter *builder, uint32_t expect_size,
+                                                               KeyStat *output) {
+            if (output) {
+                *output = KeyStat();
+            }
+            auto stream = input.blocks();
+            auto parallel = stream->isParallel();
+            auto blocks = stream->collect();
+            if (!blocks->empty()) {
+                auto hashblock = dynamic_pointer_cast<HashMemBlock<Int32Container>>((*blocks)[0]);
+                if (hashblock) {
+                    return hashblock->content();
+                }
+            }
+            vector<vector<int32_t>> keys;
+            auto stat = keyStat(*blocks, parallel, keyIndex, &keys);
+            stat.strategy_ = stat.choose(true);
+            if (output) {
+                *output = stat;
+            }
+
+            if (stat.strategy_ == JS_ARRAY) {
+                auto container = make_shared<Hash32ArrayContainer>(builder->colOffset(), stat.min_, stat.max_);
+                fillContainer32(container.get(), *blocks, keys, parallel, builder);
+                return container;
+            }
+            auto container = make_shared<Hash32Container>(builder->colOffset(), stat.expectSize(expect_size));
+            fillContainer32(container.get(), *blocks, keys, parallel, builder);
+            return container;
         }
 
         shared_ptr<Hash64Container> HashBuilder::buildContainer(Table &input,
@@ -534,6 +1383,29 @@ namespace lqf {
             return retval;
         }
 
+        shared_ptr<HashCompositeContainer> HashBuilder::buildContainer(Table &input, const CompositeKey &key,
+                                                                       Snapshoter *builder, uint32_t expect_size) {
+            // Without a snapshoter only the keys are kept
+            auto container = make_shared<HashCompositeContainer>(
+                    key, builder ? builder->colOffset() : colOffset(0), expect_size);
+            function<void(const shared_ptr<Block> &)> processor = [builder, &key, &container](
+                    const shared_ptr<Block> &block) {
+                vector<uint32_t> hashes;
+                key.hash(*block, hashes);
+                auto rows = block->rows();
+                auto block_size = block->size();
+                for (uint32_t i = 0; i < block_size; ++i) {
+                    DataRow &row = rows->next();
+                    DataRow &writeto = container->add(row, hashes[i]);
+                    if (builder) {
+                        (*builder)(writeto, row);
+                    }
+                }
+            };
+            input.blocks()->foreach(processor);
+            return container;
+        }
+
         template<typename C32>
         shared_ptr<C32> buildContainerP32(Table &input, uint32_t keyIndex, Snapshoter *builder,
                                           uint32_t expect_size = CONTAINER_SIZE) {
@@ -607,6 +1479,35 @@ namespace lqf {
 
         void buildContainerS64();
 
+        template<>
+        shared_ptr<Hash32ArrayContainer>
+        ContainerBuilder::build<Hash32ArrayContainer>(Table &input, uint32_t keyIndex,
+                                                      Snapshoter *builder, uint32_t expect_size) {
+            auto stream = input.blocks();
+            auto parallel = stream->isParallel();
+            auto blocks = stream->collect();
+            vector<vector<int32_t>> keys;
+            auto stat = HashBuilder::keyStat(*blocks, parallel, keyIndex, &keys);
+            auto container = make_shared<Hash32ArrayContainer>(builder->colOffset(), stat.min_, stat.max_);
+            fillContainer32(container.get(), *blocks, keys, parallel, builder);
+            return container;
+        }
+
+        template<>
+        shared_ptr<Hash32FlatContainer>
+        ContainerBuilder::build<Hash32FlatContainer>(Table &input, uint32_t keyIndex,
+                                                     Snapshoter *builder, uint32_t expect_size) {
+            return buildContainerP32<Hash32FlatContainer>(input, keyIndex, builder, expect_size);
+        }
+
+        template<>
+        shared_ptr<Hash64FlatContainer>
+        ContainerBuilder::build<Hash64FlatContainer>(Table &input,
+                                                     function<int64_t(DataRow &)> key_maker,
+                                                     Snapshoter *builder, uint32_t expect_size) {
+            return buildContainerP64<Hash64FlatContainer>(input, key_maker, builder, expect_size);
+        }
+
         template<>
         shared_ptr<Hash32SparseContainer>
         ContainerBuilder::build<Hash32SparseContainer>(Table &input, uint32_t keyIndex,
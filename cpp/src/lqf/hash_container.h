@@ -5,6 +5,7 @@
 #ifndef ARROW_HASH_CONTAINER_H
 #define ARROW_HASH_CONTAINER_H
 
+#include <shared_mutex>
 #include <cuckoohash_map.hh>
 #include <sparsehash/dense_hash_set>
 #include "container.h"
@@ -13,6 +14,13 @@
 #include "data_container.h"
 
 #define CONTAINER_SIZE 1048576
+// Use a direct-indexed array when the key range is within DIRECT_DENSITY times the row count
+#define DIRECT_DENSITY 2
+// Use a bitmap predicate when the key range is within BITMAP_DENSITY times the distinct key count.
+// A hash predicate takes about as many bits per key
+#define BITMAP_DENSITY 64
+// Size of the linear counting sketch estimating the distinct key count, in bits
+#define DISTINCT_SKETCH_BITS 20
 
 namespace lqf {
 
@@ -132,12 +140,19 @@ namespace lqf {
         using Hash32CuckooPredicate = HashCuckooPredicate<Int32>;
         using Hash64CuckooPredicate = HashCuckooPredicate<Int64>;
 
+        /**
+         * Keys in [base, base + limit) as bits
+         */
         class BitmapPredicate : public Int32Predicate {
         private:
+            int32_t base_;
+            uint32_t limit_;
             ConcurrentBitmap bitmap_;
         public:
             BitmapPredicate(uint32_t max);
 
+            BitmapPredicate(int32_t min, int32_t max);
+
             virtual ~BitmapPredicate() = default;
 
             void add(int32_t);
@@ -147,12 +162,105 @@ namespace lqf {
 
         using namespace datacontainer;
 
+        /**
+         * Per-thread row accessors of a container. Each thread remembers the accessor of the
+         * container it used last, keyed by a unique id, so repeated lookups into the same
+         * container skip the lock in ThreadLocal.
+         */
+        class RowAccessors {
+        protected:
+            vector<uint32_t> col_offset_;
+            uint64_t id_;
+            concurrent::ThreadLocal<MemDataRowPointer> accessors_;
+
+            MemDataRowPointer &local();
+
+        public:
+            RowAccessors(const vector<uint32_t> &col_offset);
+
+            RowAccessors(RowAccessors &) = delete;
+
+            RowAccessors &operator=(RowAccessors &) = delete;
+
+            /// The accessor of this thread pointed at the given row. It is valid until the next call
+            inline MemDataRowPointer &at(uint64_t *data) {
+                auto &acc = local();
+                acc.raw(data);
+                return acc;
+            }
+
+            /// A standalone pointer to a row stored in place
+            unique_ptr<DataRow> detach(uint64_t *data);
+        };
+
+        /**
+         * Bitmap marking the occupied slots of a container, updated atomically
+         */
+        class PresenceBits {
+        protected:
+            vector<uint64_t> bits_;
+        public:
+            PresenceBits(uint64_t size) : bits_((size >> 6) + 1, 0) {}
+
+            /// Set the bit, return true if it was not set before
+            inline bool set(uint64_t index) {
+                uint64_t mask = 1UL << (index & 0x3F);
+                return !(__atomic_fetch_or(bits_.data() + (index >> 6), mask, __ATOMIC_SEQ_CST) & mask);
+            }
+
+            /// Clear the bit, return true if it was set before. When several threads remove the same
+            /// key, only the one clearing the bit owns the row
+            inline bool clear(uint64_t index) {
+                uint64_t mask = 1UL << (index & 0x3F);
+                return __atomic_fetch_and(bits_.data() + (index >> 6), ~mask, __ATOMIC_SEQ_CST) & mask;
+            }
+
+            inline bool test(uint64_t index) const {
+                return (bits_[index >> 6] >> (index & 0x3F)) & 1;
+            }
+
+            /// Grow the bitmap, not thread-safe
+            inline void resize(uint64_t size) { bits_.resize((size >> 6) + 1, 0); }
+
+            inline vector<uint64_t> &bits() { return bits_; }
+        };
+
+        /**
+         * Common interface of containers mapping an integer key to a materialized row
+         * @tparam DTYPE
+         */
+        template<typename DTYPE>
+        class IntContainer : public IntPredicate<DTYPE> {
+            using ktype = typename DTYPE::type;
+        public:
+            virtual ~IntContainer() = default;
+
+            /// Return the row of the key, creating it if absent. Adding an existing key returns
+            /// the stored row, so the caller overwrites it
+            virtual DataRow &add(ktype key) = 0;
+
+            virtual DataRow *get(ktype key) = 0;
+
+            virtual unique_ptr<DataRow> remove(ktype key) = 0;
+
+            virtual unique_ptr<lqf::Iterator<std::pair<ktype, DataRow &> &>> iterator() = 0;
+
+            virtual uint32_t size() = 0;
+
+            virtual ktype min() = 0;
+
+            virtual ktype max() = 0;
+        };
+
+        using Int32Container = IntContainer<Int32>;
+        using Int64Container = IntContainer<Int64>;
+
         /**
          * PhaseConcurrentMap based heap allocation MemDataRow container
          * @tparam DTYPE
          */
         template<typename DTYPE>
-        class HashSparseContainer : public IntPredicate<DTYPE> {
+        class HashSparseContainer : public IntContainer<DTYPE> {
             using ktype = typename DTYPE::type;
         protected:
             vector<uint32_t> col_offset_;
@@ -167,26 +275,289 @@ namespace lqf {
 
             virtual ~HashSparseContainer() = default;
 
-            DataRow &add(ktype key);
+            DataRow &add(ktype key) override;
 
             bool test(ktype) override;
 
-            DataRow *get(ktype key);
+            DataRow *get(ktype key) override;
 
-            unique_ptr<DataRow> remove(ktype key);
+            unique_ptr<DataRow> remove(ktype key) override;
 
-            unique_ptr<lqf::Iterator<std::pair<ktype, DataRow &> &>> iterator();
+            unique_ptr<lqf::Iterator<std::pair<ktype, DataRow &> &>> iterator() override;
 
-            inline uint32_t size() { return map_.size(); }
+            inline uint32_t size() override { return map_.size(); }
 
-            inline ktype min() { return min_.load(); }
+            inline ktype min() override { return min_.load(); }
 
-            inline ktype max() { return max_.load(); }
+            inline ktype max() override { return max_.load(); }
         };
 
         using Hash32SparseContainer = HashSparseContainer<Int32>;
         using Hash64SparseContainer = HashSparseContainer<Int64>;
 
+        /**
+         * Direct-indexed container for dense keys. The row of a key is stored in slot key - min
+         * of a flat array, and a presence bitmap marks the occupied slots. The key range must be
+         * known before the container is built. Adding a key twice returns the same slot.
+         * @tparam DTYPE
+         */
+        template<typename DTYPE>
+        class HashArrayContainer : public IntContainer<DTYPE> {
+            using ktype = typename DTYPE::type;
+        protected:
+            vector<uint32_t> col_offset_;
+            uint32_t row_size_;
+            ktype min_;
+            ktype max_;
+            uint64_t range_;
+            vector<uint64_t> content_;
+            PresenceBits presence_;
+            atomic<uint32_t> size_;
+            RowAccessors accessors_;
+
+            inline uint64_t index(ktype key) {
+                return static_cast<uint64_t>(static_cast<int64_t>(key) - static_cast<int64_t>(min_));
+            }
+
+        public:
+            HashArrayContainer(const vector<uint32_t> &, ktype min, ktype max);
+
+            virtual ~HashArrayContainer() = default;
+
+            DataRow &add(ktype key) override;
+
+            bool test(ktype) override;
+
+            DataRow *get(ktype key) override;
+
+            unique_ptr<DataRow> remove(ktype key) override;
+
+            unique_ptr<lqf::Iterator<std::pair<ktype, DataRow &> &>> iterator() override;
+
+            inline uint32_t size() override { return size_.load(); }
+
+            inline ktype min() override { return min_; }
+
+            inline ktype max() override { return max_; }
+        };
+
+        using Hash32ArrayContainer = HashArrayContainer<Int32>;
+        using Hash64ArrayContainer = HashArrayContainer<Int64>;
+
+// Number of rows in a slab of the flat containers is 1 << FLAT_SLAB_BITS
+#define FLAT_SLAB_BITS 14
+
+        /**
+         * Fixed-size row slots in lazily allocated slabs. Slots are addressed by row index.
+         */
+        class FlatSlabs {
+        protected:
+            uint32_t slot_size_;
+            vector<uint64_t *> slabs_;
+        public:
+            FlatSlabs(uint32_t slot_size, uint32_t capacity);
+
+            virtual ~FlatSlabs();
+
+            FlatSlabs(FlatSlabs &) = delete;
+
+            FlatSlabs &operator=(FlatSlabs &) = delete;
+
+            // Make sure the slab holding the row exists, can be called concurrently
+            uint64_t *allocate(uint32_t row);
+
+            // Make room for more rows, not thread-safe. Existing slabs stay in place
+            void reserve(uint32_t capacity);
+
+            inline uint64_t *operator[](uint32_t row) {
+                return slabs_[row >> FLAT_SLAB_BITS] + (row & ((1 << FLAT_SLAB_BITS) - 1)) * slot_size_;
+            }
+        };
+
+        /**
+         * Flat container storing fixed-width rows inline. An open-addressed array maps each key
+         * to a row index, and the rows are laid out as [key, payload...] in lazily allocated slabs.
+         * Removed rows are only unmarked in a live bitmap, so iteration walks the slabs sequentially.
+         * The empty key marks free entries, so its row is kept aside. The entry array doubles when it
+         * gets full, which is why the container is phase-concurrent: adds can run together, and
+         * lookups and removes can run together, but not adds with lookups.
+         * @tparam DTYPE
+         */
+        template<typename DTYPE>
+        class HashFlatContainer : public IntContainer<DTYPE> {
+            using ktype = typename DTYPE::type;
+            using wtype = typename std::conditional<sizeof(ktype) == 4, uint64_t, __uint128_t>::type;
+        protected:
+            struct Pair {
+                ktype key_;
+                uint32_t row_;
+            };
+
+            union Entry {
+                Pair pair;
+                wtype whole;
+            };
+
+            vector<uint32_t> col_offset_;
+
+            Entry *entries_;
+            uint32_t entries_len_;
+            // Rows allowed before the entries grow
+            uint32_t row_limit_;
+            shared_mutex resize_lock_;
+            // Row of the empty key
+            atomic<uint32_t> empty_row_;
+
+            FlatSlabs slabs_;
+            atomic<uint32_t> row_counter_;
+            PresenceBits live_;
+
+            atomic<uint32_t> size_;
+            atomic<ktype> min_;
+            atomic<ktype> max_;
+
+            RowAccessors accessors_;
+
+            uint32_t find(ktype key);
+
+            uint64_t *allocate(uint32_t row, ktype key);
+
+            /// Insert the key and return its row, or FLAT_NONE if the entries need to grow first
+            uint32_t insert(ktype key);
+
+            uint32_t insertEmpty();
+
+            void grow(uint32_t len);
+
+        public:
+            HashFlatContainer(const vector<uint32_t> &);
+
+            HashFlatContainer(const vector<uint32_t> &, uint32_t size);
+
+            virtual ~HashFlatContainer();
+
+            HashFlatContainer(HashFlatContainer &) = delete;
+
+            HashFlatContainer(HashFlatContainer &&) = delete;
+
+            HashFlatContainer &operator=(HashFlatContainer &) = delete;
+
+            HashFlatContainer &operator=(HashFlatContainer &&) = delete;
+
+            DataRow &add(ktype key) override;
+
+            bool test(ktype) override;
+
+            DataRow *get(ktype key) override;
+
+            unique_ptr<DataRow> remove(ktype key) override;
+
+            unique_ptr<lqf::Iterator<std::pair<ktype, DataRow &> &>> iterator() override;
+
+            inline uint32_t size() override { return size_.load(); }
+
+            inline ktype min() override { return min_.load(); }
+
+            inline ktype max() override { return max_.load(); }
+        };
+
+        using Hash32FlatContainer = HashFlatContainer<Int32>;
+        using Hash64FlatContainer = HashFlatContainer<Int64>;
+
+        enum KEY_TYPE {
+            K_INT, K_LONG, K_DOUBLE, K_STRING
+        };
+
+        struct KeyField {
+            uint32_t index_;
+            KEY_TYPE type_;
+        };
+
+        /**
+         * A key made of several typed columns. The key is stored in a row slot as one word per
+         * int / long / double field and two words (a ByteArray) per string field.
+         * Each field is turned into 32-bit words (two for long and double, the CRC of the bytes
+         * for string), which are mixed into the hash with the murmur3 round.
+         */
+        class CompositeKey {
+        protected:
+            vector<KeyField> fields_;
+            // Word offset of each field in the stored key
+            vector<uint32_t> offset_;
+        public:
+            CompositeKey(const vector<KeyField> &);
+
+            inline const vector<KeyField> &fields() const { return fields_; }
+
+            inline uint32_t size() const { return offset_.back(); }
+
+            /// Whether keys of the two specifications can be compared with each other
+            bool compatible(const CompositeKey &) const;
+
+            /// Hash the key of all rows in a block. Each key column is read into a word buffer
+            /// and mixed into the hashes 16 rows at a time
+            void hash(Block &, vector<uint32_t> &) const;
+
+            uint32_t hash(DataRow &) const;
+
+            void write(uint64_t *, DataRow &) const;
+
+            bool equals(const uint64_t *, DataRow &) const;
+        };
+
+        /**
+         * Hash container on composite keys. An open-addressed array of (hash, row index) entries
+         * points to row slots storing [key..., payload...], and the full key is compared when
+         * the hashes match. The hash of a key is given by the caller, see CompositeKey::hash.
+         * Like HashFlatContainer, the entries double when full and the container is phase-concurrent.
+         */
+        class HashCompositeContainer {
+        protected:
+            CompositeKey key_;
+            vector<uint32_t> col_offset_;
+            uint32_t key_size_;
+
+            uint32_t entries_len_;
+            vector<uint64_t> entries_;
+            // Rows allowed before the entries grow
+            uint32_t row_limit_;
+            shared_mutex resize_lock_;
+
+            FlatSlabs slabs_;
+            atomic<uint32_t> row_counter_;
+            atomic<uint32_t> size_;
+
+            RowAccessors accessors_;
+
+            uint64_t *find(const CompositeKey &, DataRow &, uint32_t hash);
+
+            /// Insert the key and return its slot, or nullptr if the entries need to grow first
+            uint64_t *insert(DataRow &, uint32_t hash);
+
+            void grow(uint32_t len);
+
+        public:
+            HashCompositeContainer(const CompositeKey &, const vector<uint32_t> &, uint32_t size = CONTAINER_SIZE);
+
+            virtual ~HashCompositeContainer() = default;
+
+            HashCompositeContainer(HashCompositeContainer &) = delete;
+
+            HashCompositeContainer &operator=(HashCompositeContainer &) = delete;
+
+            /// Insert the key of the row built with the container's key specification
+            DataRow &add(DataRow &, uint32_t hash);
+
+            /// Look up with a row whose key is extracted using the given compatible specification
+            DataRow *get(const CompositeKey &, DataRow &, uint32_t hash);
+
+            bool test(const CompositeKey &, DataRow &, uint32_t hash);
+
+            inline uint32_t size() { return size_.load(); }
+
+            inline const CompositeKey &key() const { return key_; }
+        };
+
         /**
          * PhaseConcurrentMap based page allocation container
          * @tparam DTYPE
@@ -329,7 +700,7 @@ namespace lqf {
         };
 
 
-        using Hash32Container = Hash32SparseContainer;
+        using Hash32Container = Hash32FlatContainer;
         using Hash64Container = Hash64SparseContainer;
 
         using namespace datacontainer;
@@ -346,8 +717,43 @@ namespace lqf {
             shared_ptr<CONTENT> content();
         };
 
+        enum JOIN_STRATEGY {
+            JS_PREBUILT, JS_BITMAP, JS_ARRAY, JS_HASH
+        };
+
+        const char *strategyName(JOIN_STRATEGY);
+
+        /**
+         * Statistics of the key column on the materialized build side of a join,
+         * used to choose the structure holding the keys. The distinct count is
+         * estimated with linear counting and never exceeds the row count.
+         * The array and the bitmap are sized by the key range, so the statistics
+         * are collected before the build. The key column is read only once, as the
+         * scan keeps the keys for the build.
+         */
+        struct KeyStat {
+            uint64_t count_ = 0;
+            int32_t min_ = Int32::max;
+            int32_t max_ = Int32::min;
+            uint64_t distinct_ = 0;
+            JOIN_STRATEGY strategy_ = JS_PREBUILT;
+
+            /// Choose between bitmap, direct array and hash table. Bitmaps carry no payload
+            JOIN_STRATEGY choose(bool payload) const;
+
+            /// An upper bound of the distinct key count used to size hash tables
+            uint32_t expectSize() const;
+
+            /// Initial hash table size, the caller's estimation is a cap as the tables grow when full
+            uint32_t expectSize(uint32_t caller) const;
+        };
+
         class HashBuilder {
         public:
+            /// Collect the key statistics, and optionally the keys of each block for the build
+            static KeyStat keyStat(vector<shared_ptr<Block>> &, bool parallel, uint32_t keyIndex,
+                                   vector<vector<int32_t>> *keys = nullptr);
+
             static shared_ptr<Int32Predicate>
             buildHashPredicate(Table &input, uint32_t, uint32_t expect_size = CONTAINER_SIZE);
 
@@ -355,12 +761,22 @@ namespace lqf {
 
             static shared_ptr<Int32Predicate> buildBitmapPredicate(Table &input, uint32_t, uint32_t);
 
-            static shared_ptr<Hash32Container>
-            buildContainer(Table &input, uint32_t, Snapshoter *, uint32_t expect_size = CONTAINER_SIZE);
+            /// Build a BitmapPredicate or a Hash32Predicate according to the key statistics
+            static shared_ptr<Int32Predicate> buildPredicate(Table &input, uint32_t, KeyStat * = nullptr,
+                                                             uint32_t expect_size = CONTAINER_SIZE);
+
+            /// Build a Hash32ArrayContainer if the key range is dense, otherwise a Hash32Container
+            /// starting at the smaller of expect_size and the distinct key estimation
+            static shared_ptr<Int32Container>
+            buildContainer(Table &input, uint32_t, Snapshoter *, uint32_t expect_size = CONTAINER_SIZE,
+                           KeyStat * = nullptr);
 
             static shared_ptr<Hash64Container>
             buildContainer(Table &input, function<int64_t(DataRow &)>, Snapshoter *,
                            uint32_t expect_size = CONTAINER_SIZE);
+
+            static shared_ptr<HashCompositeContainer>
+            buildContainer(Table &input, const CompositeKey &, Snapshoter *, uint32_t expect_size = CONTAINER_SIZE);
         };
 
         class PredicateBuilder {
@@ -442,6 +858,22 @@ namespace lqf {
         ContainerBuilder::build<Hash32CuckooHeapContainer>(Table &input, uint32_t keyIndex,
                                                            Snapshoter *builder, uint32_t expect_size);
 
+        template<>
+        shared_ptr<Hash32ArrayContainer>
+        ContainerBuilder::build<Hash32ArrayContainer>(Table &input, uint32_t keyIndex,
+                                                      Snapshoter *builder, uint32_t expect_size);
+
+        template<>
+        shared_ptr<Hash32FlatContainer>
+        ContainerBuilder::build<Hash32FlatContainer>(Table &input, uint32_t keyIndex,
+                                                     Snapshoter *builder, uint32_t expect_size);
+
+        template<>
+        shared_ptr<Hash64FlatContainer>
+        ContainerBuilder::build<Hash64FlatContainer>(Table &input,
+                                                     function<int64_t(DataRow &)> key_maker,
+                                                     Snapshoter *builder, uint32_t expect_size);
+
     }
 }
 
@@ -252,3 +252,466 @@ TEST(Hash64DenseContainerTest, Access) {
     EXPECT_EQ(399999, max);
     EXPECT_EQ(400000, set.size());
 }
+
+TEST(Hash32ArrayContainerTest, Access) {
+    auto executor = Executor::Make(20);
+
+    Hash32ArrayContainer container(lqf::colOffset(3), 100, 400099);
+
+    vector<function<int()>> tasks;
+
+    for (int i = 0; i < 10; ++i) {
+        tasks.push_back([&container, i]() {
+            for (int j = 0; j < 40000; ++j) {
+                if (j % 7 == 3) {
+                    continue;
+                }
+                DataRow &row = container.add(i * 40000 + j + 100);
+                row[0] = j;
+                row[1] = j * 0.1;
+                row[2] = 2 * j;
+            }
+            return 0;
+        });
+    }
+
+    executor->invokeAll(tasks);
+
+    EXPECT_EQ(container.size(), 400000 - 57140);
+    EXPECT_EQ(100, container.min());
+    EXPECT_EQ(400099, container.max());
+
+    vector<function<int()>> tasks2;
+    for (int i = 0; i < 10; ++i) {
+        tasks2.push_back([&container, i]() {
+            for (int j = 0; j < 40000; ++j) {
+                DataRow *row = container.get(i * 40000 + j + 100);
+                if (j % 7 == 3) {
+                    EXPECT_TRUE(row == nullptr);
+                    continue;
+                }
+                EXPECT_TRUE(row != nullptr);
+                if (row != nullptr) {
+                    EXPECT_EQ((*row)[0].asInt(), j);
+                    EXPECT_EQ((*row)[1].asDouble(), j * 0.1);
+                    EXPECT_EQ((*row)[2].asInt(), 2 * j);
+                }
+                EXPECT_TRUE(container.get(400100 + j) == nullptr);
+                EXPECT_TRUE(container.get(j - 40000) == nullptr);
+            }
+            return 0;
+        });
+    }
+    executor->invokeAll(tasks2);
+
+    int counter = 0;
+    int prev = INT32_MIN;
+    auto ite = container.iterator();
+    while (ite->hasNext()) {
+        auto &next = ite->next();
+        auto key = next.first;
+        EXPECT_TRUE(key > prev);
+        prev = key;
+        DataRow &value = next.second;
+        auto localkey = (key - 100) % 40000;
+        EXPECT_EQ(value[0].asInt(), localkey);
+        EXPECT_EQ(value[1].asDouble(), localkey * 0.1);
+        EXPECT_EQ(value[2].asInt(), localkey * 2);
+        ++counter;
+    }
+    EXPECT_EQ(400000 - 57140, counter);
+
+    auto removed = container.remove(100);
+    EXPECT_TRUE(removed.get() != nullptr);
+    EXPECT_EQ(0, (*removed)[0].asInt());
+    EXPECT_TRUE(container.remove(100).get() == nullptr);
+    EXPECT_TRUE(container.remove(103).get() == nullptr);
+    EXPECT_FALSE(container.test(100));
+    EXPECT_EQ(container.size(), 400000 - 57140 - 1);
+}
+
+TEST(Hash32FlatContainerTest, Access) {
+    auto executor = Executor::Make(20);
+
+    Hash32FlatContainer container(lqf::colOffset(3), 500000);
+
+    vector<function<int()>> tasks;
+
+    for (int i = 0; i < 10; ++i) {
+        tasks.push_back([&container, i]() {
+            for (int j = 0; j < 40000; ++j) {
+                DataRow &row = container.add(i * 40000 + j);
+                row[0] = j;
+                row[1] = j * 0.1;
+                row[2] = 2 * j;
+            }
+            return 0;
+        });
+    }
+
+    executor->invokeAll(tasks);
+
+    EXPECT_EQ(container.size(), 400000);
+    EXPECT_EQ(0, container.min());
+    EXPECT_EQ(399999, container.max());
+
+    // Adding an existing key returns the same row
+    DataRow &again = container.add(5);
+    EXPECT_EQ(5, again[0].asInt());
+    EXPECT_EQ(container.size(), 400000);
+
+    vector<function<int()>> tasks2;
+    for (int i = 0; i < 10; ++i) {
+        tasks2.push_back([&container, i]() {
+            for (int j = 0; j < 40000; ++j) {
+                DataRow *row = container.get(i * 40000 + j);
+                EXPECT_TRUE(row != nullptr);
+                if (row != nullptr) {
+                    EXPECT_EQ((*row)[0].asInt(), j);
+                    EXPECT_EQ((*row)[1].asDouble(), j * 0.1);
+                    EXPECT_EQ((*row)[2].asInt(), 2 * j);
+                }
+                DataRow *nerow = container.get(400000 + j);
+                EXPECT_TRUE(nerow == nullptr);
+            }
+            return 0;
+        });
+    }
+    executor->invokeAll(tasks2);
+
+    vector<function<int()>> tasks3;
+    for (int i = 0; i < 10; ++i) {
+        tasks3.push_back([&container, i]() {
+            for (int j = 0; j < 40000; j += 2) {
+                auto removed = container.remove(i * 40000 + j);
+                EXPECT_TRUE(removed.get() != nullptr);
+                if (removed) {
+                    EXPECT_EQ((*removed)[0].asInt(), j);
+                }
+                EXPECT_TRUE(container.remove(i * 40000 + j).get() == nullptr);
+            }
+            return 0;
+        });
+    }
+    executor->invokeAll(tasks3);
+
+    EXPECT_EQ(container.size(), 200000);
+    EXPECT_FALSE(container.test(0));
+    EXPECT_TRUE(container.test(1));
+    EXPECT_TRUE(container.get(2) == nullptr);
+
+    unordered_set<int> set;
+    auto ite = container.iterator();
+    while (ite->hasNext()) {
+        auto &next = ite->next();
+        auto key = next.first;
+        EXPECT_EQ(1, key % 2);
+        set.insert(key);
+        DataRow &value = next.second;
+        auto localkey = key % 40000;
+        EXPECT_EQ(value[0].asInt(), localkey);
+        EXPECT_EQ(value[1].asDouble(), localkey * 0.1);
+        EXPECT_EQ(value[2].asInt(), localkey * 2);
+    }
+    EXPECT_EQ(200000, set.size());
+}
+
+TEST(Hash64FlatContainerTest, Access) {
+    auto executor = Executor::Make(20);
+
+    Hash64FlatContainer container(lqf::colOffset(3), 500000);
+
+    vector<function<int()>> tasks;
+
+    for (int i = 0; i < 10; ++i) {
+        tasks.push_back([&container, i]() {
+            for (int j = 0; j < 40000; ++j) {
+                DataRow &row = container.add((static_cast<int64_t>(i) << 40) + j);
+                row[0] = j;
+                row[1] = j * 0.1;
+                row[2] = 2 * j;
+            }
+            return 0;
+        });
+    }
+
+    executor->invokeAll(tasks);
+
+    EXPECT_EQ(container.size(), 400000);
+
+    vector<function<int()>> tasks2;
+    for (int i = 0; i < 10; ++i) {
+        tasks2.push_back([&container, i]() {
+            for (int j = 0; j < 40000; ++j) {
+                DataRow *row = container.get((static_cast<int64_t>(i) << 40) + j);
+                EXPECT_TRUE(row != nullptr);
+                if (row != nullptr) {
+                    EXPECT_EQ((*row)[0].asInt(), j);
+                    EXPECT_EQ((*row)[1].asDouble(), j * 0.1);
+                    EXPECT_EQ((*row)[2].asInt(), 2 * j);
+                }
+                DataRow *nerow = container.get((static_cast<int64_t>(i) << 40) + 40000 + j);
+                EXPECT_TRUE(nerow == nullptr);
+            }
+            return 0;
+        });
+    }
+    executor->invokeAll(tasks2);
+
+    unordered_set<int64_t> set;
+    auto ite = container.iterator();
+    while (ite->hasNext()) {
+        auto &next = ite->next();
+        auto key = next.first;
+        set.insert(key);
+        DataRow &value = next.second;
+        auto localkey = key & 0xFFFFFFFFFF;
+        EXPECT_EQ(value[0].asInt(), localkey);
+        EXPECT_EQ(value[1].asDouble(), localkey * 0.1);
+        EXPECT_EQ(value[2].asInt(), localkey * 2);
+    }
+    EXPECT_EQ(400000, set.size());
+}
+
+TEST(Hash32FlatContainerTest, EmptyKey) {
+    Hash32FlatContainer container(lqf::colOffset(1), 100);
+    EXPECT_FALSE(container.test(-1));
+    container.add(-1)[0] = 7;
+    container.add(3)[0] = 3;
+    EXPECT_EQ(2, container.size());
+    EXPECT_EQ(7, container.add(-1)[0].asInt());
+    EXPECT_EQ(2, container.size());
+    EXPECT_TRUE(container.test(-1));
+    EXPECT_EQ(7, (*container.get(-1))[0].asInt());
+
+    unordered_set<int> keys;
+    auto ite = container.iterator();
+    while (ite->hasNext()) {
+        auto &next = ite->next();
+        EXPECT_EQ(next.first, next.second[0].asInt() == 7 ? -1 : 3);
+        keys.insert(next.first);
+    }
+    EXPECT_EQ(2, keys.size());
+
+    auto removed = container.remove(-1);
+    EXPECT_TRUE(removed.get() != nullptr);
+    EXPECT_EQ(7, (*removed)[0].asInt());
+    EXPECT_FALSE(container.test(-1));
+    EXPECT_EQ(1, container.size());
+}
+
+TEST(Hash32FlatContainerTest, Grow) {
+    auto executor = Executor::Make(20);
+
+    // Far smaller than the number of keys
+    Hash32FlatContainer container(lqf::colOffset(1), 16);
+
+    vector<function<int()>> tasks;
+    for (int i = 0; i < 10; ++i) {
+        tasks.push_back([&container, i]() {
+            for (int j = 0; j < 40000; ++j) {
+                container.add(i * 40000 + j - 1)[0] = j;
+            }
+            return 0;
+        });
+    }
+    executor->invokeAll(tasks);
+
+    EXPECT_EQ(400000, container.size());
+    EXPECT_EQ(-1, container.min());
+    for (int i = 0; i < 10; ++i) {
+        for (int j = 0; j < 40000; ++j) {
+            auto row = container.get(i * 40000 + j - 1);
+            ASSERT_TRUE(row != nullptr);
+            EXPECT_EQ(j, (*row)[0].asInt());
+        }
+    }
+    uint32_t counter = 0;
+    auto ite = container.iterator();
+    while (ite->hasNext()) {
+        ite->next();
+        ++counter;
+    }
+    EXPECT_EQ(400000, counter);
+}
+
+TEST(HashBuilderTest, BuildDenseContainer) {
+    auto dense = MemTable::Make(2);
+    auto block = dense->allocate(100);
+    auto rows = block->rows();
+    for (int i = 0; i < 100; ++i) {
+        (*rows)[i][0] = 1000 + i * 3 / 2;
+        (*rows)[i][1] = i;
+    }
+    auto snapshoter = RowCopyFactory().from(RAW)->to(RAW)->from_layout(colOffset(2))
+            ->to_layout(colOffset(1))->field(F_REGULAR, 1, 0)->buildSnapshot();
+    auto container = HashBuilder::buildContainer(*dense, 0, snapshoter.get());
+    EXPECT_TRUE(dynamic_pointer_cast<Hash32ArrayContainer>(container).get() != nullptr);
+    EXPECT_EQ(100, container->size());
+    for (int i = 0; i < 100; ++i) {
+        EXPECT_EQ(i, (*container->get(1000 + i * 3 / 2))[0].asInt());
+    }
+
+    auto sparse = MemTable::Make(2);
+    block = sparse->allocate(100);
+    rows = block->rows();
+    for (int i = 0; i < 100; ++i) {
+        (*rows)[i][0] = i * 1000;
+        (*rows)[i][1] = i;
+    }
+    container = HashBuilder::buildContainer(*sparse, 0, snapshoter.get());
+    EXPECT_TRUE(dynamic_pointer_cast<Hash32Container>(container).get() != nullptr);
+    EXPECT_EQ(100, container->size());
+    for (int i = 0; i < 100; ++i) {
+        EXPECT_EQ(i, (*container->get(i * 1000))[0].asInt());
+    }
+}
+
+TEST(HashBuilderTest, KeyStat) {
+    auto table = MemTable::Make(1);
+    for (int b = 0; b < 4; ++b) {
+        auto block = table->allocate(50000);
+        auto rows = block->rows();
+        for (int i = 0; i < 50000; ++i) {
+            // 100000 distinct keys, each appearing twice
+            (*rows)[i][0] = ((b * 50000 + i) % 100000) * 7 - 500;
+        }
+    }
+    auto blocks = table->blocks()->collect();
+    auto stat = HashBuilder::keyStat(*blocks, true, 0);
+    EXPECT_EQ(200000, stat.count_);
+    EXPECT_EQ(-500, stat.min_);
+    EXPECT_EQ(99999 * 7 - 500, stat.max_);
+    EXPECT_NEAR(100000, stat.distinct_, 2000);
+    EXPECT_LE(100000, stat.expectSize());
+    EXPECT_EQ(1000, stat.expectSize(1000));
+    // The bitmap starts at the negative minimum
+    EXPECT_EQ(JS_BITMAP, stat.choose(false));
+    EXPECT_EQ(JS_HASH, stat.choose(true));
+
+    vector<vector<int32_t>> keys;
+    HashBuilder::keyStat(*blocks, true, 0, &keys);
+    EXPECT_EQ(4, keys.size());
+    for (int b = 0; b < 4; ++b) {
+        EXPECT_EQ(50000, keys[b].size());
+        EXPECT_EQ(((b * 50000 + 49999) % 100000) * 7 - 500, keys[b][49999]);
+    }
+}
+
+TEST(HashBuilderTest, BuildOffsetBitmap) {
+    auto table = MemTable::Make(1);
+    auto block = table->allocate(1000);
+    auto rows = block->rows();
+    for (int i = 0; i < 1000; ++i) {
+        (*rows)[i][0] = 1000000000 + i * 2;
+    }
+    KeyStat stat;
+    auto predicate = HashBuilder::buildPredicate(*table, 0, &stat);
+    EXPECT_EQ(JS_BITMAP, stat.strategy_);
+    EXPECT_TRUE(dynamic_pointer_cast<BitmapPredicate>(predicate).get() != nullptr);
+    for (int i = 0; i < 2000; ++i) {
+        EXPECT_EQ(i % 2 == 0, predicate->test(1000000000 + i));
+    }
+    EXPECT_FALSE(predicate->test(999999998));
+    EXPECT_FALSE(predicate->test(1000002000));
+    EXPECT_FALSE(predicate->test(-1000000000));
+    EXPECT_FALSE(predicate->test(0));
+}
+
+TEST(HashCompositeContainerTest, Access) {
+    auto executor = Executor::Make(20);
+
+    CompositeKey key({{0, K_INT}, {1, K_INT}});
+    HashCompositeContainer container(key, lqf::colOffset(2), 500000);
+
+    vector<function<int()>> tasks;
+    for (int i = 0; i < 10; ++i) {
+        tasks.push_back([&container, &key, i]() {
+            MemDataRow keyrow(2);
+            for (int j = 0; j < 40000; ++j) {
+                keyrow[0] = i;
+                keyrow[1] = j;
+                DataRow &row = container.add(keyrow, key.hash(keyrow));
+                row[0] = j;
+                row[1] = i * 0.1;
+            }
+            return 0;
+        });
+    }
+    executor->invokeAll(tasks);
+
+    EXPECT_EQ(400000, container.size());
+
+    // Look up with a key specification on other columns
+    CompositeKey probe({{2, K_INT}, {0, K_INT}});
+    vector<function<int()>> tasks2;
+    for (int i = 0; i < 10; ++i) {
+        tasks2.push_back([&container, &probe, i]() {
+            MemDataRow keyrow(3);
+            for (int j = 0; j < 40000; ++j) {
+                keyrow[2] = i;
+                keyrow[0] = j;
+                DataRow *row = container.get(probe, keyrow, probe.hash(keyrow));
+                EXPECT_TRUE(row != nullptr);
+                if (row != nullptr) {
+                    EXPECT_EQ(j, (*row)[0].asInt());
+                    EXPECT_EQ(i * 0.1, (*row)[1].asDouble());
+                }
+                keyrow[2] = i + 10;
+                EXPECT_FALSE(container.test(probe, keyrow, probe.hash(keyrow)));
+            }
+            return 0;
+        });
+    }
+    executor->invokeAll(tasks2);
+}
+
+TEST(HashCompositeContainerTest, Grow) {
+    CompositeKey key({{0, K_LONG}, {1, K_DOUBLE}});
+    // Far smaller than the number of keys
+    HashCompositeContainer container(key, lqf::colOffset(1), 16);
+
+    MemDataRow keyrow(2);
+    for (int i = 0; i < 100000; ++i) {
+        *keyrow[0].data() = (static_cast<uint64_t>(i) << 36) + i;
+        keyrow[1] = i * 0.5;
+        container.add(keyrow, key.hash(keyrow))[0] = i;
+    }
+    EXPECT_EQ(100000, container.size());
+    for (int i = 0; i < 100000; ++i) {
+        *keyrow[0].data() = (static_cast<uint64_t>(i) << 36) + i;
+        keyrow[1] = i * 0.5;
+        auto row = container.get(key, keyrow, key.hash(keyrow));
+        ASSERT_TRUE(row != nullptr);
+        EXPECT_EQ(i, (*row)[0].asInt());
+        // Differs only in the high word of the long
+        *keyrow[0].data() = (static_cast<uint64_t>(i + 1) << 36) + i;
+        EXPECT_FALSE(container.test(key, keyrow, key.hash(keyrow)));
+    }
+}
+
+TEST(CompositeKeyTest, BlockHash) {
+    vector<string> names({"alpha", "beta", "a rather long name over sixteen bytes"});
+    auto table = MemTable::Make(vector<uint32_t>({1, 1, 1, 2}));
+    // Not a multiple of 16, so the scalar tail is covered
+    auto block = table->allocate(37);
+    auto rows = block->rows();
+    for (int i = 0; i < 37; ++i) {
+        auto &name = names[i % 3];
+        ByteArray value(name.length(), (const uint8_t *) name.data());
+        (*rows)[i][0] = i;
+        *(*rows)[i][1].data() = static_cast<uint64_t>(i) << 40;
+        (*rows)[i][2] = i * 0.25;
+        (*rows)[i][3] = value;
+    }
+    CompositeKey key({{3, K_STRING}, {0, K_INT}, {1, K_LONG}, {2, K_DOUBLE}});
+    vector<uint32_t> hashes;
+    key.hash(*block, hashes);
+    ASSERT_EQ(37, hashes.size());
+    unordered_set<uint32_t> distinct;
+    for (int i = 0; i < 37; ++i) {
+        EXPECT_EQ(key.hash((*rows)[i]), hashes[i]) << i;
+        distinct.insert(hashes[i]);
+    }
+    EXPECT_EQ(37, distinct.size());
+}
@@ -40,6 +40,10 @@ namespace lqf {
                 ELEM_PNT latest = creator_();
                 *latest = *element;
                 data_.push_back(latest);
+                // The root should be the last element once the heap is full
+                if (data_.size() == size_) {
+                    heapify();
+                }
             } else if (comparator_(element, data_[0])) {
                 *(data_[0]) = *element;
                 adjust(0);
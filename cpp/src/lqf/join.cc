@@ -2,6 +2,7 @@
 // Created by harper on 2/25/20.
 //
 
+#include <algorithm>
 #include "join.h"
 #include "rowcopy.h"
 
@@ -80,12 +81,15 @@ namespace lqf {
         }
 
         RowBuilder::RowBuilder(initializer_list<int32_t> fields, bool needkey, bool vertical)
-                : JoinBuilder(fields, needkey, vertical) {}
+                : JoinBuilder(fields, needkey, vertical), batch_left_(false) {}
 
         void RowBuilder::init() {
             JoinBuilder::init();
             uint32_t i = needkey_;
             uint32_t right_counter = 0;
+            // Left fields are gathered in batches into row-major output only
+            batch_left_ = !vertical_;
+            left_fields_.clear();
 
             RowCopyFactory left_factory;
             RowCopyFactory right_factory;
@@ -122,6 +126,9 @@ namespace lqf {
                         field_type = F_REGULAR;
                     }
                     left_factory.field(field_type, index, i);
+                    left_fields_.emplace_back(index, i);
+                    // Raw fields need dictionary codes the columnar block does not keep
+                    batch_left_ &= !is_raw;
                 }
                 ++i;
             }
@@ -144,6 +151,11 @@ namespace lqf {
             (*right_copier_)(output, right);
         }
 
+        void RowBuilder::gatherLeft(MemBlock &output, uint32_t start, MemvBlock &left,
+                                    const vector<uint32_t> &positions) {
+            GatherRows(left, positions.data(), positions.size(), output, start, left_fields_);
+        }
+
         ColumnBuilder::ColumnBuilder(initializer_list<int32_t> fields)
                 : JoinBuilder(fields, false, true) {}
 
@@ -202,6 +214,18 @@ namespace lqf {
     using namespace join;
     using namespace hashcontainer;
 
+    /// Report the strategy chosen from the build side statistics
+    void logStrategy(const string &name, const KeyStat &stat) {
+#ifdef LQF_JOIN_PLAN
+        if (stat.strategy_ == JS_PREBUILT) {
+            cout << "Join " << name << ": use prebuilt container" << endl;
+        } else {
+            cout << "Join " << name << ": " << stat.count_ << " rows, keys [" << stat.min_ << ", " << stat.max_
+                 << "], about " << stat.distinct_ << " distinct, use " << strategyName(stat.strategy_) << endl;
+        }
+#endif
+    }
+
     Join::Join() : Node(2) {}
 
     unique_ptr<NodeOutput> Join::execute(const vector<NodeOutput *> &inputs) {
@@ -222,7 +246,9 @@ namespace lqf {
         builder_->on(left, right);
         builder_->init();
 
-        container_ = HashBuilder::buildContainer(right, rightKeyIndex_, builder_->snapshoter(), expect_size_);
+        container_ = HashBuilder::buildContainer(right, rightKeyIndex_, builder_->snapshoter(), expect_size_,
+                                                 &stat_);
+        logStrategy(name_, stat_);
 
         function<shared_ptr<Block>(const shared_ptr<Block> &)> prober = bind(&HashBasedJoin::probe, this, _1);
         return makeTable(left.blocks()->map(prober));
@@ -286,6 +312,20 @@ namespace lqf {
                     DataRow &right = result ? *result : MemDataRow::EMPTY;
                     rowBuilder_->build((*writer)[counter++], leftrow, right, leftval);
                 }
+            } else if (rowBuilder_->batchable(*leftBlock)) {
+                // Copy the right fields by row, then gather the left columns of all matches at once
+                vector<uint32_t> positions;
+                for (uint32_t i = 0; i < left_block_size; ++i) {
+                    DataField &key = leftkeys->next();
+                    auto leftval = key.asInt();
+                    auto result = container_->get(leftval);
+                    if (result) {
+                        positions.push_back(leftkeys->pos());
+                        rowBuilder_->buildRight((*writer)[counter++], *result, leftval);
+                    }
+                }
+                rowBuilder_->gatherLeft(static_cast<MemBlock &>(*resultblock), 0,
+                                        static_cast<MemvBlock &>(*leftBlock), positions);
             } else {
                 for (uint32_t i = 0; i < left_block_size; ++i) {
                     DataField &key = leftkeys->next();
@@ -319,7 +359,8 @@ namespace lqf {
         if (useBitmap_) {
             predicate_ = HashBuilder::buildBitmapPredicate(right, rightKeyIndex_, expect_size_);
         } else {
-            predicate_ = HashBuilder::buildHashPredicate(right, rightKeyIndex_, expect_size_);
+            predicate_ = HashBuilder::buildPredicate(right, rightKeyIndex_, &stat_, expect_size_);
+            logStrategy(name_, stat_);
         }
 
         function<shared_ptr<Block>(const shared_ptr<Block> &)> prober = bind(&FilterJoin::probe, this, _1);
@@ -403,7 +444,9 @@ namespace lqf {
         builder_->on(left, right);
         builder_->init();
 
-        container_ = HashBuilder::buildContainer(right, rightKeyIndex_, builder_->snapshoter());
+        container_ = HashBuilder::buildContainer(right, rightKeyIndex_, builder_->snapshoter(), expect_size_,
+                                                 &stat_);
+        logStrategy(name_, stat_);
 
         if (predicate_) {
             auto memTable = MemTable::Make(builder_->outputColSize(), builder_->useVertical());
@@ -486,7 +529,9 @@ namespace lqf {
         builder_->on(left, right);
         builder_->init();
 
-        container_ = HashBuilder::buildContainer(right, rightKeyIndex_, builder_->snapshoter());
+        container_ = HashBuilder::buildContainer(right, rightKeyIndex_, builder_->snapshoter(), expect_size_,
+                                                 &stat_);
+        logStrategy(name_, stat_);
 
         auto memTable = MemTable::Make(builder_->outputColSize(), builder_->useVertical());
 
@@ -550,17 +595,11 @@ namespace lqf {
             : HashBasedJoin(leftKeyIndex, rightKeyIndex, builder, expect_size), need_filter_(need_filter),
               columnBuilder_(builder) {}
 
-    shared_ptr<Block> HashColumnJoin::probe(const shared_ptr<Block> &leftBlock) {
-        shared_ptr<MemvBlock> leftvBlock = dynamic_pointer_cast<MemvBlock>(leftBlock);
-        /// Make sure the cast is valid
-        assert(leftvBlock.get() != nullptr);
-
-        auto leftkeys = leftBlock->col(leftKeyIndex_);
-
-        MemvBlock vblock(leftBlock->size(), columnBuilder_->rightColSize());
+    shared_ptr<Bitmap> HashColumnJoin::probeRight(Block &leftBlock, MemvBlock &vblock) {
+        auto leftkeys = leftBlock.col(leftKeyIndex_);
         auto writer = vblock.rows();
 
-        auto left_block_size = leftBlock->size();
+        auto left_block_size = leftBlock.size();
 
         shared_ptr<Bitmap> filter;
         if (need_filter_) {
@@ -600,6 +639,17 @@ namespace lqf {
             }
         }
         writer->close();
+        return filter;
+    }
+
+    shared_ptr<Block> HashColumnJoin::probe(const shared_ptr<Block> &leftBlock) {
+        shared_ptr<MemvBlock> leftvBlock = dynamic_pointer_cast<MemvBlock>(leftBlock);
+        /// Make sure the cast is valid
+        assert(leftvBlock.get() != nullptr);
+
+        MemvBlock vblock(leftBlock->size(), columnBuilder_->rightColSize());
+        auto filter = probeRight(*leftBlock, vblock);
+
         auto newblock = makeBlock(0);
         // Merge result block with original block
         auto newvblock = static_pointer_cast<MemvBlock>(newblock);
@@ -664,20 +714,66 @@ namespace lqf {
     HashMultiJoin::HashMultiJoin(uint32_t lk, uint32_t rk, RowBuilder *rbuilder)
             : left_key_index_(lk), right_key_index_(rk), builder_(unique_ptr<RowBuilder>(rbuilder)) {}
 
-    void HashMultiJoin::buildmap(const shared_ptr<Block> &block) {
-        auto block_size = block->size();
-        auto rows = block->rows();
-        for (uint32_t i = 0; i < block_size; ++i) {
-            DataRow &row = rows->next();
-            auto key = row[right_key_index_].asInt();
-            auto snapshot = (*builder_->snapshoter())(row);
-            auto found = container_.find(key);
-            if (found != container_.cend()) {
-                found->second->emplace_back(move(snapshot));
-            } else {
-                auto newentry = unique_ptr<vector<unique_ptr<MemDataRow>>>(new vector<unique_ptr<MemDataRow>>());
-                newentry->emplace_back(move(snapshot));
-                container_[key] = move(newentry);
+    void HashMultiJoin::buildmap(Table &right) {
+        auto stream = right.blocks();
+        auto parallel = stream->isParallel();
+        auto blocks = stream->collect();
+
+        vector<uint32_t> block_start(blocks->size() + 1, 0);
+        for (auto i = 0u; i < blocks->size(); ++i) {
+            block_start[i + 1] = block_start[i] + (*blocks)[i]->size();
+        }
+        auto num_rows = block_start.back();
+
+        auto snapshoter = builder_->snapshoter();
+        auto &col_offset = snapshoter->colOffset();
+        row_size_ = col_offset.back();
+        keys_.resize(num_rows);
+        content_.resize(static_cast<uint64_t>(num_rows) * row_size_);
+        auto num_buckets = ceil2(std::max(num_rows, 1u));
+        bucket_mask_ = num_buckets - 1;
+        bucket_start_.assign(num_buckets + 1, 0);
+        index_.resize(num_rows);
+
+        auto block_ids = IntStream::Make(0, blocks->size());
+        auto block_stream = parallel ? block_ids->parallel() : block_ids->sequential();
+
+        // Copy the rows and count the bucket sizes
+        block_stream->foreach([this, &blocks, &block_start, snapshoter, &col_offset](const int32_t &block_id) {
+            auto &block = (*blocks)[block_id];
+            auto rows = block->rows();
+            auto block_size = block->size();
+            MemDataRowPointer writeto(col_offset);
+            auto bucket_count = bucket_start_.data() + 1;
+            for (uint32_t i = 0; i < block_size; ++i) {
+                DataRow &row = rows->next();
+                auto index = block_start[block_id] + i;
+                auto key = row[right_key_index_].asInt();
+                keys_[index] = key;
+                writeto.raw(content_.data() + static_cast<uint64_t>(index) * row_size_);
+                (*snapshoter)(writeto, row);
+                __sync_fetch_and_add(bucket_count + (knuth_hash(key) & bucket_mask_), 1);
+            }
+        });
+        for (auto i = 0u; i < num_buckets; ++i) {
+            bucket_start_[i + 1] += bucket_start_[i];
+        }
+
+        // Place the row indices into the bucket ranges
+        vector<uint32_t> bucket_cursor(bucket_start_.begin(), bucket_start_.end() - 1);
+        block_ids = IntStream::Make(0, blocks->size());
+        block_stream = parallel ? block_ids->parallel() : block_ids->sequential();
+        block_stream->foreach([this, &block_start, &bucket_cursor](const int32_t &block_id) {
+            auto cursor = bucket_cursor.data();
+            for (auto index = block_start[block_id]; index < block_start[block_id + 1]; ++index) {
+                auto pos = __sync_fetch_and_add(cursor + (knuth_hash(keys_[index]) & bucket_mask_), 1);
+                index_[pos] = index;
+            }
+        });
+        // Keep the rows of a key in input order
+        for (auto i = 0u; i < num_buckets; ++i) {
+            if (bucket_start_[i + 1] - bucket_start_[i] > 1) {
+                std::sort(index_.begin() + bucket_start_[i], index_.begin() + bucket_start_[i + 1]);
             }
         }
     }
@@ -686,8 +782,7 @@ namespace lqf {
         builder_->on(left, right);
         builder_->init();
 
-        function<void(const shared_ptr<Block> &)> build_map = bind(&HashMultiJoin::buildmap, this, _1);
-        right.blocks()->sequential()->foreach(build_map);
+        buildmap(right);
 
         function<shared_ptr<Block>(const shared_ptr<Block> &)> prober = bind(&HashMultiJoin::probe, this, _1);
 
@@ -700,15 +795,18 @@ namespace lqf {
         auto block_size = left_block->size();
 
         auto output_block = make_shared<MemFlexBlock>(builder_->outputColOffset());
+        MemDataRowPointer right_row(builder_->snapshoter()->colOffset());
 
         for (uint32_t i = 0; i < block_size; ++i) {
             auto key = leftkeys->next().asInt();
-            auto found = container_.find(key);
-            if (found != container_.cend()) {
-                DataRow &left_row = (*leftrows)[leftkeys->pos()];
-                auto &exists = found->second;
-                for (auto &right_row: *exists) {
-                    builder_->build(output_block->push_back(), left_row, *right_row, key);
+            auto bucket = knuth_hash(key) & bucket_mask_;
+            auto end = bucket_start_[bucket + 1];
+            for (auto pos = bucket_start_[bucket]; pos < end; ++pos) {
+                auto index = index_[pos];
+                if (keys_[index] == key) {
+                    DataRow &left_row = (*leftrows)[leftkeys->pos()];
+                    right_row.raw(content_.data() + static_cast<uint64_t>(index) * row_size_);
+                    builder_->build(output_block->push_back(), left_row, right_row, key);
                 }
             }
         }
@@ -859,4 +957,140 @@ namespace lqf {
         }
 
     }
+
+    namespace compositejoin {
+
+        CompositeHashBasedJoin::CompositeHashBasedJoin(const vector<KeyField> &left_key,
+                                                       const vector<KeyField> &right_key,
+                                                       JoinBuilder *builder, uint32_t expect_size)
+                : left_key_(left_key), right_key_(right_key), builder_(unique_ptr<JoinBuilder>(builder)),
+                  expect_size_(expect_size) {
+            if (!left_key_.compatible(right_key_)) {
+                throw std::invalid_argument("join keys have different types");
+            }
+            if (builder_->needKey()) {
+                throw std::invalid_argument("composite key cannot be written to the output");
+            }
+        }
+
+        shared_ptr<Table> CompositeHashBasedJoin::join(Table &left, Table &right) {
+            builder_->on(left, right);
+            builder_->init();
+            container_ = HashBuilder::buildContainer(right, right_key_, builder_->snapshoter(), expect_size_);
+            function<shared_ptr<Block>(const shared_ptr<Block> &)> prober = bind(&CompositeHashBasedJoin::probe,
+                                                                                 this, _1);
+            return make_shared<TableView>(builder_->useVertical() ? OTHER : RAW, builder_->outputColSize(),
+                                          left.blocks()->map(prober));
+        }
+
+        shared_ptr<Block> CompositeHashBasedJoin::makeBlock(uint32_t size) {
+            if (builder_->useVertical())
+                return make_shared<MemvBlock>(size, builder_->outputColSize());
+            else
+                return make_shared<MemBlock>(size, builder_->outputColOffset());
+        }
+
+        CompositeHashJoin::CompositeHashJoin(const vector<KeyField> &left_key, const vector<KeyField> &right_key,
+                                             RowBuilder *rowBuilder, function<bool(DataRow &, DataRow &)> pred,
+                                             uint32_t expect_size)
+                : CompositeHashBasedJoin(left_key, right_key, rowBuilder, expect_size),
+                  rowBuilder_(rowBuilder), predicate_(pred) {}
+
+        shared_ptr<Block> CompositeHashJoin::probe(const shared_ptr<Block> &leftBlock) {
+            auto resultblock = makeBlock(leftBlock->size());
+
+            vector<uint32_t> hashes;
+            left_key_.hash(*leftBlock, hashes);
+
+            auto leftrows = leftBlock->rows();
+            uint32_t counter = 0;
+            auto writer = resultblock->rows();
+            auto left_block_size = leftBlock->size();
+            for (uint32_t i = 0; i < left_block_size; ++i) {
+                DataRow &leftrow = leftrows->next();
+                auto result = container_->get(left_key_, leftrow, hashes[i]);
+                if (result) {
+                    if (!predicate_ || predicate_(leftrow, *result)) {
+                        rowBuilder_->build((*writer)[counter++], leftrow, *result, 0);
+                    }
+                } else if (outer_) {
+                    if (!predicate_ || predicate_(leftrow, MemDataRow::EMPTY)) {
+                        rowBuilder_->build((*writer)[counter++], leftrow, MemDataRow::EMPTY, 0);
+                    }
+                }
+            }
+            resultblock->resize(counter);
+            return resultblock;
+        }
+
+        CompositeHashColumnJoin::CompositeHashColumnJoin(const vector<KeyField> &left_key,
+                                                         const vector<KeyField> &right_key,
+                                                         ColumnBuilder *colBuilder, uint32_t expect_size)
+                : CompositeHashBasedJoin(left_key, right_key, colBuilder, expect_size),
+                  columnBuilder_(colBuilder) {}
+
+        shared_ptr<Block> CompositeHashColumnJoin::probe(const shared_ptr<Block> &leftBlock) {
+            shared_ptr<MemvBlock> leftvBlock = dynamic_pointer_cast<MemvBlock>(leftBlock);
+            /// Make sure the cast is valid
+            assert(leftvBlock.get() != nullptr);
+
+            vector<uint32_t> hashes;
+            left_key_.hash(*leftBlock, hashes);
+
+            auto leftrows = leftBlock->rows();
+            auto left_block_size = leftBlock->size();
+            MemvBlock vblock(left_block_size, columnBuilder_->rightColSize());
+            auto missing = make_shared<SimpleBitmap>(left_block_size);
+            auto writer = vblock.rows();
+            for (uint32_t i = 0; i < left_block_size; ++i) {
+                DataRow &leftrow = leftrows->next();
+                auto result = container_->get(left_key_, leftrow, hashes[i]);
+                if (result) {
+                    (*writer)[i] = *result;
+                } else {
+                    missing->put(i);
+                }
+            }
+            writer->close();
+
+            auto newvblock = static_pointer_cast<MemvBlock>(makeBlock(0));
+            columnBuilder_->build(*newvblock, *leftvBlock, vblock);
+            if (outer_ || missing->isEmpty()) {
+                return newvblock;
+            }
+            return newvblock->mask(~(*missing));
+        }
+
+        CompositeHashFilterJoin::CompositeHashFilterJoin(const vector<KeyField> &left_key,
+                                                         const vector<KeyField> &right_key, uint32_t expect_size)
+                : left_key_(left_key), right_key_(right_key), expect_size_(expect_size) {
+            if (!left_key_.compatible(right_key_)) {
+                throw std::invalid_argument("join keys have different types");
+            }
+        }
+
+        shared_ptr<Block> CompositeHashFilterJoin::probe(const shared_ptr<Block> &leftBlock) {
+            vector<uint32_t> hashes;
+            left_key_.hash(*leftBlock, hashes);
+
+            auto bitmap = make_shared<SimpleBitmap>(leftBlock->limit());
+            auto rows = leftBlock->rows();
+            auto left_block_size = leftBlock->size();
+            for (uint32_t i = 0; i < left_block_size; ++i) {
+                DataRow &row = rows->next();
+                if (container_->test(left_key_, row, hashes[i]) != anti_) {
+                    bitmap->put(rows->pos());
+                }
+            }
+            return leftBlock->mask(bitmap);
+        }
+
+        shared_ptr<Table> CompositeHashFilterJoin::join(Table &left, Table &right) {
+            container_ = HashBuilder::buildContainer(right, right_key_, nullptr, expect_size_);
+
+            function<shared_ptr<Block>(const shared_ptr<Block> &)> prober = bind(&CompositeHashFilterJoin::probe,
+                                                                                 this, _1);
+            return make_shared<TableView>(left.type(), left.colSize(), left.blocks()->map(prober));
+        }
+    }
 }
@@ -67,6 +67,8 @@ namespace lqf {
 
             inline bool useVertical() { return vertical_; }
 
+            inline bool needKey() { return needkey_; }
+
             inline vector<uint32_t> &outputColSize() { return output_col_size_; }
 
             inline vector<uint32_t> &outputColOffset() { return output_col_offset_; }
@@ -78,6 +80,9 @@ namespace lqf {
         protected:
             unique_ptr<function<void(DataRow &, DataRow &)>> left_copier_;
             unique_ptr<function<void(DataRow &, DataRow &)>> right_copier_;
+            // Left columns and their output fields, for batch copy from a columnar left block
+            vector<pair<uint32_t, uint32_t>> left_fields_;
+            bool batch_left_;
 
         public:
             RowBuilder(initializer_list<int32_t>, bool needkey = false, bool vertical = false);
@@ -87,6 +92,20 @@ namespace lqf {
             virtual void init() override;
 
             virtual void build(DataRow &, DataRow &, DataRow &, int32_t key);
+
+            /// Whether gatherLeft can copy the left fields of the block as columns
+            inline bool batchable(Block &left) { return batch_left_ && dynamic_cast<MemvBlock *>(&left); }
+
+            /// Build the key and right fields only, leaving the left fields to gatherLeft
+            inline void buildRight(DataRow &output, DataRow &right, int32_t key) {
+                if (needkey_) {
+                    output[0] = key;
+                }
+                (*right_copier_)(output, right);
+            }
+
+            /// Copy the left fields of the rows at positions to consecutive output rows from start
+            void gatherLeft(MemBlock &output, uint32_t start, MemvBlock &left, const vector<uint32_t> &positions);
         };
 
         /// For use with VJoin
@@ -142,9 +161,10 @@ namespace lqf {
         uint32_t leftKeyIndex_;
         uint32_t rightKeyIndex_;
         unique_ptr<JoinBuilder> builder_;
-        shared_ptr<Hash32Container> container_;
+        shared_ptr<Int32Container> container_;
         bool outer_ = false;
         uint32_t expect_size_;
+        KeyStat stat_;
     public:
         HashBasedJoin(uint32_t leftKeyIndex, uint32_t rightKeyIndex,
                       JoinBuilder *builder, uint32_t expect_size = CONTAINER_SIZE);
@@ -154,6 +174,9 @@ namespace lqf {
         virtual shared_ptr<Table> join(Table &left, Table &right) override;
 
         inline void useOuter() { outer_ = true; };
+
+        /// Build side statistics and the container chosen from them
+        inline const KeyStat &stat() { return stat_; }
     protected:
         virtual shared_ptr<Block> probe(const shared_ptr<Block> &leftBlock) = 0;
 
@@ -176,6 +199,10 @@ namespace lqf {
         virtual shared_ptr<Block> probe(const shared_ptr<Block> &) override;
     };
 
+    /**
+     * Unless useBitmap is given, FilterJoin chooses between a bitmap and a hash predicate
+     * after the build side is materialized, according to its key range and distinct count.
+     */
     class FilterJoin : public Join {
     protected:
         uint32_t leftKeyIndex_;
@@ -184,6 +211,7 @@ namespace lqf {
         shared_ptr<Int32Predicate> predicate_;
         bool anti_ = false;
         bool useBitmap_;
+        KeyStat stat_;
     public:
         FilterJoin(uint32_t leftKeyIndex, uint32_t rightKeyIndex, uint32_t expect_size = CONTAINER_SIZE,
                    bool useBitmap = false);
@@ -194,6 +222,9 @@ namespace lqf {
 
         void useAnti() { anti_ = true; }
 
+        /// Build side statistics and the predicate chosen from them
+        inline const KeyStat &stat() { return stat_; }
+
     protected:
         virtual shared_ptr<Block> probe(const shared_ptr<Block> &);
     };
@@ -282,6 +313,9 @@ namespace lqf {
 
         ColumnBuilder *columnBuilder_;
 
+        /// Write the matching right rows to the block, returning the unmatched rows if filtering
+        shared_ptr<Bitmap> probeRight(Block &, MemvBlock &);
+
         shared_ptr<Block> probe(const shared_ptr<Block> &) override;
     };
 
@@ -301,15 +335,26 @@ namespace lqf {
 
     /**
      * Build a hash table on multiple entries with same key
+     *
+     * The table is built in parallel by count-then-place. The right rows are copied
+     * into one contiguous array in input order, the rows of each hash bucket are counted,
+     * and the row indices are then placed into the bucket ranges of an index array.
      */
     class HashMultiJoin : public Join {
     protected:
         uint32_t left_key_index_;
         uint32_t right_key_index_;
         unique_ptr<RowBuilder> builder_;
-        unordered_map<int32_t, unique_ptr<vector<unique_ptr<MemDataRow>>>> container_;
 
-        void buildmap(const shared_ptr<Block> &);
+        uint32_t row_size_;
+        vector<int32_t> keys_;
+        vector<uint64_t> content_;
+        uint32_t bucket_mask_;
+        // Bucket i holds the row indices index_[bucket_start_[i]] to index_[bucket_start_[i + 1] - 1]
+        vector<uint32_t> bucket_start_;
+        vector<uint32_t> index_;
+
+        void buildmap(Table &);
 
         shared_ptr<Block> probe(const shared_ptr<Block> &);
 
@@ -390,5 +435,88 @@ namespace lqf {
             shared_ptr<Block> probe(const shared_ptr<Block> &leftBlock);
         };
     }
+
+    /**
+     * Joins on keys made of multiple columns. The keys are hashed column by column and
+     * compared in full when hashes match, so they do not need to be packed into an integer.
+     * The left and right key specifications must have the same field types in the same order.
+     * There is no single key to write to the output, so builders with needkey are rejected.
+     */
+    namespace compositejoin {
+
+        class CompositeHashBasedJoin : public Join {
+        protected:
+            CompositeKey left_key_;
+            CompositeKey right_key_;
+            unique_ptr<JoinBuilder> builder_;
+            shared_ptr<HashCompositeContainer> container_;
+            uint32_t expect_size_;
+            bool outer_ = false;
+        public:
+            CompositeHashBasedJoin(const vector<KeyField> &, const vector<KeyField> &, JoinBuilder *,
+                                   uint32_t expect_size = CONTAINER_SIZE);
+
+            virtual ~CompositeHashBasedJoin() = default;
+
+            virtual shared_ptr<Table> join(Table &left, Table &right) override;
+
+            inline void useOuter() { outer_ = true; }
+
+        protected:
+            virtual shared_ptr<Block> probe(const shared_ptr<Block> &) = 0;
+
+            shared_ptr<Block> makeBlock(uint32_t);
+        };
+
+        class CompositeHashJoin : public CompositeHashBasedJoin {
+        public:
+            CompositeHashJoin(const vector<KeyField> &, const vector<KeyField> &, RowBuilder *,
+                              function<bool(DataRow &, DataRow &)> pred = nullptr,
+                              uint32_t expect_size = CONTAINER_SIZE);
+
+            virtual ~CompositeHashJoin() = default;
+
+        protected:
+            RowBuilder *rowBuilder_;
+            function<bool(DataRow &, DataRow &)> predicate_;
+
+            shared_ptr<Block> probe(const shared_ptr<Block> &) override;
+        };
+
+        /// Rows without a match are masked out, or kept with empty right fields in an outer join
+        class CompositeHashColumnJoin : public CompositeHashBasedJoin {
+        public:
+            CompositeHashColumnJoin(const vector<KeyField> &, const vector<KeyField> &, ColumnBuilder *,
+                                    uint32_t expect_size = CONTAINER_SIZE);
+
+            virtual ~CompositeHashColumnJoin() = default;
+
+        protected:
+            ColumnBuilder *columnBuilder_;
+
+            shared_ptr<Block> probe(const shared_ptr<Block> &) override;
+        };
+
+        class CompositeHashFilterJoin : public Join {
+        protected:
+            CompositeKey left_key_;
+            CompositeKey right_key_;
+            shared_ptr<HashCompositeContainer> container_;
+            uint32_t expect_size_;
+            bool anti_ = false;
+        public:
+            CompositeHashFilterJoin(const vector<KeyField> &, const vector<KeyField> &,
+                                    uint32_t expect_size = CONTAINER_SIZE);
+
+            virtual ~CompositeHashFilterJoin() = default;
+
+            virtual shared_ptr<Table> join(Table &left, Table &right) override;
+
+            void useAnti() { anti_ = true; }
+
+        protected:
+            shared_ptr<Block> probe(const shared_ptr<Block> &leftBlock);
+        };
+    }
 }
 #endif //LQF_JOIN_H
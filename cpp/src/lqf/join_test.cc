@@ -843,6 +843,93 @@ TEST(HashJoinTest, WithRawRight) {
     EXPECT_EQ(0, (*rrows)[i][2].asInt());
 }
 
+TEST(HashJoinTest, ChooseStrategy) {
+    auto left = MemTable::Make(2);
+    auto lblock = left->allocate(100);
+    auto lrows = lblock->rows();
+    for (int i = 0; i < 100; ++i) {
+        (*lrows)[i][0] = i * 1000;
+        (*lrows)[i][1] = i;
+    }
+
+    auto dense = MemTable::Make(2);
+    auto dblock = dense->allocate(100);
+    auto drows = dblock->rows();
+    for (int i = 0; i < 100; ++i) {
+        (*drows)[i][0] = i;
+        (*drows)[i][1] = i * 3;
+    }
+    HashJoin dense_join(0, 0, new RowBuilder({JL(1), JR(1)}));
+    auto joined = dense_join.join(*left, *dense);
+    auto blocks = joined->blocks()->collect();
+    EXPECT_EQ(JS_ARRAY, dense_join.stat().strategy_);
+    EXPECT_EQ(1, (*blocks)[0]->size());
+
+    auto sparse = MemTable::Make(2);
+    auto sblock = sparse->allocate(100);
+    auto srows = sblock->rows();
+    for (int i = 0; i < 100; ++i) {
+        (*srows)[i][0] = i * 2000;
+        (*srows)[i][1] = i * 3;
+    }
+    HashJoin sparse_join(0, 0, new RowBuilder({JL(1), JR(1)}));
+    joined = sparse_join.join(*left, *sparse);
+    blocks = joined->blocks()->collect();
+    EXPECT_EQ(JS_HASH, sparse_join.stat().strategy_);
+    EXPECT_EQ(50, (*blocks)[0]->size());
+    auto rows = (*blocks)[0]->rows();
+    for (int i = 0; i < 50; ++i) {
+        DataRow &row = rows->next();
+        EXPECT_EQ(0, row[0].asInt() % 2);
+        EXPECT_EQ(row[0].asInt() * 3 / 2, row[1].asInt());
+    }
+}
+
+TEST(HashJoinTest, WithColumnarLeft) {
+    auto left = MemTable::Make(vector<uint32_t>{1, 1, 2}, true);
+    auto lblock = left->allocate(100);
+    auto lrows = lblock->rows();
+    vector<string> texts;
+    for (int i = 0; i < 100; ++i) {
+        texts.push_back("left" + to_string(i));
+    }
+    for (int i = 0; i < 100; ++i) {
+        ByteArray bytes(texts[i].size(), reinterpret_cast<const uint8_t *>(texts[i].data()));
+        (*lrows)[i][0] = i % 30;
+        (*lrows)[i][1] = i * 1.5;
+        (*lrows)[i][2] = bytes;
+    }
+
+    auto right = MemTable::Make(2);
+    auto rblock = right->allocate(20);
+    auto rrows = rblock->rows();
+    for (int i = 0; i < 20; ++i) {
+        (*rrows)[i][0] = i;
+        (*rrows)[i][1] = i * 7;
+    }
+
+    HashJoin join(0, 0, new RowBuilder({JLS(2), JR(1), JL(1)}, true));
+    auto joined = join.join(*left, *right);
+    auto blocks = joined->blocks()->collect();
+    auto block = (*blocks)[0];
+    ASSERT_TRUE(dynamic_pointer_cast<MemBlock>(block));
+    // Keys 0 to 19 of 30 match
+    EXPECT_EQ(70, block->size());
+    auto rows = block->rows();
+    int counter = 0;
+    for (int i = 0; i < 100; ++i) {
+        if (i % 30 >= 20) {
+            continue;
+        }
+        DataRow &row = (*rows)[counter++];
+        EXPECT_EQ(i % 30, row[0].asInt());
+        EXPECT_EQ(ByteArray(texts[i].size(), reinterpret_cast<const uint8_t *>(texts[i].data())),
+                  row[1].asByteArray());
+        EXPECT_EQ((i % 30) * 7, row[2].asInt());
+        EXPECT_EQ(i * 1.5, row[3].asDouble());
+    }
+}
+
 TEST(HashFilterJoinTest, Join) {
     auto left = ParquetTable::Open("testres/lineitem");
     left->updateColumns((1 << 14) - 1);
@@ -870,6 +957,45 @@ TEST(HashFilterJoinTest, Join) {
     EXPECT_EQ(22, rblock->size());
 }
 
+TEST(HashFilterJoinTest, ChooseStrategy) {
+    auto left = MemTable::Make(1);
+    auto lblock = left->allocate(400);
+    auto lrows = lblock->rows();
+    for (int i = 0; i < 400; ++i) {
+        (*lrows)[i][0] = (i - 100) * 10;
+    }
+
+    // Keys 0, 2, ..., 198 fit in a bitmap
+    auto dense = MemTable::Make(1);
+    auto dblock = dense->allocate(100);
+    auto drows = dblock->rows();
+    for (int i = 0; i < 100; ++i) {
+        (*drows)[i][0] = i * 2;
+    }
+    FilterJoin dense_join(0, 0);
+    auto joined = dense_join.join(*left, *dense);
+    auto blocks = joined->blocks()->collect();
+    EXPECT_EQ(JS_BITMAP, dense_join.stat().strategy_);
+    EXPECT_EQ(100, dense_join.stat().count_);
+    EXPECT_EQ(0, dense_join.stat().min_);
+    EXPECT_EQ(198, dense_join.stat().max_);
+    EXPECT_EQ(20, (*blocks)[0]->size());
+
+    // Keys 0, 100000, ..., 9900000 need a hash predicate
+    auto sparse = MemTable::Make(1);
+    auto sblock = sparse->allocate(100);
+    auto srows = sblock->rows();
+    for (int i = 0; i < 100; ++i) {
+        (*srows)[i][0] = i * 100000;
+    }
+    (*srows)[99][0] = 2000;
+    FilterJoin sparse_join(0, 0);
+    joined = sparse_join.join(*left, *sparse);
+    blocks = joined->blocks()->collect();
+    EXPECT_EQ(JS_HASH, sparse_join.stat().strategy_);
+    EXPECT_EQ(2, (*blocks)[0]->size());
+}
+
 TEST(FilterTransformJoinTest, Join) {
     auto left = ParquetTable::Open("testres/lineitem");
     left->updateColumns((1 << 14) - 1);
@@ -1423,4 +1549,273 @@ TEST(HashMultiJoinTest, Join) {
     EXPECT_EQ(140, row[0].asInt());
     EXPECT_EQ(280, row[1].asInt());
     EXPECT_EQ(9, row[2].asInt());
-}
\ No newline at end of file
+}
+TEST(HashMultiJoinTest, JoinMultiBlock) {
+    auto left = MemTable::Make(2);
+    auto lblock = left->allocate(1000);
+    auto lrows = lblock->rows();
+    for (int i = 0; i < 1000; ++i) {
+        (*lrows)[i][0] = i;
+        (*lrows)[i][1] = i * 2;
+    }
+
+    // Key k appears k % 7 times, spread over the blocks
+    vector<vector<pair<int, int>>> rdata(4);
+    int counter = 0;
+    for (int k = 0; k < 2000; k += 2) {
+        for (int j = 0; j < k % 7; ++j) {
+            rdata[counter++ % 4].push_back({k, k * 10 + j});
+        }
+    }
+    // Rows of a key are expected in input order, i.e., block by block
+    unordered_map<int, vector<int>> expect;
+    auto right = MemTable::Make(2);
+    for (auto &data: rdata) {
+        auto rblock = right->allocate(data.size());
+        auto rrows = rblock->rows();
+        for (auto i = 0u; i < data.size(); ++i) {
+            (*rrows)[i][0] = data[i].first;
+            (*rrows)[i][1] = data[i].second;
+            expect[data[i].first].push_back(data[i].second);
+        }
+    }
+
+    HashMultiJoin join(0, 0, new RowBuilder({JL(1), JR(1)}, true));
+    auto joined = join.join(*left, *right);
+    auto results = joined->blocks()->collect();
+    EXPECT_EQ(1, results->size());
+    auto block = (*results)[0];
+
+    uint32_t expect_size = 0;
+    for (int k = 0; k < 1000; k += 2) {
+        expect_size += k % 7;
+    }
+    EXPECT_EQ(expect_size, block->size());
+    auto rows = block->rows();
+    int prev_key = -1;
+    uint32_t key_counter = 0;
+    for (uint32_t i = 0; i < block->size(); ++i) {
+        DataRow &row = rows->next();
+        auto key = row[0].asInt();
+        EXPECT_EQ(0, key % 2);
+        EXPECT_EQ(key * 2, row[1].asInt());
+        key_counter = key == prev_key ? key_counter + 1 : 0;
+        ASSERT_TRUE(key_counter < expect[key].size());
+        EXPECT_EQ(expect[key][key_counter], row[2].asInt());
+        prev_key = key;
+    }
+}
+
+using namespace lqf::compositejoin;
+
+TEST(CompositeHashJoinTest, Join) {
+    auto left = MemTable::Make(4);
+    auto lblock1 = left->allocate(100);
+    auto lblock2 = left->allocate(100);
+    auto lrows1 = lblock1->rows();
+    auto lrows2 = lblock2->rows();
+    for (int i = 0; i < 100; ++i) {
+        (*lrows1)[i][0] = i % 10;
+        (*lrows1)[i][1] = i / 10;
+        (*lrows1)[i][2] = 3;
+        (*lrows1)[i][3] = i;
+        (*lrows2)[i][0] = i % 10;
+        (*lrows2)[i][1] = i / 10;
+        (*lrows2)[i][2] = 4;
+        (*lrows2)[i][3] = i + 100;
+    }
+
+    auto right = MemTable::Make(4);
+    auto rblock = right->allocate(50);
+    auto rrows = rblock->rows();
+    for (int i = 0; i < 50; ++i) {
+        // Only the keys with first column being even and third column being 3 match
+        (*rrows)[i][0] = i % 5 * 2;
+        (*rrows)[i][1] = i / 5;
+        (*rrows)[i][2] = 3;
+        (*rrows)[i][3] = i * 0.5;
+    }
+
+    CompositeHashJoin join({{0, K_INT}, {1, K_INT}, {2, K_INT}}, {{0, K_INT}, {1, K_INT}, {2, K_INT}},
+                           new RowBuilder({JL(3), JR(3)}));
+    auto joined = join.join(*left, *right);
+    EXPECT_EQ(vector<uint32_t>({1, 1}), joined->colSize());
+
+    auto results = joined->blocks()->collect();
+    EXPECT_EQ(2, results->size());
+    EXPECT_EQ(50, (*results)[0]->size());
+    EXPECT_EQ(0, (*results)[1]->size());
+
+    auto rows = (*results)[0]->rows();
+    for (int i = 0; i < 50; ++i) {
+        DataRow &row = rows->next();
+        auto lid = row[0].asInt();
+        EXPECT_EQ(0, lid % 2);
+        auto rid = lid / 10 * 5 + lid % 10 / 2;
+        EXPECT_EQ(rid * 0.5, row[1].asDouble());
+    }
+}
+
+TEST(CompositeHashJoinTest, JoinOnString) {
+    vector<string> names({"alpha", "beta", "gamma", "delta", "a rather long name over sixteen bytes"});
+
+    auto left = MemTable::Make(vector<uint32_t>({2, 1, 1}));
+    auto lblock = left->allocate(20);
+    auto lrows = lblock->rows();
+    for (int i = 0; i < 20; ++i) {
+        auto &name = names[i % 5];
+        ByteArray value(name.length(), (const uint8_t *) name.data());
+        (*lrows)[i][0] = value;
+        (*lrows)[i][1] = i % 2;
+        (*lrows)[i][2] = i;
+    }
+
+    auto right = MemTable::Make(vector<uint32_t>({1, 2, 1}));
+    auto rblock = right->allocate(6);
+    auto rrows = rblock->rows();
+    for (int i = 0; i < 6; ++i) {
+        // Skip "gamma"
+        auto &name = names[i < 4 ? (i < 2 ? i : i + 1) : i - 4 + 3];
+        ByteArray value(name.length(), (const uint8_t *) name.data());
+        (*rrows)[i][0] = i * 10;
+        (*rrows)[i][1] = value;
+        (*rrows)[i][2] = i < 4 ? 0 : 1;
+    }
+    // Right keys: (alpha,0) (beta,0) (delta,0) (long,0) (delta,1) (long,1)
+
+    CompositeHashJoin join({{0, K_STRING}, {1, K_INT}}, {{1, K_STRING}, {2, K_INT}},
+                           new RowBuilder({JL(2), JR(0)}));
+    auto joined = join.join(*left, *right);
+    auto results = joined->blocks()->collect();
+    EXPECT_EQ(1, results->size());
+    auto block = (*results)[0];
+    // Left (alpha,0) (beta,1) (gamma,0) (delta,1) (long,0) (alpha,1) ...
+    // Matches are i % 5 == 0 && i % 2 == 0, i % 5 == 3, i % 5 == 4 && i % 2 == 0, i % 5 == 1 && i % 2 == 0
+    unordered_map<int, int> expect;
+    for (int i = 0; i < 20; ++i) {
+        auto n = i % 5;
+        auto k = i % 2;
+        if (n == 0 && k == 0) expect[i] = 0;
+        if (n == 1 && k == 0) expect[i] = 10;
+        if (n == 3) expect[i] = k == 0 ? 20 : 40;
+        if (n == 4) expect[i] = k == 0 ? 30 : 50;
+    }
+    EXPECT_EQ(expect.size(), block->size());
+    auto rows = block->rows();
+    for (uint32_t i = 0; i < block->size(); ++i) {
+        DataRow &row = rows->next();
+        auto lid = row[0].asInt();
+        ASSERT_TRUE(expect.find(lid) != expect.end());
+        EXPECT_EQ(expect[lid], row[1].asInt());
+    }
+}
+
+TEST(CompositeHashJoinTest, JoinOnLong) {
+    auto left = MemTable::Make(3);
+    auto lblock = left->allocate(100);
+    auto lrows = lblock->rows();
+    for (int i = 0; i < 100; ++i) {
+        // Keys only differ above 32 bits
+        *(*lrows)[i][0].data() = static_cast<uint64_t>(i % 20) << 32;
+        (*lrows)[i][1] = i % 2;
+        (*lrows)[i][2] = i;
+    }
+    auto right = MemTable::Make(3);
+    auto rblock = right->allocate(10);
+    auto rrows = rblock->rows();
+    for (int i = 0; i < 10; ++i) {
+        *(*rrows)[i][0].data() = static_cast<uint64_t>(i) << 32;
+        (*rrows)[i][1] = i % 2;
+        (*rrows)[i][2] = i * 10;
+    }
+
+    CompositeHashJoin join({{0, K_LONG}, {1, K_INT}}, {{0, K_LONG}, {1, K_INT}}, new RowBuilder({JL(2), JR(2)}));
+    auto joined = join.join(*left, *right);
+    auto block = (*joined->blocks()->collect())[0];
+    // i % 20 < 10 and i % 20 has the same parity as i
+    EXPECT_EQ(50, block->size());
+    auto rows = block->rows();
+    for (uint32_t i = 0; i < block->size(); ++i) {
+        DataRow &row = rows->next();
+        EXPECT_EQ(row[0].asInt() % 20 * 10, row[1].asInt());
+    }
+
+    EXPECT_THROW(CompositeHashJoin({{0, K_LONG}}, {{0, K_LONG}}, new RowBuilder({JL(2), JR(2)}, true)),
+                 std::invalid_argument);
+}
+
+TEST(CompositeHashColumnJoinTest, Join) {
+    auto right = MemTable::Make(3);
+    auto rblock = right->allocate(20);
+    auto rrows = rblock->rows();
+    for (int i = 0; i < 20; ++i) {
+        // Matches the left rows with i % 10 < 4 and i / 10 < 5
+        (*rrows)[i][0] = i % 4;
+        (*rrows)[i][1] = i / 4;
+        (*rrows)[i][2] = i * 0.5;
+    }
+
+    for (auto outer: {false, true}) {
+        // The output takes over the left columns, so each join needs its own input
+        auto left = MemTable::Make(3, true);
+        auto lblock = left->allocate(100);
+        auto lrows = lblock->rows();
+        for (int i = 0; i < 100; ++i) {
+            (*lrows)[i][0] = i % 10;
+            (*lrows)[i][1] = i / 10;
+            (*lrows)[i][2] = i;
+        }
+        CompositeHashColumnJoin join({{0, K_INT}, {1, K_INT}}, {{0, K_INT}, {1, K_INT}},
+                                     new ColumnBuilder({JL(2), JR(2)}));
+        if (outer) {
+            join.useOuter();
+        }
+        auto joined = join.join(*left, *right);
+        auto block = (*joined->blocks()->collect())[0];
+        EXPECT_EQ(outer ? 100 : 20, block->size());
+        auto rows = block->rows();
+        for (uint32_t i = 0; i < block->size(); ++i) {
+            DataRow &row = rows->next();
+            auto lid = row[0].asInt();
+            if (lid % 10 < 4 && lid / 10 < 5) {
+                EXPECT_EQ((lid / 10 * 4 + lid % 10) * 0.5, row[1].asDouble());
+            } else {
+                EXPECT_TRUE(outer);
+                EXPECT_EQ(0, row[1].asDouble());
+            }
+        }
+    }
+}
+
+TEST(CompositeHashFilterJoinTest, Join) {
+    auto left = MemTable::Make(3);
+    auto lblock = left->allocate(100);
+    auto lrows = lblock->rows();
+    for (int i = 0; i < 100; ++i) {
+        (*lrows)[i][0] = i % 10;
+        (*lrows)[i][1] = i / 10 * 0.5;
+        (*lrows)[i][2] = i;
+    }
+
+    auto right = MemTable::Make(2);
+    auto rblock = right->allocate(10);
+    auto rrows = rblock->rows();
+    for (int i = 0; i < 10; ++i) {
+        (*rrows)[i][0] = i;
+        (*rrows)[i][1] = i * 0.5;
+    }
+
+    CompositeHashFilterJoin join({{0, K_INT}, {1, K_DOUBLE}}, {{0, K_INT}, {1, K_DOUBLE}});
+    auto filtered = join.join(*left, *right);
+    auto results = filtered->blocks()->collect();
+    EXPECT_EQ(10, (*results)[0]->size());
+    auto rows = (*results)[0]->rows();
+    for (int i = 0; i < 10; ++i) {
+        EXPECT_EQ(i * 11, rows->next()[2].asInt());
+    }
+
+    CompositeHashFilterJoin antiJoin({{0, K_INT}, {1, K_DOUBLE}}, {{0, K_INT}, {1, K_DOUBLE}});
+    antiJoin.useAnti();
+    auto antiFiltered = antiJoin.join(*left, *right);
+    EXPECT_EQ(90, (*antiFiltered->blocks()->collect())[0]->size());
+}
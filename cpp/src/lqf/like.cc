@@ -0,0 +1,124 @@
+//
+// Created by agent on 10/19/26.
+//
+
+#include <cstring>
+#include <immintrin.h>
+#include "like.h"
+
+namespace lqf {
+
+    Like::Like(const string &pattern) : anchor_start_(pattern.empty() || pattern.front() != '%'),
+                                        anchor_end_(pattern.empty() || pattern.back() != '%'), min_length_(0) {
+        size_t start = 0;
+        while (start <= pattern.size()) {
+            auto stop = pattern.find('%', start);
+            if (stop == string::npos) {
+                stop = pattern.size();
+            }
+            if (stop > start) {
+                segments_.push_back(pattern.substr(start, stop - start));
+                wildcards_.push_back(segments_.back().find('_') != string::npos);
+                min_length_ += stop - start;
+            }
+            start = stop + 1;
+        }
+    }
+
+    bool Like::equals(const uint8_t *data, uint32_t segment) const {
+        auto &seg = segments_[segment];
+        if (!wildcards_[segment]) {
+            return !memcmp(data, seg.data(), seg.size());
+        }
+        for (uint32_t i = 0; i < seg.size(); ++i) {
+            if (seg[i] != '_' && seg[i] != (char) data[i]) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    int64_t Like::find(const uint8_t *text, uint32_t len, uint32_t segment) const {
+        auto &seg = segments_[segment];
+        if (!wildcards_[segment]) {
+            return search(text, len, seg);
+        }
+        for (uint32_t i = 0; i + seg.size() <= len; ++i) {
+            if (equals(text + i, segment)) {
+                return i;
+            }
+        }
+        return -1;
+    }
+
+    bool Like::match(const uint8_t *data, uint32_t len) const {
+        if (len < min_length_) {
+            return false;
+        }
+        uint32_t first = 0;
+        uint32_t last = segments_.size();
+        // No % in the pattern
+        if (anchor_start_ && anchor_end_ && last <= 1) {
+            return len == min_length_ && (last == 0 || equals(data, 0));
+        }
+        uint32_t begin = 0;
+        uint32_t end = len;
+        if (anchor_start_ && first < last) {
+            if (!equals(data, first)) {
+                return false;
+            }
+            begin = segments_[first++].size();
+        }
+        if (anchor_end_ && first < last) {
+            end = len - segments_[--last].size();
+            if (!equals(data + end, last)) {
+                return false;
+            }
+        }
+        for (uint32_t i = first; i < last; ++i) {
+            auto pos = find(data + begin, end - begin, i);
+            if (pos < 0) {
+                return false;
+            }
+            begin += pos + segments_[i].size();
+        }
+        return true;
+    }
+
+    int64_t Like::search(const uint8_t *text, uint32_t len, const string &needle) {
+        uint32_t k = needle.size();
+        if (k == 0) {
+            return 0;
+        }
+        if (k > len) {
+            return -1;
+        }
+        auto pattern = reinterpret_cast<const uint8_t *>(needle.data());
+        if (k == 1) {
+            auto found = (const uint8_t *) memchr(text, pattern[0], len);
+            return found ? found - text : -1;
+        }
+        auto first = _mm256_set1_epi8(pattern[0]);
+        auto last = _mm256_set1_epi8(pattern[k - 1]);
+        uint32_t i = 0;
+        for (; i + k - 1 + 32 <= len; i += 32) {
+            auto block_first = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(text + i));
+            auto block_last = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(text + i + k - 1));
+            uint32_t mask = _mm256_movemask_epi8(_mm256_and_si256(_mm256_cmpeq_epi8(first, block_first),
+                                                                  _mm256_cmpeq_epi8(last, block_last)));
+            while (mask) {
+                auto bit = __builtin_ctz(mask);
+                if (!memcmp(text + i + bit + 1, pattern + 1, k - 2)) {
+                    return i + bit;
+                }
+                mask &= mask - 1;
+            }
+        }
+        for (; i + k <= len; ++i) {
+            if (text[i] == pattern[0] && !memcmp(text + i, pattern, k)) {
+                return i;
+            }
+        }
+        return -1;
+    }
+}
@@ -0,0 +1,60 @@
+//
+// Created by agent on 10/19/26.
+//
+
+#ifndef LQF_LIKE_H
+#define LQF_LIKE_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <parquet/types.h>
+
+namespace lqf {
+    using namespace std;
+
+    /**
+     * SQL LIKE pattern on byte strings, where % matches any sequence and _ matches one byte.
+     * The pattern is split at % into segments. The first segment is matched at the start and
+     * the last one at the end, unless the pattern starts or ends with %. The segments between
+     * them are searched left to right with a SIMD substring search.
+     */
+    class Like {
+    protected:
+        bool anchor_start_;
+        bool anchor_end_;
+        vector<string> segments_;
+        // Segments containing _
+        vector<bool> wildcards_;
+        uint32_t min_length_;
+
+        bool equals(const uint8_t *data, uint32_t segment) const;
+
+        int64_t find(const uint8_t *text, uint32_t len, uint32_t segment) const;
+
+    public:
+        Like(const string &pattern);
+
+        bool match(const uint8_t *data, uint32_t len) const;
+
+        inline bool match(const parquet::ByteArray &value) const {
+            return match(value.ptr, value.len);
+        }
+
+        /// The pattern is a literal followed by a single %
+        inline bool prefixOnly() const {
+            return anchor_start_ && !anchor_end_ && segments_.size() == 1
+                   && segments_[0].find('_') == string::npos;
+        }
+
+        inline const vector<string> &segments() const { return segments_; }
+
+        /**
+         * First position of needle in text, or -1 if it is absent. Candidate positions are
+         * filtered 32 at a time by comparing the first and the last byte of the needle.
+         */
+        static int64_t search(const uint8_t *text, uint32_t len, const string &needle);
+    };
+}
+
+#endif //LQF_LIKE_H
@@ -0,0 +1,70 @@
+//
+// Created by agent on 10/19/26.
+//
+
+#include <gtest/gtest.h>
+#include "like.h"
+
+using namespace lqf;
+
+TEST(LikeTest, Match) {
+    Like brass("%BRASS");
+    EXPECT_TRUE(brass.match(parquet::ByteArray("LARGE POLISHED BRASS")));
+    EXPECT_TRUE(brass.match(parquet::ByteArray("BRASS")));
+    EXPECT_FALSE(brass.match(parquet::ByteArray("BRASS TIN")));
+
+    Like promo("PROMO%");
+    EXPECT_TRUE(promo.prefixOnly());
+    EXPECT_TRUE(promo.match(parquet::ByteArray("PROMO BURNISHED COPPER")));
+    EXPECT_FALSE(promo.match(parquet::ByteArray("PROM")));
+    EXPECT_FALSE(promo.match(parquet::ByteArray("SMALL PROMO")));
+
+    Like green("%green%");
+    EXPECT_FALSE(green.prefixOnly());
+    EXPECT_TRUE(green.match(parquet::ByteArray("forest green")));
+    EXPECT_TRUE(green.match(parquet::ByteArray("greenish")));
+    EXPECT_FALSE(green.match(parquet::ByteArray("gree n")));
+
+    // Segments are matched in order and do not overlap
+    Like requests("%special%requests%");
+    EXPECT_TRUE(requests.match(parquet::ByteArray("the special pending requests sleep")));
+    EXPECT_FALSE(requests.match(parquet::ByteArray("requests are special")));
+    Like overlap("ab%ba");
+    EXPECT_TRUE(overlap.match(parquet::ByteArray("abba")));
+    EXPECT_FALSE(overlap.match(parquet::ByteArray("aba")));
+
+    Like exact("MAIL");
+    EXPECT_TRUE(exact.match(parquet::ByteArray("MAIL")));
+    EXPECT_FALSE(exact.match(parquet::ByteArray("MAILS")));
+
+    Like single("A_R%");
+    EXPECT_TRUE(single.match(parquet::ByteArray("AIR")));
+    EXPECT_TRUE(single.match(parquet::ByteArray("AIR REG")));
+    EXPECT_FALSE(single.match(parquet::ByteArray("AR")));
+    Like middle("%R_G%");
+    EXPECT_TRUE(middle.match(parquet::ByteArray("AIR REG")));
+    EXPECT_FALSE(middle.match(parquet::ByteArray("AIR")));
+
+    Like any("%");
+    EXPECT_TRUE(any.match(parquet::ByteArray("")));
+    EXPECT_TRUE(any.match(parquet::ByteArray("anything")));
+}
+
+TEST(LikeTest, Search) {
+    string text;
+    for (int i = 0; i < 200; ++i) {
+        text += (char) ('a' + i % 7);
+    }
+    text += "needle";
+    for (int i = 0; i < 50; ++i) {
+        text += 'x';
+    }
+    auto data = reinterpret_cast<const uint8_t *>(text.data());
+    for (uint32_t len = 0; len <= text.size(); len += 13) {
+        for (const string needle: {"needle", "cde", "gab", "e", "xxxx", "needles"}) {
+            auto expected = text.substr(0, len).find(needle);
+            EXPECT_EQ(expected == string::npos ? -1 : (int64_t) expected, Like::search(data, len, needle))
+                                << needle << " " << len;
+        }
+    }
+}
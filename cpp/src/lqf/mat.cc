@@ -45,7 +45,7 @@ namespace lqf {
             // Make Container
             auto table = MemTable::Make(offset2size(snapshoter_->colOffset()));
             auto container = HashBuilder::buildContainer(input, key_index_, snapshoter_.get(), expect_size_);
-            auto block = make_shared<HashMemBlock<Hash32Container>>(move(container));
+            auto block = make_shared<HashMemBlock<Int32Container>>(move(container));
             table->append(block);
             return table;
         } else {
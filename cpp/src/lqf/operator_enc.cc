@@ -4,7 +4,12 @@
 
 #include "operator_enc.h"
 #include <sboost/unpacker.h>
+#include <sboost/sboost.h>
+#include <sboost/bitmap_writer.h>
+#include <sboost/encoding/rlehybrid.h>
+#include <algorithm>
 #include <immintrin.h>
+#include <stdexcept>
 #ifdef LQF_STAT
 #include "stat.h"
 #endif
@@ -49,39 +54,454 @@ namespace lqf {
         template
         class EncHashTJoin<Hash32MapPageContainer>;
 
-        EncMemBetweenPredicate::EncMemBetweenPredicate(uint32_t index, int32_t from, int32_t to)
-                : ColPredicate(index), from_(from), to_(to) {}
+        EncHashColumnJoin::EncHashColumnJoin(uint32_t l, uint32_t r, ColumnBuilder *cb,
+                                             initializer_list<parquet::Type::type> right_type,
+                                             initializer_list<encoding::EncodingType> right_enc,
+                                             bool need_filter, uint32_t expect_size)
+                : HashColumnJoin(l, r, cb, need_filter, expect_size), right_types_(right_type),
+                  right_encs_(right_enc) {}
+
+        shared_ptr<Block> EncHashColumnJoin::probe(const shared_ptr<Block> &leftBlock) {
+            auto encBlock = dynamic_pointer_cast<EncMemvBlock>(leftBlock);
+            if (!encBlock) {
+                return HashColumnJoin::probe(leftBlock);
+            }
+            auto &left_inst = columnBuilder_->leftMergeInst();
+            auto &right_inst = columnBuilder_->rightMergeInst();
+            if (right_inst.size() != right_types_.size() || right_inst.size() != right_encs_.size()) {
+                throw invalid_argument("Encoding types should be given for each right column");
+            }
+
+            MemvBlock vblock(leftBlock->size(), columnBuilder_->rightColSize());
+            auto filter = probeRight(*leftBlock, vblock);
+
+            auto num_fields = left_inst.size() + right_inst.size();
+            vector<parquet::Type::type> types(num_fields);
+            vector<encoding::EncodingType> encs(num_fields);
+            for (auto &inst: left_inst) {
+                types[inst.second] = encBlock->dataTypes()[inst.first];
+                encs[inst.second] = encBlock->encodingTypes()[inst.first];
+            }
+            for (auto &inst: right_inst) {
+                types[inst.second] = right_types_[inst.first];
+                encs[inst.second] = right_encs_[inst.first];
+            }
+            auto output = make_shared<EncMemvBlock>(types, encs);
+            for (auto &inst: left_inst) {
+                output->share(*encBlock, inst.first, inst.second);
+            }
+            for (auto &inst: right_inst) {
+                output->encode(vblock, inst.first, inst.second);
+            }
+            output->resize(leftBlock->size());
+#ifdef LQF_STAT
+            lqf::stat::MemEstimator::INST.Record("EncHashColumnJoin", output->memrss());
+#endif
+            if (need_filter_) {
+                return output->mask(~(*filter));
+            }
+            return output;
+        }
+
+        /// Decode the codes of a column if it is a DICTIONARY column of an encoded block, maybe masked.
+        /// Codes are indexed by the row positions in the encoded block
+        bool decodeCodes(Block &block, uint32_t index, vector<int32_t> &codes) {
+            auto masked = dynamic_cast<MaskedBlock *>(&block);
+            auto encblock = dynamic_cast<EncMemvBlock *>(masked ? masked->inner().get() : &block);
+            if (!encblock || encblock->encodingTypes()[index] != encoding::DICTIONARY || !encblock->rawcol(index)) {
+                return false;
+            }
+            codes.resize(encblock->size());
+            encoding::DecodeDictCodes(*encblock->rawcol(index), codes.data());
+            return true;
+        }
+
+        EncHashCore::EncHashCore(uint32_t key_index, const vector<uint32_t> &col_offset,
+                                 function<unique_ptr<agg::AggReducer>()> reducer_gen,
+                                 function<uint64_t(DataRow &)> &hasher,
+                                 function<void(DataRow &, DataRow &)> *row_copier, bool need_dump)
+                : HashCore(col_offset, reducer_gen, hasher, row_copier, need_dump), key_index_(key_index) {}
+
+        void EncHashCore::reduce(Block &block) {
+            auto rows = block.rows();
+            uint64_t block_size = block.size();
+            vector<int32_t> codes;
+            if (!decodeCodes(block, key_index_, codes)) {
+                for (uint64_t i = 0; i < block_size; ++i) {
+                    HashCore::reduce(rows->next());
+                }
+                return;
+            }
+            // The group of each code, found by its first row
+            vector<agg::AggReducer *> groups;
+            for (uint64_t i = 0; i < block_size; ++i) {
+                DataRow &row = rows->next();
+                uint32_t code = codes[rows->pos()];
+                if (code >= groups.size()) {
+                    groups.resize(code + 1, nullptr);
+                }
+                auto group = groups[code];
+                if (group) {
+                    group->reduce(row);
+                    continue;
+                }
+                auto key = hasher_(row);
+                auto found = map_.find(key);
+                if (found != map_.end()) {
+                    found->second->reduce(row);
+                    groups[code] = found->second.get();
+                } else {
+                    DataRow &newstorage = rows_.push_back();
+                    auto reducer = reducer_gen_();
+                    reducer->attach(newstorage.raw());
+                    reducer->init(row);
+                    groups[code] = reducer.get();
+                    map_[key] = move(reducer);
+                }
+            }
+        }
+
+        EncHashAgg::EncHashAgg(uint32_t key_index, function<uint64_t(DataRow &)> hasher,
+                               unique_ptr<Snapshoter> header_copier, function<vector<agg::AggField *>()> fields_gen,
+                               function<bool(DataRow &)> pred, bool vertical)
+                : HashAgg(hasher, move(header_copier), fields_gen, pred, vertical), key_index_(key_index) {}
+
+        shared_ptr<agg::HashCore> EncHashAgg::processBlock(const shared_ptr<Block> &block) {
+            function<unique_ptr<agg::AggReducer>()> rc = [this]() { return createReducer(); };
+            auto core = make_shared<EncHashCore>(key_index_, col_offset_, rc, hasher_, row_copier_.get(),
+                                                 need_field_dump_);
+            core->reduce(*block);
+            return core;
+        }
+
+        EncSnapshotSort::EncSnapshotSort(uint32_t key_index, bool desc, const vector<uint32_t> col_size,
+                                         function<bool(DataRow *, DataRow *)> comp,
+                                         function<unique_ptr<MemDataRow>(DataRow &)> snapshoter, bool vertical)
+                : SnapshotSort(col_size, comp, snapshoter, vertical), key_index_(key_index), desc_(desc) {}
+
+        shared_ptr<vector<DataRow *>> EncSnapshotSort::sortBlock(const shared_ptr<Block> &block) {
+            auto rows = block->rows();
+            uint64_t block_size = block->size();
+            vector<DataRow *> snapshots;
+            vector<uint64_t> positions;
+            snapshots.reserve(block_size);
+            positions.reserve(block_size);
+            for (uint64_t i = 0; i < block_size; ++i) {
+                snapshots.push_back(snapshoter_(rows->next()).release());
+                positions.push_back(rows->pos());
+            }
+            vector<int32_t> codes;
+            if (!decodeCodes(*block, key_index_, codes)) {
+                auto run = make_shared<vector<DataRow *>>(move(snapshots));
+                std::sort(run->begin(), run->end(), comparator_);
+                return run;
+            }
+            // Count the rows of each code, and place them in the order of codes
+            int32_t num_codes = 0;
+            for (auto pos: positions) {
+                num_codes = std::max(num_codes, codes[pos] + 1);
+            }
+            auto rank = [this, &codes, num_codes](uint64_t pos) {
+                return desc_ ? num_codes - 1 - codes[pos] : codes[pos];
+            };
+            vector<uint32_t> starts(num_codes + 1, 0);
+            for (auto pos: positions) {
+                ++starts[rank(pos) + 1];
+            }
+            for (int32_t i = 0; i < num_codes; ++i) {
+                starts[i + 1] += starts[i];
+            }
+            auto run = make_shared<vector<DataRow *>>(block_size);
+            for (uint64_t i = 0; i < block_size; ++i) {
+                (*run)[starts[rank(positions[i])]++] = snapshots[i];
+            }
+            // Each start is now the end of its code. Rows of equal codes are ordered by the comparator
+            uint32_t begin = 0;
+            for (int32_t i = 0; i < num_codes; ++i) {
+                if (starts[i] - begin > 1) {
+                    std::sort(run->begin() + begin, run->begin() + starts[i], comparator_);
+                }
+                begin = starts[i];
+            }
+            return run;
+        }
+
+        shared_ptr<Table> EncSnapshotSort::sort(Table &input) {
+            auto stream = input.blocks();
+            auto parallel = stream->isParallel();
+            auto blocks = stream->collect();
+            function<shared_ptr<vector<DataRow *>>(const shared_ptr<Block> &)> sort_block =
+                    [this](const shared_ptr<Block> &block) { return sortBlock(block); };
+            auto block_stream = unique_ptr<Stream<shared_ptr<Block>>>(new VectorStream<shared_ptr<Block>>(*blocks));
+            auto runs = (parallel ? block_stream->parallel() : block_stream->sequential())->map(sort_block)->collect();
+            auto memblock = make_shared<SortBlock>();
+            MergeRuns(*runs, memblock->content(), comparator_, parallel);
+            auto resultTable = MemTable::Make(col_size_, vertical_);
+            resultTable->append(memblock);
+            return resultTable;
+        }
 
-        shared_ptr<Bitmap> EncMemBetweenPredicate::filterBlock(Block &block, Bitmap &prev) {
-            auto emvblock = dynamic_cast<EncMemvBlock *>(&block);
-            auto block_size = emvblock->size();
-            auto bitmap = make_shared<SimpleBitmap>(block_size);
+        template<typename DTYPE>
+        EncPredicate<DTYPE>::EncPredicate(uint32_t index) : ColPredicate(index) {}
 
-            auto coldata = emvblock->rawcol(index_);
+        template<typename DTYPE>
+        bool EncPredicate<DTYPE>::test(const T &value) {
+            for (auto &range: ranges_) {
+                if (range.has_lower && (range.lower_open ? !(range.lower < value) : value < range.lower)) {
+                    continue;
+                }
+                if (range.has_upper && (range.upper_open ? !(value < range.upper) : range.upper < value)) {
+                    continue;
+                }
+                return true;
+            }
+            return false;
+        }
 
-            auto dictbuffer = (*coldata)[coldata->size() - 1];
+        template<typename DTYPE>
+        void readDictionary(Buffer &dictblock, vector<typename DTYPE::c_type> &entries) {
+            auto view = reinterpret_cast<const typename DTYPE::c_type *>(dictblock.data());
+            entries.assign(view, view + dictblock.size() / sizeof(typename DTYPE::c_type));
+        }
 
-            Int32Dictionary dict(dictbuffer->mutable_data(), dictbuffer->size() >> 3);
-            auto rawFrom = dict.lookup(from_);
-            if (rawFrom < 0) {
-                rawFrom = -rawFrom;
+        template<>
+        void readDictionary<ByteArrayType>(Buffer &dictblock, vector<ByteArray> &entries) {
+            auto header = reinterpret_cast<const uint32_t *>(dictblock.data());
+            auto num_entry = header[0];
+            auto bytes = dictblock.data() + sizeof(uint32_t) * (num_entry + 2);
+            entries.resize(num_entry);
+            for (uint32_t i = 0; i < num_entry; ++i) {
+                entries[i] = ByteArray(header[i + 2] - header[i + 1], bytes + header[i + 1]);
             }
-            auto rawTo = dict.lookup(to_);
-            if (rawTo < 0) {
-                rawTo = -rawTo;
+        }
+
+        template<typename DTYPE>
+        void EncPredicate<DTYPE>::filterBitpack(vector<shared_ptr<Buffer>> &blocks, SimpleBitmap &bitmap,
+                                                const Range &range) {
+            if constexpr (is_same<DTYPE, Int32Type>::value) {
+                uint32_t offset = 0;
+                for (auto &block: blocks) {
+                    auto header = block->data();
+                    auto num_entry = reinterpret_cast<const int32_t *>(header)[0];
+                    int64_t min = reinterpret_cast<const int32_t *>(header)[1];
+                    uint32_t bit_width = header[8];
+                    auto data = header + 9;
+                    // Offsets of the range from the block minimum
+                    int64_t max_offset = (1ll << bit_width) - 1;
+                    int64_t lower = range.has_lower ? (int64_t) range.lower + range.lower_open - min : 0;
+                    int64_t upper = range.has_upper ? (int64_t) range.upper - range.upper_open - min : max_offset;
+                    lower = std::max<int64_t>(lower, 0);
+                    upper = std::min<int64_t>(upper, max_offset);
+                    if (lower > upper) {
+                        // No value in the block
+                    } else if (lower == 0 && upper == max_offset) {
+                        ::sboost::BitmapWriter(bitmap.raw(), offset).appendBits(1, num_entry);
+                    } else if (lower == upper) {
+                        ::sboost::Bitpack(bit_width, lower).equal(data, num_entry, bitmap.raw(), offset);
+                    } else if (lower == 0) {
+                        ::sboost::Bitpack(bit_width, upper).leq(data, num_entry, bitmap.raw(), offset);
+                    } else if (upper == max_offset) {
+                        ::sboost::Bitpack(bit_width, lower).geq(data, num_entry, bitmap.raw(), offset);
+                    } else {
+                        ::sboost::Bitpack(bit_width, lower, upper).between(data, num_entry, bitmap.raw(), offset);
+                    }
+                    offset += num_entry;
+                }
             }
+        }
 
-            uint64_t counter = 0;
-            for (uint32_t i = 0; i < coldata->size() - 1; ++i) {
-                auto buffer_block = (*coldata)[i];
-                auto block_buffer = buffer_block->data();
-                auto bit_width = block_buffer[0];
-                auto num_entry = ((uint32_t *) (block_buffer + 1))[0];
-                auto data_begin = block_buffer + 5;
-                ::sboost::encoding::rlehybrid::between(data_begin, bitmap->raw(), counter, bit_width, num_entry,
-                                                       rawFrom, rawTo);
+        template<typename DTYPE>
+        void EncPredicate<DTYPE>::filterDict(vector<shared_ptr<Buffer>> &blocks, SimpleBitmap &bitmap,
+                                             uint32_t lower, uint32_t upper) {
+            uint32_t offset = 0;
+            // The last one is dictionary
+            for (uint32_t i = 0; i < blocks.size() - 1; ++i) {
+                auto header = blocks[i]->data();
+                uint32_t bit_width = header[0];
+                auto num_entry = reinterpret_cast<const uint32_t *>(header + 1)[0];
+                auto data = header + 5;
+                if (lower == upper) {
+                    ::sboost::encoding::rlehybrid::equal(data, bitmap.raw(), offset, bit_width, num_entry, lower);
+                } else if (lower == 0) {
+                    ::sboost::encoding::rlehybrid::less(data, bitmap.raw(), offset, bit_width, num_entry,
+                                                        upper + 1);
+                } else {
+                    ::sboost::encoding::rlehybrid::between(data, bitmap.raw(), offset, bit_width, num_entry,
+                                                           lower, upper);
+                }
+                offset += num_entry;
+            }
+        }
+
+        template<typename DTYPE>
+        void EncPredicate<DTYPE>::filterDelta(vector<shared_ptr<Buffer>> &blocks, SimpleBitmap &bitmap,
+                                              const Range &range) {
+            if constexpr (is_same<DTYPE, Int32Type>::value) {
+                int64_t lower = range.has_lower ? (int64_t) range.lower + range.lower_open : INT64_MIN;
+                int64_t upper = range.has_upper ? (int64_t) range.upper - range.upper_open : INT64_MAX;
+                auto lower_512 = _mm512_set1_epi32(std::max<int64_t>(lower, INT32_MIN));
+                auto upper_512 = _mm512_set1_epi32(std::min<int64_t>(upper, INT32_MAX));
+                vector<int32_t> buffer;
+                auto raw = bitmap.raw();
+                uint32_t offset = 0;
+                for (auto &block: blocks) {
+                    auto header = reinterpret_cast<const encoding::DeltaHeader *>(block->data());
+                    auto num_entry = header->num_entry_;
+                    if (header->max_ < lower || header->min_ > upper) {
+                        // No value in the block
+                    } else if (lower <= header->min_ && header->max_ <= upper) {
+                        ::sboost::BitmapWriter(raw, offset).appendBits(1, num_entry);
+                    } else {
+                        buffer.resize(std::max<size_t>(buffer.size(), (num_entry + 15) & ~15u));
+                        encoding::DecodeDelta(block->data(), buffer.data());
+                        for (uint32_t i = 0; i < num_entry; i += 16) {
+                            auto loaded = _mm512_loadu_si512(buffer.data() + i);
+                            uint64_t res = _mm512_cmp_epi32_mask(loaded, lower_512, _MM_CMPINT_NLT)
+                                           & _mm512_cmp_epi32_mask(loaded, upper_512, _MM_CMPINT_LE);
+                            if (i + 16 > num_entry) {
+                                res &= (1ull << (num_entry - i)) - 1;
+                            }
+                            auto pos = offset + i;
+                            raw[pos >> 6] |= res << (pos & 63);
+                            if ((pos & 63) > 48) {
+                                raw[(pos >> 6) + 1] |= res >> (64 - (pos & 63));
+                            }
+                        }
+                    }
+                    offset += num_entry;
+                }
+            }
+        }
+
+        template<typename DTYPE>
+        void EncPredicate<DTYPE>::filterDecode(Block &block, SimpleBitmap &bitmap) {
+            auto ite = block.col(index_);
+            auto block_size = block.size();
+            for (uint64_t i = 0; i < block_size; ++i) {
+                if (test(*reinterpret_cast<T *>(ite->next().data()))) {
+                    bitmap.put(ite->pos());
+                }
+            }
+        }
+
+        template<typename DTYPE>
+        shared_ptr<Bitmap> EncPredicate<DTYPE>::filterBlock(Block &block, Bitmap &prev) {
+            auto result = make_shared<SimpleBitmap>(block.limit());
+            auto encblock = dynamic_cast<EncMemvBlock *>(&block);
+            if (encblock == nullptr || encblock->rawcol(index_) == nullptr) {
+                filterDecode(block, *result);
+                return prev & *result;
+            }
+            if (encblock->dataTypes()[index_] != DTYPE::type_num) {
+                throw invalid_argument("Predicate type does not match the column");
+            }
+            auto &coldata = *encblock->rawcol(index_);
+            // Each range after the first is evaluated in a separate bitmap, as the kernels write whole
+            // words of the bitmap for long runs
+            auto evaluate = [this, &result, &block](function<void(SimpleBitmap &)> kernel, bool first) {
+                if (first) {
+                    kernel(*result);
+                } else {
+                    SimpleBitmap another(block.limit());
+                    kernel(another);
+                    *result | another;
+                }
+            };
+            switch (encblock->encodingTypes()[index_]) {
+                case encoding::DICTIONARY: {
+                    vector<T> entries;
+                    readDictionary<DTYPE>(*coldata.back(), entries);
+                    // Translate the ranges to disjoint code ranges over the sorted dictionary
+                    vector<pair<uint32_t, uint32_t>> codes;
+                    for (auto &range: ranges_) {
+                        auto lower = !range.has_lower ? entries.begin() :
+                                     range.lower_open ? upper_bound(entries.begin(), entries.end(), range.lower)
+                                                      : lower_bound(entries.begin(), entries.end(), range.lower);
+                        auto upper = !range.has_upper ? entries.end() :
+                                     range.upper_open ? lower_bound(entries.begin(), entries.end(), range.upper)
+                                                      : upper_bound(entries.begin(), entries.end(), range.upper);
+                        if (lower < upper) {
+                            codes.emplace_back(lower - entries.begin(), upper - entries.begin());
+                        }
+                    }
+                    std::sort(codes.begin(), codes.end());
+                    uint32_t merged = 0;
+                    for (uint32_t i = 1; i < codes.size(); ++i) {
+                        if (codes[i].first <= codes[merged].second) {
+                            codes[merged].second = std::max(codes[merged].second, codes[i].second);
+                        } else {
+                            codes[++merged] = codes[i];
+                        }
+                    }
+                    codes.resize(std::min<uint32_t>(codes.size(), merged + 1));
+                    if (codes.size() == 1 && codes[0].first == 0 && codes[0].second == entries.size()) {
+                        return prev.shared_from_this();
+                    }
+                    for (uint32_t i = 0; i < codes.size(); ++i) {
+                        evaluate([this, &coldata, &codes, i](SimpleBitmap &bitmap) {
+                            filterDict(coldata, bitmap, codes[i].first, codes[i].second - 1);
+                        }, i == 0);
+                    }
+                    break;
+                }
+                case encoding::DELTA:
+                    for (uint32_t i = 0; i < ranges_.size(); ++i) {
+                        evaluate([this, &coldata, i](SimpleBitmap &bitmap) {
+                            filterDelta(coldata, bitmap, ranges_[i]);
+                        }, i == 0);
+                    }
+                    break;
+                case encoding::BITPACK:
+                    if (is_same<DTYPE, Int32Type>::value) {
+                        for (uint32_t i = 0; i < ranges_.size(); ++i) {
+                            evaluate([this, &coldata, i](SimpleBitmap &bitmap) {
+                                filterBitpack(coldata, bitmap, ranges_[i]);
+                            }, i == 0);
+                        }
+                        break;
+                    }
+                    // Other types are bit-packed in 64-bit words
+                default:
+                    filterDecode(block, *result);
+                    break;
+            }
+            return prev & *result;
+        }
+
+        template<typename DTYPE>
+        EncEq<DTYPE>::EncEq(uint32_t index, const typename DTYPE::c_type &target) : EncPredicate<DTYPE>(index) {
+            this->ranges_.push_back({target, target, true, true, false, false});
+        }
+
+        template<typename DTYPE>
+        EncLess<DTYPE>::EncLess(uint32_t index, const typename DTYPE::c_type &target) : EncPredicate<DTYPE>(index) {
+            this->ranges_.push_back({target, target, false, true, false, true});
+        }
+
+        template<typename DTYPE>
+        EncGreater<DTYPE>::EncGreater(uint32_t index, const typename DTYPE::c_type &target)
+                : EncPredicate<DTYPE>(index) {
+            this->ranges_.push_back({target, target, true, false, true, false});
+        }
+
+        template<typename DTYPE>
+        EncBetween<DTYPE>::EncBetween(uint32_t index, const typename DTYPE::c_type &lower,
+                                      const typename DTYPE::c_type &upper) : EncPredicate<DTYPE>(index) {
+            this->ranges_.push_back({lower, upper, true, true, false, false});
+        }
+
+        template<typename DTYPE>
+        EncRangele<DTYPE>::EncRangele(uint32_t index, const typename DTYPE::c_type &lower,
+                                      const typename DTYPE::c_type &upper) : EncPredicate<DTYPE>(index) {
+            this->ranges_.push_back({lower, upper, true, true, false, true});
+        }
+
+        template<typename DTYPE>
+        EncIn<DTYPE>::EncIn(uint32_t index, const vector<typename DTYPE::c_type> &targets)
+                : EncPredicate<DTYPE>(index) {
+            for (auto &target: targets) {
+                this->ranges_.push_back({target, target, true, true, false, false});
             }
-            return prev & *bitmap;
         }
 
         EncMatBetweenFilter::EncMatBetweenFilter(initializer_list<parquet::Type::type> types,
@@ -172,5 +592,89 @@ namespace lqf {
 #endif
             return outputblock;
         }
+
+        template
+        class EncPredicate<Int32Type>;
+
+        template
+        class EncPredicate<Int64Type>;
+
+        template
+        class EncPredicate<DoubleType>;
+
+        template
+        class EncPredicate<ByteArrayType>;
+
+        template
+        class EncEq<Int32Type>;
+
+        template
+        class EncEq<Int64Type>;
+
+        template
+        class EncEq<DoubleType>;
+
+        template
+        class EncEq<ByteArrayType>;
+
+        template
+        class EncLess<Int32Type>;
+
+        template
+        class EncLess<Int64Type>;
+
+        template
+        class EncLess<DoubleType>;
+
+        template
+        class EncLess<ByteArrayType>;
+
+        template
+        class EncGreater<Int32Type>;
+
+        template
+        class EncGreater<Int64Type>;
+
+        template
+        class EncGreater<DoubleType>;
+
+        template
+        class EncGreater<ByteArrayType>;
+
+        template
+        class EncBetween<Int32Type>;
+
+        template
+        class EncBetween<Int64Type>;
+
+        template
+        class EncBetween<DoubleType>;
+
+        template
+        class EncBetween<ByteArrayType>;
+
+        template
+        class EncRangele<Int32Type>;
+
+        template
+        class EncRangele<Int64Type>;
+
+        template
+        class EncRangele<DoubleType>;
+
+        template
+        class EncRangele<ByteArrayType>;
+
+        template
+        class EncIn<Int32Type>;
+
+        template
+        class EncIn<Int64Type>;
+
+        template
+        class EncIn<DoubleType>;
+
+        template
+        class EncIn<ByteArrayType>;
     }
-}
\ No newline at end of file
+}
@@ -9,6 +9,8 @@
 #include "join.h"
 #include "filter.h"
 #include "tjoin.h"
+#include "agg.h"
+#include "sort.h"
 #include "encoding.h"
 #include "data_model_enc.h"
 
@@ -47,19 +49,159 @@ namespace lqf {
         };
 
         /**
-         * A predicate using SBoost to filter encoded intermediate results
-         * TODO For now hard-code to support dictionary encoding
+         * A HashColumnJoin on encoded left blocks. The left columns are shared with the output
+         * without decoding, and the right columns are encoded with the given types.
          */
-        class EncMemBetweenPredicate : public ColPredicate {
+        class EncHashColumnJoin : public HashColumnJoin {
         protected:
-            int32_t from_;
-            int32_t to_;
+            vector<parquet::Type::type> right_types_;
+            vector<encoding::EncodingType> right_encs_;
+
+            shared_ptr<Block> probe(const shared_ptr<Block> &) override;
+
+        public:
+            EncHashColumnJoin(uint32_t, uint32_t, ColumnBuilder *,
+                              initializer_list<parquet::Type::type> right_type,
+                              initializer_list<encoding::EncodingType> right_enc,
+                              bool need_filter = false, uint32_t expect_size = CONTAINER_SIZE);
+        };
+
+        /**
+         * A HashCore grouping the rows of an EncMemvBlock by the dictionary codes of its key column.
+         * Only the first row of a code is hashed to find its group, and the other rows of the code
+         * share the group without decoding the key. Other blocks are reduced row by row.
+         */
+        class EncHashCore : public agg::HashCore {
+        protected:
+            uint32_t key_index_;
         public:
-            EncMemBetweenPredicate(uint32_t index, int32_t from, int32_t to);
+            EncHashCore(uint32_t key_index, const vector<uint32_t> &, function<unique_ptr<agg::AggReducer>()>,
+                        function<uint64_t(DataRow &)> &, function<void(DataRow &, DataRow &)> *, bool);
 
-            virtual shared_ptr<Bitmap> filterBlock(Block &, Bitmap &) override;
+            using HashCore::reduce;
+
+            void reduce(Block &block);
         };
 
+        /**
+         * A HashAgg on EncMemvBlocks with a DICTIONARY key column. The hasher should read
+         * only the key column. Inputs with many groups take the partitioned path of HashAgg.
+         */
+        class EncHashAgg : public HashAgg {
+        protected:
+            uint32_t key_index_;
+
+            shared_ptr<agg::HashCore> processBlock(const shared_ptr<Block> &block) override;
+
+        public:
+            EncHashAgg(uint32_t key_index, function<uint64_t(DataRow &)>, unique_ptr<Snapshoter>,
+                       function<vector<agg::AggField *>()>, function<bool(DataRow &)> pred = nullptr,
+                       bool vertical = false);
+        };
+
+        /**
+         * A SnapshotSort ordering each EncMemvBlock by the dictionary codes of its key column with
+         * a counting sort, as the sorted dictionary keeps the order of values. Only rows of equal
+         * codes are compared, and the sorted blocks are merged by the comparator. The comparator
+         * should rank the rows by the key column first.
+         */
+        class EncSnapshotSort : public SnapshotSort {
+        protected:
+            uint32_t key_index_;
+            bool desc_;
+
+            shared_ptr<vector<DataRow *>> sortBlock(const shared_ptr<Block> &block);
+
+        public:
+            EncSnapshotSort(uint32_t key_index, bool desc, const vector<uint32_t>,
+                            function<bool(DataRow *, DataRow *)>, function<unique_ptr<MemDataRow>(DataRow &)>,
+                            bool vertical = false);
+
+            shared_ptr<Table> sort(Table &) override;
+        };
+
+        /**
+         * Predicates on the encoded columns of EncMemvBlock, the counterpart of sboost::SboostPredicate
+         * for intermediate results. A predicate is a list of value ranges. On a BITPACK block the ranges
+         * are shifted by the block minimum, and on a DICTIONARY block they are translated to codes over
+         * the sorted dictionary, so the SBoost kernels run on the packed data without decoding it.
+         * A DELTA block is accepted or skipped by its value range, and only a block crossing a bound
+         * is decoded. Columns in other encodings are decoded and compared value by value.
+         */
+        template<typename DTYPE>
+        class EncPredicate : public ColPredicate {
+        protected:
+            using T = typename DTYPE::c_type;
+
+            struct Range {
+                T lower;
+                T upper;
+                bool has_lower;
+                bool has_upper;
+                bool lower_open;
+                bool upper_open;
+            };
+
+            vector<Range> ranges_;
+
+            bool test(const T &);
+
+            void filterBitpack(vector<shared_ptr<Buffer>> &, SimpleBitmap &, const Range &);
+
+            void filterDict(vector<shared_ptr<Buffer>> &, SimpleBitmap &, uint32_t, uint32_t);
+
+            void filterDelta(vector<shared_ptr<Buffer>> &, SimpleBitmap &, const Range &);
+
+            void filterDecode(Block &, SimpleBitmap &);
+
+        public:
+            EncPredicate(uint32_t index);
+
+            virtual ~EncPredicate() = default;
+
+            shared_ptr<Bitmap> filterBlock(Block &, Bitmap &) override;
+        };
+
+        template<typename DTYPE>
+        class EncEq : public EncPredicate<DTYPE> {
+        public:
+            EncEq(uint32_t index, const typename DTYPE::c_type &target);
+        };
+
+        template<typename DTYPE>
+        class EncLess : public EncPredicate<DTYPE> {
+        public:
+            EncLess(uint32_t index, const typename DTYPE::c_type &target);
+        };
+
+        template<typename DTYPE>
+        class EncGreater : public EncPredicate<DTYPE> {
+        public:
+            EncGreater(uint32_t index, const typename DTYPE::c_type &target);
+        };
+
+        /// lower <= value <= upper
+        template<typename DTYPE>
+        class EncBetween : public EncPredicate<DTYPE> {
+        public:
+            EncBetween(uint32_t index, const typename DTYPE::c_type &lower, const typename DTYPE::c_type &upper);
+        };
+
+        /// lower <= value < upper
+        template<typename DTYPE>
+        class EncRangele : public EncPredicate<DTYPE> {
+        public:
+            EncRangele(uint32_t index, const typename DTYPE::c_type &lower, const typename DTYPE::c_type &upper);
+        };
+
+        template<typename DTYPE>
+        class EncIn : public EncPredicate<DTYPE> {
+        public:
+            EncIn(uint32_t index, const vector<typename DTYPE::c_type> &targets);
+        };
+
+        using EncMemBetweenPredicate = EncBetween<Int32Type>;
+
         /**
          * A filter that checks and filter bit-packed columns without delaying
          */
@@ -4,8 +4,12 @@
 
 #include <gtest/gtest.h>
 #include <iostream>
+#include <atomic>
+#include <map>
 #include "operator_enc.h"
 #include "data_model.h"
+#include "agg.h"
+#include "sort.h"
 
 using namespace std;
 using namespace lqf;
@@ -47,4 +51,295 @@ TEST(EncMatBetweenFilter, Filter) {
         ASSERT_EQ(row[0].asInt(), i / 4 * 10 + val);
     }
 
-}
\ No newline at end of file
+}
+TEST(EncHashColumnJoin, JoinAggSort) {
+    auto left = MemTable::Make(3, true);
+    auto block = make_shared<EncMemvBlock>(
+            vector<parquet::Type::type>{parquet::Type::type::INT32, parquet::Type::type::DOUBLE,
+                                        parquet::Type::type::INT32},
+            vector<EncodingType>{EncodingType::BITPACK, EncodingType::DICTIONARY, EncodingType::PLAIN});
+    auto writer = block->rows();
+    for (int i = 0; i < 1000; i++) {
+        DataRow &row = writer->next();
+        row[0] = i % 40;
+        row[1] = (i % 8) * 0.5;
+        row[2] = i;
+    }
+    writer->close();
+    left->append(block);
+
+    auto right = MemTable::Make(2);
+    auto rblock = right->allocate(30);
+    auto rrows = rblock->rows();
+    for (int i = 0; i < 30; ++i) {
+        (*rrows)[i][0] = i;
+        (*rrows)[i][1] = i * 100;
+    }
+
+    EncHashColumnJoin join(0, 0, new ColumnBuilder({JL(0), JL(1), JR(1)}),
+                           {parquet::Type::type::INT32}, {EncodingType::BITPACK}, true);
+    auto joined = join.join(*left, *right);
+
+    // Aggregate and sort the encoded join output through its row iterator.
+    // Keys from 30 to 39 have no match.
+    function<vector<AggField *>()> aggFields = []() {
+        return vector<AggField *>{new DoubleSum(1), new IntSum(2), new Count()};
+    };
+    HashAgg agg([](DataRow &row) { return row[0].asInt(); },
+                RowCopyFactory().field(F_REGULAR, 0, 0)->buildSnapshot(), aggFields);
+    auto agged = agg.agg(*joined);
+
+    vector<uint32_t> col_offset{0, 1, 2, 3, 4};
+    SnapshotSort sort(lqf::colSize(4), [](DataRow *a, DataRow *b) { return SILE(0); },
+                      [&col_offset](DataRow &row) {
+                          auto snapshot = new MemDataRow(col_offset);
+                          (*snapshot) = row;
+                          return unique_ptr<MemDataRow>(snapshot);
+                      });
+    auto sorted = sort.sort(*agged);
+    auto sortedBlock = (*sorted->blocks()->collect())[0];
+    EXPECT_EQ(30, sortedBlock->size());
+    auto rows = sortedBlock->rows();
+    for (int key = 0; key < 30; ++key) {
+        DataRow &row = rows->next();
+        // 25 rows per key, the values of column 1 cycle with i % 8
+        double sum = 0;
+        for (int i = key; i < 1000; i += 40) {
+            sum += (i % 8) * 0.5;
+        }
+        EXPECT_EQ(key, row[0].asInt());
+        EXPECT_EQ(sum, row[1].asDouble());
+        EXPECT_EQ(key * 100 * 25, row[2].asInt());
+        EXPECT_EQ(25, row[3].asInt());
+    }
+}
+
+// Two blocks with a DICTIONARY key column in runs, the second masked to the rows not divisible by 3
+shared_ptr<MemTable> makeDictKeyTable(vector<pair<int, int>> &rows) {
+    auto table = MemTable::Make(2);
+    for (int b = 0; b < 2; ++b) {
+        auto block = make_shared<EncMemvBlock>(
+                initializer_list<parquet::Type::type>{parquet::Type::type::INT32, parquet::Type::type::INT32},
+                initializer_list<EncodingType>{EncodingType::DICTIONARY, EncodingType::PLAIN});
+        auto writer = block->rows();
+        auto mask = make_shared<SimpleBitmap>(3000);
+        for (int i = 0; i < 3000; i++) {
+            DataRow &row = writer->next();
+            row[0] = (i / 7) % 13 * 10;
+            row[1] = i + b;
+            if (b == 0 || i % 3 != 0) {
+                mask->put(i);
+                rows.emplace_back((i / 7) % 13 * 10, i + b);
+            }
+        }
+        writer->close();
+        if (b == 0) {
+            table->append(block);
+        } else {
+            table->append(block->mask(mask));
+        }
+    }
+    return table;
+}
+
+TEST(EncHashAgg, DictKey) {
+    vector<pair<int, int>> rows;
+    auto table = makeDictKeyTable(rows);
+    std::map<int, pair<int, int>> expect;
+    for (auto &row: rows) {
+        expect[row.first].first += row.second;
+        expect[row.first].second += 1;
+    }
+
+    atomic<int> hashed(0);
+    function<vector<AggField *>()> aggFields = []() {
+        return vector<AggField *>{new IntSum(1), new Count()};
+    };
+    EncHashAgg agg(0, [&hashed](DataRow &row) {
+        ++hashed;
+        return row[0].asInt();
+    }, RowCopyFactory().field(F_REGULAR, 0, 0)->buildSnapshot(), aggFields);
+    auto agged = agg.agg(*table);
+    // The first block is sampled to estimate the groups, then each block hashes the first row of a code
+    EXPECT_EQ(3000 + 2 * 13, hashed.load());
+
+    EXPECT_EQ(13, agged->size());
+    auto blocks = agged->blocks()->collect();
+    for (auto &block: *blocks) {
+        auto agged_rows = block->rows();
+        for (uint32_t i = 0; i < block->size(); ++i) {
+            DataRow &row = agged_rows->next();
+            auto &group = expect[row[0].asInt()];
+            EXPECT_EQ(group.first, row[1].asInt());
+            EXPECT_EQ(group.second, row[2].asInt());
+        }
+    }
+}
+
+TEST(EncSnapshotSort, DictKey) {
+    vector<pair<int, int>> rows;
+    auto table = makeDictKeyTable(rows);
+    vector<uint32_t> col_offset{0, 1, 2};
+    auto snapshoter = [&col_offset](DataRow &row) {
+        auto snapshot = new MemDataRow(col_offset);
+        (*snapshot) = row;
+        return unique_ptr<MemDataRow>(snapshot);
+    };
+
+    auto check = [&table](SnapshotSort &sort, vector<pair<int, int>> &expect) {
+        auto sorted = sort.sort(*table);
+        auto sortedBlock = (*sorted->blocks()->collect())[0];
+        ASSERT_EQ(expect.size(), sortedBlock->size());
+        auto sorted_rows = sortedBlock->rows();
+        for (auto &row: expect) {
+            DataRow &next = sorted_rows->next();
+            ASSERT_EQ(row.first, next[0].asInt());
+            ASSERT_EQ(row.second, next[1].asInt());
+        }
+    };
+
+    // Key ascending, ties by the value descending
+    EncSnapshotSort asc(0, false, lqf::colSize(2), [](DataRow *a, DataRow *b) {
+        return SILE(0) || (SIE(0) && SIGE(1));
+    }, snapshoter);
+    auto expect = rows;
+    std::sort(expect.begin(), expect.end(), [](const pair<int, int> &a, const pair<int, int> &b) {
+        return a.first < b.first || (a.first == b.first && a.second > b.second);
+    });
+    check(asc, expect);
+
+    // Key descending, ties by the value ascending
+    EncSnapshotSort desc(0, true, lqf::colSize(2), [](DataRow *a, DataRow *b) {
+        return SIGE(0) || (SIE(0) && SILE(1));
+    }, snapshoter);
+    std::sort(expect.begin(), expect.end(), [](const pair<int, int> &a, const pair<int, int> &b) {
+        return a.first > b.first || (a.first == b.first && a.second < b.second);
+    });
+    check(desc, expect);
+}
+
+TEST(EncPredicate, Bitpack) {
+    auto block = make_shared<EncMemvBlock>(initializer_list<parquet::Type::type>{parquet::Type::type::INT32},
+                                           initializer_list<EncodingType>{EncodingType::BITPACK});
+    auto writer = block->rows();
+    vector<int32_t> values;
+    for (int i = 0; i < 3000; i++) {
+        // Each block of 512 has its own minimum
+        values.push_back((i * 37) % 101 - 50 + (i / 512) * 20);
+        (*writer).next()[0] = values.back();
+    }
+    writer->close();
+
+    vector<pair<unique_ptr<ColPredicate>, function<bool(int32_t)>>> cases;
+    cases.emplace_back(new EncEq<parquet::Int32Type>(0, 7), [](int32_t v) { return v == 7; });
+    cases.emplace_back(new EncLess<parquet::Int32Type>(0, 10), [](int32_t v) { return v < 10; });
+    cases.emplace_back(new EncGreater<parquet::Int32Type>(0, 40), [](int32_t v) { return v > 40; });
+    cases.emplace_back(new EncBetween<parquet::Int32Type>(0, -20, 60), [](int32_t v) { return v >= -20 && v <= 60; });
+    cases.emplace_back(new EncRangele<parquet::Int32Type>(0, -20, 60), [](int32_t v) { return v >= -20 && v < 60; });
+    cases.emplace_back(new EncIn<parquet::Int32Type>(0, {-50, 3, 4, 99, 1000}),
+                       [](int32_t v) { return v == -50 || v == 3 || v == 4 || v == 99; });
+    cases.emplace_back(new EncLess<parquet::Int32Type>(0, 1000), [](int32_t v) { return true; });
+    cases.emplace_back(new EncGreater<parquet::Int32Type>(0, 1000), [](int32_t v) { return false; });
+
+    for (auto &c: cases) {
+        FullBitmap full(block->size());
+        auto result = c.first->filterBlock(*block, full);
+        uint32_t count = 0;
+        for (uint32_t i = 0; i < values.size(); ++i) {
+            ASSERT_EQ(c.second(values[i]), result->check(i)) << i;
+            count += c.second(values[i]);
+        }
+        EXPECT_EQ(count, result->cardinality());
+    }
+}
+
+TEST(EncPredicate, Dictionary) {
+    auto block = make_shared<EncMemvBlock>(
+            initializer_list<parquet::Type::type>{parquet::Type::type::INT32, parquet::Type::type::DOUBLE,
+                                                  parquet::Type::type::BYTE_ARRAY, parquet::Type::type::INT32},
+            initializer_list<EncodingType>{EncodingType::DICTIONARY, EncodingType::DICTIONARY,
+                                           EncodingType::DICTIONARY, EncodingType::PLAIN});
+    const char *modes[] = {"RAIL", "AIR", "TRUCK", "SHIP", "MAIL", "FOB", "REG AIR"};
+    auto writer = block->rows();
+    for (int i = 0; i < 10000; i++) {
+        DataRow &row = writer->next();
+        // Long runs and short runs of codes
+        row[0] = (i / 100) % 13 * 10 + (i % 3);
+        row[1] = ((i * 7) % 29) * 0.5;
+        ByteArray mode(modes[(i / 7) % 7]);
+        row[2] = mode;
+        row[3] = i % 10;
+    }
+    writer->close();
+
+    auto count = [&block](ColPredicate &pred, function<bool(DataRow &)> expect) {
+        FullBitmap full(block->size());
+        auto result = pred.filterBlock(*block, full);
+        auto rows = block->rows();
+        uint32_t count = 0;
+        for (uint32_t i = 0; i < block->size(); ++i) {
+            auto matched = expect(rows->next());
+            EXPECT_EQ(matched, result->check(i)) << i;
+            count += matched;
+        }
+        EXPECT_EQ(count, result->cardinality());
+        return count;
+    };
+    EncEq<parquet::Int32Type> eq(0, 41);
+    EXPECT_LT(0, count(eq, [](DataRow &row) { return row[0].asInt() == 41; }));
+    EncEq<parquet::Int32Type> absent(0, 43);
+    EXPECT_EQ(0, count(absent, [](DataRow &row) { return false; }));
+    EncLess<parquet::Int32Type> less(0, 45);
+    count(less, [](DataRow &row) { return row[0].asInt() < 45; });
+    EncGreater<parquet::Int32Type> greater(0, 50);
+    count(greater, [](DataRow &row) { return row[0].asInt() > 50; });
+    EncRangele<parquet::DoubleType> rangele(1, 3.0, 11.0);
+    count(rangele, [](DataRow &row) { return row[1].asDouble() >= 3 && row[1].asDouble() < 11; });
+    EncBetween<parquet::DoubleType> between(1, 3.2, 11.0);
+    count(between, [](DataRow &row) { return row[1].asDouble() >= 3.2 && row[1].asDouble() <= 11; });
+
+    ByteArray air("AIR");
+    ByteArray rail("RAIL");
+    ByteArray truck("TRUCK");
+    EncBetween<parquet::ByteArrayType> sbetween(2, air, rail);
+    count(sbetween, [&](DataRow &row) { return !(row[2].asByteArray() < air) && !(rail < row[2].asByteArray()); });
+    EncIn<parquet::ByteArrayType> in(2, {air, truck});
+    EXPECT_EQ(2856, count(in, [&](DataRow &row) {
+        return row[2].asByteArray() == air || row[2].asByteArray() == truck;
+    }));
+
+    // Other encodings are decoded
+    EncIn<parquet::Int32Type> plain(3, {2, 5});
+    EXPECT_EQ(2000, count(plain, [](DataRow &row) { return row[3].asInt() == 2 || row[3].asInt() == 5; }));
+}
+
+TEST(EncPredicate, Delta) {
+    auto block = make_shared<EncMemvBlock>(initializer_list<parquet::Type::type>{parquet::Type::type::INT32},
+                                           initializer_list<EncodingType>{EncodingType::DELTA});
+    auto writer = block->rows();
+    for (int i = 0; i < 5000; i++) {
+        // Sorted keys with repeats, as in a join output ordered by key
+        (*writer).next()[0] = 100 + i / 4;
+    }
+    writer->close();
+
+    EncBetween<parquet::Int32Type> between(0, 300, 900);
+    EncRangele<parquet::Int32Type> rangele(0, 300, 900);
+    EncGreater<parquet::Int32Type> greater(0, 1300);
+    EncIn<parquet::Int32Type> in(0, {99, 100, 700, 1349});
+    vector<pair<ColPredicate *, function<bool(int32_t)>>> cases{
+            {&between, [](int32_t v) { return v >= 300 && v <= 900; }},
+            {&rangele, [](int32_t v) { return v >= 300 && v < 900; }},
+            {&greater, [](int32_t v) { return v > 1300; }},
+            {&in,      [](int32_t v) { return v == 100 || v == 700 || v == 1349; }}};
+    for (auto &c: cases) {
+        FullBitmap full(block->size());
+        auto result = c.first->filterBlock(*block, full);
+        uint32_t count = 0;
+        for (int i = 0; i < 5000; ++i) {
+            ASSERT_EQ(c.second(100 + i / 4), result->check(i)) << i;
+            count += c.second(100 + i / 4);
+        }
+        EXPECT_EQ(count, result->cardinality());
+    }
+}
@@ -2,6 +2,7 @@
 // Created by Harper on 6/6/20.
 //
 
+#include <immintrin.h>
 #include "rowcopy.h"
 
 namespace lqf {
@@ -14,9 +15,104 @@ namespace lqf {
             contents_.emplace_back(f);
         }
 
-        void FunctorBase::operator()(DataRow &to, DataRow &from) {
-            for (auto &p:contents_) {
-                p(to, from);
+        void FunctorBase::add(const CopyInst &inst) {
+            insts_.push_back(inst);
+        }
+
+        template<uint32_t N>
+        void copyRun(const vector<CopyInst> &insts, uint64_t *to, uint64_t *from) {
+            memcpy(to + insts[0].to_, from + insts[0].from_, N * sizeof(uint64_t));
+        }
+
+        template<uint32_t N1, uint32_t N2>
+        void copyTwoRuns(const vector<CopyInst> &insts, uint64_t *to, uint64_t *from) {
+            memcpy(to + insts[0].to_, from + insts[0].from_, N1 * sizeof(uint64_t));
+            memcpy(to + insts[1].to_, from + insts[1].from_, N2 * sizeof(uint64_t));
+        }
+
+        void copyRuns(const vector<CopyInst> &insts, uint64_t *to, uint64_t *from) {
+            for (auto &inst: insts) {
+                memcpy(to + inst.to_, from + inst.from_, inst.len_ * sizeof(uint64_t));
+            }
+        }
+
+        static const WordCopy ONE_RUN[] = {
+                nullptr, copyRun<1>, copyRun<2>, copyRun<3>, copyRun<4>,
+                copyRun<5>, copyRun<6>, copyRun<7>, copyRun<8>};
+
+        static const WordCopy TWO_RUNS[4][4] = {
+                {copyTwoRuns<1, 1>, copyTwoRuns<1, 2>, copyTwoRuns<1, 3>, copyTwoRuns<1, 4>},
+                {copyTwoRuns<2, 1>, copyTwoRuns<2, 2>, copyTwoRuns<2, 3>, copyTwoRuns<2, 4>},
+                {copyTwoRuns<3, 1>, copyTwoRuns<3, 2>, copyTwoRuns<3, 3>, copyTwoRuns<3, 4>},
+                {copyTwoRuns<4, 1>, copyTwoRuns<4, 2>, copyTwoRuns<4, 3>, copyTwoRuns<4, 4>}};
+
+        void FunctorBase::compile(const vector<uint32_t> &to_offset) {
+            copy_words_ = nullptr;
+            to_words_.clear();
+            if (insts_.empty()) {
+                return;
+            }
+            bool words = true;
+            for (auto &inst: insts_) {
+                words &= inst.op_ == C_WORDS;
+            }
+            if (words) {
+                if (insts_.size() == 1 && insts_[0].len_ <= 8) {
+                    copy_words_ = ONE_RUN[insts_[0].len_];
+                } else if (insts_.size() == 2 && insts_[0].len_ <= 4 && insts_[1].len_ <= 4) {
+                    copy_words_ = TWO_RUNS[insts_[0].len_ - 1][insts_[1].len_ - 1];
+                } else {
+                    copy_words_ = copyRuns;
+                }
+                return;
+            }
+            for (auto &inst: insts_) {
+                if (inst.op_ == C_WORDS || inst.to_ + 1 >= to_offset.size()) {
+                    to_words_.clear();
+                    return;
+                }
+                to_words_.emplace_back(to_offset[inst.to_], to_offset[inst.to_ + 1] - to_offset[inst.to_]);
+            }
+        }
+
+        void FunctorBase::copyToWords(uint64_t *to, DataRow &from) {
+            auto num_inst = insts_.size();
+            for (uint32_t i = 0; i < num_inst; ++i) {
+                auto &inst = insts_[i];
+                auto &dest = to_words_[i];
+                DataField &field = inst.op_ == C_RAWFIELD ? from(inst.from_) : from[inst.from_];
+                // Like DataField assignment, a field wider than the destination is not copied
+                if (field.size_ > dest.second) {
+                    continue;
+                }
+                auto target = to + dest.first;
+                if (field.size_ == 1) {
+                    *target = *field.data();
+                } else {
+                    memcpy(target, field.data(), field.size_ * sizeof(uint64_t));
+                }
+                if (inst.op_ == C_EXTFIELD) {
+                    memory::ByteArrayBuffer::instance.allocate(*reinterpret_cast<ByteArray *>(target));
+                }
+            }
+        }
+
+        void FunctorBase::copyFields(DataRow &to, DataRow &from) {
+            for (auto &inst: insts_) {
+                switch (inst.op_) {
+                    case C_WORDS:
+                        elements::rc_fieldmemcpy(to, from, inst.from_, inst.to_, inst.len_);
+                        break;
+                    case C_FIELD:
+                        elements::rc_field(to, from, inst.to_, inst.from_);
+                        break;
+                    case C_EXTFIELD:
+                        elements::rc_extfield(to, from, inst.to_, inst.from_);
+                        break;
+                    case C_RAWFIELD:
+                        elements::rc_rawfield(to, from, inst.to_, inst.from_);
+                        break;
+                }
             }
         }
 
@@ -25,9 +121,7 @@ namespace lqf {
 
         unique_ptr<MemDataRow> Snapshoter::operator()(DataRow &input) {
             unique_ptr<MemDataRow> result = unique_ptr<MemDataRow>(new MemDataRow(col_offset_));
-            for (auto &p:contents_) {
-                p(*result, input);
-            }
+            FunctorBase::operator()(*result, input);
             return result;
         }
 
@@ -89,8 +183,7 @@ namespace lqf {
                         } else if (next.from_ == f_prev + 1 && next.to_ == t_prev + 1) {
                             length += from_offset_[next.from_ + 1] - from_offset_[next.from_];
                         } else {
-                            base.add(bind(elements::rc_fieldmemcpy,
-                                          placeholders::_1, placeholders::_2, from_start, to_start, length));
+                            base.add(CopyInst{C_WORDS, from_start, to_start, length});
                             from_start = from_offset_[next.from_];
                             to_start = to_offset_[next.to_];
                             length = from_offset_[next.from_ + 1] - from_start;
@@ -98,28 +191,25 @@ namespace lqf {
                         f_prev = next.from_;
                         t_prev = next.to_;
                     }
-                    base.add(bind(elements::rc_fieldmemcpy,
-                                  placeholders::_1, placeholders::_2, from_start, to_start, length));
+                    base.add(CopyInst{C_WORDS, from_start, to_start, length});
                 } else {
                     for (auto &field: fields_) {
                         switch (field.type_) {
                             case F_REGULAR:
-                                base.add(bind(elements::rc_field, placeholders::_1, placeholders::_2,
-                                              field.to_, field.from_));
+                                base.add(CopyInst{C_FIELD, field.from_, field.to_, 1});
                                 break;
                             case F_STRING:
-                                base.add(bind(from_type_ == EXTERNAL ? elements::rc_extfield : elements::rc_field,
-                                              placeholders::_1, placeholders::_2,
-                                              field.to_, field.from_));
+                                base.add(CopyInst{from_type_ == EXTERNAL ? C_EXTFIELD : C_FIELD,
+                                                  field.from_, field.to_, 2});
                                 break;
                             case F_RAW:
-                                base.add(bind(elements::rc_rawfield, placeholders::_1, placeholders::_2,
-                                              field.to_, field.from_));
+                                base.add(CopyInst{C_RAWFIELD, field.from_, field.to_, 1});
                                 break;
                         }
                     }
                 }
             }
+            base.compile(to_offset_);
             for (auto &p: processors_) {
                 base.add(move(p));
             }
@@ -178,5 +268,64 @@ namespace lqf {
             }
             return this->build();
         }
+    
+        void GatherRows(MemvBlock &src, const uint32_t *positions, uint32_t count,
+                        MemBlock &dest, uint32_t dest_start, const vector<pair<uint32_t, uint32_t>> &fields) {
+            auto &dest_offset = dest.col_offset();
+            uint64_t row_size = dest_offset.back();
+            auto dest_base = dest.content().data() + dest_start * row_size;
+            // Word offsets of 8 consecutive destination rows
+            auto row_index = _mm512_mullo_epi64(_mm512_set_epi64(7, 6, 5, 4, 3, 2, 1, 0),
+                                                _mm512_set1_epi64(row_size));
+            for (auto &field: fields) {
+                uint64_t width = src.colSize()[field.first];
+                auto vwidth = _mm512_set1_epi64(width);
+                for (uint32_t w = 0; w < width; ++w) {
+                    auto source = src.column(field.first).data() + w;
+                    auto target = dest_base + dest_offset[field.second] + w;
+                    uint32_t i = 0;
+                    for (; i + 8 <= count; i += 8) {
+                        auto pos = _mm512_cvtepu32_epi64(
+                                _mm256_loadu_si256(reinterpret_cast<const __m256i *>(positions + i)));
+                        auto values = _mm512_i64gather_epi64(_mm512_mullo_epi64(pos, vwidth), source, 8);
+                        _mm512_i64scatter_epi64(target + i * row_size, row_index, values, 8);
+                    }
+                    for (; i < count; ++i) {
+                        target[i * row_size] = source[positions[i] * width];
+                    }
+                }
+            }
+        }
+
+        void ScatterRows(MemBlock &src, const uint32_t *positions, uint32_t count,
+                         MemvBlock &dest, uint32_t dest_start, const vector<pair<uint32_t, uint32_t>> &fields) {
+            auto &src_offset = src.col_offset();
+            uint64_t row_size = src_offset.back();
+            auto vrow_size = _mm512_set1_epi64(row_size);
+            for (auto &field: fields) {
+                uint64_t width = dest.colSize()[field.second];
+                // Word offsets of 8 consecutive rows in the destination column
+                auto col_index = _mm512_mullo_epi64(_mm512_set_epi64(7, 6, 5, 4, 3, 2, 1, 0),
+                                                    _mm512_set1_epi64(width));
+                for (uint32_t w = 0; w < width; ++w) {
+                    auto source = src.content().data() + src_offset[field.first] + w;
+                    auto target = dest.column(field.second).data() + dest_start * width + w;
+                    uint32_t i = 0;
+                    for (; i + 8 <= count; i += 8) {
+                        auto pos = _mm512_cvtepu32_epi64(
+                                _mm256_loadu_si256(reinterpret_cast<const __m256i *>(positions + i)));
+                        auto values = _mm512_i64gather_epi64(_mm512_mullo_epi64(pos, vrow_size), source, 8);
+                        if (width == 1) {
+                            _mm512_storeu_si512(target + i, values);
+                        } else {
+                            _mm512_i64scatter_epi64(target + i * width, col_index, values, 8);
+                        }
+                    }
+                    for (; i < count; ++i) {
+                        target[i * width] = source[positions[i] * row_size];
+                    }
+                }
+            }
+        }
     }
-}
\ No newline at end of file
+}
@@ -28,14 +28,65 @@ namespace lqf {
             FieldInst(FIELD_TYPE, uint32_t, uint32_t);
         };
 
+        enum COPY_OP {
+            C_WORDS, C_FIELD, C_EXTFIELD, C_RAWFIELD
+        };
+
+        /// A step of a compiled copy plan
+        struct CopyInst {
+            COPY_OP op_;
+            // Word offsets for C_WORDS, field indices otherwise
+            uint32_t from_;
+            uint32_t to_;
+            // Words copied by C_WORDS
+            uint32_t len_;
+        };
+
+        using WordCopy = void (*)(const vector<CopyInst> &, uint64_t *to, uint64_t *from);
+
+        /**
+         * FunctorBase runs a copy plan compiled from the field instructions, followed by the
+         * custom processors. A plan of RAW layouts only moves words between the raw buffers of
+         * the rows. One or two runs of up to 8 words are copied by template instances with the
+         * lengths known at compile time. Other plans read fields from the source, and write them
+         * straight into the words of a raw destination with a known layout.
+         */
         class FunctorBase {
         protected:
+            vector<CopyInst> insts_;
+            // The copy of a plan with only C_WORDS
+            WordCopy copy_words_ = nullptr;
+            // Word offset and width in the destination of each instruction of a field plan
+            vector<pair<uint32_t, uint32_t>> to_words_;
             vector<function<void(DataRow &, DataRow &)>> contents_;
 
+            void copyFields(DataRow &to, DataRow &from);
+
+            void copyToWords(uint64_t *to, DataRow &from);
+
         public:
             void add(function<void(DataRow &, DataRow &)> &&f);
 
-            void operator()(DataRow &to, DataRow &from);
+            void add(const CopyInst &);
+
+            /// Choose the copy of the plan after all instructions are added, given the destination layout if known
+            void compile(const vector<uint32_t> &to_offset);
+
+            inline void operator()(DataRow &to, DataRow &from) {
+                uint64_t *dest;
+                if (copy_words_) {
+                    copy_words_(insts_, to.raw(), from.raw());
+                } else if (!to_words_.empty() && (dest = to.raw()) != nullptr) {
+                    copyToWords(dest, from);
+                } else {
+                    copyFields(to, from);
+                }
+                for (auto &p: contents_) {
+                    p(to, from);
+                }
+            }
+
+            inline const vector<CopyInst> &insts() { return insts_; }
         };
 
         class Snapshoter : public FunctorBase {
@@ -91,6 +142,18 @@ namespace lqf {
             unique_ptr<Snapshoter> buildSnapshot();
         };
 
+        /**
+         * Copy fields of the rows at positions of a columnar block into consecutive rows of a
+         * row-major block starting at dest_start. Each pair maps a source column to a destination
+         * field. Words of 8 rows move at once by an AVX-512 gather and scatter.
+         */
+        void GatherRows(MemvBlock &src, const uint32_t *positions, uint32_t count,
+                        MemBlock &dest, uint32_t dest_start, const vector<pair<uint32_t, uint32_t>> &fields);
+
+        /// The reverse of GatherRows, from rows at positions of a row-major block to a columnar block
+        void ScatterRows(MemBlock &src, const uint32_t *positions, uint32_t count,
+                         MemvBlock &dest, uint32_t dest_start, const vector<pair<uint32_t, uint32_t>> &fields);
+
         namespace elements {
 
             inline void rc_memcpy(DataRow &to, DataRow &from) {
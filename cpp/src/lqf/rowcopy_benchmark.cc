@@ -23,12 +23,31 @@ protected:
 public:
 
     shared_ptr<MemBlock> mem_source_;
+    shared_ptr<MemBlock> string_source_;
     shared_ptr<ParquetBlock> parquet_source_;
     unique_ptr<function<void(DataRow &, DataRow &)>> copier1_;
     unique_ptr<function<void(DataRow &, DataRow &)>> copier2_;
+    unique_ptr<function<void(DataRow &, DataRow &)>> string_copier_;
+    // The field by field copy the factory used to build
+    vector<function<void(DataRow &, DataRow &)>> functions_;
+    vector<uint32_t> string_offset_{0, 2, 3, 5, 6};
+    string text_ = "a string of some length";
 
     RowCopyBenchmark() {
         mem_source_ = make_shared<MemBlock>(300000, 8);
+        string_source_ = make_shared<MemBlock>(300000, string_offset_);
+        auto rows = string_source_->rows();
+        ByteArray bytes(text_.size(), reinterpret_cast<const uint8_t *>(text_.data()));
+        for (uint32_t i = 0; i < 300000; ++i) {
+            DataRow &row = (*rows)[i];
+            row[0] = bytes;
+            row[1] = static_cast<int32_t>(i);
+            row[2] = bytes;
+            row[3] = 1.5;
+        }
+        for (uint32_t i = 0; i < 8; ++i) {
+            functions_.push_back(bind(elements::rc_field, placeholders::_1, placeholders::_2, i, i));
+        }
 
         rowcopy::RowCopyFactory f;
         copier1_ = f.from(RAW)->to(RAW)
@@ -45,6 +64,7 @@ public:
                 ->build();
         rowcopy::RowCopyFactory f2;
         copier2_ = f2.from(EXTERNAL)->to(RAW)
+                ->to_layout(vector<uint32_t>{0, 1, 2, 3, 4, 5, 6, 7, 8})
                 ->field(F_REGULAR, 0, 0)
                 ->field(F_REGULAR, 1, 1)
                 ->field(F_REGULAR, 2, 2)
@@ -54,6 +74,13 @@ public:
                 ->field(F_REGULAR, 6, 6)
                 ->field(F_REGULAR, 7, 7)
                 ->build();
+        rowcopy::RowCopyFactory f3;
+        string_copier_ = f3.from(EXTERNAL)->to(RAW)
+                ->field(F_STRING, 0, 0)
+                ->field(F_REGULAR, 1, 1)
+                ->field(F_STRING, 2, 2)
+                ->field(F_REGULAR, 3, 3)
+                ->build();
     }
 
     virtual ~RowCopyBenchmark() {
@@ -109,6 +136,74 @@ BENCHMARK_F(RowCopyBenchmark, CopyMethodFromMem)(benchmark::State &state) {
     }
 }
 
+BENCHMARK_F(RowCopyBenchmark, CopyFunctionsFromMem)(benchmark::State &state) {
+    for (auto _ : state) {
+        auto mem_dest = make_shared<MemBlock>(mem_source_->size(), 8);
+        auto reader = mem_source_->rows();
+        auto writer = mem_dest->rows();
+        auto size = mem_source_->size();
+
+        for (uint32_t i = 0; i < size; ++i) {
+            DataRow &next = reader->next();
+            DataRow &dest = (*writer)[i];
+            for (auto &f: functions_) {
+                f(dest, next);
+            }
+        }
+        blackhole(mem_dest);
+    }
+    state.SetItemsProcessed(state.iterations() * mem_source_->size());
+}
+
+BENCHMARK_F(RowCopyBenchmark, CopyRawToRaw)(benchmark::State &state) {
+    for (auto _ : state) {
+        auto mem_dest = make_shared<MemBlock>(mem_source_->size(), 8);
+        auto reader = mem_source_->rows();
+        auto writer = mem_dest->rows();
+        auto size = mem_source_->size();
+
+        for (uint32_t i = 0; i < size; ++i) {
+            (*copier1_)((*writer)[i], reader->next());
+        }
+        blackhole(mem_dest);
+    }
+    state.SetItemsProcessed(state.iterations() * mem_source_->size());
+}
+
+BENCHMARK_F(RowCopyBenchmark, CopyExternalToRaw)(benchmark::State &state) {
+    // The first 8 columns of lineitem are all single words
+    auto table = ParquetTable::Open("testres/lineitem2", (1 << 8) - 1);
+    auto blocks = table->blocks()->collect();
+    auto source = (*blocks)[0];
+    auto size = source->size();
+    for (auto _ : state) {
+        auto mem_dest = make_shared<MemBlock>(size, 8);
+        auto reader = source->rows();
+        auto writer = mem_dest->rows();
+
+        for (uint32_t i = 0; i < size; ++i) {
+            (*copier2_)((*writer)[i], reader->next());
+        }
+        blackhole(mem_dest);
+    }
+    state.SetItemsProcessed(state.iterations() * size);
+}
+
+BENCHMARK_F(RowCopyBenchmark, CopyStringFields)(benchmark::State &state) {
+    for (auto _ : state) {
+        auto mem_dest = make_shared<MemBlock>(string_source_->size(), string_offset_);
+        auto reader = string_source_->rows();
+        auto writer = mem_dest->rows();
+        auto size = string_source_->size();
+
+        for (uint32_t i = 0; i < size; ++i) {
+            (*string_copier_)((*writer)[i], reader->next());
+        }
+        blackhole(mem_dest);
+    }
+    state.SetItemsProcessed(state.iterations() * string_source_->size());
+}
+
 BENCHMARK_F(RowCopyBenchmark, CopyVirtualFromParquet)(benchmark::State &state) {
     for (auto _ : state) {
         auto table = ParquetTable::Open("testres/lineitem2", (1 << 10) - 1);
@@ -229,3 +229,164 @@ TEST(RowCopyTest, SnapshotTestWithProcessor) {
     EXPECT_EQ((*snapshot)[2].asInt(), 227);
     EXPECT_EQ((*snapshot)[3].asInt(), 881);
 }
+
+TEST(RowCopyTest, CompiledPlan) {
+    vector<uint32_t> col_offset{0, 1, 3, 4, 5, 6};
+    auto snapshoter = RowCopyFactory().from(RAW)->to(RAW)->from_layout(col_offset)
+            ->field(F_REGULAR, 0, 0)
+            ->field(F_STRING, 1, 1)
+            ->field(F_REGULAR, 2, 2)
+            ->field(F_REGULAR, 4, 3)
+            ->buildSnapshot();
+    // Consecutive fields are merged into one instruction
+    auto &insts = snapshoter->insts();
+    ASSERT_EQ(2, insts.size());
+    EXPECT_EQ(C_WORDS, insts[0].op_);
+    EXPECT_EQ(4, insts[0].len_);
+    EXPECT_EQ(1, insts[1].len_);
+    EXPECT_EQ(5, insts[1].from_);
+    EXPECT_EQ(4, insts[1].to_);
+
+    string text("abcdefg");
+    ByteArray bytes(text.size(), reinterpret_cast<const uint8_t *>(text.data()));
+    MemDataRow from(col_offset);
+    from[0] = 3;
+    from[1] = bytes;
+    from[2] = 2.5;
+    from[3] = 8;
+    from[4] = 9;
+    auto to = (*snapshoter)(from);
+    EXPECT_EQ(3, (*to)[0].asInt());
+    EXPECT_EQ(bytes, (*to)[1].asByteArray());
+    EXPECT_EQ(2.5, (*to)[2].asDouble());
+    EXPECT_EQ(9, (*to)[3].asInt());
+}
+
+TEST(RowCopyTest, FieldsIntoWords) {
+    string text("abcdefg");
+    ByteArray bytes(text.size(), reinterpret_cast<const uint8_t *>(text.data()));
+    vector<uint32_t> col_size{1, 2, 1};
+    MemvBlock columns(10, col_size);
+    auto crows = columns.rows();
+    for (int i = 0; i < 10; ++i) {
+        DataRow &row = (*crows)[i];
+        row[0] = i;
+        row[1] = bytes;
+        row[2] = i * 0.5;
+    }
+    vector<uint32_t> to_offset{0, 1, 3, 4};
+    auto copier = RowCopyFactory().from(OTHER)->to(RAW)->to_layout(to_offset)
+            ->field(F_REGULAR, 0, 2)
+            ->field(F_STRING, 1, 1)
+            ->field(F_REGULAR, 2, 0)
+            ->build();
+    MemBlock block(10, to_offset);
+    auto rows = block.rows();
+    crows = columns.rows();
+    for (int i = 0; i < 10; ++i) {
+        (*copier)((*rows)[i], (*crows)[i]);
+    }
+    rows = block.rows();
+    for (int i = 0; i < 10; ++i) {
+        DataRow &row = (*rows)[i];
+        EXPECT_EQ(i * 0.5, row[0].asDouble());
+        EXPECT_EQ(bytes, row[1].asByteArray());
+        EXPECT_EQ(i, row[2].asInt());
+    }
+
+    // A columnar destination has no raw words, and is written field by field
+    MemvBlock back(10, col_size);
+    auto back_copier = RowCopyFactory().from(RAW)->to(OTHER)->to_layout(to_offset)
+            ->field(F_REGULAR, 2, 0)
+            ->field(F_STRING, 1, 1)
+            ->field(F_REGULAR, 0, 2)
+            ->build();
+    auto brows = back.rows();
+    rows = block.rows();
+    for (int i = 0; i < 10; ++i) {
+        (*back_copier)((*brows)[i], (*rows)[i]);
+    }
+    brows = back.rows();
+    for (int i = 0; i < 10; ++i) {
+        DataRow &row = (*brows)[i];
+        EXPECT_EQ(i, row[0].asInt());
+        EXPECT_EQ(bytes, row[1].asByteArray());
+        EXPECT_EQ(i * 0.5, row[2].asDouble());
+    }
+}
+
+TEST(RowCopyTest, WordRuns) {
+    vector<uint32_t> col_offset{0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10};
+    MemDataRow from(col_offset);
+    for (int i = 0; i < 10; ++i) {
+        from[i] = i + 1;
+    }
+    // One run of 10 words, two short runs, and three runs
+    vector<vector<pair<uint32_t, uint32_t>>> plans{
+            {{0, 0}, {1, 1}, {2, 2}, {3, 3}, {4, 4}, {5, 5}, {6, 6}, {7, 7}, {8, 8}, {9, 9}},
+            {{0, 5}, {1, 6}, {2, 7}, {7, 0}},
+            {{0, 9}, {3, 4}, {4, 5}, {8, 1}}};
+    vector<uint32_t> num_insts{1, 2, 3};
+    for (uint32_t p = 0; p < plans.size(); ++p) {
+        RowCopyFactory f;
+        f.from(RAW)->to(RAW)->from_layout(col_offset)->to_layout(col_offset);
+        for (auto &field: plans[p]) {
+            f.field(F_REGULAR, field.first, field.second);
+        }
+        auto snapshoter = f.buildSnapshot();
+        EXPECT_EQ(num_insts[p], snapshoter->insts().size());
+        MemDataRow to(col_offset);
+        (*snapshoter)(to, from);
+        for (auto &field: plans[p]) {
+            EXPECT_EQ(field.first + 1, to[field.second].asInt()) << p;
+        }
+    }
+}
+
+TEST(RowCopyTest, GatherScatter) {
+    vector<uint32_t> col_size{1, 2, 1};
+    MemvBlock columns(100, col_size);
+    vector<string> texts;
+    for (int i = 0; i < 100; ++i) {
+        texts.push_back("text" + to_string(i));
+    }
+    auto writer = columns.rows();
+    for (int i = 0; i < 100; ++i) {
+        DataRow &row = (*writer)[i];
+        ByteArray bytes(texts[i].size(), reinterpret_cast<const uint8_t *>(texts[i].data()));
+        row[0] = i;
+        row[1] = bytes;
+        row[2] = i * 0.5;
+    }
+
+    // 13 positions leave a tail after the 8-row batch
+    vector<uint32_t> positions{3, 97, 15, 0, 42, 42, 77, 8, 99, 1, 64, 33, 50};
+    vector<uint32_t> row_offset{0, 1, 3, 4, 5};
+    MemBlock rows(positions.size() + 2, row_offset);
+    GatherRows(columns, positions.data(), positions.size(), rows, 2, {{0, 2}, {1, 1}, {2, 3}});
+    auto reader = rows.rows();
+    for (uint32_t i = 0; i < positions.size(); ++i) {
+        DataRow &row = (*reader)[i + 2];
+        auto pos = positions[i];
+        EXPECT_EQ(pos, row[2].asInt());
+        EXPECT_EQ(ByteArray(texts[pos].size(), reinterpret_cast<const uint8_t *>(texts[pos].data())),
+                  row[1].asByteArray());
+        EXPECT_EQ(pos * 0.5, row[3].asDouble());
+    }
+
+    MemvBlock back(20, col_size);
+    vector<uint32_t> sources;
+    for (uint32_t i = 0; i < positions.size(); ++i) {
+        sources.push_back(positions.size() + 1 - i);
+    }
+    ScatterRows(rows, sources.data(), sources.size(), back, 5, {{2, 0}, {1, 1}, {3, 2}});
+    auto backrows = back.rows();
+    for (uint32_t i = 0; i < sources.size(); ++i) {
+        DataRow &row = (*backrows)[i + 5];
+        auto pos = positions[sources[i] - 2];
+        EXPECT_EQ(pos, row[0].asInt());
+        EXPECT_EQ(ByteArray(texts[pos].size(), reinterpret_cast<const uint8_t *>(texts[pos].data())),
+                  row[1].asByteArray());
+        EXPECT_EQ(pos * 0.5, row[2].asDouble());
+    }
+}
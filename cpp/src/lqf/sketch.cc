@@ -0,0 +1,144 @@
+//
+// Created by agent on 10/19/26.
+//
+
+#include <cmath>
+#include <algorithm>
+#include <stdexcept>
+#include <immintrin.h>
+#include "sketch.h"
+
+namespace lqf {
+    namespace sketch {
+
+        HyperLogLog::HyperLogLog(uint32_t precision) : precision_(precision) {
+            // 32 registers at least to merge with full AVX2 lanes
+            if (precision < 5 || precision > 18) {
+                throw invalid_argument("HyperLogLog precision should be in [5, 18]");
+            }
+            registers_.resize(1 << precision, 0);
+        }
+
+        void HyperLogLog::merge(const HyperLogLog &another) {
+            if (another.precision_ != precision_) {
+                throw invalid_argument("HyperLogLog precision mismatch");
+            }
+            auto size = registers_.size();
+            auto target = registers_.data();
+            auto source = another.registers_.data();
+            for (uint32_t i = 0; i < size; i += 32) {
+                auto a = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(target + i));
+                auto b = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(source + i));
+                _mm256_storeu_si256(reinterpret_cast<__m256i *>(target + i), _mm256_max_epu8(a, b));
+            }
+        }
+
+        uint64_t HyperLogLog::estimate() const {
+            double m = registers_.size();
+            double sum = 0;
+            uint32_t zeros = 0;
+            for (auto reg: registers_) {
+                sum += ldexp(1.0, -reg);
+                zeros += reg == 0;
+            }
+            double alpha = 0.7213 / (1 + 1.079 / m);
+            double estimate = alpha * m * m / sum;
+            // Linear counting is more accurate for small cardinalities
+            if (estimate <= 2.5 * m && zeros > 0) {
+                estimate = m * log(m / zeros);
+            }
+            return static_cast<uint64_t>(estimate + 0.5);
+        }
+
+        KllSketch::KllSketch(uint32_t k) : k_(k), count_(0), size_(0), max_size_(k), random_(0x9E3779B97F4A7C15),
+                                           levels_(1) {
+            if (k < 8) {
+                throw invalid_argument("KLL k should be at least 8");
+            }
+        }
+
+        uint32_t KllSketch::capacity(uint32_t level) const {
+            auto depth = levels_.size() - level - 1;
+            return std::max<uint32_t>(2, static_cast<uint32_t>(ceil(k_ * pow(2.0 / 3, depth))));
+        }
+
+        void KllSketch::grow() {
+            levels_.emplace_back();
+            max_size_ = 0;
+            for (uint32_t level = 0; level < levels_.size(); ++level) {
+                max_size_ += capacity(level);
+            }
+        }
+
+        void KllSketch::compress() {
+            while (size_ >= max_size_) {
+                for (uint32_t level = 0; level < levels_.size(); ++level) {
+                    if (levels_[level].size() < capacity(level)) {
+                        continue;
+                    }
+                    if (level + 1 == levels_.size()) {
+                        grow();
+                    }
+                    auto &items = levels_[level];
+                    auto &next = levels_[level + 1];
+                    sort(items.begin(), items.end());
+                    // An odd item out stays at this level
+                    double leftover = items.back();
+                    bool odd = items.size() % 2;
+                    uint32_t pairs = items.size() / 2;
+                    random_ ^= random_ << 13;
+                    random_ ^= random_ >> 7;
+                    random_ ^= random_ << 17;
+                    uint32_t offset = random_ & 1;
+                    for (uint32_t i = 0; i < pairs; ++i) {
+                        next.push_back(items[2 * i + offset]);
+                    }
+                    items.clear();
+                    if (odd) {
+                        items.push_back(leftover);
+                    }
+                    size_ -= pairs;
+                    break;
+                }
+            }
+        }
+
+        void KllSketch::merge(const KllSketch &another) {
+            while (levels_.size() < another.levels_.size()) {
+                grow();
+            }
+            for (uint32_t level = 0; level < another.levels_.size(); ++level) {
+                auto &items = another.levels_[level];
+                levels_[level].insert(levels_[level].end(), items.begin(), items.end());
+            }
+            count_ += another.count_;
+            size_ += another.size_;
+            compress();
+        }
+
+        double KllSketch::quantile(double rank) const {
+            vector<pair<double, uint64_t>> weighted;
+            weighted.reserve(size_);
+            uint64_t total = 0;
+            for (uint32_t level = 0; level < levels_.size(); ++level) {
+                for (auto item: levels_[level]) {
+                    weighted.emplace_back(item, 1ull << level);
+                    total += 1ull << level;
+                }
+            }
+            if (weighted.empty()) {
+                return NAN;
+            }
+            sort(weighted.begin(), weighted.end());
+            double target = rank * total;
+            uint64_t acc = 0;
+            for (auto &item: weighted) {
+                acc += item.second;
+                if (acc >= target) {
+                    return item.first;
+                }
+            }
+            return weighted.back().first;
+        }
+    }
+}
@@ -0,0 +1,90 @@
+//
+// Created by agent on 10/19/26.
+//
+
+#ifndef LQF_SKETCH_H
+#define LQF_SKETCH_H
+
+#include <cstdint>
+#include <vector>
+#include <memory>
+
+// Default HyperLogLog precision, 2^12 registers with a standard error of 1.04/sqrt(2^12) = 1.6%
+#define HLL_PRECISION 12
+// Default KLL accuracy parameter, the normalized rank error is about 1.7/k^0.9, around 1.5%
+#define KLL_K 200
+
+namespace lqf {
+    namespace sketch {
+        using namespace std;
+
+        /**
+         * HyperLogLog distinct counter over 64-bit hashes. The registers are bytes so that
+         * merging two sketches is a vectorized byte-wise max.
+         */
+        class HyperLogLog {
+        protected:
+            uint32_t precision_;
+            vector<uint8_t> registers_;
+        public:
+            HyperLogLog(uint32_t precision = HLL_PRECISION);
+
+            inline void add(uint64_t hash) {
+                uint32_t index = hash >> (64 - precision_);
+                // The guard bit bounds the rank by 64 - precision + 1
+                uint8_t rank = __builtin_clzll((hash << precision_) | (1ull << (precision_ - 1))) + 1;
+                auto &reg = registers_[index];
+                reg = reg < rank ? rank : reg;
+            }
+
+            void merge(const HyperLogLog &);
+
+            uint64_t estimate() const;
+
+            inline uint32_t precision() const { return precision_; }
+        };
+
+        /**
+         * KLL quantile sketch. Level h keeps items of weight 2^h. A full level is sorted and every
+         * other item, starting at a random offset, is promoted to the next level. The capacity of a
+         * level shrinks geometrically with its distance from the top, so the sketch holds O(k) items.
+         */
+        class KllSketch {
+        protected:
+            uint32_t k_;
+            uint64_t count_;
+            uint32_t size_;
+            uint32_t max_size_;
+            uint64_t random_;
+            vector<vector<double>> levels_;
+
+            uint32_t capacity(uint32_t level) const;
+
+            void grow();
+
+            void compress();
+
+        public:
+            KllSketch(uint32_t k = KLL_K);
+
+            inline void add(double value) {
+                levels_[0].push_back(value);
+                ++count_;
+                if (++size_ >= max_size_) {
+                    compress();
+                }
+            }
+
+            void merge(const KllSketch &);
+
+            /// Value at the given normalized rank in [0, 1]
+            double quantile(double rank) const;
+
+            inline uint64_t count() const { return count_; }
+
+            inline uint32_t size() const { return size_; }
+        };
+    }
+}
+
+#endif //LQF_SKETCH_H
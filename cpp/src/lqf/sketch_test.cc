@@ -0,0 +1,91 @@
+//
+// Created by agent on 10/19/26.
+//
+
+#include <gtest/gtest.h>
+#include <random>
+#include <algorithm>
+#include "sketch.h"
+#include "hash.h"
+
+using namespace lqf;
+using namespace lqf::sketch;
+
+TEST(HyperLogLogTest, Estimate) {
+    for (uint64_t cardinality: {10, 1000, 100000, 1000000}) {
+        HyperLogLog hll;
+        for (uint64_t i = 0; i < cardinality; ++i) {
+            // Duplicates do not change the estimate
+            hll.add(lqf::hash::fmix64(i));
+            hll.add(lqf::hash::fmix64(i));
+        }
+        // 3 standard errors
+        EXPECT_NEAR(cardinality, hll.estimate(), cardinality * 3 * 1.04 / 64 + 1);
+    }
+}
+
+TEST(HyperLogLogTest, Merge) {
+    HyperLogLog a;
+    HyperLogLog b;
+    HyperLogLog all;
+    for (uint64_t i = 0; i < 300000; ++i) {
+        auto hash = lqf::hash::fmix64(i);
+        (i < 200000 ? a : b).add(hash);
+        if (i >= 100000) {
+            b.add(hash);
+        }
+        all.add(hash);
+    }
+    a.merge(b);
+    // Merging is exact on the registers
+    EXPECT_EQ(all.estimate(), a.estimate());
+    EXPECT_NEAR(300000, a.estimate(), 300000 * 3 * 1.04 / 64);
+
+    HyperLogLog other(10);
+    EXPECT_THROW(a.merge(other), std::invalid_argument);
+}
+
+TEST(KllSketchTest, Quantile) {
+    std::mt19937 rand(13);
+    std::uniform_real_distribution<double> dist(0, 1000);
+    vector<double> values;
+    KllSketch sketch;
+    for (int i = 0; i < 200000; ++i) {
+        auto v = dist(rand);
+        values.push_back(v);
+        sketch.add(v);
+    }
+    EXPECT_EQ(200000, sketch.count());
+    EXPECT_LT(sketch.size(), 1000);
+
+    std::sort(values.begin(), values.end());
+    for (double rank: {0.01, 0.25, 0.5, 0.75, 0.99}) {
+        auto value = sketch.quantile(rank);
+        auto actual = std::lower_bound(values.begin(), values.end(), value) - values.begin();
+        EXPECT_NEAR(rank, (double) actual / values.size(), 0.02);
+    }
+}
+
+TEST(KllSketchTest, Merge) {
+    vector<double> values;
+    KllSketch merged;
+    for (int part = 0; part < 8; ++part) {
+        KllSketch sketch;
+        // Each part covers a different range, so the merged ranks depend on all of them
+        for (int i = 0; i < 30000; ++i) {
+            double v = part * 30000 + (i * 7919) % 30000;
+            values.push_back(v);
+            sketch.add(v);
+        }
+        merged.merge(sketch);
+    }
+    EXPECT_EQ(240000, merged.count());
+    EXPECT_LT(merged.size(), 1000);
+
+    std::sort(values.begin(), values.end());
+    for (double rank: {0.1, 0.5, 0.9}) {
+        auto value = merged.quantile(rank);
+        auto actual = std::lower_bound(values.begin(), values.end(), value) - values.begin();
+        EXPECT_NEAR(rank, (double) actual / values.size(), 0.02);
+    }
+}
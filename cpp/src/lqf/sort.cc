@@ -3,6 +3,13 @@
 //
 
 #include <memory>
+#include <algorithm>
+#include <cstring>
+#include <queue>
+#include <cstdio>
+#include <unistd.h>
+#include <mutex>
+#include <condition_variable>
 #include "sort.h"
 
 using namespace std;
@@ -89,12 +96,614 @@ namespace lqf {
         shared_ptr<Block> SortBlock::mask(shared_ptr<Bitmap> mask) {
             return make_shared<MaskedBlock>(shared_from_this(), mask);
         }
+
+        SortKey::SortKey(vector<SortKeyColumn> columns) : columns_(move(columns)), width_(0), exact_(true) {
+            for (auto &column: columns_) {
+                width_ += column.width_;
+                exact_ &= column.type_ != S_BYTES;
+            }
+            words_ = (width_ + 7) / 8;
+        }
+
+        // Order-preserving unsigned image of a numeric field, in the low width bytes
+        inline uint64_t numericKey(const SortKeyColumn &column, DataField &field) {
+            uint64_t key;
+            if (column.type_ == S_INT) {
+                key = static_cast<uint32_t>(field.asInt()) ^ 0x80000000u;
+            } else {
+                double value = field.asDouble();
+                memcpy(&key, &value, sizeof(uint64_t));
+                key = (key >> 63) ? ~key : key ^ (1ull << 63);
+            }
+            if (column.desc_) {
+                key = ~key;
+            }
+            return column.width_ == 8 ? key : key & ((1ull << (column.width_ * 8)) - 1);
+        }
+
+        void SortKey::encode(DataRow &row, uint8_t *dest) {
+            for (auto &column: columns_) {
+                auto &field = row[column.index_];
+                if (column.type_ == S_BYTES) {
+                    auto &bytes = field.asByteArray();
+                    auto len = std::min(bytes.len, column.width_);
+                    memcpy(dest, bytes.ptr, len);
+                    memset(dest + len, 0, column.width_ - len);
+                    if (column.desc_) {
+                        for (uint32_t i = 0; i < column.width_; ++i) {
+                            dest[i] = ~dest[i];
+                        }
+                    }
+                } else {
+                    auto key = numericKey(column, field);
+                    for (int32_t i = column.width_ - 1; i >= 0; --i) {
+                        dest[i] = key & 0xFF;
+                        key >>= 8;
+                    }
+                }
+                dest += column.width_;
+            }
+        }
+
+        uint64_t SortKey::encode64(DataRow &row) {
+            uint64_t key = 0;
+            for (auto &column: columns_) {
+                auto &field = row[column.index_];
+                uint64_t part;
+                if (column.type_ == S_BYTES) {
+                    auto &bytes = field.asByteArray();
+                    auto len = std::min(bytes.len, column.width_);
+                    part = 0;
+                    for (uint32_t i = 0; i < column.width_; ++i) {
+                        part = (part << 8) | (i < len ? bytes.ptr[i] : 0);
+                    }
+                    if (column.desc_) {
+                        part = ~part & (column.width_ == 8 ? -1ull : (1ull << (column.width_ * 8)) - 1);
+                    }
+                } else {
+                    part = numericKey(column, field);
+                }
+                // Shifting by 64 is undefined
+                key = column.width_ == 8 ? part : (key << (column.width_ * 8)) | part;
+            }
+            return key;
+        }
+
+        void SortKey::encodeWords(DataRow &row, uint64_t *dest) {
+            if (width_ <= 8) {
+                dest[0] = encode64(row);
+                return;
+            }
+            dest[words_ - 1] = 0;
+            encode(row, reinterpret_cast<uint8_t *>(dest));
+            for (uint32_t i = 0; i < words_; ++i) {
+                dest[i] = __builtin_bswap64(dest[i]);
+            }
+        }
+
+        bool SortKey::less(DataRow *a, DataRow *b) {
+            for (auto &column: columns_) {
+                auto &fa = (*a)[column.index_];
+                auto &fb = (*b)[column.index_];
+                bool lt, gt;
+                switch (column.type_) {
+                    case S_INT:
+                        lt = fa.asInt() < fb.asInt();
+                        gt = fb.asInt() < fa.asInt();
+                        break;
+                    case S_DOUBLE:
+                        lt = fa.asDouble() < fb.asDouble();
+                        gt = fb.asDouble() < fa.asDouble();
+                        break;
+                    default:
+                        lt = fa.asByteArray() < fb.asByteArray();
+                        gt = fb.asByteArray() < fa.asByteArray();
+                        break;
+                }
+                if (lt || gt) {
+                    return column.desc_ ? gt : lt;
+                }
+            }
+            return false;
+        }
+
+        function<bool(DataRow *, DataRow *)> SortKey::comparator() {
+            return [this](DataRow *a, DataRow *b) { return less(a, b); };
+        }
+
+        void SortKey::sort(vector<DataRow *> &rows, vector<uint64_t> *keys) {
+            if (width_ <= 8) {
+                radixSort(rows, keys);
+            } else {
+                wordSort(rows, keys);
+            }
+        }
+
+        void SortKey::radixSort(vector<DataRow *> &rows, vector<uint64_t> *keys) {
+            auto size = rows.size();
+            vector<pair<uint64_t, DataRow *>> entries(size);
+            vector<pair<uint64_t, DataRow *>> buffer(size);
+            for (uint64_t i = 0; i < size; ++i) {
+                entries[i] = {encode64(*rows[i]), rows[i]};
+            }
+            auto src = &entries;
+            auto dest = &buffer;
+            for (uint32_t pass = 0; pass < width_; ++pass) {
+                auto shift = pass * 8;
+                uint64_t offsets[257] = {0};
+                for (auto &entry: *src) {
+                    ++offsets[((entry.first >> shift) & 0xFF) + 1];
+                }
+                // Skip the digit shared by all keys
+                if (std::find(offsets + 1, offsets + 257, size) != offsets + 257) {
+                    continue;
+                }
+                for (uint32_t i = 1; i < 257; ++i) {
+                    offsets[i] += offsets[i - 1];
+                }
+                for (auto &entry: *src) {
+                    (*dest)[offsets[(entry.first >> shift) & 0xFF]++] = entry;
+                }
+                std::swap(src, dest);
+            }
+            auto &sorted = *src;
+            for (uint64_t i = 0; i < size; ++i) {
+                rows[i] = sorted[i].second;
+            }
+            if (!exact_) {
+                // Rows sharing a key are ordered by the full fields
+                uint64_t start = 0;
+                for (uint64_t i = 1; i <= size; ++i) {
+                    if (i == size || sorted[i].first != sorted[start].first) {
+                        if (i - start > 1) {
+                            std::sort(rows.begin() + start, rows.begin() + i, comparator());
+                        }
+                        start = i;
+                    }
+                }
+            }
+            if (keys) {
+                keys->resize(size);
+                for (uint64_t i = 0; i < size; ++i) {
+                    (*keys)[i] = sorted[i].first;
+                }
+            }
+        }
+
+        void SortKey::wordSort(vector<DataRow *> &rows, vector<uint64_t> *keys) {
+            auto size = rows.size();
+            auto words = words_;
+            vector<uint64_t> encoded(size * words);
+            vector<uint32_t> order(size);
+            for (uint32_t i = 0; i < size; ++i) {
+                encodeWords(*rows[i], encoded.data() + i * words);
+                order[i] = i;
+            }
+            auto data = encoded.data();
+            std::sort(order.begin(), order.end(), [this, &rows, data, words](uint32_t a, uint32_t b) {
+                return less(data + a * words, rows[a], data + b * words, rows[b]);
+            });
+            vector<DataRow *> sorted(size);
+            for (uint32_t i = 0; i < size; ++i) {
+                sorted[i] = rows[order[i]];
+            }
+            rows.swap(sorted);
+            if (keys) {
+                keys->resize(size * words);
+                for (uint32_t i = 0; i < size; ++i) {
+                    memcpy(keys->data() + i * words, data + order[i] * words, words * sizeof(uint64_t));
+                }
+            }
+        }
+
+        SortKeyFactory *SortKeyFactory::field(SORT_KEY_TYPE type, uint32_t index, bool desc, uint32_t prefix) {
+            uint32_t width = type == S_INT ? 4 : (type == S_DOUBLE ? 8 : prefix);
+            columns_.push_back({type, index, desc, width});
+            return this;
+        }
+
+        unique_ptr<SortKey> SortKeyFactory::build() {
+            return unique_ptr<SortKey>(new SortKey(columns_));
+        }
+
+        /// A MemBlock owning the bytes its ByteArray fields point to, and its layout
+        class SpillBlock : public MemBlock {
+        protected:
+            shared_ptr<vector<uint32_t>> layout_;
+            vector<unique_ptr<uint8_t[]>> chunks_;
+            uint32_t chunk_size_ = 0;
+            uint32_t used_ = 0;
+        public:
+            SpillBlock(uint32_t size, const shared_ptr<vector<uint32_t>> &col_offset)
+                    : MemBlock(size, *col_offset), layout_(col_offset) {}
+
+            const uint8_t *store(const ByteArray &bytes) {
+                if (used_ + bytes.len > chunk_size_) {
+                    chunk_size_ = std::max<uint32_t>(SORT_READ_AHEAD, bytes.len);
+                    chunks_.emplace_back(new uint8_t[chunk_size_]);
+                    used_ = 0;
+                }
+                auto dest = chunks_.back().get() + used_;
+                memcpy(dest, bytes.ptr, bytes.len);
+                used_ += bytes.len;
+                return dest;
+            }
+        };
+
+        void writeSpill(const void *data, size_t size, FILE *file) {
+            if (size > 0 && fwrite(data, 1, size, file) != size) {
+                throw std::invalid_argument("cannot write spill file");
+            }
+        }
+
+        void readSpill(void *data, size_t size, FILE *file) {
+            if (size > 0 && fread(data, 1, size, file) != size) {
+                throw std::invalid_argument("cannot read spill file");
+            }
+        }
+
+        void writeRow(DataRow &row, const vector<uint32_t> &col_size, FILE *file) {
+            for (uint32_t i = 0; i < col_size.size(); ++i) {
+                auto &field = row[i];
+                if (col_size[i] == 2) {
+                    auto &bytes = field.asByteArray();
+                    writeSpill(&bytes.len, sizeof(uint32_t), file);
+                    writeSpill(bytes.ptr, bytes.len, file);
+                } else {
+                    writeSpill(field.data(), sizeof(uint64_t) * col_size[i], file);
+                }
+            }
+        }
+
+        /// Reads back the rows of a spilled run, each after the words of its key if key_words is not 0
+        class SpillRun {
+        protected:
+            FILE *file_;
+            unique_ptr<char[]> buffer_;
+            uint64_t remain_;
+            const vector<uint32_t> &col_size_;
+            vector<uint64_t> key_;
+            MemDataRow row_;
+            vector<vector<uint8_t>> bytes_;
+        public:
+            SpillRun(int fd, uint64_t num_row, const vector<uint32_t> &col_size,
+                     const vector<uint32_t> &col_offset, uint32_t key_words)
+                    : file_(fdopen(fd, "rb")), buffer_(new char[SORT_READ_AHEAD]), remain_(num_row),
+                      col_size_(col_size), key_(key_words), row_(col_offset), bytes_(col_size.size()) {
+                if (file_ == nullptr) {
+                    close(fd);
+                    throw std::invalid_argument("cannot open spill file");
+                }
+                setvbuf(file_, buffer_.get(), _IOFBF, SORT_READ_AHEAD);
+            }
+
+            virtual ~SpillRun() {
+                fclose(file_);
+            }
+
+            bool next() {
+                if (remain_ == 0) {
+                    return false;
+                }
+                --remain_;
+                readSpill(key_.data(), key_.size() * sizeof(uint64_t), file_);
+                for (uint32_t i = 0; i < col_size_.size(); ++i) {
+                    auto &field = row_[i];
+                    if (col_size_[i] == 2) {
+                        uint32_t len;
+                        readSpill(&len, sizeof(uint32_t), file_);
+                        auto &bytes = bytes_[i];
+                        bytes.resize(len);
+                        readSpill(bytes.data(), len, file_);
+                        ByteArray value(len, bytes.data());
+                        field = value;
+                    } else {
+                        readSpill(field.data(), sizeof(uint64_t) * col_size_[i], file_);
+                    }
+                }
+                return true;
+            }
+
+            inline DataRow &row() { return row_; }
+
+            inline const uint64_t *key() { return key_.data(); }
+        };
+
+        /// Merges spilled runs with a heap, taking over their descriptors. Runs spilled with their
+        /// keys are merged by comparing the keys.
+        class RunMerger {
+        protected:
+            vector<uint32_t> col_size_;
+            vector<uint32_t> col_offset_;
+            function<bool(DataRow *, DataRow *)> comparator_;
+            SortKey *key_;
+            vector<unique_ptr<SpillRun>> runs_;
+            vector<SpillRun *> heap_;
+            SpillRun *last_ = nullptr;
+            uint64_t num_row_ = 0;
+
+            // The run with the smallest row on top
+            inline bool later(SpillRun *a, SpillRun *b) {
+                return key_ ? key_->less(b->key(), &b->row(), a->key(), &a->row())
+                            : comparator_(&b->row(), &a->row());
+            }
+
+        public:
+            RunMerger(vector<pair<int, uint64_t>> &files, const vector<uint32_t> &col_size,
+                      const vector<uint32_t> &col_offset, function<bool(DataRow *, DataRow *)> comparator,
+                      SortKey *key)
+                    : col_size_(col_size), col_offset_(col_offset), comparator_(comparator), key_(key) {
+                for (auto &file: files) {
+                    runs_.emplace_back(new SpillRun(file.first, file.second, col_size_, col_offset_,
+                                                    key_ ? key_->words() : 0));
+                    num_row_ += file.second;
+                }
+                for (auto &run: runs_) {
+                    if (run->next()) {
+                        heap_.push_back(run.get());
+                    }
+                }
+                make_heap(heap_.begin(), heap_.end(), bind(&RunMerger::later, this, _1, _2));
+            }
+
+            virtual ~RunMerger() = default;
+
+            /// The next row in order, valid until the next call, or nullptr when all runs are merged
+            DataRow *next() {
+                auto later = bind(&RunMerger::later, this, _1, _2);
+                if (last_) {
+                    if (last_->next()) {
+                        push_heap(heap_.begin(), heap_.end(), later);
+                    } else {
+                        heap_.pop_back();
+                    }
+                    last_ = nullptr;
+                }
+                if (heap_.empty()) {
+                    return nullptr;
+                }
+                pop_heap(heap_.begin(), heap_.end(), later);
+                last_ = heap_.back();
+                return &last_->row();
+            }
+
+            /// The key words of the row returned by next
+            inline const uint64_t *key() { return last_->key(); }
+
+            inline uint64_t numRow() { return num_row_; }
+
+            inline const vector<uint32_t> &colSize() { return col_size_; }
+        };
+
+        /// Produces the output blocks of ExternalSort one after another from the final merge
+        class MergedBlocks {
+        protected:
+            RunMerger merger_;
+            // The blocks outlive the merger
+            shared_ptr<vector<uint32_t>> col_offset_;
+            uint32_t next_block_ = 0;
+            mutex lock_;
+            condition_variable turn_;
+        public:
+            MergedBlocks(vector<pair<int, uint64_t>> &files, const vector<uint32_t> &col_size,
+                         const vector<uint32_t> &col_offset, function<bool(DataRow *, DataRow *)> comparator,
+                         SortKey *key)
+                    : merger_(files, col_size, col_offset, comparator, key),
+                      col_offset_(make_shared<vector<uint32_t>>(col_offset)) {}
+
+            inline uint32_t numBlock() {
+                return (merger_.numRow() + SORT_OUTPUT_BLOCK - 1) / SORT_OUTPUT_BLOCK;
+            }
+
+            /// Merge the index-th block. A parallel stream submits the blocks in order to a FIFO pool,
+            /// so waiting for the earlier blocks cannot block them.
+            shared_ptr<Block> block(uint32_t index) {
+                unique_lock<mutex> guard(lock_);
+                turn_.wait(guard, [this, index]() { return next_block_ == index; });
+
+                // Pass the turn on even if reading a run fails, the failure reaches the reader anyway
+                auto pass = [this]() {
+                    ++next_block_;
+                    turn_.notify_all();
+                };
+                auto &col_size = merger_.colSize();
+                auto block = make_shared<SpillBlock>(SORT_OUTPUT_BLOCK, col_offset_);
+                auto writer = block->rows();
+                uint32_t counter = 0;
+                try {
+                    DataRow *src;
+                    while (counter < SORT_OUTPUT_BLOCK && (src = merger_.next()) != nullptr) {
+                        DataRow &dest = (*writer)[counter++];
+                        for (uint32_t i = 0; i < col_size.size(); ++i) {
+                            if (col_size[i] == 2) {
+                                auto &bytes = (*src)[i].asByteArray();
+                                ByteArray copy(bytes.len, block->store(bytes));
+                                dest[i] = copy;
+                            } else {
+                                dest[i] = (*src)[i];
+                            }
+                        }
+                    }
+                } catch (const std::invalid_argument &) {
+                    pass();
+                    throw;
+                }
+                block->resize(counter);
+                pass();
+                return block;
+            }
+        };
+
+        SortedRun::SortedRun(SortKey &key, vector<DataRow *> &rows) {
+            key.sort(rows, &keys_);
+            auto words = key.words();
+            rows_.resize(rows.size());
+            for (uint64_t i = 0; i < rows.size(); ++i) {
+                rows_[i] = KeyedRow(keys_.data() + i * words, rows[i]);
+            }
+        }
+
+        inline DataRow *rowOf(DataRow *row) { return row; }
+
+        inline DataRow *rowOf(const KeyedRow &row) { return row.second; }
+
+        template<typename E, typename LESS>
+        void mergeSlices(vector<pair<E *, E *>> &slices, DataRow **dest, LESS &less) {
+            using Slice = pair<E *, E *>;
+            slices.erase(remove_if(slices.begin(), slices.end(), [](Slice &s) { return s.first == s.second; }),
+                         slices.end());
+            if (slices.empty()) {
+                return;
+            }
+            if (slices.size() <= 2) {
+                if (slices.size() == 2) {
+                    auto &a = slices[0];
+                    auto &b = slices[1];
+                    while (a.first != a.second && b.first != b.second) {
+                        // Take from the first slice on ties, as std::merge does
+                        *dest++ = rowOf(less(*b.first, *a.first) ? *b.first++ : *a.first++);
+                    }
+                }
+                for (auto &slice: slices) {
+                    dest = std::transform(slice.first, slice.second, dest, [](const E &e) { return rowOf(e); });
+                }
+                return;
+            }
+            // Heap of slices with the smallest head on top
+            auto later = [&less](const Slice &a, const Slice &b) { return less(*b.first, *a.first); };
+            make_heap(slices.begin(), slices.end(), later);
+            while (!slices.empty()) {
+                pop_heap(slices.begin(), slices.end(), later);
+                auto &top = slices.back();
+                *dest++ = rowOf(*top.first++);
+                if (top.first == top.second) {
+                    slices.pop_back();
+                } else {
+                    push_heap(slices.begin(), slices.end(), later);
+                }
+            }
+        }
+
+        template<typename E, typename LESS>
+        void mergeRuns(vector<vector<E> *> &runs, vector<DataRow *> &output, LESS less, bool parallel) {
+            uint64_t total = 0;
+            for (auto run: runs) {
+                total += run->size();
+            }
+            output.resize(total);
+            uint32_t num_range = 1;
+            if (parallel && total >= SORT_PARALLEL_THRESHOLD) {
+                num_range = StreamEvaluator::defaultExecutor->pool_size();
+            }
+
+            // Sample num_range - 1 rows from each run, and take evenly spaced ones as splitters
+            vector<E> splitters;
+            if (num_range > 1) {
+                vector<E> samples;
+                for (auto run: runs) {
+                    for (uint32_t i = 1; i < num_range; ++i) {
+                        if (!run->empty()) {
+                            samples.push_back((*run)[run->size() * i / num_range]);
+                        }
+                    }
+                }
+                std::sort(samples.begin(), samples.end(), less);
+                for (uint32_t i = 1; i < num_range; ++i) {
+                    splitters.push_back(samples[samples.size() * i / num_range]);
+                }
+            }
+            // bounds[i][r] is where range i starts in run r
+            vector<vector<uint64_t>> bounds(num_range + 1, vector<uint64_t>(runs.size(), 0));
+            for (uint32_t r = 0; r < runs.size(); ++r) {
+                auto &run = *runs[r];
+                for (uint32_t i = 1; i < num_range; ++i) {
+                    bounds[i][r] = lower_bound(run.begin(), run.end(), splitters[i - 1], less) - run.begin();
+                }
+                bounds[num_range][r] = run.size();
+            }
+            vector<uint64_t> starts(num_range + 1, 0);
+            for (uint32_t i = 0; i <= num_range; ++i) {
+                for (auto bound: bounds[i]) {
+                    starts[i] += bound;
+                }
+            }
+
+            function<void(const int32_t &)> merge_range = [&runs, &output, &less, &bounds, &starts](
+                    const int32_t &range) {
+                vector<pair<E *, E *>> slices;
+                for (uint32_t r = 0; r < runs.size(); ++r) {
+                    auto data = runs[r]->data();
+                    slices.emplace_back(data + bounds[range][r], data + bounds[range + 1][r]);
+                }
+                mergeSlices(slices, output.data() + starts[range], less);
+            };
+            auto range_stream = IntStream::Make(0, num_range);
+            (num_range > 1 ? range_stream->parallel() : range_stream->sequential())->foreach(merge_range);
+        }
+
+        void MergeRuns(vector<shared_ptr<vector<DataRow *>>> &runs, vector<DataRow *> &output,
+                       function<bool(DataRow *, DataRow *)> &comp, bool parallel) {
+            vector<vector<DataRow *> *> refs;
+            for (auto &run: runs) {
+                refs.push_back(run.get());
+            }
+            mergeRuns(refs, output, comp, parallel);
+        }
+
+        void MergeRuns(vector<shared_ptr<SortedRun>> &runs, vector<DataRow *> &output, SortKey &key, bool parallel) {
+            vector<vector<KeyedRow> *> refs;
+            for (auto &run: runs) {
+                refs.push_back(&run->rows());
+            }
+            mergeRuns(refs, output, [&key](const KeyedRow &a, const KeyedRow &b) {
+                return key.less(a.first, a.second, b.first, b.second);
+            }, parallel);
+        }
+
+        void ParallelSort(vector<shared_ptr<Block>> &blocks, bool parallel, function<DataRow *(DataRow &)> snapshoter,
+                          vector<DataRow *> &output, function<bool(DataRow *, DataRow *)> &comp,
+                          SortKey *key) {
+            auto snapshot = [&snapshoter](const shared_ptr<Block> &block) {
+                vector<DataRow *> run;
+                auto block_size = block->size();
+                run.reserve(block_size);
+                auto rows = block->rows();
+                for (uint32_t i = 0; i < block_size; ++i) {
+                    run.push_back(snapshoter(rows->next()));
+                }
+                return run;
+            };
+            auto stream = unique_ptr<Stream<shared_ptr<Block>>>(new VectorStream<shared_ptr<Block>>(blocks));
+            auto blocks_stream = parallel ? stream->parallel() : stream->sequential();
+            if (key) {
+                // The runs keep their keys, so the merge compares no fields unless keys are equal and inexact
+                function<shared_ptr<SortedRun>(const shared_ptr<Block> &)> sort_block =
+                        [&snapshot, key](const shared_ptr<Block> &block) {
+                            auto run = snapshot(block);
+                            return make_shared<SortedRun>(*key, run);
+                        };
+                auto runs = blocks_stream->map(sort_block)->collect();
+                MergeRuns(*runs, output, *key, parallel);
+            } else {
+                function<shared_ptr<vector<DataRow *>>(const shared_ptr<Block> &)> sort_block =
+                        [&snapshot, &comp](const shared_ptr<Block> &block) {
+                            auto run = make_shared<vector<DataRow *>>(snapshot(block));
+                            std::sort(run->begin(), run->end(), comp);
+                            return run;
+                        };
+                auto runs = blocks_stream->map(sort_block)->collect();
+                MergeRuns(*runs, output, comp, parallel);
+            }
+        }
     }
     using namespace sort;
 
     SmallSort::SmallSort(function<bool(DataRow *, DataRow *)> comp, bool vertical)
             : Node(1), comparator_(comp), vertical_(vertical) {}
 
+    SmallSort::SmallSort(unique_ptr<SortKey> key, bool vertical)
+            : Node(1), comparator_(key->comparator()), key_(move(key)), vertical_(vertical) {}
+
     unique_ptr<NodeOutput> SmallSort::execute(const vector<NodeOutput *> &inputs) {
         auto input0 = static_cast<TableOutput *>(inputs[0]);
         auto table = sort(*(input0->get()));
@@ -104,13 +713,15 @@ namespace lqf {
     shared_ptr<Table> SmallSort::sort(Table &table) {
         auto output = MemTable::Make(table.colSize(), false);
 
+        auto stream = table.blocks();
+        auto parallel = stream->isParallel();
+        auto blocks = stream->collect();
         auto sblock = make_shared<SortBlock>();
-        // TODO Note the multi-thread here
-        table.blocks()->sequential()->foreach([sblock](const shared_ptr<Block> &block) {
-            sblock->copy(block);
-        });
-        auto &container = sblock->content();
-        std::sort(container.begin(), container.end(), comparator_);
+        for (auto &block: *blocks) {
+            sblock->hold(block);
+        }
+        ParallelSort(*blocks, parallel, [](DataRow &row) { return row.snapshot().release(); }, sblock->content(),
+                     comparator_, key_.get());
         output->append(sblock);
         return output;
     }
@@ -120,6 +731,11 @@ namespace lqf {
                                function<unique_ptr<MemDataRow>(DataRow &)> snapshoter, bool vertical)
             : Node(1), col_size_(col_size), comparator_(comp), snapshoter_(snapshoter), vertical_(vertical) {}
 
+    SnapshotSort::SnapshotSort(const vector<uint32_t> col_size, unique_ptr<SortKey> key,
+                               function<unique_ptr<MemDataRow>(DataRow &)> snapshoter, bool vertical)
+            : Node(1), col_size_(col_size), comparator_(key->comparator()), snapshoter_(snapshoter),
+              key_(move(key)), vertical_(vertical) {}
+
     unique_ptr<NodeOutput> SnapshotSort::execute(const vector<NodeOutput *> &inputs) {
         auto input0 = static_cast<TableOutput *>(inputs[0]);
         auto table = sort(*(input0->get()));
@@ -127,25 +743,193 @@ namespace lqf {
     }
 
     shared_ptr<Table> SnapshotSort::sort(Table &input) {
+        auto stream = input.blocks();
+        auto parallel = stream->isParallel();
+        auto blocks = stream->collect();
         auto memblock = make_shared<SortBlock>();
-        auto row_cache = &(memblock->content());
-        input.blocks()->sequential()->foreach([this, row_cache](const shared_ptr<Block> &block) {
-            auto block_size = block->size();
+        ParallelSort(*blocks, parallel, [this](DataRow &row) { return snapshoter_(row).release(); },
+                     memblock->content(), comparator_, key_.get());
+        auto resultTable = MemTable::Make(col_size_, vertical_);
+        resultTable->append(memblock);
+        return resultTable;
+    }
+
+    ExternalSort::ExternalSort(function<bool(DataRow *, DataRow *)> comp, uint64_t budget, string temp_dir)
+            : Node(1), comparator_(comp), budget_(budget), temp_dir_(temp_dir) {}
+
+    ExternalSort::ExternalSort(unique_ptr<SortKey> key, uint64_t budget, string temp_dir)
+            : Node(1), comparator_(key->comparator()), key_(move(key)), budget_(budget), temp_dir_(temp_dir) {}
+
+    unique_ptr<NodeOutput> ExternalSort::execute(const vector<NodeOutput *> &inputs) {
+        auto input0 = static_cast<TableOutput *>(inputs[0]);
+        auto table = sort(*(input0->get()));
+        return unique_ptr<TableOutput>(new TableOutput(table));
+    }
+
+    void ExternalSort::sortRun(vector<DataRow *> &run, vector<uint64_t> *keys) {
+        if (key_) {
+            key_->sort(run, keys);
+        } else {
+            std::sort(run.begin(), run.end(), comparator_);
+        }
+    }
+
+    FILE *ExternalSort::openSpill(int &fd) {
+        string path = temp_dir_ + "/lqf_sort_XXXXXX";
+        fd = mkstemp(&path[0]);
+        if (fd < 0) {
+            throw std::invalid_argument("cannot create spill file in " + temp_dir_);
+        }
+        // The file is removed once closed
+        unlink(path.c_str());
+        // Write through a duplicate, so the run is read back with a fresh buffer
+        int write_fd = dup(fd);
+        if (write_fd < 0) {
+            close(fd);
+            throw std::invalid_argument("cannot duplicate spill file descriptor");
+        }
+        auto file = fdopen(write_fd, "wb");
+        if (file == nullptr) {
+            close(write_fd);
+            close(fd);
+            throw std::invalid_argument("cannot open spill file");
+        }
+        return file;
+    }
+
+    void ExternalSort::closeSpill(FILE *file, int fd) {
+        if (fclose(file) != 0 || lseek(fd, 0, SEEK_SET) != 0) {
+            close(fd);
+            throw std::invalid_argument("cannot write spill file");
+        }
+    }
+
+    int ExternalSort::spill(vector<DataRow *> &run, const vector<uint32_t> &col_size) {
+        int fd;
+        auto file = openSpill(fd);
+        vector<uint64_t> keys;
+        sortRun(run, &keys);
+        auto words = key_ ? key_->words() : 0;
+        try {
+            for (uint64_t i = 0; i < run.size(); ++i) {
+                writeSpill(keys.data() + i * words, words * sizeof(uint64_t), file);
+                writeRow(*run[i], col_size, file);
+            }
+        } catch (const std::invalid_argument &) {
+            fclose(file);
+            close(fd);
+            throw;
+        }
+        closeSpill(file, fd);
+        ++num_run_;
+        return fd;
+    }
+
+    pair<int, uint64_t> ExternalSort::mergeSpill(vector<pair<int, uint64_t>> &files, const vector<uint32_t> &col_size,
+                                                 const vector<uint32_t> &col_offset) {
+        RunMerger merger(files, col_size, col_offset, comparator_, key_.get());
+        int fd;
+        auto file = openSpill(fd);
+        auto words = key_ ? key_->words() : 0;
+        try {
+            DataRow *row;
+            while ((row = merger.next()) != nullptr) {
+                writeSpill(merger.key(), words * sizeof(uint64_t), file);
+                writeRow(*row, col_size, file);
+            }
+        } catch (const std::invalid_argument &) {
+            fclose(file);
+            close(fd);
+            throw;
+        }
+        closeSpill(file, fd);
+        return pair<int, uint64_t>(fd, merger.numRow());
+    }
+
+    shared_ptr<Table> ExternalSort::sort(Table &input) {
+        auto &col_size = input.colSize();
+        auto col_offset = lqf::size2offset(col_size);
+        uint64_t row_bytes = col_offset.back() * sizeof(uint64_t) + sizeof(MemDataRow);
+        num_run_ = 0;
+        num_pass_ = 0;
+
+        vector<DataRow *> run;
+        vector<shared_ptr<Block>> sources;
+        uint64_t run_bytes = 0;
+        vector<pair<int, uint64_t>> files;
+        // Snapshots may refer to the memory of their blocks, so the rows are read sequentially
+        // and a run keeps its blocks until it is spilled
+        input.blocks()->sequential()->foreach([&](const shared_ptr<Block> &block) {
+            sources.push_back(block);
             auto rows = block->rows();
+            auto block_size = block->size();
             for (uint32_t i = 0; i < block_size; ++i) {
-                row_cache->push_back(snapshoter_(rows->next()).release());
+                auto row = rows->next().snapshot().release();
+                run.push_back(row);
+                run_bytes += row_bytes;
+                for (uint32_t c = 0; c < col_size.size(); ++c) {
+                    if (col_size[c] == 2) {
+                        run_bytes += (*row)[c].asByteArray().len;
+                    }
+                }
+                if (run_bytes >= budget_) {
+                    files.emplace_back(spill(run, col_size), run.size());
+                    for (auto r: run) {
+                        delete r;
+                    }
+                    run.clear();
+                    run_bytes = 0;
+                    sources.clear();
+                    sources.push_back(block);
+                }
             }
         });
 
-        std::sort(row_cache->begin(), row_cache->end(), comparator_);
-        auto resultTable = MemTable::Make(col_size_, vertical_);
-        resultTable->append(memblock);
-        return resultTable;
+        if (files.empty()) {
+            auto result = MemTable::Make(col_size);
+            auto sblock = make_shared<SortBlock>();
+            for (auto &source: sources) {
+                sblock->hold(source);
+            }
+            sortRun(run, nullptr);
+            sblock->content().swap(run);
+            result->append(sblock);
+            return result;
+        }
+        if (!run.empty()) {
+            files.emplace_back(spill(run, col_size), run.size());
+            for (auto r: run) {
+                delete r;
+            }
+            run.clear();
+        }
+        sources.clear();
+
+        // Each pass merges groups of SORT_MERGE_FANIN runs, bounding the open files and read-ahead buffers
+        while (files.size() > SORT_MERGE_FANIN) {
+            vector<pair<int, uint64_t>> merged;
+            for (uint32_t start = 0; start < files.size(); start += SORT_MERGE_FANIN) {
+                auto end = std::min<uint32_t>(start + SORT_MERGE_FANIN, files.size());
+                vector<pair<int, uint64_t>> group(files.begin() + start, files.begin() + end);
+                merged.push_back(mergeSpill(group, col_size, col_offset));
+            }
+            files.swap(merged);
+            ++num_pass_;
+        }
+
+        auto blocks = make_shared<MergedBlocks>(files, col_size, col_offset, comparator_, key_.get());
+        function<shared_ptr<Block>(const int32_t &)> merge_block = [blocks](const int32_t &index) {
+            return blocks->block(index);
+        };
+        return make_shared<TableView>(RAW, col_size, IntStream::Make(0, blocks->numBlock())->map(merge_block));
     }
 
     TopN::TopN(uint32_t n, function<bool(DataRow *, DataRow *)> comp, bool vertical)
             : Node(1), n_(n), comparator_(comp), vertical_(vertical) {}
 
+    TopN::TopN(uint32_t n, unique_ptr<SortKey> key, bool vertical)
+            : Node(1), n_(n), comparator_(key->comparator()), key_(move(key)), vertical_(vertical) {}
+
     unique_ptr<NodeOutput> TopN::execute(const vector<NodeOutput *> &inputs) {
         auto input0 = static_cast<TableOutput *>(inputs[0]);
         auto table = sort(*(input0->get()));
@@ -154,17 +938,20 @@ namespace lqf {
 
     shared_ptr<Table> TopN::sort(Table &table) {
         auto resultTable = MemTable::Make(table.colSize(), vertical_);
+        key_bound_ = UINT64_MAX;
+        atomic_store(&row_bound_, shared_ptr<DataRow>());
 
-        vector<DataRow *> collector;
-
-        function<void(const shared_ptr<Block> &)> proc =
-                bind(&TopN::sortBlock, this, &collector, resultTable.get(), _1);
-        table.blocks()->foreach(proc);
-
-        /// Make a final sort and fetch the top n
-        if (collector.size() > n_) {
-            std::sort(collector.begin(), collector.end(), comparator_);
+        function<shared_ptr<vector<DataRow *>>(const shared_ptr<Block> &)> proc;
+        if (key_ && key_->exact() && key_->width() <= 8) {
+            proc = bind(&TopN::sortBlockByKey, this, resultTable.get(), _1);
+        } else {
+            proc = bind(&TopN::sortBlock, this, resultTable.get(), _1);
         }
+        auto runs = table.blocks()->map(proc)->collect();
+
+        /// Merge the sorted heaps and fetch the top n
+        vector<DataRow *> collector;
+        MergeRuns(*runs, collector, comparator_, false);
 
         auto result_size = std::min(n_, static_cast<uint32_t>(collector.size()));
         auto resultBlock = resultTable->allocate(result_size);
@@ -179,22 +966,87 @@ namespace lqf {
         return resultTable;
     }
 
-    void TopN::sortBlock(vector<DataRow *> *collector, MemTable *dest, const shared_ptr<Block> &input) {
+    void TopN::publish(DataRow *kth, MemTable *dest) {
+        auto current = atomic_load(&row_bound_);
+        if (current && !comparator_(kth, current.get())) {
+            return;
+        }
+        // A snapshot of a MemDataRow refers to its memory, which the heap reuses
+        auto bound = make_shared<MemDataRow>(dest->colOffset());
+        *bound = *kth;
+        shared_ptr<DataRow> published = bound;
+        // Retry if another block published a row in between, unless that one is better
+        while (!atomic_compare_exchange_weak(&row_bound_, &current, published)) {
+            if (current && !comparator_(kth, current.get())) {
+                return;
+            }
+        }
+    }
+
+    shared_ptr<vector<DataRow *>> TopN::sortBlock(MemTable *dest, const shared_ptr<Block> &input) {
         Heap<DataRow *> heap(n_, [=]() { return new MemDataRow(dest->colOffset()); }, comparator_);
+        auto bound = atomic_load(&row_bound_);
         auto rows = input->rows();
         auto block_size = input->size();
         for (uint32_t i = 0; i < block_size; ++i) {
             DataRow &row = rows->next();
+            if (bound && !comparator_(&row, bound.get())) {
+                continue;
+            }
             heap.add(&row);
         }
+        if (heap.content().size() == n_) {
+            // The heap root is its k-th row before sorting
+            publish(heap.content()[0], dest);
+        }
         heap.done();
 
-        /// Collect the result
-        collector_lock_.lock();
-        auto content = heap.content();
-        collector->insert(collector->end(), content.begin(), content.end());
+        auto content = make_shared<vector<DataRow *>>(heap.content());
         // So heap will not delete these pointers as they have been moved
         heap.content().clear();
-        collector_lock_.unlock();
+        return content;
+    }
+
+    shared_ptr<vector<DataRow *>> TopN::sortBlockByKey(MemTable *dest, const shared_ptr<Block> &input) {
+        // Keys of the n smallest rows with copies of the rows, the largest on top. Rows are copied
+        // as they are accepted, as the rows of a parquet or masked block can only be read forward.
+        using Entry = pair<uint64_t, DataRow *>;
+        auto later = [](const Entry &a, const Entry &b) { return a.first < b.first; };
+        vector<Entry> heap;
+        heap.reserve(n_);
+        auto rows = input->rows();
+        auto block_size = input->size();
+        for (uint32_t i = 0; i < block_size && n_ > 0; ++i) {
+            DataRow &row = rows->next();
+            auto key = key_->encode64(row);
+            if (key > key_bound_.load(memory_order_relaxed)) {
+                continue;
+            }
+            if (heap.size() < n_) {
+                auto slot = new MemDataRow(dest->colOffset());
+                *slot = row;
+                heap.emplace_back(key, slot);
+                push_heap(heap.begin(), heap.end(), later);
+            } else if (key < heap.front().first) {
+                // Reuse the slot of the evicted row
+                pop_heap(heap.begin(), heap.end(), later);
+                heap.back().first = key;
+                *heap.back().second = row;
+                push_heap(heap.begin(), heap.end(), later);
+            } else {
+                continue;
+            }
+            if (heap.size() == n_) {
+                auto kth = heap.front().first;
+                auto bound = key_bound_.load(memory_order_relaxed);
+                while (kth < bound && !key_bound_.compare_exchange_weak(bound, kth, memory_order_relaxed));
+            }
+        }
+        sort_heap(heap.begin(), heap.end(), later);
+        auto content = make_shared<vector<DataRow *>>(heap.size());
+        for (uint32_t i = 0; i < heap.size(); ++i) {
+            (*content)[i] = heap[i].second;
+        }
+        return content;
     }
 }
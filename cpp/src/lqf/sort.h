@@ -19,6 +19,18 @@
 #define SILE(x) (*a)[x].asInt() < (*b)[x].asInt()
 #define SIGE(x) (*a)[x].asInt() > (*b)[x].asInt()
 #define SIE(x) (*a)[x].asInt() == (*b)[x].asInt()
+// Sorted runs with fewer rows in total are merged by a single thread
+#define SORT_PARALLEL_THRESHOLD 65536
+// Leading bytes of a ByteArray column encoded in a sort key by default
+#define SORT_KEY_PREFIX 8
+// Bytes of rows ExternalSort buffers before sorting and spilling them as a run
+#define SORT_MEMORY_BUDGET (256ull << 20)
+// Read-ahead buffer of each spilled run
+#define SORT_READ_AHEAD (1 << 20)
+// Rows in an output block of ExternalSort
+#define SORT_OUTPUT_BLOCK 65536
+// Largest number of runs ExternalSort merges at once, more runs are merged in multiple passes
+#define SORT_MERGE_FANIN 64
 using namespace std;
 
 namespace lqf {
@@ -48,6 +60,9 @@ namespace lqf {
 
             void copy(const shared_ptr<Block> &source);
 
+            /// Keep the source alive for the snapshots referring to it
+            inline void hold(const shared_ptr<Block> &source) { sources_.push_back(source); }
+
             inline vector<DataRow *> &content() { return content_; }
 
             unique_ptr<ColumnIterator> col(uint32_t) override;
@@ -56,18 +71,132 @@ namespace lqf {
 
             shared_ptr<Block> mask(shared_ptr<Bitmap>) override;
         };
+
+        enum SORT_KEY_TYPE {
+            S_INT, S_DOUBLE, S_BYTES
+        };
+
+        struct SortKeyColumn {
+            SORT_KEY_TYPE type_;
+            uint32_t index_;
+            bool desc_;
+            // Bytes in the key
+            uint32_t width_;
+        };
+
+        /**
+         * SortKey encodes the sort columns of a row into a byte string whose memcmp order is the
+         * row order. Integers flip the sign bit, doubles flip the sign bit of positive values and
+         * all bits of negative ones, and ByteArrays keep a zero-padded prefix. DESC columns invert
+         * their bytes. Keys of up to 8 bytes are sorted as integers by an LSD radix sort, longer
+         * ones by comparing their big-endian 8-byte words as integers, which is the memcmp order.
+         * Prefixes make a key inexact, rows with equal keys then compare fields.
+         */
+        class SortKey {
+        protected:
+            vector<SortKeyColumn> columns_;
+            uint32_t width_;
+            uint32_t words_;
+            bool exact_;
+
+            void radixSort(vector<DataRow *> &, vector<uint64_t> *keys);
+
+            void wordSort(vector<DataRow *> &, vector<uint64_t> *keys);
+
+        public:
+            SortKey(vector<SortKeyColumn>);
+
+            /// Key length in bytes
+            inline uint32_t width() { return width_; }
+
+            /// Key length in 64-bit words
+            inline uint32_t words() { return words_; }
+
+            /// Whether equal keys mean equal sort columns
+            inline bool exact() { return exact_; }
+
+            void encode(DataRow &, uint8_t *);
+
+            /// The key as a big-endian integer, only for keys of up to 8 bytes
+            uint64_t encode64(DataRow &);
+
+            /// The key as words() big-endian integers, zero-padded
+            void encodeWords(DataRow &, uint64_t *);
+
+            /// Compare the sort columns of two rows, consistent with the key order
+            bool less(DataRow *, DataRow *);
+
+            /// Compare two rows by their encoded words, and by the fields if inexact keys are equal
+            inline bool less(const uint64_t *ka, DataRow *a, const uint64_t *kb, DataRow *b) {
+                for (uint32_t i = 0; i < words_; ++i) {
+                    if (ka[i] != kb[i]) {
+                        return ka[i] < kb[i];
+                    }
+                }
+                return !exact_ && less(a, b);
+            }
+
+            function<bool(DataRow *, DataRow *)> comparator();
+
+            /// Sort the rows, and output the words of their keys in the sorted order if keys is given
+            void sort(vector<DataRow *> &, vector<uint64_t> *keys = nullptr);
+        };
+
+        class SortKeyFactory {
+        protected:
+            vector<SortKeyColumn> columns_;
+        public:
+            SortKeyFactory *field(SORT_KEY_TYPE, uint32_t index, bool desc = false, uint32_t prefix = SORT_KEY_PREFIX);
+
+            unique_ptr<SortKey> build();
+        };
+
+        using KeyedRow = pair<const uint64_t *, DataRow *>;
+
+        /// A run sorted by a SortKey, keeping the encoded key of each row to merge by
+        class SortedRun {
+        protected:
+            vector<uint64_t> keys_;
+            vector<KeyedRow> rows_;
+        public:
+            SortedRun(SortKey &, vector<DataRow *> &rows);
+
+            inline vector<KeyedRow> &rows() { return rows_; }
+        };
+
+        /**
+         * Merge sorted runs into output. Splitters sampled from all runs cut the output into
+         * ranges of similar size, and each range is merged from its slices of the runs in parallel.
+         */
+        void MergeRuns(vector<shared_ptr<vector<DataRow *>>> &runs, vector<DataRow *> &output,
+                       function<bool(DataRow *, DataRow *)> &comp, bool parallel);
+
+        /// Merge runs sorted by the key, comparing their encoded keys
+        void MergeRuns(vector<shared_ptr<SortedRun>> &runs, vector<DataRow *> &output, SortKey &key, bool parallel);
+
+        /**
+         * Snapshot and sort the rows of each block on the workers, then merge the runs into output
+         */
+        void ParallelSort(vector<shared_ptr<Block>> &blocks, bool parallel, function<DataRow *(DataRow &)> snapshoter,
+                          vector<DataRow *> &output, function<bool(DataRow *, DataRow *)> &comp,
+                          SortKey *key = nullptr);
     }
+    using namespace sort;
+
     /**
      *
      */
     class SmallSort : public Node {
     protected:
         function<bool(DataRow *, DataRow *)> comparator_;
+        unique_ptr<SortKey> key_;
         bool vertical_ = false;
 
     public:
         SmallSort(function<bool(DataRow *, DataRow *)>, bool vertical = false);
 
+        SmallSort(unique_ptr<SortKey>, bool vertical = false);
+
         virtual ~SmallSort() = default;
 
         unique_ptr<NodeOutput> execute(const vector<NodeOutput *> &) override;
@@ -80,27 +209,101 @@ namespace lqf {
         vector<uint32_t> col_size_;
         function<bool(DataRow *, DataRow *)> comparator_;
         function<unique_ptr<MemDataRow>(DataRow &)> snapshoter_;
+        unique_ptr<SortKey> key_;
         bool vertical_;
     public:
         SnapshotSort(const vector<uint32_t>, function<bool(DataRow *, DataRow *)>,
                      function<unique_ptr<MemDataRow>(DataRow &)>, bool vertical = false);
 
+        /// The key columns refer to the snapshots
+        SnapshotSort(const vector<uint32_t>, unique_ptr<SortKey>,
+                     function<unique_ptr<MemDataRow>(DataRow &)>, bool vertical = false);
+
         virtual ~SnapshotSort() = default;
 
         unique_ptr<NodeOutput> execute(const vector<NodeOutput *> &) override;
 
+        virtual shared_ptr<Table> sort(Table &);
+    };
+
+    /**
+     * ExternalSort sorts inputs larger than memory. Rows are buffered up to a memory budget, then
+     * sorted and spilled as a run to an unlinked temp file, with ByteArrays written as length and
+     * bytes. With a SortKey, the encoded key is written before each row and the runs are merged by
+     * comparing keys. While there are more than SORT_MERGE_FANIN runs, groups of them are merged
+     * into longer runs on disk. A heap then merges the remaining runs through read-ahead buffers
+     * into blocks owning their bytes. The blocks are merged as the result table is read, which can be done once,
+     * and the node must outlive it. An input within the budget is sorted in memory without spilling.
+     */
+    class ExternalSort : public Node {
+    protected:
+        function<bool(DataRow *, DataRow *)> comparator_;
+        unique_ptr<SortKey> key_;
+        uint64_t budget_;
+        string temp_dir_;
+        uint32_t num_run_ = 0;
+        uint32_t num_pass_ = 0;
+
+        /// Sort a run, and output the words of the keys in the sorted order if sorted by a key
+        void sortRun(vector<DataRow *> &, vector<uint64_t> *keys);
+
+        /// Create an unlinked temp file, returning its descriptor and a stream writing to it
+        FILE *openSpill(int &fd);
+
+        /// Flush the written stream and rewind the file to read it back
+        void closeSpill(FILE *, int fd);
+
+        /// Sort and write a run, returning the descriptor of the file to read it back
+        int spill(vector<DataRow *> &, const vector<uint32_t> &col_size);
+
+        /// Merge the runs into a single run on disk
+        pair<int, uint64_t> mergeSpill(vector<pair<int, uint64_t>> &files, const vector<uint32_t> &col_size,
+                                       const vector<uint32_t> &col_offset);
+
+    public:
+        ExternalSort(function<bool(DataRow *, DataRow *)>, uint64_t budget = SORT_MEMORY_BUDGET,
+                     string temp_dir = "/tmp");
+
+        ExternalSort(unique_ptr<SortKey>, uint64_t budget = SORT_MEMORY_BUDGET, string temp_dir = "/tmp");
+
+        virtual ~ExternalSort() = default;
+
+        unique_ptr<NodeOutput> execute(const vector<NodeOutput *> &) override;
+
         shared_ptr<Table> sort(Table &);
+
+        /// Runs spilled by the last sort
+        inline uint32_t numRun() { return num_run_; }
+
+        /// Merge passes over the spilled runs before the final merge in the last sort
+        inline uint32_t numPass() { return num_pass_; }
     };
 
+    /**
+     * TopN ranks each block in its own heap without locking, and merges the sorted heaps at last.
+     * The k-th best row of a finished block bounds the global k-th best, and is published for the
+     * blocks starting later to skip worse rows before touching their heaps. Exact keys of up to
+     * 8 bytes publish the bound as an atomic integer whenever a heap improves.
+     */
     class TopN : public Node {
     private:
         uint32_t n_;
-        mutex collector_lock_;
         function<bool(DataRow *, DataRow *)> comparator_;
+        unique_ptr<SortKey> key_;
         bool vertical_ = false;
+        // Smallest k-th key among the blocks
+        atomic<uint64_t> key_bound_;
+        // Best k-th row among the finished blocks, accessed by atomic_load and atomic_store
+        shared_ptr<DataRow> row_bound_;
+
+        void publish(DataRow *, MemTable *);
+
     public:
         TopN(uint32_t, function<bool(DataRow *, DataRow *)>, bool vertical = false);
 
+        /// Exact keys of up to 8 bytes rank the rows of a block by integer compares
+        TopN(uint32_t, unique_ptr<SortKey>, bool vertical = false);
+
         virtual ~TopN() = default;
 
         unique_ptr<NodeOutput> execute(const vector<NodeOutput *> &) override;
@@ -108,7 +311,9 @@ namespace lqf {
         shared_ptr<Table> sort(Table &);
 
     protected:
-        void sortBlock(vector<DataRow *> *, MemTable *, const shared_ptr<Block> &input);
+        shared_ptr<vector<DataRow *>> sortBlock(MemTable *, const shared_ptr<Block> &input);
+
+        shared_ptr<vector<DataRow *>> sortBlockByKey(MemTable *, const shared_ptr<Block> &input);
     };
 }
 #endif //ARROW_SORT_H
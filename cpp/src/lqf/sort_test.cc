@@ -117,4 +117,363 @@ TEST(SmallSortTest, Sort) {
     for (int i = 0; i < 1000; ++i) {
         EXPECT_EQ(buffer[i], (*sortedrows)[i][2].asInt()) << i;
     }
-}
\ No newline at end of file
+}
+
+TEST(SmallSortTest, ParallelMerge) {
+    auto table = MemTable::Make(2);
+    vector<int> buffer;
+    for (int b = 0; b < 8; ++b) {
+        // An empty block makes an empty run
+        int block_size = b == 3 ? 0 : 20000 + b * 1000;
+        auto block = table->allocate(block_size);
+        auto rows = block->rows();
+        for (int i = 0; i < block_size; i++) {
+            // Many duplicates across the runs
+            int next = rand() % 5000;
+            buffer.push_back(next);
+            (*rows)[i][0] = next;
+            (*rows)[i][1] = static_cast<double>(b);
+        }
+    }
+    function<bool(DataRow *, DataRow *)> comparator = [](DataRow *a, DataRow *b) {
+        return SILE(0);
+    };
+    std::sort(buffer.begin(), buffer.end());
+
+    auto check = [&buffer](shared_ptr<Table> sorted) {
+        auto sortedblock = (*sorted->blocks()->collect())[0];
+        ASSERT_EQ(buffer.size(), sortedblock->size());
+        auto sortedrows = sortedblock->rows();
+        for (uint32_t i = 0; i < buffer.size(); ++i) {
+            ASSERT_EQ(buffer[i], (*sortedrows)[i][0].asInt()) << i;
+        }
+    };
+    SmallSort sort(comparator);
+    check(sort.sort(*table));
+    // Runs merged by keys of one word and of two words
+    SmallSort keysort(SortKeyFactory().field(S_INT, 0)->build());
+    check(keysort.sort(*table));
+    SmallSort widesort(SortKeyFactory().field(S_INT, 0)->field(S_DOUBLE, 1, true)->build());
+    auto widesorted = widesort.sort(*table);
+    check(widesorted);
+    auto widerows = (*widesorted->blocks()->collect())[0]->rows();
+    for (uint32_t i = 1; i < buffer.size(); ++i) {
+        if ((*widerows)[i - 1][0].asInt() == (*widerows)[i][0].asInt()) {
+            ASSERT_GE((*widerows)[i - 1][1].asDouble(), (*widerows)[i][1].asDouble()) << i;
+        }
+    }
+}
+
+TEST(SortKeyTest, Encode) {
+    auto key = SortKeyFactory().field(S_INT, 0)->field(S_DOUBLE, 1, true)->build();
+    EXPECT_EQ(12, key->width());
+    EXPECT_TRUE(key->exact());
+
+    vector<int> ints{INT32_MIN, -5, -1, 0, 1, 7, INT32_MAX};
+    vector<double> doubles{-1e10, -2.5, -0.5, 0, 0.5, 3.25, 1e12};
+    vector<MemDataRow> rows;
+    for (auto i: ints) {
+        for (auto d: doubles) {
+            MemDataRow row(2);
+            row[0] = i;
+            row[1] = d;
+            rows.push_back(row);
+        }
+    }
+    for (auto &a: rows) {
+        for (auto &b: rows) {
+            uint8_t ka[12];
+            uint8_t kb[12];
+            key->encode(a, ka);
+            key->encode(b, kb);
+            EXPECT_EQ(key->less(&a, &b), memcmp(ka, kb, 12) < 0);
+            uint64_t wa[2];
+            uint64_t wb[2];
+            key->encodeWords(a, wa);
+            key->encodeWords(b, wb);
+            EXPECT_EQ(key->less(&a, &b), key->less(wa, &a, wb, &b));
+        }
+    }
+
+    auto key64 = SortKeyFactory().field(S_INT, 1, true)->field(S_INT, 0)->build();
+    for (auto &a: rows) {
+        a[1] = static_cast<int32_t>(a[1].asDouble());
+    }
+    for (auto &a: rows) {
+        for (auto &b: rows) {
+            EXPECT_EQ(key64->less(&a, &b), key64->encode64(a) < key64->encode64(b));
+        }
+    }
+}
+
+TEST(SortKeyTest, Sort) {
+    auto table = MemTable::Make(vector<uint32_t>{1, 2, 1});
+    vector<string> words{"apple", "applesauce", "apply", "banana", "band", "bandana", "", "b", "ab"};
+    vector<tuple<int, string, int>> expect;
+    for (int b = 0; b < 4; ++b) {
+        auto block = table->allocate(3000);
+        auto rows = block->rows();
+        for (int i = 0; i < 3000; ++i) {
+            auto &word = words[(i * 7 + b) % words.size()];
+            ByteArray bytes(word.size(), reinterpret_cast<const uint8_t *>(word.data()));
+            DataRow &row = (*rows)[i];
+            row[0] = (i * 13) % 50 - 25;
+            row[1] = bytes;
+            row[2] = b * 3000 + i;
+            expect.emplace_back(row[0].asInt(), word, row[2].asInt());
+        }
+    }
+    // Sorted by int desc, then by string with a 4-byte prefix
+    std::sort(expect.begin(), expect.end(), [](const tuple<int, string, int> &a, const tuple<int, string, int> &b) {
+        return get<0>(a) > get<0>(b) || (get<0>(a) == get<0>(b) && get<1>(a) < get<1>(b));
+    });
+    for (uint32_t prefix: {4, 12}) {
+        // A 4-byte prefix makes an 8-byte key of radix sort, the other one is sorted by its words
+        SmallSort sort(SortKeyFactory().field(S_INT, 0, true)->field(S_BYTES, 1, false, prefix)->build());
+        auto sorted = sort.sort(*table);
+        auto sortedblock = (*sorted->blocks()->collect())[0];
+        ASSERT_EQ(expect.size(), sortedblock->size());
+        auto rows = sortedblock->rows();
+        for (uint32_t i = 0; i < expect.size(); ++i) {
+            DataRow &row = rows->next();
+            ASSERT_EQ(get<0>(expect[i]), row[0].asInt()) << i;
+            auto &bytes = row[1].asByteArray();
+            ASSERT_EQ(get<1>(expect[i]), string(reinterpret_cast<const char *>(bytes.ptr), bytes.len)) << i;
+        }
+    }
+}
+
+TEST(TopNTest, SortKey) {
+    auto table = MemTable::Make(2);
+    vector<pair<int, int>> buffer;
+    for (int b = 0; b < 5; ++b) {
+        auto block = table->allocate(1000);
+        auto rows = block->rows();
+        for (int i = 0; i < 1000; ++i) {
+            int first = rand() % 100 - 50;
+            int second = rand();
+            (*rows)[i][0] = first;
+            (*rows)[i][1] = second;
+            buffer.emplace_back(-first, second);
+        }
+    }
+    std::sort(buffer.begin(), buffer.end());
+
+    TopN top(20, SortKeyFactory().field(S_INT, 0, true)->field(S_INT, 1)->build());
+    auto sorted = top.sort(*table);
+    auto sortedblock = (*sorted->blocks()->collect())[0];
+    ASSERT_EQ(20, sortedblock->size());
+    auto rows = sortedblock->rows();
+    for (int i = 0; i < 20; ++i) {
+        DataRow &row = rows->next();
+        EXPECT_EQ(-buffer[i].first, row[0].asInt());
+        EXPECT_EQ(buffer[i].second, row[1].asInt());
+    }
+}
+
+/// Rows can only be read forward, as those of a parquet block
+class ForwardRowIterator : public DataRowIterator {
+    unique_ptr<DataRowIterator> inner_;
+public:
+    ForwardRowIterator(unique_ptr<DataRowIterator> inner) : inner_(move(inner)) {}
+
+    DataRow &operator[](uint64_t idx) override {
+        if (idx < inner_->pos()) {
+            throw std::logic_error("row read backward");
+        }
+        return (*inner_)[idx];
+    }
+
+    DataRow &next() override { return inner_->next(); }
+
+    uint64_t pos() override { return inner_->pos(); }
+};
+
+class ForwardBlock : public Block {
+    shared_ptr<Block> inner_;
+public:
+    ForwardBlock(shared_ptr<Block> inner) : inner_(inner) {}
+
+    uint64_t size() override { return inner_->size(); }
+
+    unique_ptr<ColumnIterator> col(uint32_t index) override { return inner_->col(index); }
+
+    unique_ptr<DataRowIterator> rows() override {
+        return unique_ptr<DataRowIterator>(new ForwardRowIterator(inner_->rows()));
+    }
+
+    shared_ptr<Block> mask(shared_ptr<Bitmap> mask) override { return inner_->mask(mask); }
+};
+
+TEST(TopNTest, ForwardOnlyRows) {
+    auto table = MemTable::Make(2);
+    vector<pair<int, int>> buffer;
+    for (int b = 0; b < 3; ++b) {
+        auto block = table->allocate(1000);
+        auto rows = block->rows();
+        for (int i = 0; i < 1000; ++i) {
+            int first = rand() % 1000;
+            (*rows)[i][0] = first;
+            (*rows)[i][1] = b * 1000 + i;
+            buffer.emplace_back(first, b * 1000 + i);
+        }
+    }
+    std::sort(buffer.begin(), buffer.end());
+    auto blocks = table->blocks()->collect();
+    vector<shared_ptr<Block>> forward;
+    for (auto &block: *blocks) {
+        forward.push_back(make_shared<ForwardBlock>(block));
+    }
+    TableView view(RAW, table->colSize(), unique_ptr<Stream<shared_ptr<Block>>>(
+            new VectorStream<shared_ptr<Block>>(forward)));
+
+    TopN top(20, SortKeyFactory().field(S_INT, 0)->field(S_INT, 1)->build());
+    auto sorted = top.sort(view);
+    auto sortedblock = (*sorted->blocks()->collect())[0];
+    ASSERT_EQ(20, sortedblock->size());
+    auto rows = sortedblock->rows();
+    for (int i = 0; i < 20; ++i) {
+        DataRow &row = rows->next();
+        EXPECT_EQ(buffer[i].first, row[0].asInt()) << i;
+        EXPECT_EQ(buffer[i].second, row[1].asInt()) << i;
+    }
+}
+
+TEST(TopNTest, ParallelBound) {
+    auto table = MemTable::Make(2);
+    vector<pair<double, int>> buffer;
+    for (int b = 0; b < 16; ++b) {
+        auto block = table->allocate(5000);
+        auto rows = block->rows();
+        for (int i = 0; i < 5000; ++i) {
+            // Later blocks hold larger values, so the published bound prunes earlier ones and vice versa
+            double value = (rand() % 100000) * 0.5 + b * 1000;
+            (*rows)[i][0] = value;
+            (*rows)[i][1] = b * 5000 + i;
+            buffer.emplace_back(-value, b * 5000 + i);
+        }
+    }
+    std::sort(buffer.begin(), buffer.end());
+
+    function<bool(DataRow *, DataRow *)> comparator = [](DataRow *a, DataRow *b) {
+        return SDGE(0) || (SDE(0) && SILE(1));
+    };
+    auto check = [&buffer](shared_ptr<Table> sorted) {
+        auto sortedblock = (*sorted->blocks()->collect())[0];
+        ASSERT_EQ(100, sortedblock->size());
+        auto rows = sortedblock->rows();
+        for (int i = 0; i < 100; ++i) {
+            DataRow &row = rows->next();
+            EXPECT_EQ(-buffer[i].first, row[0].asDouble()) << i;
+            EXPECT_EQ(buffer[i].second, row[1].asInt()) << i;
+        }
+    };
+    TopN top(100, comparator);
+    check(top.sort(*table));
+    // Run twice to check the bound is reset
+    check(top.sort(*table));
+
+    TopN keytop(100, SortKeyFactory().field(S_DOUBLE, 0, true)->build());
+    auto sorted = keytop.sort(*table);
+    auto sortedblock = (*sorted->blocks()->collect())[0];
+    ASSERT_EQ(100, sortedblock->size());
+    auto rows = sortedblock->rows();
+    for (int i = 0; i < 100; ++i) {
+        EXPECT_EQ(-buffer[i].first, rows->next()[0].asDouble()) << i;
+    }
+}
+
+TEST(ExternalSortTest, Spill) {
+    auto table = MemTable::Make(vector<uint32_t>{1, 2, 1});
+    vector<string> words;
+    for (int i = 0; i < 100; ++i) {
+        words.push_back("word" + to_string(i * 37 % 100) + string(i % 13, 'x'));
+    }
+    vector<pair<double, string>> expect;
+    for (int b = 0; b < 5; ++b) {
+        auto block = table->allocate(2000);
+        auto rows = block->rows();
+        for (int i = 0; i < 2000; ++i) {
+            auto &word = words[(i + b * 7) % words.size()];
+            ByteArray bytes(word.size(), reinterpret_cast<const uint8_t *>(word.data()));
+            double value = (rand() % 1000) * 0.25;
+            DataRow &row = (*rows)[i];
+            row[0] = value;
+            row[1] = bytes;
+            row[2] = b;
+            expect.emplace_back(value, word);
+        }
+    }
+    std::sort(expect.begin(), expect.end());
+
+    function<bool(DataRow *, DataRow *)> comparator = [](DataRow *a, DataRow *b) {
+        return SDLE(0) || (SDE(0) && SBLE(1));
+    };
+    // 64KB holds about 800 rows, and 4KB about 50 rows, which spills more runs than a merge takes
+    auto check = [&table, &expect](ExternalSort &sort, uint64_t budget) {
+        auto sorted = sort.sort(*table);
+        if (budget == SORT_MEMORY_BUDGET) {
+            EXPECT_EQ(0, sort.numRun());
+        } else {
+            EXPECT_GT(sort.numRun(), 5);
+        }
+        if (budget == 1ull << 12) {
+            EXPECT_GT(sort.numRun(), SORT_MERGE_FANIN);
+            EXPECT_EQ(1, sort.numPass());
+        } else {
+            EXPECT_EQ(0, sort.numPass());
+        }
+        // The merged blocks are streamed, so the result is read only once
+        auto blocks = sorted->blocks()->collect();
+        uint32_t index = 0;
+        for (auto &block: *blocks) {
+            auto rows = block->rows();
+            for (uint32_t i = 0; i < block->size(); ++i) {
+                DataRow &row = rows->next();
+                ASSERT_EQ(expect[index].first, row[0].asDouble()) << index;
+                auto &bytes = row[1].asByteArray();
+                ASSERT_EQ(expect[index].second, string(reinterpret_cast<const char *>(bytes.ptr), bytes.len))
+                                            << index;
+                ++index;
+            }
+        }
+        EXPECT_EQ(expect.size(), index);
+    };
+    for (uint64_t budget: {1ull << 12, 1ull << 16, SORT_MEMORY_BUDGET}) {
+        ExternalSort sort(comparator, budget);
+        check(sort, budget);
+        // Spill the keys with the rows. The 4-byte prefix is inexact, so rows with equal keys compare fields.
+        ExternalSort keysort(SortKeyFactory().field(S_DOUBLE, 0)->field(S_BYTES, 1, false, 4)->build(), budget);
+        check(keysort, budget);
+    }
+}
+
+TEST(ExternalSortTest, ReadMergedInParallel) {
+    auto table = MemTable::Make(1);
+    vector<int32_t> expect;
+    for (int b = 0; b < 4; ++b) {
+        auto block = table->allocate(50000);
+        auto rows = block->rows();
+        for (int i = 0; i < 50000; ++i) {
+            int32_t value = rand() % 1000000;
+            (*rows)[i][0] = value;
+            expect.push_back(value);
+        }
+    }
+    std::sort(expect.begin(), expect.end());
+
+    ExternalSort sort(SORTER1(0), 1ull << 20);
+    auto sorted = sort.sort(*table);
+    EXPECT_GT(sort.numRun(), 1);
+    auto blocks = sorted->blocks()->parallel()->collect();
+    EXPECT_EQ((expect.size() + SORT_OUTPUT_BLOCK - 1) / SORT_OUTPUT_BLOCK, blocks->size());
+    uint32_t index = 0;
+    for (auto &block: *blocks) {
+        auto rows = block->rows();
+        for (uint32_t i = 0; i < block->size(); ++i) {
+            ASSERT_EQ(expect[index], rows->next()[0].asInt()) << index;
+            ++index;
+        }
+    }
+    EXPECT_EQ(expect.size(), index);
+}
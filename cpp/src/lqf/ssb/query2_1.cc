@@ -38,14 +38,13 @@ namespace lqf {
             HashJoin partJoin(LineOrder::PARTKEY, Part::PARTKEY, new Q2RowBuilder());
             auto withPart = partJoin.join(*filteredLineorder, *filteredPart);
 
-            function<uint64_t(DataRow &)> hasher = [](DataRow &data) {
-                return (data(1).asInt() << 16) + data(2).asInt();
-            };
+            auto brandDict = partTable->LoadDictionary<ByteArrayType>(Part::BRAND);
             function<vector<AggField *>()> aggFields = []() {
                 return vector<AggField *>{new DoubleSum(0)};
             };
-            HashAgg agg(hasher, RowCopyFactory().field(F_REGULAR, 1, 0)
-                                ->field(F_REGULAR, 2, 1)->buildSnapshot(),
+            // Group by year and brand code on an array
+            DictAgg agg({DictDim(1, 7, 1992, false), DictDim(2, brandDict->size())},
+                        RowCopyFactory().field(F_REGULAR, 1, 0)->field(F_REGULAR, 2, 1)->buildSnapshot(),
                         aggFields);
             auto agged = agg.agg(*withPart);
 
@@ -55,9 +54,8 @@ namespace lqf {
             SmallSort sort(comparator);
             auto sorted = sort.sort(*agged);
 
-            auto brandDict = partTable->LoadDictionary<ByteArrayType>(Part::BRAND);
-            // TODO use dictionary to print column 1
-            Printer printer(PBEGIN PD(2) PI(0) PI(1) PEND);
+            auto brandDictp = brandDict.get();
+            Printer printer(PBEGIN PD(2) PI(0) PDICT(brandDictp, 1) PEND);
             printer.print(*sorted);
         }
 
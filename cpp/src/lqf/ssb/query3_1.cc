@@ -87,15 +87,17 @@ namespace lqf {
                                                                    {JRR(Customer::NATION), JL(1), JL(2), JL(3)}), true);
             auto allJoined = allJoin.join(*orderWithSupp, *filteredCustomer);
 
-            function<uint64_t(DataRow &)> hasher = [](DataRow &data) {
-                return (data[0].asInt() << 22) + (data[1].asInt() << 12) + data[2].asInt();
-            };
+            auto custNationDict = customerTable->LoadDictionary<ByteArrayType>(Customer::NATION);
+            auto suppNationDict = supplierTable->LoadDictionary<ByteArrayType>(Supplier::NATION);
             function<vector<AggField *>()> aggFields = []() {
                 return vector<AggField *>{new DoubleSum(3)};
             };
-            HashAgg agg(hasher, RowCopyFactory().field(F_REGULAR, 0, 0)
-                    ->field(F_REGULAR, 1, 1)
-                    ->field(F_REGULAR, 2, 2)->buildSnapshot(), aggFields);
+            // Group by nation codes and year on an array
+            DictAgg agg({DictDim(0, custNationDict->size()), DictDim(1, suppNationDict->size()),
+                         DictDim(2, 7, 1992, false)},
+                        RowCopyFactory().field(F_REGULAR, 0, 0)
+                                ->field(F_REGULAR, 1, 1)
+                                ->field(F_REGULAR, 2, 2)->buildSnapshot(), aggFields);
             auto agged = agg.agg(*allJoined);
 
             function<bool(DataRow *, DataRow *)> comparator = [](DataRow *a, DataRow *b) {
@@ -104,8 +106,9 @@ namespace lqf {
             SmallSort sort(comparator);
             auto sorted = sort.sort(*agged);
 
-            // TODO use dictionary to print column 1
-            Printer printer(PBEGIN PI(0) PI(1) PI(2) PD(3) PEND);
+            auto custNationDictp = custNationDict.get();
+            auto suppNationDictp = suppNationDict.get();
+            Printer printer(PBEGIN PDICT(custNationDictp, 0) PDICT(suppNationDictp, 1) PI(2) PD(3) PEND);
             printer.print(*sorted);
         }
 
@@ -59,14 +59,13 @@ namespace lqf {
             HashJoin withCustJoin(LineOrder::CUSTKEY, Customer::CUSTKEY, new OrderProfitBuilder());
             auto validOrder = withCustJoin.join(*orderOnValidSP, *filteredCustomer);
 
-            function<uint64_t(DataRow &)> hasher = [](DataRow &data) {
-                return (data[0].asInt() << 10) + data[1].asInt();
-            };
+            auto nationDict = customerTable->LoadDictionary<ByteArrayType>(Customer::NATION);
             function<vector<AggField *>()> aggFields = []() {
                 return vector<AggField *>{new DoubleSum(2)};
             };
-            HashAgg agg(hasher, RowCopyFactory().field(F_REGULAR, 0, 0)
-                    ->field(F_REGULAR, 1, 1)->buildSnapshot(), aggFields);
+            // Group by year and nation code on an array
+            DictAgg agg({DictDim(0, 7, 1992, false), DictDim(1, nationDict->size())},
+                        RowCopyFactory().field(F_REGULAR, 0, 0)->field(F_REGULAR, 1, 1)->buildSnapshot(), aggFields);
             auto agged = agg.agg(*validOrder);
 
             function<bool(DataRow *, DataRow *)> comparator = [](DataRow *a, DataRow *b) {
@@ -75,8 +74,8 @@ namespace lqf {
             SmallSort sort(comparator);
             auto sorted = sort.sort(*agged);
 
-            // TODO use dictionary to print column 1
-            Printer printer(PBEGIN PI(0) PI(1) PD(2) PEND);
+            auto nationDictp = nationDict.get();
+            Printer printer(PBEGIN PI(0) PDICT(nationDictp, 1) PD(2) PEND);
             printer.print(*sorted);
         }
 
@@ -621,6 +621,15 @@ namespace lqf {
             return evaluator_->collect(source_.get(), mapper_.get());
         }
 
+        inline bool isEmpty() {
+            return !source_->hasNext();
+        }
+
+        /// Evaluate the first element in the caller thread, the stream continues with the rest
+        T head() {
+            return (*mapper_)(source_->next());
+        }
+
         // For simplicity we assume there is at least one valid element
         template<typename REDUCER>
         T reduce(REDUCER reducer) {
@@ -3,6 +3,7 @@
 //
 #include <benchmark/benchmark.h>
 #include <lqf/agg.h>
+#include <lqf/agg_key.h>
 #include <lqf/join.h>
 #include "tpchquery.h"
 
@@ -61,4 +62,26 @@ BENCHMARK_F(AggBenchmark, StringWithSparse)(benchmark::State &state) {
         auto result = agg.agg(*table);
         size_ = result->size();
     }
-}
\ No newline at end of file
+}
+
+BENCHMARK_F(AggBenchmark, BytesKey)(benchmark::State &state) {
+    for (auto _ : state) {
+        auto table = ParquetTable::Open(LineItem::path, {LineItem::RECEIPTDATE});
+        KeyHashAgg agg(BytesKey(ByteArrayKey(LineItem::RECEIPTDATE)),
+                       RowCopyFactory().field(F_STRING, LineItem::RECEIPTDATE, 0)->buildSnapshot(),
+                       []() { return vector<AggField *>{new Count()}; });
+        auto result = agg.agg(*table);
+        size_ = result->size();
+    }
+}
+
+BENCHMARK_F(AggBenchmark, DictKey)(benchmark::State &state) {
+    for (auto _ : state) {
+        auto table = ParquetTable::Open(LineItem::path, {LineItem::RECEIPTDATE});
+        KeyHashAgg agg(PackedKey(DictKey<>(LineItem::RECEIPTDATE)),
+                       RowCopyFactory().field(F_RAW, LineItem::RECEIPTDATE, 0)->buildSnapshot(),
+                       []() { return vector<AggField *>{new Count()}; });
+        auto result = agg.agg(*table);
+        size_ = result->size();
+    }
+}
@@ -35,7 +35,7 @@ BENCHMARK_F(FilterBenchmark, Normal)(benchmark::State &state) {
 BENCHMARK_F(FilterBenchmark, LQF)(benchmark::State &state) {
     for (auto _ : state) {
         auto table = ParquetTable::Open(LineItem::path, {LineItem::SHIPDATE,LineItem::RECEIPTDATE});
-        SboostRowFilter rf(LineItem::SHIPDATE,LineItem::RECEIPTDATE);
+        ColFilter rf(new ByteArrayColCompare(LineItem::SHIPDATE, LineItem::RECEIPTDATE, LESS));
         auto result = rf.filter(*table);
         size_ = result->size();
     }
@@ -80,7 +80,7 @@ namespace lqf {
                          aggFields);
             auto agged = agg.agg(*filtered);
 //
-            SmallSort sort(SORTER2(0, 1));
+            SmallSort sort(SortKeyFactory().field(S_INT, 0)->field(S_INT, 1)->build());
             auto sorted = sort.sort(*agged);
 
             auto dict1 = lineItemTable->LoadDictionary<ByteArrayType>(LineItem::RETURNFLAG);
@@ -138,7 +138,7 @@ namespace lqf {
                                                       ->field(F_RAW, LineItem::LINESTATUS, 1)->buildSnapshot(),
                                               aggFields), {colFilter});
 
-            auto sort = graph.add(new SmallSort(SORTER2(0, 1)), {agg});
+            auto sort = graph.add(new SmallSort(SortKeyFactory().field(S_INT, 0)->field(S_INT, 1)->build()), {agg});
 
             auto dict1 = lineItem->LoadDictionary<ByteArrayType>(LineItem::RETURNFLAG);
             auto dict2 = lineItem->LoadDictionary<ByteArrayType>(LineItem::LINESTATUS);
@@ -195,7 +195,7 @@ namespace lqf {
                                                       ->field(F_RAW, LineItem::LINESTATUS, 1)->buildSnapshot(),
                                               aggFields), {colFilter});
 
-            auto sort = graph.add(new SmallSort(SORTER2(0, 1)), {agg});
+            auto sort = graph.add(new SmallSort(SortKeyFactory().field(S_INT, 0)->field(S_INT, 1)->build()), {agg});
 
             auto dict1 = lineItem->LoadDictionary<ByteArrayType>(LineItem::RETURNFLAG);
             auto dict2 = lineItem->LoadDictionary<ByteArrayType>(LineItem::LINESTATUS);
@@ -68,10 +68,16 @@ namespace lqf {
                                              {lineitemFilter, orderDateFilter});
             // CUSTKEY, REV
 
-            auto itemAgg = graph.add(new HashAgg(COL_HASHER(0),
-                                                 RowCopyFactory().field(F_REGULAR, 0, 0)->buildSnapshot(),
-                                                 []() { return vector<AggField *>({new DoubleSum(1)}); }),
-                                     {orderItemFilter});
+            function<bool(DataRow *, DataRow *)> comparator = [](DataRow *a, DataRow *b) {
+                return SDGE(1);
+            };
+            // Revenue is non-negative, so the ranking is bound by it
+            auto topAgg = new HashTopKAgg(20, comparator, COL_HASHER(0),
+                                          RowCopyFactory().field(F_REGULAR, 0, 0)->buildSnapshot(),
+                                          []() { return vector<AggField *>({new DoubleSum(1, true)}); });
+            topAgg->setBound(0);
+            auto top = graph.add(topAgg, {orderItemFilter});
+            // CUSTKEY, REV
 //            auto itemAgg = graph.add(new StripeHashAgg(30, COL_HASHER(0), COL_HASHER(0),
 //                                                       RowCopyFactory().field(F_REGULAR, 0, 0)
 //                                                               ->field(F_REGULAR, 1, 1)->buildSnapshot(),
@@ -79,12 +85,6 @@ namespace lqf {
 //                                                       []() { return vector<AggField *>({new DoubleSum(1)}); }),
 //                                     {orderItemFilter});
 
-            function<bool(DataRow *, DataRow *)> comparator = [](DataRow *a, DataRow *b) {
-                return SDGE(1);
-            };
-            auto top = graph.add(new TopN(20, comparator), {itemAgg});
-            // CUSTKEY, REV
-
             auto customerJoin = graph.add(new HashJoin(Customer::CUSTKEY, 0, new RowBuilder(
                     {JR(1), JL(Customer::NATIONKEY), JLS(Customer::NAME), JL(Customer::ACCTBAL), JLS(Customer::ADDRESS),
                      JLS(Customer::PHONE), JLS(Customer::COMMENT)}, false)), {customer, top});
@@ -127,17 +127,15 @@ namespace lqf {
             // CUSTKEY, REV
             validLineitem = orderItemFilter.join(*validLineitem, *validOrder);
 
-            HashAgg itemAgg(COL_HASHER(0),
-                            RowCopyFactory().field(F_REGULAR, 0, 0)->buildSnapshot(),
-                            []() { return vector<AggField *>({new DoubleSum(1)}); });
-            auto agglineitem = itemAgg.agg(*validLineitem);
-
             function<bool(DataRow *, DataRow *)> comparator = [](DataRow *a, DataRow *b) {
                 return SDGE(1);
             };
-            TopN top(20, comparator);
+            HashTopKAgg top(20, comparator, COL_HASHER(0),
+                            RowCopyFactory().field(F_REGULAR, 0, 0)->buildSnapshot(),
+                            []() { return vector<AggField *>({new DoubleSum(1, true)}); });
+            top.setBound(0);
             // CUSTKEY, REV
-            auto sorted = top.sort(*agglineitem);
+            auto sorted = top.agg(*validLineitem);
 
             HashJoin customerJoin(Customer::CUSTKEY, 0, new RowBuilder(
                     {JR(1), JL(Customer::NATIONKEY), JLS(Customer::NAME), JL(Customer::ACCTBAL), JLS(Customer::ADDRESS),
@@ -132,7 +132,9 @@ namespace lqf {
                                                                               }))});
             auto validLineitem = lineitemFilter.filter(*lineitem);
 
-            SboostRow2Filter lineItemAgainFilter(LineItem::SHIPDATE, LineItem::COMMITDATE, LineItem::RECEIPTDATE);
+            ColFilter lineItemAgainFilter(
+                    {new ByteArrayColCompare(LineItem::SHIPDATE, LineItem::COMMITDATE, LESS),
+                     new ByteArrayColCompare(LineItem::COMMITDATE, LineItem::RECEIPTDATE, LESS)});
 //
 //            [](DataRow &row) {
 //                auto &commitDate = row[LineItem::COMMITDATE].asByteArray();
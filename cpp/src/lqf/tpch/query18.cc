@@ -36,12 +36,10 @@ namespace lqf {
                     new TableNode(ParquetTable::Open(Customer::path, {Customer::NAME, Customer::CUSTKEY})), {});
 
             auto hashAgg = graph.add(
-                    new StripeHashAgg(32, COL_HASHER(LineItem::ORDERKEY), COL_HASHER(0),
-                                      RowCopyFactory().field(F_REGULAR, LineItem::ORDERKEY, 0)
-                                              ->field(F_REGULAR, LineItem::QUANTITY, 1)->buildSnapshot(),
-                                      RowCopyFactory().field(F_REGULAR, 0, 0)->buildSnapshot(),
-                                      []() { return vector<AggField *>{new IntSum(1)}; },
-                                      [=](DataRow &row) { return row[1].asInt() > quantity; }),
+                    new HashAgg(COL_HASHER(LineItem::ORDERKEY),
+                                RowCopyFactory().field(F_REGULAR, LineItem::ORDERKEY, 0)->buildSnapshot(),
+                                []() { return vector<AggField *>{new IntSum(LineItem::QUANTITY)}; },
+                                [=](DataRow &row) { return row[1].asInt() > quantity; }),
                     {lineitem});
             // ORDERKEY, SUM_QUANTITY
 
@@ -73,12 +71,11 @@ namespace lqf {
             auto lineitem = ParquetTable::Open(LineItem::path, {LineItem::ORDERKEY, LineItem::QUANTITY});
             auto customer = ParquetTable::Open(Customer::path, {Customer::NAME, Customer::CUSTKEY});
 
-            StripeHashAgg hashAgg(32, COL_HASHER(LineItem::ORDERKEY), COL_HASHER(0),
-                                  RowCopyFactory().field(F_REGULAR, LineItem::ORDERKEY, 0)
-                                          ->field(F_REGULAR, LineItem::QUANTITY, 1)->buildSnapshot(),
-                                  RowCopyFactory().field(F_REGULAR, 0, 0)->buildSnapshot(),
-                                  []() { return vector<AggField *>{new IntSum(1)}; },
-                                  [=](DataRow &row) { return row[1].asInt() > quantity; });
+            // The group count is close to ORDERS, HashAgg runs it as a two-phase partitioned aggregation
+            HashAgg hashAgg(COL_HASHER(LineItem::ORDERKEY),
+                            RowCopyFactory().field(F_REGULAR, LineItem::ORDERKEY, 0)->buildSnapshot(),
+                            []() { return vector<AggField *>{new IntSum(LineItem::QUANTITY)}; },
+                            [=](DataRow &row) { return row[1].asInt() > quantity; });
             // ORDERKEY, SUM_QUANTITY
             auto validLineitem = hashAgg.agg(*lineitem);
 
@@ -50,12 +50,7 @@ namespace lqf {
             auto matSupplier = graph.add(new FilterMat(), {suppFilter});
 
 
-            auto partFilter = graph.add(new ColFilter(
-                    new SimplePredicate(Part::NAME, [](const DataField &field) {
-                        ByteArray &val = field.asByteArray();
-                        char *start = (char *) val.ptr;
-                        return lqf::util::strnstr(start, "forest", val.len) == start;
-                    })), {part});
+            auto partFilter = graph.add(new ColFilter(new LikePredicate(Part::NAME, "forest%")), {part});
 
             auto partfilterPs = graph.add(new FilterJoin(PartSupp::PARTKEY, Part::PARTKEY), {partsupp, partFilter});
 //            auto validps = partfilterPs.join(*partsupp, *validpart);
@@ -142,12 +137,7 @@ namespace lqf {
                                                                 bind(&Int32DictEq::build, 3)));
             auto validSupplier = fmat.mat(*suppFilter.filter(*supplier));
 
-            ColFilter partFilter(
-                    new SimplePredicate(Part::NAME, [](const DataField &field) {
-                        ByteArray &val = field.asByteArray();
-                        char *start = (char *) val.ptr;
-                        return lqf::util::strnstr(start, "forest", val.len) == start;
-                    }));
+            ColFilter partFilter(new LikePredicate(Part::NAME, "forest%"));
             auto validpart = partFilter.filter(*part);
 
             FilterJoin partfilterPs(PartSupp::PARTKEY, Part::PARTKEY);
@@ -113,8 +113,8 @@ namespace lqf {
 //            auto linedateFilter = graph.add(new RowFilter([](DataRow &row) {
 //                return row[LineItem::RECEIPTDATE].asByteArray() > row[LineItem::COMMITDATE].asByteArray();
 //            }), {linewithorder});
-            auto linedateFilter = graph.add(new SboostRowFilter(LineItem::COMMITDATE, LineItem::RECEIPTDATE),
-                                            {linewithorder});
+            auto linedateFilter = graph.add(new ColFilter(
+                    new ByteArrayColCompare(LineItem::COMMITDATE, LineItem::RECEIPTDATE, LESS)), {linewithorder});
 
             auto l1withdate = graph.add(new FilterMat(), {linedateFilter});
 
@@ -197,7 +197,7 @@ namespace lqf {
             FilterJoin lineWithOrderJoin(LineItem::ORDERKEY, Orders::ORDERKEY, 3600000);
             auto linewithorder = mat.mat(*lineWithOrderJoin.join(*lineitem, *validorder));
 
-            SboostRowFilter linedateFilter(LineItem::COMMITDATE, LineItem::RECEIPTDATE);
+            ColFilter linedateFilter(new ByteArrayColCompare(LineItem::COMMITDATE, LineItem::RECEIPTDATE, LESS));
             auto l1withdate = mat.mat(*linedateFilter.filter(*linewithorder));
 
             ColFilter supplierNationFilter(new SboostPredicate<Int32Type>(Supplier::NATIONKEY,
@@ -265,7 +265,7 @@ namespace lqf {
                                                                      bind(&ByteArrayDictEq::build, status)));
             auto validorder = orderFilter.filter(*order);
 
-            SboostRowFilter linedateFilter(LineItem::COMMITDATE, LineItem::RECEIPTDATE);
+            ColFilter linedateFilter(new ByteArrayColCompare(LineItem::COMMITDATE, LineItem::RECEIPTDATE, LESS));
             auto validitems = mat.mat(*linedateFilter.filter(*lineitem));
 
             HashMat hashMat(Orders::ORDERKEY, nullptr);
@@ -7,6 +7,7 @@
 #include <lqf/filter.h>
 #include <lqf/join.h>
 #include <lqf/agg.h>
+#include <lqf/agg_key.h>
 #include <lqf/sort.h>
 #include <lqf/print.h>
 #include "tpchquery.h"
@@ -64,30 +65,21 @@ namespace lqf {
                      JRR(Orders::SHIPPRIORITY)}, true), nullptr, 3000000), {lineItemFilter, orderOnCustFilterJoin});
             // ORDERKEY EXTENDEDPRICE DISCOUNT ORDERDATE SHIPPRIORITY
 
-            function<uint64_t(DataRow &)> hasher = [](DataRow &data) {
-                int orderkey = data[0].asInt();
-                int shipdate = data[3].asInt();
-                int priority = data[4].asInt();
-                uint64_t key = 0;
-                key += static_cast<uint64_t>(orderkey) << 32;
-                key += shipdate << 5;
-                key += priority;
-                return key;
-            };
+            // ORDERKEY, ORDERDATE code, SHIPPRIORITY code
+            PackedKey key(IntKey<>(0), DictKey<27>(3), DictKey<5>(4));
             function<vector<AggField *>()> aggFields = []() {
                 return vector<AggField *>{new PriceField()};
             };
-            auto orderItemAgg = graph.add(new HashAgg(hasher, RowCopyFactory().field(F_REGULAR, 0, 0)
+            auto orderItemAgg = graph.add(new KeyHashAgg(key, RowCopyFactory().field(F_REGULAR, 0, 0)
                                                   ->field(F_REGULAR, 3, 1)
                                                   ->field(F_REGULAR, 4, 2)
                                                   ->buildSnapshot(), aggFields),
                                           {orderItemJoin});
 //            orderItemAgg.useVertical();
 
-            auto comparator = [](DataRow *a, DataRow *b) {
-                return SDGE(3) || (SDE(3) && SILE(2));
-            };
-            auto sort = graph.add(new TopN(10, comparator), {orderItemAgg});
+            // REVENUE DESC, ORDERDATE
+            auto sort = graph.add(new TopN(10, SortKeyFactory().field(S_DOUBLE, 3, true)->field(S_INT, 2)->build()),
+                                  {orderItemAgg});
 
             auto orderdateDict = orderTable->LoadDictionary<ByteArrayType>(Orders::ORDERDATE);
             auto shippriorityDict = orderTable->LoadDictionary<ByteArrayType>(Orders::SHIPPRIORITY);
@@ -132,29 +124,19 @@ namespace lqf {
             // ORDERKEY EXTENDEDPRICE DISCOUNT ORDERDATE SHIPPRIORITY
             auto orderItemTable = orderItemJoin.join(*filteredLineItemTable, *filteredOrderTable);
 
-            function<uint64_t(DataRow &)> hasher = [](DataRow &data) {
-                int orderkey = data[0].asInt();
-                int shipdate = data[3].asInt();
-                int priority = data[4].asInt();
-                uint64_t key = 0;
-                key += static_cast<uint64_t>(orderkey) << 32;
-                key += shipdate << 5;
-                key += priority;
-                return key;
-            };
+            // ORDERKEY, ORDERDATE code, SHIPPRIORITY code
+            PackedKey key(IntKey<>(0), DictKey<27>(3), DictKey<5>(4));
             function<vector<AggField *>()> aggFields = []() {
                 return vector<AggField *>{new PriceField()};
             };
-            HashAgg orderItemAgg(hasher, RowCopyFactory().field(F_REGULAR, 0, 0)
-                                         ->field(F_REGULAR, 3, 1)->field(F_REGULAR, 4, 2)->buildSnapshot(),
-                                 aggFields);
+            KeyHashAgg orderItemAgg(key, RowCopyFactory().field(F_REGULAR, 0, 0)
+                                            ->field(F_REGULAR, 3, 1)->field(F_REGULAR, 4, 2)->buildSnapshot(),
+                                    aggFields);
 //            orderItemAgg.useVertical();
             auto result = orderItemAgg.agg(*orderItemTable);
 
-            auto comparator = [](DataRow *a, DataRow *b) {
-                return SDGE(3) || (SDE(3) && SILE(2));
-            };
-            TopN sort(10, comparator);
+            // REVENUE DESC, ORDERDATE
+            TopN sort(10, SortKeyFactory().field(S_DOUBLE, 3, true)->field(S_INT, 2)->build());
             result = sort.sort(*result);
 
             auto orderdateDict = orderTable->LoadDictionary<ByteArrayType>(Orders::ORDERDATE);
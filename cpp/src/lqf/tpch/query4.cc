@@ -41,8 +41,8 @@ namespace lqf {
 //            auto lineItemFilter = graph.add(new RowFilter([](DataRow &datarow) {
 //                return datarow[LineItem::COMMITDATE].asByteArray() < datarow[LineItem::RECEIPTDATE].asByteArray();
 //            }), {lineitem});
-            auto lineItemFilter = graph.add(new SboostRowFilter(LineItem::COMMITDATE, LineItem::RECEIPTDATE),
-                                            {lineitem});
+            auto lineItemFilter = graph.add(new ColFilter(
+                    new ByteArrayColCompare(LineItem::COMMITDATE, LineItem::RECEIPTDATE, LESS)), {lineitem});
 
             auto existJoin = graph.add(new FilterJoin(Orders::ORDERKEY, LineItem::ORDERKEY, 3000000),
                                        {orderFilter, lineItemFilter});
@@ -80,7 +80,7 @@ namespace lqf {
                                                         bind(&ByteArrayDictRangele::build, dateFrom, dateTo))});
             auto filteredOrderTable = orderFilter.filter(*orderTable);
 
-            SboostRowFilter lineItemFilter(LineItem::COMMITDATE, LineItem::RECEIPTDATE);
+            ColFilter lineItemFilter(new ByteArrayColCompare(LineItem::COMMITDATE, LineItem::RECEIPTDATE, LESS));
             auto filteredLineItemTable = lineItemFilter.filter(*lineitemTable);
 
 //            auto set = make_shared<unordered_set<int32_t>>();
@@ -120,6 +120,7 @@ namespace lqf {
         };
         using namespace q9;
         using namespace powerjoin;
+        using namespace compositejoin;
 
         void executeQ9() {
             ExecutionGraph graph;
@@ -140,10 +141,7 @@ namespace lqf {
             auto nationTable = ParquetTable::Open(Nation::path, {Nation::NATIONKEY, Nation::NAME});
             auto nation = graph.add(new TableNode(nationTable), {});
 
-            auto partFilter = graph.add(new ColFilter(new SimplePredicate(Part::NAME, [](const DataField &field) {
-                auto &ref = field.asByteArray();
-                return lqf::util::strnstr((const char *) ref.ptr, "green", ref.len);
-            })), {part});
+            auto partFilter = graph.add(new ColFilter(new LikePredicate(Part::NAME, "%green%")), {part});
 
             auto itemPartJoin = graph.add(new FilterJoin(LineItem::PARTKEY, Part::PARTKEY), {lineitem, partFilter});
             auto validItem = graph.add(new FilterMat(), {itemPartJoin});
@@ -159,11 +157,12 @@ namespace lqf {
             // PARTKEY SUPPKEY PRICE_DISCOUNT QUANTITY YEAR
 
             auto pskey_maker = COL_HASHER2(PartSupp::PARTKEY, PartSupp::SUPPKEY);
-            auto itemkey_maker = COL_HASHER2(0, 1);
 
             auto psFilter = graph.add(new PartSuppFilter(new PowerMapFilter(pskey_maker)), {partsupp, itemProcessor});
 
-            auto ps2lJoin = graph.add(new PowerHashJoin(itemkey_maker, pskey_maker, new ItemWithRevBuilder()),
+            auto ps2lJoin = graph.add(new CompositeHashJoin({{0, K_INT}, {1, K_INT}},
+                                                            {{PartSupp::PARTKEY, K_INT}, {PartSupp::SUPPKEY, K_INT}},
+                                                            new ItemWithRevBuilder()),
                                       {itemOrderJoin, psFilter});
             // SUPPKEY, ORDER_YEAR, REV
 
@@ -207,10 +206,7 @@ namespace lqf {
             auto supplier = ParquetTable::Open(Supplier::path, {Supplier::NATIONKEY, Supplier::SUPPKEY});
             auto nation = ParquetTable::Open(Nation::path, {Nation::NATIONKEY, Nation::NAME});
 
-            ColFilter partFilter(new SimplePredicate(Part::NAME, [](const DataField &field) {
-                auto &ref = field.asByteArray();
-                return lqf::util::strnstr((const char *) ref.ptr, "green", ref.len);
-            }));
+            ColFilter partFilter(new LikePredicate(Part::NAME, "%green%"));
             auto validPart = partFilter.filter(*part);
 
             FilterMat filterMat;
@@ -246,12 +242,13 @@ namespace lqf {
             auto orderLineitem = itemOrderJoin.join(*validLineitem, *filteredOrders);
 
             auto pskey_maker = COL_HASHER2(PartSupp::PARTKEY, PartSupp::SUPPKEY);
-            auto itemkey_maker = COL_HASHER2(0, 1);
 
             PowerMapFilter psFilter(pskey_maker, partsuppkeys);
             auto validps = psFilter.filter(*partsupp);
 
-            PowerHashJoin ps2lJoin(itemkey_maker, pskey_maker, new ItemWithRevBuilder());
+            CompositeHashJoin ps2lJoin({{0, K_INT}, {1, K_INT}},
+                                       {{PartSupp::PARTKEY, K_INT}, {PartSupp::SUPPKEY, K_INT}},
+                                       new ItemWithRevBuilder());
             // SUPPKEY, ORDER_YEAR, REV
             auto itemWithRev = ps2lJoin.join(*orderLineitem, *validps);
 